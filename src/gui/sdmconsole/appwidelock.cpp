@@ -23,8 +23,11 @@
 #include "appwidelock.h"
 
 #include "fruntime_error.h"
+#include "sdmplug.h"
+#include "treeitem.h"
 
 #include <chrono>
+#include <algorithm>
 
 #include <QCoreApplication>
 
@@ -42,7 +45,60 @@ AppWideLock::lock_t AppWideLock::getTimedLock(int msec) {
 }
 
 AppWideLock::lock_t AppWideLock::guiLock() {
-	lock_t lock=lock_t(mutex(),std::chrono::milliseconds(1000));
+	return guiLock(mutex());
+}
+
+AppWideLock::lock_t AppWideLock::getLock(mutex_t &m) {
+	return lock_t(m);
+}
+
+AppWideLock::lock_t AppWideLock::getTimedLock(mutex_t &m,int msec) {
+	return lock_t(m,std::chrono::milliseconds(msec));
+}
+
+AppWideLock::lock_t AppWideLock::guiLock(mutex_t &m) {
+	lock_t lock=lock_t(m,std::chrono::milliseconds(1000));
 	if(!lock) throw fruntime_error(QCoreApplication::translate("AppWideLock","Device is busy"));
 	return lock;
 }
+
+AppWideLock::lock_t AppWideLock::parentLock(TreeItem &item) {
+	if(auto obj=dynamic_cast<SDMBase*>(item.parent())) return getLock(*obj->mutex());
+	return getLock();
+}
+
+/*
+ * AppWideLock::ObjectLock members
+ */
+
+static void collectMutexes(TreeItem &item,std::vector<std::shared_ptr<AppWideLock::mutex_t> > &mutexes) {
+// Children can be opened or closed by Lua while holding this mutex
+	AppWideLock::lock_t lock;
+	if(auto obj=dynamic_cast<SDMBase*>(&item)) lock=AppWideLock::guiLock(*obj->mutex());
+	for(std::size_t i=0;i<item.children();i++) {
+		if(auto obj=dynamic_cast<SDMBase*>(&item.child(i))) mutexes.push_back(obj->mutex());
+		collectMutexes(item.child(i),mutexes);
+	}
+}
+
+void AppWideLock::ObjectLock::lock(SDMBase &obj,bool recursive) try {
+	_global=guiLock();
+	_mutexes.push_back(obj.mutex());
+	if(recursive) {
+		if(auto item=dynamic_cast<TreeItem*>(&obj)) collectMutexes(*item,_mutexes);
+	}
+// Lock object mutexes in a fixed order
+	std::sort(_mutexes.begin(),_mutexes.end());
+	_mutexes.erase(std::unique(_mutexes.begin(),_mutexes.end()),_mutexes.end());
+	for(auto const &m: _mutexes) _locks.push_back(guiLock(*m));
+}
+catch(...) {
+	unlock();
+	throw;
+}
+
+void AppWideLock::ObjectLock::unlock() {
+	while(!_locks.empty()) _locks.pop_back();
+	_mutexes.clear();
+	if(_global) _global.unlock();
+}
@@ -17,12 +17,22 @@
  * along with SDM framework.  If not, see <https://www.gnu.org/licenses/>.
  *
  * This header file defines a global mutex namespace;
+ *
+ * The global mutex protects the object tree together with the parent
+ * object mutexes (see parentLock()). Calls to SDM objects are
+ * serialized by object mutexes (see SDMBase::mutex()) which are shared
+ * according to the thread safety level declared by the plugin.
  */
 
 #ifndef APPWIDELOCK_H_INCLUDED
 #define APPWIDELOCK_H_INCLUDED
 
 #include <mutex>
+#include <memory>
+#include <vector>
+
+class SDMBase;
+class TreeItem;
 
 namespace AppWideLock {
 	typedef std::recursive_timed_mutex mutex_t;
@@ -32,6 +42,34 @@ namespace AppWideLock {
 	lock_t getLock();
 	lock_t getTimedLock(int msec);
 	lock_t guiLock();
+	
+// Object mutex locks
+	lock_t getLock(mutex_t &m);
+	lock_t getTimedLock(mutex_t &m,int msec);
+	lock_t guiLock(mutex_t &m);
+	
+// Objects are added to and removed from the tree while holding the
+// mutex of their parent (the global mutex for plugins), and the tree
+// is walked holding it as well. Locks the parent mutex of the item.
+	lock_t parentLock(TreeItem &item);
+	
+// Locks the global mutex and the object mutex from the GUI thread,
+// throws if the device is busy. Recursive locks also obtain mutexes
+// of object descendants, which is required before closing the object.
+	class ObjectLock {
+		lock_t _global;
+		std::vector<std::shared_ptr<mutex_t> > _mutexes; // keep mutexes alive while locked
+		std::vector<lock_t> _locks;
+	public:
+		ObjectLock() {}
+		explicit ObjectLock(SDMBase &obj,bool recursive=false) {lock(obj,recursive);}
+		ObjectLock(const ObjectLock &)=delete;
+		
+		ObjectLock &operator=(const ObjectLock &)=delete;
+		
+		void lock(SDMBase &obj,bool recursive=false);
+		void unlock();
+	};
 }
 
 #endif
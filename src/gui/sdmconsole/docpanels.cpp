@@ -115,7 +115,7 @@ void PluginPanel::addButton(const QString &text,const QString &cmd) {
 }
 
 void PluginPanel::closePlugin() try {
-	AppWideLock::lock_t am(AppWideLock::guiLock());
+	AppWideLock::ObjectLock am(plugin,true);
 	plugin.close();
 }
 catch(std::exception &ex) {
@@ -126,7 +126,7 @@ void PluginPanel::openDevice() try {
 	int iDev;
 	
 	try {
-		auto lock=AppWideLock::guiLock();
+		AppWideLock::ObjectLock lock(plugin);
 		auto const &deviceList=plugin.listProperties("Devices");
 		lock.unlock();
 		if(deviceList.empty()) throw std::runtime_error("Device list is empty");
@@ -151,7 +151,7 @@ void PluginPanel::openDevice() try {
 		iDev=d.intValue();
 	}
 	
-	auto lock=AppWideLock::guiLock();
+	AppWideLock::ObjectLock lock(plugin);
 	plugin.addDeviceItem(iDev);
 }
 catch(std::exception &ex) {
@@ -211,7 +211,7 @@ void DevicePanel::addButton(const QString &text,const QString &cmd) {
 }
 
 void DevicePanel::closeDevice() try {
-	AppWideLock::lock_t am(AppWideLock::guiLock());
+	AppWideLock::ObjectLock am(device,true);
 	device.close();
 }
 catch(std::exception &ex) {
@@ -220,7 +220,7 @@ catch(std::exception &ex) {
 
 void DevicePanel::connect() try {
 	try {
-		auto lock=AppWideLock::guiLock();
+		AppWideLock::ObjectLock lock(device);
 		auto const &pars=device.listProperties("ConnectionParameters");
 		lock.unlock();
 		if(pars.empty()) throw std::runtime_error("ConnectionParameters is empty");
@@ -260,7 +260,7 @@ void DevicePanel::connect() try {
 		}
 	} catch(std::exception &) {}
 	
-	auto lock=AppWideLock::guiLock();
+	AppWideLock::ObjectLock lock(device);
 	refresh();
 	device.connect();
 }
@@ -269,7 +269,7 @@ catch(std::exception &ex) {
 }
 
 void DevicePanel::disconnect() try {
-	AppWideLock::lock_t am(AppWideLock::guiLock());
+	AppWideLock::ObjectLock am(device);
 	device.disconnect();
 }
 catch(std::exception &ex) {
@@ -280,7 +280,7 @@ void DevicePanel::openChannel() try {
 	int iChannel;
 	
 	try {
-		auto lock=AppWideLock::guiLock();
+		AppWideLock::ObjectLock lock(device);
 		auto const &channelList=device.listProperties("Channels");
 		lock.unlock();
 		if(channelList.empty()) throw std::runtime_error("Channel list is empty");
@@ -305,7 +305,7 @@ void DevicePanel::openChannel() try {
 		iChannel=d.intValue();
 	}
 	
-	auto lock=AppWideLock::guiLock();
+	AppWideLock::ObjectLock lock(device);
 	device.addChannelItem(iChannel);
 }
 catch(std::exception &ex) {
@@ -316,7 +316,7 @@ void DevicePanel::openSource() try {
 	int iSource;
 	
 	try {
-		auto lock=AppWideLock::guiLock();
+		AppWideLock::ObjectLock lock(device);
 		auto const &sourceList=device.listProperties("Sources");
 		lock.unlock();
 		if(sourceList.empty()) throw std::runtime_error("Source list is empty");
@@ -341,7 +341,7 @@ void DevicePanel::openSource() try {
 		iSource=d.intValue();
 	}
 	
-	auto lock=AppWideLock::guiLock();
+	AppWideLock::ObjectLock lock(device);
 	device.addSourceItem(iSource);
 }
 catch(std::exception &ex) {
@@ -400,7 +400,7 @@ void ChannelPanel::addButton(const QString &text,const QString &cmd) {
 }
 
 void ChannelPanel::closeChannel() try {
-	AppWideLock::lock_t am(AppWideLock::guiLock());
+	AppWideLock::ObjectLock am(channel,true);
 	channel.close();
 }
 catch(std::exception &ex) {
@@ -408,7 +408,7 @@ catch(std::exception &ex) {
 }
 
 void ChannelPanel::showRegisterMap() try {
-	AppWideLock::lock_t am(AppWideLock::guiLock());
+	AppWideLock::ObjectLock am(channel);
 	channel.registerMap();
 }
 catch(std::exception &ex) {
@@ -527,15 +527,22 @@ SourcePanel::SourcePanel(DocSource &src,QWidget *parent):
 	QObject::connect(&source,&DocSource::streamErrorsChanged,[=](int i){errors->setText(QString::number(i));});
 	layout->addWidget(errors,7,1);
 	
+// Packet loss detected from sequence numbers (reported by the reader thread)
+	layout->addWidget(new QLabel(tr("Dropped packets: ")),8,0);
+	auto dropped=new QLineEdit("0");
+	dropped->setReadOnly(true);
+	QObject::connect(&reader,&StreamReader::droppedPacketsChanged,dropped,[=](quint64 n){dropped->setText(QString::number(n));});
+	layout->addWidget(dropped,8,1);
+	
 	auto flushBufferButton=new QPushButton(tr("Flush buffer"));
 	QObject::connect(flushBufferButton,&QAbstractButton::clicked,this,&SourcePanel::flushBuffer);
-	layout->addWidget(flushBufferButton,8,0,1,2);
+	layout->addWidget(flushBufferButton,9,0,1,2);
 	
 	addons=new AddonButtonPanel;
-	layout->addWidget(addons,9,0,1,2);
+	layout->addWidget(addons,10,0,1,2);
 	
 	propEditor=new PropertyEditor(source);
-	layout->addWidget(propEditor,10,0,1,2);
+	layout->addWidget(propEditor,11,0,1,2);
 	
 	setLayout(layout);
 }
@@ -545,7 +552,7 @@ void SourcePanel::addButton(const QString &text,const QString &cmd) {
 }
 
 void SourcePanel::closeSource() try {
-	AppWideLock::lock_t am(AppWideLock::guiLock());
+	AppWideLock::ObjectLock am(source,true);
 	source.close();
 }
 catch(std::exception &ex) {
@@ -565,7 +572,7 @@ catch(std::exception &ex) {
 
 void SourcePanel::fileWriter() try {
 	{
-		AppWideLock::lock_t lock(AppWideLock::guiLock());
+		AppWideLock::ObjectLock lock(source.device());
 		
 		if(!source.device().isConnected())
 			throw fruntime_error(tr("Device is not connected"));
@@ -585,7 +592,7 @@ catch(std::exception &ex) {
 }
 
 void SourcePanel::flushBuffer() try {
-	AppWideLock::lock_t lock(AppWideLock::guiLock());
+	AppWideLock::ObjectLock lock(source);
 	source.discardPackets();
 	reader.flush();
 }
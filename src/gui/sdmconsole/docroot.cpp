@@ -119,7 +119,7 @@ void DocRoot::setSideBar(SideBar *w) {
 DocPlugin &DocRoot::addPluginItem(const std::string &path) {
 	return *marshal([&]{
 		DocPlugin &plugin=LuaBridge::addPluginItem(path).cast<DocPlugin>();
-		plugin.setCallbackMutex(callbackMutex());
+		plugin.setCallbackMutex(plugin.mutex());
 		if(!sideBar.isNull()) {
 			sideBar->treeWidget().addTopLevelItem(&plugin);
 		}
@@ -184,17 +184,17 @@ BridgeFactory &DocPlugin::factory() const {
 DocDevice &DocPlugin::addDeviceItem(int iDev) {
 	return *marshal([&]{
 		DocDevice &device=SDMPluginLua::addDeviceItem(iDev).cast<DocDevice>();
-		device.setCallbackMutex(callbackMutex());
+		device.setCallbackMutex(device.mutex());
 		if(!device.treeWidget()) QTreeWidgetItem::addChild(&device);
 	// Add auto-opened channels (if any)
 		for(std::size_t i=0;i<device.children();i++) {
 			if(auto channel=dynamic_cast<DocChannel*>(&device.child(i))) {
 				device.QTreeWidgetItem::addChild(channel);
-				channel->setCallbackMutex(callbackMutex());
+				channel->setCallbackMutex(channel->mutex());
 			}
 			else if(auto source=dynamic_cast<DocSource*>(&device.child(i))) {
 				device.QTreeWidgetItem::addChild(source);
-				source->setCallbackMutex(callbackMutex());
+				source->setCallbackMutex(source->mutex());
 			}
 		}
 		return &device;
@@ -215,6 +215,7 @@ void DocPlugin::open(const std::string &strFileName) {
 }
 
 void DocPlugin::close() {
+	auto lock=AppWideLock::parentLock(*this);
 	marshal([this]{
 		enableUnsafeDestruction(true);
 		SDMPluginLua::close();
@@ -238,7 +239,7 @@ BridgeFactory &DocDevice::factory() const {
 DocChannel &DocDevice::addChannelItem(int iChannel) {
 	return *marshal([&]{
 		DocChannel &channel=SDMDeviceLua::addChannelItem(iChannel).cast<DocChannel>();
-		channel.setCallbackMutex(callbackMutex());
+		channel.setCallbackMutex(channel.mutex());
 		if(!channel.treeWidget()) {
 			QTreeWidgetItem::addChild(&channel);
 			QSettings s;
@@ -257,7 +258,7 @@ DocChannel &DocDevice::addChannelItem(int iChannel) {
 DocSource &DocDevice::addSourceItem(int iSource) {
 	return *marshal([&]{
 		DocSource &source=SDMDeviceLua::addSourceItem(iSource).cast<DocSource>();
-		source.setCallbackMutex(callbackMutex());
+		source.setCallbackMutex(source.mutex());
 		if(!source.treeWidget()) {
 			QTreeWidgetItem::addChild(&source);
 			QSettings s;
@@ -287,6 +288,7 @@ void DocDevice::open(const SDMPlugin &pl,int iDev) {
 }
 
 void DocDevice::close() {
+	auto lock=AppWideLock::parentLock(*this);
 	marshal([this]{
 		enableUnsafeDestruction(true);
 		SDMDeviceLua::close();
@@ -314,7 +316,7 @@ void DocDevice::disconnect() {
 }
 
 void DocDevice::checkConnection() {
-	AppWideLock::lock_t lock=AppWideLock::getTimedLock(20);
+	AppWideLock::lock_t lock=AppWideLock::getTimedLock(*mutex(),20);
 	if(!lock) return;
 	if(!isConnected()) {
 		setStockIcon(1,QObject::tr("Not connected"));
@@ -351,6 +353,7 @@ void DocChannel::open(const SDMDevice &d,int ch) {
 }
 
 void DocChannel::close() {
+	auto lock=AppWideLock::parentLock(*this);
 	marshal([this]{
 		enableUnsafeDestruction(true);
 		SDMChannelLua::close();
@@ -406,6 +409,7 @@ void DocSource::open(const SDMDevice &d,int ch) {
 }
 
 void DocSource::close() {
+	auto lock=AppWideLock::parentLock(*this);
 	marshal([this]{
 		enableUnsafeDestruction(true);
 		SDMSourceLua::close();
@@ -37,6 +37,8 @@ void addExtraKeywords(LuaHighlighter *hl) {
 	hl->addKeyword(set,"sdm.sleep");
 	hl->addKeyword(set,"sdm.time");
 	hl->addKeyword(set,"sdm.lock");
+	hl->addKeyword(set,"sdm.stats");
+	hl->addKeyword(set,"sdm.trace");
 	hl->addKeyword(set,"sdm.selected");
 	hl->addKeyword(set,"gui");
 	hl->addKeyword(set,"gui.screen");
@@ -66,6 +66,13 @@ PropertyEditor::PropertyEditor(SDMBase &obj,QWidget *parent): QWidget(parent),ob
 	layout->addWidget(refreshButton);
 	
 	setLayout(layout);
+	
+// Cache property values if the plugin allows to validate them
+	try {
+		AppWideLock::ObjectLock am(object);
+		object.enablePropertyCache();
+	}
+	catch(std::exception &) {}
 }
 
 QSize PropertyEditor::minimumSizeHint() const {
@@ -75,14 +82,24 @@ QSize PropertyEditor::minimumSizeHint() const {
 }
 
 void PropertyEditor::refresh(bool needsMutex) try {
-	AppWideLock::lock_t am;
-	if(needsMutex) am=AppWideLock::guiLock();
+	AppWideLock::ObjectLock am;
+	if(needsMutex) am.lock(object);
 	
 	SignalBlocker sb(&table);
 	
 	for(int row=table.rowCount()-1;row>=0;row--) table.removeRow(row);
 	
 	auto const &constProperties=object.listProperties("*ro");
+	auto const &mutableProperties=object.listProperties("*wr");
+	
+// Get all values with a single call
+	std::vector<std::string> names(constProperties);
+	names.insert(names.end(),mutableProperties.begin(),mutableProperties.end());
+	auto const &values=object.getProperties(names);
+	auto valueOf=[&values](const std::string &name) {
+		auto it=values.find(name);
+		return (it!=values.end())?it->second:std::string();
+	};
 	
 	if(!constProperties.empty()) {
 		const int row=table.rowCount();
@@ -96,7 +113,7 @@ void PropertyEditor::refresh(bool needsMutex) try {
 		
 		for(auto const &name: constProperties) {
 			const int row=table.rowCount();
-			auto const &value=object.getProperty(name,"");
+			auto const &value=valueOf(name);
 			
 			table.insertRow(row);
 			auto nameItem=new QTableWidgetItem(FString(name));
@@ -109,8 +126,6 @@ void PropertyEditor::refresh(bool needsMutex) try {
 		}
 	}
 	
-	auto const &mutableProperties=object.listProperties("*wr");
-	
 	if(!mutableProperties.empty()) {
 		const int row=table.rowCount();
 		table.insertRow(row);
@@ -123,7 +138,7 @@ void PropertyEditor::refresh(bool needsMutex) try {
 		
 		for(auto const &name: mutableProperties) {
 			const int row=table.rowCount();
-			auto const &value=object.getProperty(name,"");
+			auto const &value=valueOf(name);
 			
 			table.insertRow(row);
 			auto nameItem=new QTableWidgetItem(FString(name));
@@ -145,7 +160,7 @@ void PropertyEditor::itemChanged(QTableWidgetItem *it) {
 	const FString &newValue=item->text();
 	
 	try {
-		AppWideLock::lock_t am=AppWideLock::guiLock();
+		AppWideLock::ObjectLock am(object);
 		object.setProperty(item->name(),newValue);
 		item->setValue(newValue);
 	}
@@ -662,6 +662,11 @@ RegisterActionPage::RegisterActionPage(RegisterMap::RowData &d,bool write,QWidge
 	_useCustomAction=new QCheckBox(tr("Use custom action"));
 	_useCustomAction->setChecked(action.use);
 	topBox->addWidget(_skipGroup);
+	if(!_write&&_reg.type==RegisterMap::Register) {
+		_cacheGroup=new QCheckBox(tr("Cache group read"));
+		_cacheGroup->setChecked(_reg.cacheGroupRead);
+		topBox->addWidget(_cacheGroup);
+	}
 	topBox->addWidget(_useCustomAction);
 	topBox->addStretch();
 	layout->addLayout(topBox);
@@ -715,6 +720,7 @@ RegisterActionPage::RegisterActionPage(RegisterMap::RowData &d,bool write,QWidge
 	hl->addKeyword(group,"_reg.readaction");
 	hl->addKeyword(group,"_reg.skipgroupwrite");
 	hl->addKeyword(group,"_reg.skipgroupread");
+	hl->addKeyword(group,"_reg.cachegroupread");
 	hl->addKeyword(group,"_reg.widget");
 	hl->addKeyword(group,"_reg.options");
 	hl->addKeyword(group,"_reg.prewriteaddr");
@@ -782,6 +788,7 @@ RegisterActionPage::RegisterActionPage(RegisterMap::RowData &d,bool write,QWidge
 	
 // Emit signal when something changes
 	QObject::connect(_skipGroup,&QAbstractButton::clicked,this,&RegisterActionPage::modified);
+	if(_cacheGroup) QObject::connect(_cacheGroup,&QAbstractButton::clicked,this,&RegisterActionPage::modified);
 	QObject::connect(_useCustomAction,&QAbstractButton::clicked,this,&RegisterActionPage::modified);
 	QObject::connect(_customAction,&CodeEditor::textChanged,this,&RegisterActionPage::modified);
 	
@@ -791,6 +798,7 @@ RegisterActionPage::RegisterActionPage(RegisterMap::RowData &d,bool write,QWidge
 void RegisterActionPage::commit() {
 	if(_write) _reg.skipGroupWrite=_skipGroup->isChecked();
 	else _reg.skipGroupRead=_skipGroup->isChecked();
+	if(_cacheGroup) _reg.cacheGroupRead=_cacheGroup->isChecked();
 	auto &action=_write?_reg.writeAction:_reg.readAction;
 	action.use=_useCustomAction->isChecked();
 	action.script=_customAction->toPlainText();
@@ -156,6 +156,7 @@ class RegisterActionPage : public QWidget {
 	RegisterMap::RowData &_reg;
 	
 	QCheckBox *_skipGroup;
+	QCheckBox *_cacheGroup=nullptr;
 	QCheckBox *_useCustomAction;
 	CodeEditor *_customAction;
 	
@@ -36,6 +36,7 @@ using namespace std::placeholders;
 RegisterMapEngine::RegisterMapEngine(LuaServer &l,QWidget *w): QTabWidget(w),_lua(l) {
 	_handle=_lua.registerObject(*this);
 	_numMode=RegisterMap::AsIs;
+	_shadow=std::make_shared<RegisterMap::ShadowRegisters>();
 	setMovable(true);
 	tabBar()->hide();	
 	pageNum=1;
@@ -126,6 +127,7 @@ int RegisterMapEngine::currentRow() const {
 
 void RegisterMapEngine::clear() {
 	QTabWidget::clear();
+	_shadow->clear();
 	pageNum=1;
 }
 
@@ -439,6 +441,7 @@ LuaValue RegisterMapEngine::rowDataToLua(const RegisterMap::RowData &data) {
 		
 		t.table()["skipgroupwrite"]=data.skipGroupWrite;
 		t.table()["skipgroupread"]=data.skipGroupRead;
+		t.table()["cachegroupread"]=data.cacheGroupRead;
 	}
 	else if(data.type==RegisterMap::Fifo||data.type==RegisterMap::Memory) {
 		if(data.type==RegisterMap::Fifo) t.table()["type"]="fifo";
@@ -531,6 +534,8 @@ void RegisterMapEngine::luaToRowData(const LuaValue &from,RegisterMap::RowData &
 			to.skipGroupWrite=it->second.toBoolean();
 		if((it=from.table().find("skipgroupread"))!=from.table().end())
 			to.skipGroupRead=it->second.toBoolean();
+		if((it=from.table().find("cachegroupread"))!=from.table().end())
+			to.cacheGroupRead=it->second.toBoolean();
 	}
 	else if(to.type==RegisterMap::Fifo||to.type==RegisterMap::Memory) {
 		bool hasPreWriteAddr=false,hasPreWriteData=false;
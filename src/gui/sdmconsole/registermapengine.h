@@ -30,6 +30,8 @@
 #include <QString>
 #include <QTabWidget>
 
+#include <memory>
+
 class RegisterMapTable;
 
 class RegisterMapEngine : public QTabWidget,public LuaGUIObject {
@@ -39,6 +41,7 @@ class RegisterMapEngine : public QTabWidget,public LuaGUIObject {
 	int pageNum;
 	LuaValue _handle;
 	RegisterMap::NumberMode _numMode;
+	std::shared_ptr<RegisterMap::ShadowRegisters> _shadow;
 	
 public:
 	RegisterMapEngine(LuaServer &l,QWidget *w=nullptr);
@@ -66,6 +69,8 @@ public:
 	RegisterMap::NumberMode numMode() const {return _numMode;}
 	void setNumMode(RegisterMap::NumberMode mode);
 	
+	const std::shared_ptr<RegisterMap::ShadowRegisters> &shadow() const {return _shadow;}
+	
 	static LuaValue rowDataToLua(const RegisterMap::RowData &data);
 	static void luaToRowData(const LuaValue &from,RegisterMap::RowData &to);
 	
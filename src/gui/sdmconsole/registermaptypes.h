@@ -28,6 +28,8 @@
 #include <QTextStream>
 
 #include <vector>
+#include <map>
+#include <mutex>
 #include <utility>
 #include <type_traits>
 
@@ -176,6 +178,7 @@ namespace RegisterMap {
 	// Group operations
 		bool skipGroupWrite=false;
 		bool skipGroupRead=false;
+		bool cacheGroupRead=false; // registers are volatile unless marked cacheable
 		
 		RowData(RowType t=Register): type(t),widget(LineEdit) {
 			if(type==Register) {
@@ -204,6 +207,34 @@ namespace RegisterMap {
 			}
 		}
 	};
+
+// Register values last read or written by a register map. Group reads
+// of cacheable registers are served from here; the channel's own shadow
+// register cache is not affected.
+	class ShadowRegisters {
+		std::mutex _mutex;
+		std::map<sdm_addr_t,sdm_reg_t> _values;
+	public:
+		bool get(sdm_addr_t addr,sdm_reg_t &value) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			auto it=_values.find(addr);
+			if(it==_values.end()) return false;
+			value=it->second;
+			return true;
+		}
+		void set(sdm_addr_t addr,sdm_reg_t value) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			_values[addr]=value;
+		}
+		void erase(sdm_addr_t first,sdm_addr_t last) {
+			std::lock_guard<std::mutex> lock(_mutex);
+			_values.erase(_values.lower_bound(first),_values.upper_bound(last));
+		}
+		void clear() {
+			std::lock_guard<std::mutex> lock(_mutex);
+			_values.clear();
+		}
+	};
 }
 
 #endif
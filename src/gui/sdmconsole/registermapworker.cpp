@@ -30,7 +30,7 @@
 #include <QMessageBox>
 
 RegisterMapWorker::RegisterMapWorker(LuaServer &l,DocChannel &ch,RegisterMapEngine &e):
-	_lua(l),_channel(&ch),_engine(&e) {}
+	_lua(l),_channel(&ch),_engine(&e),_shadow(e.shadow()) {}
 
 RegisterMapWorker::~RegisterMapWorker() {
 	stop();
@@ -72,7 +72,11 @@ void RegisterMapWorker::run() try {
 	for(;;) {
 		if(isInterruptionRequested()) break;
 		lock_t lock(_queueMutex);
-		if(_cmdQueue.empty()) break;
+		if(_cmdQueue.empty()) {
+			lock.unlock();
+			flushChannel();
+			break;
+		}
 		Command cmd=_cmdQueue.front();
 		_cmdQueue.pop_front();
 		lock.unlock();
@@ -90,21 +94,35 @@ catch(std::exception &ex) {
 
 void RegisterMapWorker::executeCommand(const Command &cmd) try {
 	if(cmd.type==Write) {
-		if(cmd.data.writeAction.use) executeCustomAction(cmd);
+		if(cmd.data.writeAction.use) {
+// A custom action can write any register
+			_shadow->clear();
+			executeCustomAction(cmd);
+		}
 		else if(cmd.data.type==RegisterMap::Register) {
 			if(!cmd.data.addr.valid()||!cmd.data.data.valid()) throw fruntime_error(tr("Invalid value"));
-			AppWideLock::lock_t lock=AppWideLock::guiLock();
+			auto mutex=_channel->mutex();
+			AppWideLock::lock_t lock=AppWideLock::guiLock(*mutex);
 			_channel->writeReg(cmd.data.addr,cmd.data.data);
+			_shadow->set(cmd.data.addr,cmd.data.data);
 		}
 		else { // FIFO or memory
 			if(!cmd.data.addr.valid()) throw fruntime_error(tr("Invalid value"));
 			auto const &fifo=cmd.data.fifo;
-			AppWideLock::lock_t lock=AppWideLock::guiLock();
-			if(fifo.usePreWrite) _channel->writeReg(fifo.preWriteAddr,fifo.preWriteData);
-			if(cmd.data.type==RegisterMap::Fifo)
+			auto mutex=_channel->mutex();
+			AppWideLock::lock_t lock=AppWideLock::guiLock(*mutex);
+			if(fifo.usePreWrite) {
+				_channel->writeReg(fifo.preWriteAddr,fifo.preWriteData);
+				_shadow->set(fifo.preWriteAddr,fifo.preWriteData);
+			}
+			if(cmd.data.type==RegisterMap::Fifo) {
 				_channel->writeFIFO(cmd.data.addr,fifo.data.data(),fifo.data.size());
-			else // memory
+				_shadow->erase(cmd.data.addr,cmd.data.addr);
+			}
+			else if(!fifo.data.empty()) { // memory
 				_channel->writeMem(cmd.data.addr,fifo.data.data(),fifo.data.size());
+				_shadow->erase(cmd.data.addr,cmd.data.addr+(fifo.data.size()-1));
+			}
 		}
 	}
 	else {
@@ -123,13 +141,22 @@ void RegisterMapWorker::executeCommand(const Command &cmd) try {
 		else if(cmd.data.type==RegisterMap::Register) {
 			if(!cmd.data.addr.valid()) throw fruntime_error(tr("Invalid value"));
 			sdm_addr_t addr=cmd.data.addr;
-			AppWideLock::lock_t lock=AppWideLock::guiLock();
-			d.data=_channel->readReg(addr);
+// Group reads of registers marked as cacheable return the value last
+// read or written by this map, other registers are treated as volatile
+			sdm_reg_t value;
+			if(cmd.target!=Row&&cmd.data.cacheGroupRead&&_shadow->get(addr,value)) d.data=value;
+			else {
+				auto mutex=_channel->mutex();
+				AppWideLock::lock_t lock=AppWideLock::guiLock(*mutex);
+				d.data=_channel->refreshReg(addr);
+				_shadow->set(addr,d.data);
+			}
 		}
 		else { // FIFO or memory
 			if(!cmd.data.addr.valid()) throw fruntime_error(tr("Invalid value"));
 			auto const &fifo=cmd.data.fifo;
-			AppWideLock::lock_t lock=AppWideLock::guiLock();
+			auto mutex=_channel->mutex();
+			AppWideLock::lock_t lock=AppWideLock::guiLock(*mutex);
 			if(fifo.usePreWrite) _channel->writeReg(fifo.preWriteAddr,fifo.preWriteData);
 			if(cmd.data.type==RegisterMap::Fifo)
 				_channel->readFIFO(cmd.data.addr,d.fifo.data.data(),d.fifo.data.size());
@@ -148,6 +175,15 @@ catch(std::exception &ex) {
 	throw fruntime_error(str);
 }
 
+// Writes registers deferred by the write-back cache once the queue has been processed
+
+void RegisterMapWorker::flushChannel() {
+	if(!_channel) return;
+	auto mutex=_channel->mutex();
+	AppWideLock::lock_t lock=AppWideLock::guiLock(*mutex);
+	if(_channel->pendingWrites()>0) _channel->flush();
+}
+
 LuaValue RegisterMapWorker::executeCustomAction(const Command &cmd) {
 // Set up completer object in the worker thread
 	RegisterMapAsyncCompleter completer(*this);
@@ -36,6 +36,7 @@
 #include <QPointer>
 
 #include <deque>
+#include <memory>
 
 class LuaServer;
 class DocChannel;
@@ -66,6 +67,7 @@ private:
 	LuaServer &_lua;
 	PointerWatcher<DocChannel> _channel;
 	PointerWatcher<RegisterMapEngine> _engine;
+	std::shared_ptr<RegisterMap::ShadowRegisters> _shadow;
 	
 	std::deque<Command> _cmdQueue;
 	mutex_t _queueMutex;
@@ -91,6 +93,7 @@ protected:
 
 private:
 	void executeCommand(const Command &cmd);
+	void flushChannel();
 	LuaValue executeCustomAction(const Command &cmd);
 	void completeAction(const LuaCallResult &res);
 signals:
@@ -126,6 +126,7 @@ void RegisterMapXML::writeRegisterData(const RegisterMap::RowData &d) {
 	
 	if(d.skipGroupWrite) xmlw.writeEmptyElement("SkipGroupWrite");
 	if(d.skipGroupRead) xmlw.writeEmptyElement("SkipGroupRead");
+	if(d.cacheGroupRead) xmlw.writeEmptyElement("CacheGroupRead");
 	
 	xmlw.writeEndElement();
 }
@@ -255,6 +256,10 @@ void RegisterMapXML::processRegister(int page,int r) {
 			d.skipGroupRead=true;
 			xmlr.skipCurrentElement();
 		}
+		else if(xmlr.name()=="CacheGroupRead") {
+			d.cacheGroupRead=true;
+			xmlr.skipCurrentElement();
+		}
 		else xmlr.skipCurrentElement();
 	}
 	regMap.insertRow(page,r,d);
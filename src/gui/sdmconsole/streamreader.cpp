@@ -21,9 +21,10 @@
  * Notes:
  * 
  * 1) There is a separate StreamReader object (and, by extension, worker
- * thread) for every source. Since SDM API methods are not thread-safe,
- * the threads compete for the same mutex. The whole thing should be probably
- * rewritten to have just one worker thread servicing all sources.
+ * thread) for every source. The thread holds the source mutex (see
+ * SDMBase::mutex()) while reading, so sources can be read in parallel
+ * if the plugin thread safety level allows that. The device mutex is
+ * only obtained to check connection status.
  * 
  * 2) We can't use blocking I/O here for a couple of reasons:
  *    * Blocking operation can block for a long time, or indefinitely, which
@@ -32,6 +33,9 @@
  *    * More importantly, some sources may be slower then other, and blocking
  *      readStream() would prevent reading the faster source in a timely
  *      manner.
+ *    Instead, the worker thread polls the source with an adaptive delay.
+ *    If the source supports readiness notifications, the delay is cut
+ *    short as soon as new data arrive.
  */
 
 #include "appwidelock.h"
@@ -72,6 +76,8 @@ StreamReader::StreamLayer::StreamLayer(PlotterWidget *w,int s,int l,int multi):
  * StreamReader members
  */
 
+StreamReader::StreamReader(SDMSource &src): _src(src) {}
+
 StreamReader::~StreamReader() {
 	requestInterruption();
 	wait();
@@ -108,10 +114,14 @@ void StreamReader::flush() {
 	_flush=true;
 }
 
+sdm_uint64_t StreamReader::droppedPackets() const {
+	return _droppedPackets;
+}
+
 void StreamReader::addViewer(PlotterWidget *w,int stream,int layer,int multi) {
 	_widgets.emplace(w,StreamLayer(w,stream,layer,multi));
 	prepareStreamSet();
-	if(!isRunning()) start();
+	launch();
 }
 
 void StreamReader::writeFile(const QString &strFileName,MHDBWriter::FileType type,const std::vector<int> streams,
@@ -133,7 +143,28 @@ void StreamReader::writeFile(const QString &strFileName,MHDBWriter::FileType typ
 	_fileProgress=new StatusProgressWidget(tr("Writing stream data:"),static_cast<int>(_filePackets));
 	g_MainWindow->statusBar()->addWidget(_fileProgress.data());
 	
-	if(!isRunning()) start();
+	launch();
+}
+
+// Note: the source is not yet opened when StreamReader is constructed,
+// so plugin capabilities are only queried when the thread is started
+
+void StreamReader::launch() {
+	if(isRunning()) return;
+// Don't try to borrow packets if the plugin doesn't support that
+	_acquireSupported=((_src.plugin().capabilities().features&SDM_FEATURE_ACQUIRE)!=0);
+	_packetInfoSupported=((_src.plugin().capabilities().features&SDM_FEATURE_PACKETINFO)!=0);
+	_srcMutex=_src.mutex();
+	_devMutex=_src.device().mutex();
+	start();
+}
+
+// Returns 1 if the device is connected, 0 if it isn't, -1 if the device is busy
+
+int StreamReader::deviceStatus() {
+	AppWideLock::lock_t lock=AppWideLock::getTimedLock(*_devMutex,100);
+	if(!lock) return -1;
+	return _src.device().isConnected()?1:0;
 }
 
 void StreamReader::run() try {
@@ -150,29 +181,34 @@ void StreamReader::run() try {
 		if(isInterruptionRequested()) return;
 		
 // Obtain lock
-		AppWideLock::lock_t glock;
+		AppWideLock::lock_t slock;
 		do {
-			glock=AppWideLock::getTimedLock(100);
+			slock=AppWideLock::getTimedLock(*_srcMutex,100);
 			if(isInterruptionRequested()) return;
-		} while(!glock);
+		} while(!slock);
 		
 // Check whether we are connected
 		bool force=false;
 		if(!connectionVerified) {
-			if(!_src.device().isConnected()) {
-				glock.unlock();
+			int status=deviceStatus();
+			if(status<=0) { // not connected or busy
+				slock.unlock();
 				packets.clear();
-				QThread::msleep(250);
+				if(status==0) QThread::msleep(250);
 				continue;
 			}
 			else {
 				connectionVerified=true;
 				_src.discardPackets();
+				_haveSequence=false;
 				force=true;
 			}
 		}
 		
-		if(applyStreamSet(force)) packets.clear();
+		if(applyStreamSet(force)) {
+			packets.clear();
+			_haveSequence=false;
+		}
 		if(_flush.exchange(false)) packets.clear();
 		
 		std::size_t nStreams=_streams.streams.size();
@@ -181,25 +217,19 @@ void StreamReader::run() try {
 		std::size_t ready=0;
 		std::size_t maxNewSamples=0;
 		try {
+			std::map<int,int> oldSizes;
+			for(int s: _streams.streams) oldSizes[s]=packets[s].data.size();
+			readPackets(packets);
 			for(int s: _streams.streams) {
-				if(packets[s].finished) {
-					ready++;
-					continue;
-				}
-				auto oldSize=packets[s].data.size();
-				auto r=readFullPacket(s,packets[s].data);
-				std::size_t newSamples=packets[s].data.size()-oldSize;
+				std::size_t newSamples=packets[s].data.size()-oldSizes[s];
 				if(newSamples>0) haveNewData=true;
 				maxNewSamples=std::max(newSamples,maxNewSamples);
-				if(r==FullPacket) {
-					packets[s].finished=true;
-					ready++;
-				}
+				if(packets[s].finished) ready++;
 			}
 		}
 		catch(std::exception &) {
 			readFailures++;
-			if(!_src.device().isConnected()) { // connection problem?
+			if(deviceStatus()==0) { // connection problem?
 				connectionVerified=false;
 				packets.clear();
 				readFailures=0;
@@ -208,6 +238,7 @@ void StreamReader::run() try {
 			else if(readFailures<5) { // reset stream set if number of errors is small
 				prepareStreamSet();
 				_src.discardPackets();
+				_haveSequence=false;
 				packets.clear();
 				ready=0;
 				continue;
@@ -224,9 +255,10 @@ void StreamReader::run() try {
 		if(ready==nStreams) { // all streams are ready, produce full result
 			_packetSizeHint=DefaultPacketSizeHint;
 			for(auto const &item: packets) _packetSizeHint=std::max(_packetSizeHint,item.second.data.size());
+			checkSequence();
 			_src.readNextPacket();
 			_src.readStreamErrors();
-			glock.unlock();
+			slock.unlock();
 			marshalAsync(&StreamReader::dispatch,std::move(packets));
 			haveNewData=false;
 			packets.clear();
@@ -235,7 +267,7 @@ void StreamReader::run() try {
 			continue;
 		}
 		
-		glock.unlock();
+		slock.unlock();
 		
 		if(haveNewData&&t.elapsed()>_displayTimeout) { // too much time since last result, try to produce partial result
 // Copy packets instead of moving since we aren't done yet
@@ -244,7 +276,8 @@ void StreamReader::run() try {
 			t.start();
 		}
 		
-		QThread::msleep(msecWait);
+// Wake up earlier if the source supports readiness notifications
+		_src.waitReady(msecWait);
 	}
 }
 catch(std::exception &ex) {
@@ -252,51 +285,127 @@ catch(std::exception &ex) {
 	marshalAsync(&StreamReader::reset);
 }
 
-// Note: StreamReader::readFullPacket is intended to be run from the worker thread
-// Read until either (1) packet ends, (2) no data are available or (3) time is out
-StreamReader::ReadResult StreamReader::readFullPacket(int s,QVector<sdm_sample_t> &data) {
+// Note: StreamReader::readPackets is intended to be run from the worker thread
+// For each unfinished stream, read until either (1) packet ends, (2) no data
+// are available or (3) time is out
+void StreamReader::readPackets(std::map<int,StreamPacket> &packets) {
 	static const int MaxRequest=16384;
-	int incomplete=0;
+	
+// Borrow whole packets from the source if it supports that, which saves
+// the copy made by the plugin into the caller's buffer and reallocations
+// of the buffer (host-side decimation only works with sequential reads).
+// The packet is still copied once here: it is dispatched asynchronously
+// to the GUI thread, but must be released before the next one is acquired.
+	if(_acquireSupported&&!_src.hostDecimation()) {
+		for(int s: _streams.streams) {
+			auto &packet=packets[s];
+			if(packet.finished||!packet.data.isEmpty()) continue;
+			const sdm_sample_t *ptr;
+			std::size_t n;
+			int r=_src.acquirePacket(s,ptr,n,SDMSource::NonBlocking);
+			if(r==SDMSource::WouldBlock) continue;
+			if(r!=0) throw fruntime_error(tr("Plugin declares sdmAcquirePacket() support but doesn't implement it"));
+			auto size=static_cast<int>(std::min(n,static_cast<std::size_t>(_maxPacketSize.load())));
+			packet.data.resize(size);
+			std::copy(ptr,ptr+size,packet.data.data());
+			_src.releasePacket(s);
+			packet.finished=true;
+		}
+		return;
+	}
+	
+// Otherwise read all unfinished streams with a single call per iteration
+	std::vector<StreamRequest> requests;
+	for(int s: _streams.streams) {
+		if(!packets[s].finished) requests.emplace_back(s,&packets[s]);
+	}
+	
+	std::vector<int> streams;
+	std::vector<sdm_sample_t*> buffers;
+	std::vector<std::size_t> sizes;
+	std::vector<int> results;
+	
 	QTime t;
 	t.start();
 	
-	for(;;) {
-		int oldSize=data.size();
-		if(oldSize==0) {
+	while(!requests.empty()) {
+		for(auto it=requests.begin();it!=requests.end();) {
+			auto &data=it->packet->data;
+			it->oldSize=data.size();
+			if(it->oldSize==0) {
 // If the buffer is not initialized yet, reserve a number of samples equal to
 // the packet size hint rounded up to the nearest multiple of MaxRequest,
 // to make reallocations less likely
-			int reserve=_packetSizeHint;
-			int rem=reserve%MaxRequest;
-			if(rem!=0) reserve+=(MaxRequest-rem);
-			data.reserve(reserve);
+				int reserve=_packetSizeHint;
+				int rem=reserve%MaxRequest;
+				if(rem!=0) reserve+=(MaxRequest-rem);
+				data.reserve(reserve);
+			}
+			
+			if(it->incomplete==0) it->increment=std::min(MaxRequest,_maxPacketSize-it->oldSize);
+			else it->increment=it->incomplete;
+			if(it->increment<=0) { // trim large packet
+				it->packet->finished=true;
+				it=requests.erase(it);
+				continue;
+			}
+			data.resize(it->oldSize+it->increment);
+			++it;
 		}
+		if(requests.empty()) break;
 		
-		int increment;
-		if(incomplete==0) increment=std::min(MaxRequest,_maxPacketSize-oldSize);
-		else increment=incomplete;
-		if(increment<=0) return FullPacket; // trim large packet
-		data.resize(oldSize+increment);
-		
-		int r=_src.readStream(s,&data[oldSize],increment,SDMSource::NonBlocking);
-		if(r==SDMSource::WouldBlock) { // no data are available
-			data.resize(oldSize);
-			return NotEnoughData;
+		streams.clear();
+		buffers.clear();
+		sizes.clear();
+		for(auto &req: requests) {
+			streams.push_back(req.stream);
+			buffers.push_back(&req.packet->data[req.oldSize]);
+			sizes.push_back(req.increment);
 		}
-		else {
-			if(r==0) { // end of packet
-				data.resize(oldSize);
-				return FullPacket;
+		results.resize(requests.size());
+		
+		_src.readStreams(streams.data(),buffers.data(),sizes.data(),results.data(),requests.size(),SDMSource::NonBlocking);
+		
+		std::size_t i=0;
+		for(auto it=requests.begin();it!=requests.end();i++) {
+			auto &data=it->packet->data;
+			int r=results[i];
+			if(r==SDMSource::WouldBlock) { // no data are available
+				data.resize(it->oldSize);
+				it=requests.erase(it);
+			}
+			else if(r==0) { // end of packet
+				data.resize(it->oldSize);
+				it->packet->finished=true;
+				it=requests.erase(it);
 			}
-			else if(r!=increment) {
-				data.resize(oldSize+r);
-// Exit loop if the previous request returned less data than asked
-				if(incomplete) return NotEnoughData;
-				incomplete=increment-r;
+			else if(r!=it->increment) {
+				data.resize(it->oldSize+r);
+// Stop reading the stream if the previous request returned less data than asked
+				if(it->incomplete) it=requests.erase(it);
+				else {
+					it->incomplete=it->increment-r;
+					++it;
+				}
 			}
+			else ++it;
 		}
-		if(t.elapsed()>PacketTimeOut) return LimitReached; // timeout
+		if(t.elapsed()>PacketTimeOut) break; // timeout
+	}
+}
+
+// Note: StreamReader::checkSequence is intended to be run from the worker thread
+// Count lost packets using sequence numbers, if the source reports them
+void StreamReader::checkSequence() {
+	if(!_packetInfoSupported) return;
+	sdm_packet_info_t info;
+	if(!_src.packetInfo(info)||!(info.flags&SDM_PACKETINFO_SEQUENCE)) return;
+	if(_haveSequence&&info.sequence>_lastSequence+1) {
+		_droppedPackets+=info.sequence-_lastSequence-1;
+		emit droppedPacketsChanged(_droppedPackets);
 	}
+	_lastSequence=info.sequence;
+	_haveSequence=true;
 }
 
 // Note: StreamReader::dispatch() is intended to be run from the GUI thread
@@ -442,7 +551,8 @@ bool StreamReader::applyStreamSet(bool force) {
 
 void StreamReader::reset() {
 // Kill everything
-	AppWideLock::lock_t glock=AppWideLock::getLock();
+	AppWideLock::lock_t lock;
+	if(_srcMutex) lock=AppWideLock::getLock(*_srcMutex);
 	_streams.clear();
 	_widgets.clear();
 	_partial.clear();
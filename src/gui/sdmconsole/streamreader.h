@@ -23,6 +23,7 @@
 #ifndef STREAMREADER_H_INCLUDED
 #define STREAMREADER_H_INCLUDED
 
+#include "appwidelock.h"
 #include "marshal.h"
 #include "mhdbwriter.h"
 #include "statusprogresswidget.h"
@@ -50,8 +51,6 @@ class StreamReader : public QThread,public Marshal {
 	typedef std::recursive_mutex mutex_t;
 	typedef std::unique_lock<mutex_t> lock_t;
 	
-	enum ReadResult {FullPacket,NotEnoughData,LimitReached};
-	
 	static const int DefaultPacketSizeHint;
 	
 	struct StreamLayer {
@@ -65,6 +64,14 @@ class StreamReader : public QThread,public Marshal {
 		QVector<sdm_sample_t> data;
 		bool finished=false;
 	};
+	struct StreamRequest {
+		int stream;
+		StreamPacket *packet;
+		int oldSize=0;
+		int increment=0;
+		int incomplete=0;
+		StreamRequest(int s,StreamPacket *p): stream(s),packet(p) {}
+	};
 	struct StreamSet {
 		std::set<int> streams;
 		std::size_t packets=0;
@@ -78,16 +85,23 @@ class StreamReader : public QThread,public Marshal {
 	};
 	
 	SDMSource &_src;
+	std::shared_ptr<AppWideLock::mutex_t> _srcMutex;
+	std::shared_ptr<AppWideLock::mutex_t> _devMutex;
 	
 	std::atomic<int> _maxPacketSize {262144};
 	std::atomic<int> _displayTimeout {500};
 	std::atomic<bool> _flush {false};
+	std::atomic<sdm_uint64_t> _droppedPackets {0};
 	
 	mutex_t _streamMutex;
 	StreamSet _streams,_newStreams;
 	std::multimap<PlotterWidget*,StreamLayer> _widgets;
 	
 	int _packetSizeHint=DefaultPacketSizeHint;
+	bool _acquireSupported=true;
+	bool _packetInfoSupported=true;
+	bool _haveSequence=false;
+	sdm_uint64_t _lastSequence=0;
 	std::map<int,bool> _partial;
 	
 	std::unique_ptr<MHDBWriter> _fileWriter;
@@ -98,7 +112,7 @@ class StreamReader : public QThread,public Marshal {
 	bool _fileHeaderWritten;
 	QPointer<StatusProgressWidget> _fileProgress;
 public:
-	StreamReader(SDMSource &src): _src(src) {}
+	StreamReader(SDMSource &src);
 	StreamReader(const StreamReader &)=delete;
 	~StreamReader();
 	
@@ -113,14 +127,20 @@ public:
 	int displayTimeout() const;
 	void setDisplayTimeout(int i);
 	void flush();
+	sdm_uint64_t droppedPackets() const;
 	
+signals:
+	void droppedPacketsChanged(quint64 n);
 protected:
 	virtual void run() override;
 private:
+	void launch();
+	int deviceStatus();
 	void prepareStreamSet();
 	bool applyStreamSet(bool force=false);
 	
-	ReadResult readFullPacket(int s,QVector<sdm_sample_t> &data);
+	void readPackets(std::map<int,StreamPacket> &packets);
+	void checkSequence();
 	void dispatch(const std::map<int,StreamPacket> &data);
 	void reset();
 	void finishFileWriter(bool success);
@@ -47,10 +47,36 @@ protected:
 	int LuaMethod_listproperties(LuaServer &lua);
 	int LuaMethod_getproperty(LuaServer &lua);
 	int LuaMethod_setproperty(LuaServer &lua);
+	int LuaMethod_getproperties(LuaServer &lua);
+	int LuaMethod_propertycache(LuaServer &lua);
 	int LuaMethod_meta_index(LuaServer &lua);
 	int LuaMethod_meta_newindex(LuaServer &lua);
 };
 
+// Implements lock() methods. Mutexes are held on behalf of the Lua
+// thread until unlocked or until the current chunk completes
+
+class BridgeLock {
+public:
+	typedef LuaCallbackObject::callback_mutex_t mutex_t;
+	typedef std::vector<std::shared_ptr<mutex_t> > mutex_list;
+private:
+	struct State {
+		int count=0;
+		mutex_list mutexes;
+	};
+	std::shared_ptr<State> _state;
+public:
+	BridgeLock(): _state(std::make_shared<State>()) {}
+	
+	bool locked() const {return _state->count>0;}
+	void lock(LuaServer &lua,const mutex_list &mutexes);
+	void unlock();
+private:
+	static void release(State &state);
+	static void finalizer(const std::shared_ptr<State> &state);
+};
+
 class BridgeFactory {
 public:
 	virtual SDMPluginLua *makePlugin(LuaServer &lua);
@@ -66,7 +92,7 @@ class LuaBridge : public LuaCallbackObject,public TreeItem {
 	LuaValue _handle;
 	std::vector<std::string> _pluginSearchPath;
 	std::map<std::string,LuaValue> _infoTags;
- 	std::shared_ptr<int> _lockCnt;
+	BridgeLock _lock;
 
 public:
 	LuaBridge(LuaServer &l);
@@ -95,14 +121,17 @@ protected:
 	
 	static int LuaMethod_sleep(LuaServer &lua);
 	static int LuaMethod_time(LuaServer &lua);
+	static int LuaMethod_stats(LuaServer &lua);
+	static int LuaMethod_trace(LuaServer &lua);
 private:
-	static void lockFinalizer(callback_mutex_t *m,const std::shared_ptr<int> &cnt);
+	static void collectMutexes(TreeItem *item,BridgeLock::mutex_list &mutexes);
 	static TreeItem *findObject(TreeItem *root,const std::string &name,const std::string &type);
 };
 
 class SDMPluginLua : public TreeItem,public SDMPlugin,public LuaCallbackObject,private BridgePropertyManager {
 	LuaServer &_lua;
 	LuaValue _handle;
+	BridgeLock _lock;
 
 public:
 	SDMPluginLua(LuaServer &l);
@@ -126,12 +155,15 @@ protected:
 	int LuaMethod_path(LuaServer &lua);
 	int LuaMethod_close(LuaServer &lua);
 	int LuaMethod_opendevice(LuaServer &lua);
+	int LuaMethod_capabilities(LuaServer &lua);
 	int LuaMethod_devices(LuaServer &lua);
+	int LuaMethod_lock(LuaServer &lua);
 };
 
 class SDMDeviceLua : public TreeItem,public SDMDevice,public LuaCallbackObject,private BridgePropertyManager {
 	LuaServer &_lua;
 	LuaValue _handle;
+	BridgeLock _lock;
 
 public:
 	SDMDeviceLua(LuaServer &l);
@@ -164,11 +196,13 @@ protected:
 	int LuaMethod_channels(LuaServer &lua);
 	int LuaMethod_opensource(LuaServer &lua);
 	int LuaMethod_sources(LuaServer &lua);
+	int LuaMethod_lock(LuaServer &lua);
 };
 
 class SDMChannelLua : public TreeItem,public SDMChannel,public LuaCallbackObject,private BridgePropertyManager {
 	LuaServer &_lua;
 	LuaValue _handle;
+	BridgeLock _lock;
 
 protected:
 	virtual BridgeFactory &factory() const;
@@ -195,11 +229,33 @@ protected:
 	int LuaMethod_readfifo(LuaServer &lua);
 	int LuaMethod_writemem(LuaServer &lua);
 	int LuaMethod_readmem(LuaServer &lua);
+	int LuaMethod_writeregs(LuaServer &lua);
+	int LuaMethod_readregs(LuaServer &lua);
+	int LuaMethod_writeregasync(LuaServer &lua);
+	int LuaMethod_readregasync(LuaServer &lua);
+	int LuaMethod_waittransaction(LuaServer &lua);
+	int LuaMethod_polltransaction(LuaServer &lua);
+	int LuaMethod_lock(LuaServer &lua);
+	int LuaMethod_writereg64(LuaServer &lua);
+	int LuaMethod_readreg64(LuaServer &lua);
+	int LuaMethod_writefifo64(LuaServer &lua);
+	int LuaMethod_readfifo64(LuaServer &lua);
+	int LuaMethod_writemem64(LuaServer &lua);
+	int LuaMethod_readmem64(LuaServer &lua);
+	int LuaMethod_cachemode(LuaServer &lua);
+	int LuaMethod_cachepolicy(LuaServer &lua);
+	int LuaMethod_refreshreg(LuaServer &lua);
+	int LuaMethod_flush(LuaServer &lua);
+	int LuaMethod_invalidatecache(LuaServer &lua);
+	int LuaMethod_postedwrites(LuaServer &lua);
+	int LuaMethod_modifyreg(LuaServer &lua);
+	int LuaMethod_modifyregs(LuaServer &lua);
 };
 
 class SDMSourceLua : public TreeItem,public SDMSource,public LuaCallbackObject,private BridgePropertyManager {
 	LuaServer &_lua;
 	LuaValue _handle;
+	BridgeLock _lock;
 
 protected:
 	virtual BridgeFactory &factory() const;
@@ -225,6 +281,9 @@ protected:
 	int LuaMethod_readnextpacket(LuaServer &lua);
 	int LuaMethod_discardpackets(LuaServer &lua);
 	int LuaMethod_readstreamerrors(LuaServer &lua);
+	int LuaMethod_readpacket(LuaServer &lua);
+	int LuaMethod_packetinfo(LuaServer &lua);
+	int LuaMethod_lock(LuaServer &lua);
 };
 
 #endif
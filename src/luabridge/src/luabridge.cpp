@@ -26,9 +26,43 @@
 
 #include <thread>
 #include <chrono>
+#include <algorithm>
+#include <exception>
 
 using namespace std::placeholders;
 
+/*
+ * BridgeLock members
+ */
+
+void BridgeLock::lock(LuaServer &lua,const mutex_list &mutexes) {
+	if(_state->count==0) { // if not already locked
+		for(auto const &m: mutexes) m->lock();
+		_state->mutexes=mutexes;
+// Add finalizer to be called after Lua chunk completion
+		lua.addFinalizer(std::bind(finalizer,_state));
+	}
+	_state->count++;
+}
+
+void BridgeLock::unlock() {
+	if(_state->count<=0) throw std::runtime_error("Mutex is not locked");
+	_state->count--;
+	if(_state->count==0) release(*_state);
+}
+
+void BridgeLock::release(State &state) {
+	for(auto it=state.mutexes.rbegin();it!=state.mutexes.rend();it++) (*it)->unlock();
+	state.mutexes.clear();
+}
+
+void BridgeLock::finalizer(const std::shared_ptr<State> &state) {
+	if(state->count>0) {
+		release(*state);
+		state->count=0;
+	}
+}
+
 /*
  * BridgePropertyManager members
  */
@@ -50,6 +84,12 @@ std::function<int(LuaServer&)> BridgePropertyManager::enumeratePropertyMethods(i
 	case 4:
 		strName="__newindex";
 		return std::bind(&BridgePropertyManager::LuaMethod_meta_newindex,this,_1);
+	case 5:
+		strName="getproperties";
+		return std::bind(&BridgePropertyManager::LuaMethod_getproperties,this,_1);
+	case 6:
+		strName="propertycache";
+		return std::bind(&BridgePropertyManager::LuaMethod_propertycache,this,_1);
 	default:
 		return std::function<int(LuaServer&)>();
 	}
@@ -91,6 +131,30 @@ int BridgePropertyManager::LuaMethod_setproperty(LuaServer &lua) {
 	return 0;
 }
 
+int BridgePropertyManager::LuaMethod_getproperties(LuaServer &lua) {
+	if(lua.argc()!=1) throw std::runtime_error("getproperties() method takes 1 argument");
+	
+	auto const &arg=lua.argv(0,true); // get argument as array
+	if(arg.type()!=LuaValue::Array) throw std::runtime_error("getproperties() argument must be of table type");
+	
+	std::vector<std::string> names;
+	for(auto const &v: arg.array()) names.push_back(v.toString());
+	
+	LuaValue t;
+	t.newtable();
+	for(auto const &item: getProperties(names)) t.table()[item.first]=item.second;
+	
+	lua.pushValue(t);
+	return 1;
+}
+
+int BridgePropertyManager::LuaMethod_propertycache(LuaServer &lua) {
+	if(lua.argc()>1) throw std::runtime_error("propertycache() method takes 0-1 arguments");
+	if(lua.argc()==1) enablePropertyCache(lua.argv(0).toBoolean());
+	lua.pushValue(propertyCacheEnabled());
+	return 1;
+}
+
 int BridgePropertyManager::LuaMethod_meta_index(LuaServer &lua) {
 	if(lua.argc()!=2) return 0;
 	try {
@@ -135,8 +199,7 @@ BridgeFactory BridgeFactory::global;
  */
 
 LuaBridge::LuaBridge(LuaServer &l):
-	_lua(l),
-	_lockCnt(std::make_shared<int>(0))
+	_lua(l)
 {
 	setInfoTag("host","undefined");
 	setInfoTag("version",Config::version());
@@ -164,6 +227,8 @@ const LuaValue &LuaBridge::luaHandle() {
 		_handle=_lua.registerObject(*this);
 		_handle.table()["sleep"]=_lua.registerCallback(LuaMethod_sleep);
 		_handle.table()["time"]=_lua.registerCallback(LuaMethod_time);
+		_handle.table()["stats"]=_lua.registerCallback(LuaMethod_stats);
+		_handle.table()["trace"]=_lua.registerCallback(LuaMethod_trace);
 	}
 	return _handle;
 }
@@ -369,29 +434,103 @@ int LuaBridge::LuaMethod_time(LuaServer &lua) {
 	return 1;
 }
 
+// Plugin call statistics: without arguments returns an array of
+// records, "json" and "csv" return formatted reports, "reset" clears
+// the statistics, a boolean argument enables or disables them
+
+int LuaBridge::LuaMethod_stats(LuaServer &lua) {
+	if(lua.argc()>1) throw std::runtime_error("stats() method takes 0-1 arguments");
+	if(lua.argc()==1) {
+		auto const &arg=lua.argv(0);
+		if(arg.type()==LuaValue::Boolean) {
+			SDMStats::setEnabled(arg.toBoolean());
+			return 0;
+		}
+		auto const &str=arg.toString();
+		if(str=="json") lua.pushValue(SDMStats::toJSON());
+		else if(str=="csv") lua.pushValue(SDMStats::toCSV());
+		else if(str=="enabled") lua.pushValue(SDMStats::enabled());
+		else if(str=="reset") {
+			SDMStats::reset();
+			return 0;
+		}
+		else throw std::runtime_error("Unrecognized argument: \""+str+"\"");
+		return 1;
+	}
+	
+	LuaValue res;
+	auto &arr=res.newarray();
+	for(auto const &rec: SDMStats::records()) {
+		LuaValue t;
+		t.newtable();
+		t.table()["object"]=rec.object;
+		t.table()["func"]=rec.function;
+		t.table()["calls"]=static_cast<lua_Integer>(rec.calls);
+		t.table()["bytes"]=static_cast<lua_Integer>(rec.bytes);
+		t.table()["totalns"]=static_cast<lua_Integer>(rec.totalNs);
+		t.table()["minns"]=static_cast<lua_Integer>(rec.minNs);
+		t.table()["meanns"]=static_cast<lua_Integer>(rec.totalNs/rec.calls);
+		t.table()["p50ns"]=static_cast<lua_Integer>(rec.percentile(50));
+		t.table()["p90ns"]=static_cast<lua_Integer>(rec.percentile(90));
+		t.table()["p99ns"]=static_cast<lua_Integer>(rec.percentile(99));
+		t.table()["maxns"]=static_cast<lua_Integer>(rec.maxNs);
+		arr.push_back(t);
+	}
+	lua.pushValue(res);
+	return 1;
+}
+
+// Plugin call recording: a file name starts a new trace, false stops
+// recording, without arguments returns whether a trace is being recorded
+
+int LuaBridge::LuaMethod_trace(LuaServer &lua) {
+	if(lua.argc()>1) throw std::runtime_error("trace() method takes 0-1 arguments");
+	if(lua.argc()==0) {
+		lua.pushValue(SDMTrace::active());
+		return 1;
+	}
+	auto const &arg=lua.argv(0);
+	if(arg.type()==LuaValue::Boolean) {
+		if(arg.toBoolean()) throw std::runtime_error("Trace file name expected");
+		SDMTrace::stop();
+	}
+	else SDMTrace::start(arg.toString());
+	return 0;
+}
+
+// Objects can use different mutexes depending on the plugin thread
+// safety level. sdm.lock() obtains all of them: the global mutex
+// first, then object mutexes in a fixed (address) order
+
 int LuaBridge::LuaMethod_lock(LuaServer &lua) {
 	if(lua.argc()!=1) throw std::runtime_error("lock() method takes 1 argument");
 	if(callbackMutex()==nullptr) return 0; // Mutex is not set - do nothing
 	if(lua.argv(0).toBoolean()) { // lock
-		if(*_lockCnt==0) { // if not already locked
-			callbackMutex()->lock(); // lock mutex
-// Add finalizer to be called after Lua chunk completion
-			lua.addFinalizer(std::bind(lockFinalizer,callbackMutex(),_lockCnt));
+		BridgeLock::mutex_list mutexes;
+		if(!_lock.locked()) {
+			collectMutexes(this,mutexes);
+			std::sort(mutexes.begin(),mutexes.end());
+			mutexes.erase(std::unique(mutexes.begin(),mutexes.end()),mutexes.end());
+			mutexes.erase(std::remove(mutexes.begin(),mutexes.end(),sharedCallbackMutex()),mutexes.end());
+			mutexes.insert(mutexes.begin(),sharedCallbackMutex());
 		}
-		(*_lockCnt)++;
-	}
-	else { // unlock
-		if(*_lockCnt<=0) throw std::runtime_error("Mutex is not locked");
-		(*_lockCnt)--;
-		if(*_lockCnt==0) callbackMutex()->unlock();
+		_lock.lock(lua,mutexes);
 	}
+	else _lock.unlock(); // unlock
 	return 0;
 }
 
-void LuaBridge::lockFinalizer(callback_mutex_t *m,const std::shared_ptr<int> &cnt) {
-	if(*cnt>0) {
-		m->unlock();
-		*cnt=0;
+// Children are opened and closed while holding the parent's mutex,
+// which is therefore held while they are enumerated
+
+void LuaBridge::collectMutexes(TreeItem *item,BridgeLock::mutex_list &mutexes) {
+	std::unique_lock<LuaCallbackObject::callback_mutex_t> lock;
+	auto parent=dynamic_cast<LuaCallbackObject*>(item);
+	if(parent&&parent->callbackMutex()) lock=std::unique_lock<LuaCallbackObject::callback_mutex_t>(*parent->callbackMutex());
+	for(std::size_t i=0;i<item->children();i++) {
+		auto obj=dynamic_cast<LuaCallbackObject*>(&item->child(i));
+		if(obj&&obj->callbackMutex()) mutexes.push_back(obj->sharedCallbackMutex());
+		collectMutexes(&item->child(i),mutexes);
 	}
 }
 
@@ -528,8 +667,14 @@ std::function<int(LuaServer&)> SDMPluginLua::enumerateLuaMethods(int i,std::stri
 	case 3:
 		strName="devices";
 		return std::bind(&SDMPluginLua::LuaMethod_devices,this,_1);
+	case 4:
+		strName="capabilities";
+		return std::bind(&SDMPluginLua::LuaMethod_capabilities,this,_1);
+	case 5:
+		strName="lock";
+		return std::bind(&SDMPluginLua::LuaMethod_lock,this,_1);
 	default:
-		return enumeratePropertyMethods(i-4,strName,upvalues);
+		return enumeratePropertyMethods(i-6,strName,upvalues);
 	}
 }
 
@@ -553,6 +698,54 @@ int SDMPluginLua::LuaMethod_opendevice(LuaServer &lua) {
 	return 1;
 }
 
+int SDMPluginLua::LuaMethod_capabilities(LuaServer &lua) {
+	static const struct {sdm_uint32_t flag; const char *name;} features[]={
+		{SDM_FEATURE_REGBATCH,"regbatch"},
+		{SDM_FEATURE_ASYNCREGS,"asyncregs"},
+		{SDM_FEATURE_TYPEDREAD,"typedread"},
+		{SDM_FEATURE_ACQUIRE,"acquire"},
+		{SDM_FEATURE_READYCALLBACK,"readycallback"},
+		{SDM_FEATURE_MULTISTREAM,"multistream"},
+		{SDM_FEATURE_PACKETINFO,"packetinfo"},
+		{SDM_FEATURE_BATCHPROPS,"batchprops"},
+		{SDM_FEATURE_REG64,"reg64"},
+		{SDM_FEATURE_DECIMATION,"decimation"},
+		{SDM_FEATURE_MODIFYREG,"modifyreg"},
+		{SDM_FEATURE_LASTERROR,"lasterror"}
+	};
+	static const char *formats[]={"double","float","int8","uint8","int16","uint16","int32"};
+	static const char *threadSafety[]={"none","device","object","full"};
+	
+	if(lua.argc()!=0) throw std::runtime_error("capabilities() method doesn't take arguments");
+	
+	auto const &caps=capabilities();
+	LuaValue res;
+	res.newtable();
+	
+	LuaValue f;
+	auto &fa=f.newarray();
+	for(auto const &feature: features) {
+		if(caps.features&feature.flag) fa.emplace_back(feature.name);
+	}
+	res.table()["features"]=f;
+	
+	LuaValue fmt;
+	auto &fmta=fmt.newarray();
+	for(int i=0;i<static_cast<int>(sizeof(formats)/sizeof(formats[0]));i++) {
+		if(caps.formats&(1<<i)) fmta.emplace_back(formats[i]);
+	}
+	res.table()["formats"]=fmt;
+	
+	if(caps.threadSafety>=SDM_THREADSAFE_NONE&&caps.threadSafety<=SDM_THREADSAFE_FULL)
+		res.table()["threadsafety"]=threadSafety[caps.threadSafety];
+	res.table()["maxregbatch"]=lua_Integer(caps.maxRegBatch);
+	res.table()["maxstreambatch"]=lua_Integer(caps.maxStreamBatch);
+	res.table()["preferredpacketsize"]=lua_Integer(caps.preferredPacketSize);
+	
+	lua.pushValue(res);
+	return 1;
+}
+
 int SDMPluginLua::LuaMethod_devices(LuaServer &lua) {
 	if(lua.argc()==0) {
 // Return number of devices
@@ -567,6 +760,14 @@ int SDMPluginLua::LuaMethod_devices(LuaServer &lua) {
 	return 1;
 }
 
+int SDMPluginLua::LuaMethod_lock(LuaServer &lua) {
+	if(lua.argc()!=1) throw std::runtime_error("lock() method takes 1 argument");
+	if(callbackMutex()==nullptr) return 0; // Mutex is not set - do nothing
+	if(lua.argv(0).toBoolean()) _lock.lock(lua,{sharedCallbackMutex()});
+	else _lock.unlock();
+	return 0;
+}
+
 /*
  * SDMDeviceLua members
  */
@@ -717,8 +918,11 @@ std::function<int(LuaServer&)> SDMDeviceLua::enumerateLuaMethods(int i,std::stri
 	case 8:
 		strName="sources";
 		return std::bind(&SDMDeviceLua::LuaMethod_sources,this,_1);
+	case 9:
+		strName="lock";
+		return std::bind(&SDMDeviceLua::LuaMethod_lock,this,_1);
 	default:
-		return enumeratePropertyMethods(i-9,strName,upvalues);
+		return enumeratePropertyMethods(i-10,strName,upvalues);
 	}
 }
 
@@ -806,6 +1010,14 @@ int SDMDeviceLua::LuaMethod_sources(LuaServer &lua) {
 	return 1;
 }
 
+int SDMDeviceLua::LuaMethod_lock(LuaServer &lua) {
+	if(lua.argc()!=1) throw std::runtime_error("lock() method takes 1 argument");
+	if(callbackMutex()==nullptr) return 0; // Mutex is not set - do nothing
+	if(lua.argv(0).toBoolean()) _lock.lock(lua,{sharedCallbackMutex()});
+	else _lock.unlock();
+	return 0;
+}
+
 /*
  * SDMChannelLua members
  */
@@ -831,8 +1043,18 @@ void SDMChannelLua::open(const SDMDevice &d,int ch) {
 	setName(getProperty("Name","Channel "+std::to_string(ch)));
 }
 
+// Pending writes are flushed first so that errors reach the script
+
 void SDMChannelLua::close() {
+	std::exception_ptr error;
+	try {
+		if(*this) flush();
+	}
+	catch(std::exception &) {
+		error=std::current_exception();
+	}
 	delete this;
+	if(error) std::rethrow_exception(error);
 }
 
 std::function<int(LuaServer&)> SDMChannelLua::enumerateLuaMethods(int i,std::string &strName,std::vector<LuaValue> &upvalues) {
@@ -861,8 +1083,71 @@ std::function<int(LuaServer&)> SDMChannelLua::enumerateLuaMethods(int i,std::str
 	case 7:
 		strName="readmem";
 		return std::bind(&SDMChannelLua::LuaMethod_readmem,this,_1);
+	case 8:
+		strName="writeregs";
+		return std::bind(&SDMChannelLua::LuaMethod_writeregs,this,_1);
+	case 9:
+		strName="readregs";
+		return std::bind(&SDMChannelLua::LuaMethod_readregs,this,_1);
+	case 10:
+		strName="writeregasync";
+		return std::bind(&SDMChannelLua::LuaMethod_writeregasync,this,_1);
+	case 11:
+		strName="readregasync";
+		return std::bind(&SDMChannelLua::LuaMethod_readregasync,this,_1);
+	case 12:
+		strName="waittransaction";
+		return std::bind(&SDMChannelLua::LuaMethod_waittransaction,this,_1);
+	case 13:
+		strName="polltransaction";
+		return std::bind(&SDMChannelLua::LuaMethod_polltransaction,this,_1);
+	case 14:
+		strName="lock";
+		return std::bind(&SDMChannelLua::LuaMethod_lock,this,_1);
+	case 15:
+		strName="writereg64";
+		return std::bind(&SDMChannelLua::LuaMethod_writereg64,this,_1);
+	case 16:
+		strName="readreg64";
+		return std::bind(&SDMChannelLua::LuaMethod_readreg64,this,_1);
+	case 17:
+		strName="writefifo64";
+		return std::bind(&SDMChannelLua::LuaMethod_writefifo64,this,_1);
+	case 18:
+		strName="readfifo64";
+		return std::bind(&SDMChannelLua::LuaMethod_readfifo64,this,_1);
+	case 19:
+		strName="writemem64";
+		return std::bind(&SDMChannelLua::LuaMethod_writemem64,this,_1);
+	case 20:
+		strName="readmem64";
+		return std::bind(&SDMChannelLua::LuaMethod_readmem64,this,_1);
+	case 21:
+		strName="cachemode";
+		return std::bind(&SDMChannelLua::LuaMethod_cachemode,this,_1);
+	case 22:
+		strName="cachepolicy";
+		return std::bind(&SDMChannelLua::LuaMethod_cachepolicy,this,_1);
+	case 23:
+		strName="refreshreg";
+		return std::bind(&SDMChannelLua::LuaMethod_refreshreg,this,_1);
+	case 24:
+		strName="flush";
+		return std::bind(&SDMChannelLua::LuaMethod_flush,this,_1);
+	case 25:
+		strName="invalidatecache";
+		return std::bind(&SDMChannelLua::LuaMethod_invalidatecache,this,_1);
+	case 26:
+		strName="postedwrites";
+		return std::bind(&SDMChannelLua::LuaMethod_postedwrites,this,_1);
+	case 27:
+		strName="modifyreg";
+		return std::bind(&SDMChannelLua::LuaMethod_modifyreg,this,_1);
+	case 28:
+		strName="modifyregs";
+		return std::bind(&SDMChannelLua::LuaMethod_modifyregs,this,_1);
 	default:
-		return enumeratePropertyMethods(i-8,strName,upvalues);
+		return enumeratePropertyMethods(i-29,strName,upvalues);
 	}
 }
 
@@ -965,6 +1250,279 @@ int SDMChannelLua::LuaMethod_readmem(LuaServer &lua) {
 	return 1;
 }
 
+int SDMChannelLua::LuaMethod_writeregs(LuaServer &lua) {
+	if(lua.argc()!=2) throw std::runtime_error("writeregs() method takes 2 arguments");
+	
+	auto const &addrs=lua.argv(0,true); // get arguments as arrays
+	auto const &values=lua.argv(1,true);
+	if(addrs.type()!=LuaValue::Array||values.type()!=LuaValue::Array)
+		throw std::runtime_error("writeregs() arguments must be of table type");
+	if(addrs.array().size()!=values.array().size())
+		throw std::runtime_error("writeregs() arguments must have the same size");
+	
+	auto const n=addrs.array().size();
+	std::vector<sdm_addr_t> a(n);
+	std::vector<sdm_reg_t> v(n);
+	for(std::size_t i=0;i<n;i++) {
+		a[i]=static_cast<sdm_addr_t>(addrs.array()[i].toInteger());
+		v[i]=static_cast<sdm_reg_t>(values.array()[i].toInteger());
+	}
+	
+	writeRegs(a.data(),v.data(),n);
+	
+	return 0;
+}
+
+int SDMChannelLua::LuaMethod_readregs(LuaServer &lua) {
+	if(lua.argc()!=1) throw std::runtime_error("readregs() method takes 1 argument");
+	
+	auto const &addrs=lua.argv(0,true); // get argument as array
+	if(addrs.type()!=LuaValue::Array) throw std::runtime_error("readregs() argument must be of table type");
+	
+	auto const n=addrs.array().size();
+	std::vector<sdm_addr_t> a(n);
+	for(std::size_t i=0;i<n;i++) a[i]=static_cast<sdm_addr_t>(addrs.array()[i].toInteger());
+	
+	std::vector<sdm_reg_t> data(n);
+	readRegs(a.data(),data.data(),n);
+	
+	LuaValue res;
+	auto &v=res.newarray();
+	v.reserve(n);
+	for(std::size_t i=0;i<n;i++) v.emplace_back(static_cast<lua_Integer>(data[i]));
+	
+	lua.pushValue(res);
+	
+	return 1;
+}
+
+int SDMChannelLua::LuaMethod_writeregasync(LuaServer &lua) {
+	if(lua.argc()!=2) throw std::runtime_error("writeregasync() method takes 2 arguments");
+	int token=submitWriteReg((sdm_addr_t)lua.argv(0).toInteger(),(sdm_reg_t)lua.argv(1).toInteger());
+	lua.pushValue(lua_Integer(token));
+	return 1;
+}
+
+int SDMChannelLua::LuaMethod_readregasync(LuaServer &lua) {
+	if(lua.argc()!=1) throw std::runtime_error("readregasync() method takes 1 argument");
+	int token=submitReadReg((sdm_addr_t)lua.argv(0).toInteger());
+	lua.pushValue(lua_Integer(token));
+	return 1;
+}
+
+int SDMChannelLua::LuaMethod_waittransaction(LuaServer &lua) {
+	if(lua.argc()!=1) throw std::runtime_error("waittransaction() method takes 1 argument");
+	lua.pushValue(lua_Integer(waitTransaction(static_cast<int>(lua.argv(0).toInteger()))));
+	return 1;
+}
+
+int SDMChannelLua::LuaMethod_polltransaction(LuaServer &lua) {
+	if(lua.argc()!=1) throw std::runtime_error("polltransaction() method takes 1 argument");
+	sdm_reg_t data;
+	if(pollTransaction(static_cast<int>(lua.argv(0).toInteger()),&data))
+		lua.pushValue(lua_Integer(data));
+	else lua.pushValue(LuaValue());
+	return 1;
+}
+
+int SDMChannelLua::LuaMethod_lock(LuaServer &lua) {
+	if(lua.argc()!=1) throw std::runtime_error("lock() method takes 1 argument");
+	if(callbackMutex()==nullptr) return 0; // Mutex is not set - do nothing
+	if(lua.argv(0).toBoolean()) _lock.lock(lua,{sharedCallbackMutex()});
+	else _lock.unlock();
+	return 0;
+}
+
+// Lua integers are signed 64-bit, values above 2^63-1 are passed as negative numbers
+
+int SDMChannelLua::LuaMethod_writereg64(LuaServer &lua) {
+	if(lua.argc()!=2) throw std::runtime_error("writereg64() method takes 2 arguments");
+	writeReg64(static_cast<sdm_addr64_t>(lua.argv(0).toInteger()),static_cast<sdm_reg64_t>(lua.argv(1).toInteger()));
+	return 0;
+}
+
+int SDMChannelLua::LuaMethod_readreg64(LuaServer &lua) {
+	if(lua.argc()!=1) throw std::runtime_error("readreg64() method takes 1 argument");
+	lua.pushValue(static_cast<lua_Integer>(readReg64(static_cast<sdm_addr64_t>(lua.argv(0).toInteger()))));
+	return 1;
+}
+
+int SDMChannelLua::LuaMethod_writefifo64(LuaServer &lua) {
+	if(lua.argc()!=2) throw std::runtime_error("writefifo64() method takes 2 arguments");
+	
+	auto const addr=static_cast<sdm_addr64_t>(lua.argv(0).toInteger());
+	auto const &data=lua.argv(1,true); // get argument as array
+	if(data.type()!=LuaValue::Array) throw std::runtime_error("writefifo64() 2nd argument must be of table type");
+	
+	auto const &arr=data.array();
+	std::vector<sdm_reg64_t> v(arr.size());
+	for(std::size_t i=0;i<arr.size();i++) v[i]=static_cast<sdm_reg64_t>(arr[i].toInteger());
+	
+	writeFIFO64(addr,v.data(),v.size());
+	return 0;
+}
+
+int SDMChannelLua::LuaMethod_readfifo64(LuaServer &lua) {
+	if(lua.argc()!=2) throw std::runtime_error("readfifo64() method takes 2 arguments");
+	
+	auto const addr=static_cast<sdm_addr64_t>(lua.argv(0).toInteger());
+	auto const n=static_cast<std::size_t>(lua.argv(1).toInteger());
+	
+	std::vector<sdm_reg64_t> data(n);
+	if(n>0) readFIFO64(addr,data.data(),n);
+	
+	LuaValue t;
+	auto &arr=t.newarray();
+	arr.reserve(n);
+	for(auto const &v: data) arr.emplace_back(static_cast<lua_Integer>(v));
+	lua.pushValue(t);
+	return 1;
+}
+
+int SDMChannelLua::LuaMethod_writemem64(LuaServer &lua) {
+	if(lua.argc()!=2) throw std::runtime_error("writemem64() method takes 2 arguments");
+	
+	auto const addr=static_cast<sdm_addr64_t>(lua.argv(0).toInteger());
+	auto const &data=lua.argv(1,true); // get argument as array
+	if(data.type()!=LuaValue::Array) throw std::runtime_error("writemem64() 2nd argument must be of table type");
+	
+	auto const &arr=data.array();
+	std::vector<sdm_reg64_t> v(arr.size());
+	for(std::size_t i=0;i<arr.size();i++) v[i]=static_cast<sdm_reg64_t>(arr[i].toInteger());
+	
+	writeMem64(addr,v.data(),v.size());
+	return 0;
+}
+
+int SDMChannelLua::LuaMethod_readmem64(LuaServer &lua) {
+	if(lua.argc()!=2) throw std::runtime_error("readmem64() method takes 2 arguments");
+	
+	auto const addr=static_cast<sdm_addr64_t>(lua.argv(0).toInteger());
+	auto const n=static_cast<std::size_t>(lua.argv(1).toInteger());
+	if(n==0) return 0;
+	
+	std::vector<sdm_reg64_t> data(n);
+	readMem64(addr,data.data(),n);
+	
+	LuaValue res;
+	auto &arr=res.newarray();
+	arr.reserve(n);
+	for(auto const &v: data) arr.emplace_back(static_cast<lua_Integer>(v));
+	lua.pushValue(res);
+	return 1;
+}
+
+int SDMChannelLua::LuaMethod_cachemode(LuaServer &lua) {
+	static const char *modes[]={"off","writethrough","writeback"};
+	if(lua.argc()>1) throw std::runtime_error("cachemode() method takes 0-1 arguments");
+	if(lua.argc()==1) {
+		auto const &str=lua.argv(0).toString();
+		int i;
+		for(i=0;i<3;i++) if(str==modes[i]) break;
+		if(i==3) throw std::runtime_error("Unknown cache mode: \""+str+"\"");
+		setCacheMode(static_cast<CacheMode>(i));
+		return 0;
+	}
+	lua.pushValue(modes[cacheMode()]);
+	return 1;
+}
+
+int SDMChannelLua::LuaMethod_cachepolicy(LuaServer &lua) {
+	static const char *policies[]={"cacheable","volatile","writeonly"};
+	if(lua.argc()<1||lua.argc()>3) throw std::runtime_error("cachepolicy() method takes 1-3 arguments");
+	auto const first=static_cast<sdm_addr_t>(lua.argv(0).toInteger());
+	if(lua.argc()==1) {
+		lua.pushValue(policies[cachePolicy(first)]);
+		return 1;
+	}
+	auto const last=(lua.argc()==3)?static_cast<sdm_addr_t>(lua.argv(1).toInteger()):first;
+	auto const &str=lua.argv(lua.argc()-1).toString();
+	int i;
+	for(i=0;i<3;i++) if(str==policies[i]) break;
+	if(i==3) throw std::runtime_error("Unknown cache policy: \""+str+"\"");
+	setCachePolicy(first,last,static_cast<CachePolicy>(i));
+	return 0;
+}
+
+int SDMChannelLua::LuaMethod_refreshreg(LuaServer &lua) {
+	if(lua.argc()!=1) throw std::runtime_error("refreshreg() method takes 1 argument");
+	lua.pushValue(lua_Integer(refreshReg(static_cast<sdm_addr_t>(lua.argv(0).toInteger()))));
+	return 1;
+}
+
+int SDMChannelLua::LuaMethod_flush(LuaServer &lua) {
+	if(lua.argc()!=0) throw std::runtime_error("flush() method doesn't take arguments");
+	flush();
+	return 0;
+}
+
+int SDMChannelLua::LuaMethod_invalidatecache(LuaServer &lua) {
+	if(lua.argc()!=0) throw std::runtime_error("invalidatecache() method doesn't take arguments");
+	invalidateCache();
+	return 0;
+}
+
+int SDMChannelLua::LuaMethod_postedwrites(LuaServer &lua) {
+	if(lua.argc()>1) throw std::runtime_error("postedwrites() method takes 0-1 arguments");
+	if(lua.argc()==1) setPostedWrites(lua.argv(0).toBoolean());
+	lua.pushValue(postedWrites());
+	return 1;
+}
+
+// Several fields of the same register can be passed as arrays of
+// masks and values, they are merged into one modification
+
+int SDMChannelLua::LuaMethod_modifyreg(LuaServer &lua) {
+	if(lua.argc()!=3) throw std::runtime_error("modifyreg() method takes 3 arguments");
+	
+	auto const addr=static_cast<sdm_addr_t>(lua.argv(0).toInteger());
+	auto const &masks=lua.argv(1,true);
+	auto const &values=lua.argv(2,true);
+	if(masks.type()!=LuaValue::Array&&values.type()!=LuaValue::Array) {
+		modifyReg(addr,static_cast<sdm_reg_t>(masks.toInteger()),static_cast<sdm_reg_t>(values.toInteger()));
+		return 0;
+	}
+	if(masks.type()!=LuaValue::Array||values.type()!=LuaValue::Array)
+		throw std::runtime_error("modifyreg() masks and values must be both integers or both tables");
+	if(masks.array().size()!=values.array().size())
+		throw std::runtime_error("modifyreg() arguments must have the same size");
+	
+	sdm_reg_t mask=0,data=0;
+	for(std::size_t i=0;i<masks.array().size();i++) {
+		auto const m=static_cast<sdm_reg_t>(masks.array()[i].toInteger());
+		auto const v=static_cast<sdm_reg_t>(values.array()[i].toInteger());
+		mask|=m;
+		data=(data&~m)|(v&m);
+	}
+	modifyReg(addr,mask,data);
+	return 0;
+}
+
+int SDMChannelLua::LuaMethod_modifyregs(LuaServer &lua) {
+	if(lua.argc()!=3) throw std::runtime_error("modifyregs() method takes 3 arguments");
+	
+	auto const &addrs=lua.argv(0,true); // get arguments as arrays
+	auto const &masks=lua.argv(1,true);
+	auto const &values=lua.argv(2,true);
+	if(addrs.type()!=LuaValue::Array||masks.type()!=LuaValue::Array||values.type()!=LuaValue::Array)
+		throw std::runtime_error("modifyregs() arguments must be of table type");
+	if(addrs.array().size()!=masks.array().size()||addrs.array().size()!=values.array().size())
+		throw std::runtime_error("modifyregs() arguments must have the same size");
+	
+	auto const n=addrs.array().size();
+	std::vector<sdm_addr_t> a(n);
+	std::vector<sdm_reg_t> m(n),v(n);
+	for(std::size_t i=0;i<n;i++) {
+		a[i]=static_cast<sdm_addr_t>(addrs.array()[i].toInteger());
+		m[i]=static_cast<sdm_reg_t>(masks.array()[i].toInteger());
+		v[i]=static_cast<sdm_reg_t>(values.array()[i].toInteger());
+	}
+	
+	modifyRegs(a.data(),m.data(),v.data(),n);
+	
+	return 0;
+}
+
 /*
  * SDMSourceLua members
  */
@@ -1017,8 +1575,17 @@ std::function<int(LuaServer&)> SDMSourceLua::enumerateLuaMethods(int i,std::stri
 	case 6:
 		strName="readstreamerrors";
 		return std::bind(&SDMSourceLua::LuaMethod_readstreamerrors,this,_1);
+	case 7:
+		strName="readpacket";
+		return std::bind(&SDMSourceLua::LuaMethod_readpacket,this,_1);
+	case 8:
+		strName="packetinfo";
+		return std::bind(&SDMSourceLua::LuaMethod_packetinfo,this,_1);
+	case 9:
+		strName="lock";
+		return std::bind(&SDMSourceLua::LuaMethod_lock,this,_1);
 	default:
-		return enumeratePropertyMethods(i-7,strName,upvalues);
+		return enumeratePropertyMethods(i-10,strName,upvalues);
 	}
 }
 
@@ -1035,7 +1602,7 @@ int SDMSourceLua::LuaMethod_close(LuaServer &lua) {
 }
 
 int SDMSourceLua::LuaMethod_selectreadstreams(LuaServer &lua) {
-	if(lua.argc()<1||lua.argc()>3) throw std::runtime_error("selectreadstreams() method takes 1-3 arguments");
+	if(lua.argc()<1||lua.argc()>4) throw std::runtime_error("selectreadstreams() method takes 1-4 arguments");
 	
 	std::vector<int> streams;
 	const LuaValue &t=lua.argv(0);
@@ -1048,7 +1615,9 @@ int SDMSourceLua::LuaMethod_selectreadstreams(LuaServer &lua) {
 	if(lua.argc()>=2) packets=static_cast<std::size_t>(lua.argv(1).toInteger());
 	
 	int df=1;
-	if(lua.argc()==3) df=static_cast<int>(lua.argv(2).toInteger());
+	if(lua.argc()>=3) df=static_cast<int>(lua.argv(2).toInteger());
+	
+	if(lua.argc()==4) setDecimationMode(SDMDecimator::modeFromName(lua.argv(3).toString()));
 	
 	selectReadStreams(streams,packets,df);
 	
@@ -1112,3 +1681,58 @@ int SDMSourceLua::LuaMethod_readstreamerrors(LuaServer &lua) {
 	lua.pushValue(static_cast<lua_Integer>(r));
 	return 1;
 }
+
+int SDMSourceLua::LuaMethod_readpacket(LuaServer &lua) {
+	if(lua.argc()!=1) throw std::runtime_error("readpacket() method takes 1 argument");
+	
+	const int stream=static_cast<int>(lua.argv(0).toInteger());
+	
+	LuaValue t;
+	auto &arr=t.newarray();
+	
+	const sdm_sample_t *data;
+	std::size_t n;
+	if(acquirePacket(stream,data,n)==0) {
+		arr.reserve(n);
+		for(std::size_t i=0;i<n;i++) arr.emplace_back(static_cast<lua_Number>(data[i]));
+		releasePacket(stream);
+	}
+	else { // the source can't lend packets, read the rest of the packet chunk by chunk
+		std::vector<sdm_sample_t> buf(16384);
+		for(;;) {
+			int r=readStream(stream,buf.data(),buf.size(),AllowPartial);
+			if(r<=0) break;
+			for(int i=0;i<r;i++) arr.emplace_back(static_cast<lua_Number>(buf[i]));
+		}
+	}
+	
+	lua.pushValue(t);
+	return 1;
+}
+
+int SDMSourceLua::LuaMethod_packetinfo(LuaServer &lua) {
+	if(lua.argc()!=0) throw std::runtime_error("packetinfo() method doesn't take arguments");
+	
+	sdm_packet_info_t info;
+	if(!packetInfo(info)) {
+		lua.pushValue(LuaValue()); // not supported
+		return 1;
+	}
+	
+	LuaValue t;
+	t.newtable();
+	if(info.flags&SDM_PACKETINFO_SEQUENCE) t.table()["sequence"]=static_cast<lua_Integer>(info.sequence);
+	if(info.flags&SDM_PACKETINFO_TIMESTAMP) t.table()["timestamp"]=static_cast<lua_Integer>(info.timestamp);
+	if(info.flags&SDM_PACKETINFO_ARRIVAL) t.table()["arrival"]=static_cast<lua_Integer>(info.arrival);
+	
+	lua.pushValue(t);
+	return 1;
+}
+
+int SDMSourceLua::LuaMethod_lock(LuaServer &lua) {
+	if(lua.argc()!=1) throw std::runtime_error("lock() method takes 1 argument");
+	if(callbackMutex()==nullptr) return 0; // Mutex is not set - do nothing
+	if(lua.argv(0).toBoolean()) _lock.lock(lua,{sharedCallbackMutex()});
+	else _lock.unlock();
+	return 0;
+}
@@ -49,6 +49,7 @@ private:
 		std::thread::id unsafeDestructionThread;
 		std::vector<std::thread::id> callbackThreadStack;
 		callback_mutex_t *callbackMutex=nullptr;
+		std::shared_ptr<callback_mutex_t> callbackMutexOwner; // set if the mutex is shared
 	};
 	
 	std::shared_ptr<ControlBlock> _cb;
@@ -62,8 +63,14 @@ public:
 	LuaCallbackObject &operator=(const LuaCallbackObject &);
 	LuaCallbackObject &operator=(LuaCallbackObject &&);
 	
-	void setCallbackMutex(callback_mutex_t *m) {_cb->callbackMutex=m;}
+	void setCallbackMutex(callback_mutex_t *m) {_cb->callbackMutex=m;_cb->callbackMutexOwner.reset();}
+	void setCallbackMutex(const std::shared_ptr<callback_mutex_t> &m) {_cb->callbackMutex=m.get();_cb->callbackMutexOwner=m;}
 	callback_mutex_t *callbackMutex() const {return _cb->callbackMutex;}
+// Returns a pointer that keeps the mutex alive if it is shared (non-owning otherwise)
+	std::shared_ptr<callback_mutex_t> sharedCallbackMutex() const {
+		if(_cb->callbackMutexOwner) return _cb->callbackMutexOwner;
+		return std::shared_ptr<callback_mutex_t>(std::shared_ptr<callback_mutex_t>(),_cb->callbackMutex);
+	}
 	
 	virtual std::string objectType() const=0;
 
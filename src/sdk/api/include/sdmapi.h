@@ -85,4 +85,63 @@ SDMAPI int SDMCALL sdmReadNextPacket(void *h);
 SDMAPI void SDMCALL sdmDiscardPackets(void *h);
 SDMAPI int SDMCALL sdmReadStreamErrors(void *h);
 
+/********************************************************************
+ * Optional plugin functions
+ * 
+ * Plugins are not required to export these functions. If
+ * sdmGetCapabilities() is missing, clients must detect optional
+ * functions by their names.
+ *******************************************************************/
+
+SDMAPI int SDMCALL sdmGetCapabilities(sdm_capabilities_t *caps);
+SDMAPI int SDMCALL sdmGetLastError(char *buf,size_t n);
+
+/********************************************************************
+ * Optional property functions
+ * 
+ * Plugins are not required to export these functions. Clients must
+ * fall back to getting properties one by one if they are missing.
+ *******************************************************************/
+
+SDMAPI int SDMCALL sdmGetPluginProperties(const char *names,char *buf,size_t n);
+SDMAPI int SDMCALL sdmGetDeviceProperties(void *h,const char *names,char *buf,size_t n);
+SDMAPI int SDMCALL sdmGetChannelProperties(void *h,const char *names,char *buf,size_t n);
+SDMAPI int SDMCALL sdmGetSourceProperties(void *h,const char *names,char *buf,size_t n);
+
+/********************************************************************
+ * Optional control channel functions
+ * 
+ * Plugins are not required to export these functions. Clients must
+ * fall back to the basic control channel functions if they are missing.
+ *******************************************************************/
+
+SDMAPI int SDMCALL sdmWriteRegs(void *h,const sdm_addr_t *addr,const sdm_reg_t *data,size_t n);
+SDMAPI int SDMCALL sdmReadRegs(void *h,const sdm_addr_t *addr,sdm_reg_t *data,size_t n);
+SDMAPI int SDMCALL sdmSubmitWriteReg(void *h,sdm_addr_t addr,sdm_reg_t data);
+SDMAPI int SDMCALL sdmSubmitReadReg(void *h,sdm_addr_t addr);
+SDMAPI int SDMCALL sdmCompleteTransaction(void *h,int token,sdm_reg_t *data,int nb);
+SDMAPI int SDMCALL sdmWriteReg64(void *h,sdm_addr64_t addr,sdm_reg64_t data);
+SDMAPI sdm_reg64_t SDMCALL sdmReadReg64(void *h,sdm_addr64_t addr,int *status);
+SDMAPI int SDMCALL sdmWriteFIFO64(void *h,sdm_addr64_t addr,const sdm_reg64_t *data,size_t n,int flags);
+SDMAPI int SDMCALL sdmReadFIFO64(void *h,sdm_addr64_t addr,sdm_reg64_t *data,size_t n,int flags);
+SDMAPI int SDMCALL sdmWriteMem64(void *h,sdm_addr64_t addr,const sdm_reg64_t *data,size_t n);
+SDMAPI int SDMCALL sdmReadMem64(void *h,sdm_addr64_t addr,sdm_reg64_t *data,size_t n);
+SDMAPI int SDMCALL sdmModifyReg(void *h,sdm_addr_t addr,sdm_reg_t mask,sdm_reg_t data);
+SDMAPI int SDMCALL sdmModifyRegs(void *h,const sdm_addr_t *addr,const sdm_reg_t *mask,const sdm_reg_t *data,size_t n);
+
+/********************************************************************
+ * Optional data source functions
+ * 
+ * Plugins are not required to export these functions. Clients must
+ * fall back to the basic data source functions if they are missing.
+ *******************************************************************/
+
+SDMAPI int SDMCALL sdmGetStreamFormat(void *h,int stream);
+SDMAPI int SDMCALL sdmReadStreamTyped(void *h,int stream,void *data,size_t n,int format,int nb);
+SDMAPI int SDMCALL sdmAcquirePacket(void *h,int stream,const sdm_sample_t **data,size_t *n,int nb);
+SDMAPI int SDMCALL sdmReleasePacket(void *h,int stream);
+SDMAPI int SDMCALL sdmSetReadyCallback(void *h,sdm_ready_callback_t callback,void *context);
+SDMAPI int SDMCALL sdmReadStreams(void *h,const int *streams,sdm_sample_t * const *data,const size_t *n,int *res,size_t count,int nb);
+SDMAPI int SDMCALL sdmGetPacketInfo(void *h,sdm_packet_info_t *info);
+
 #endif
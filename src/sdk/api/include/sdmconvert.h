@@ -0,0 +1,82 @@
+/*
+ * Copyright (c) 2015-2022 Simple Device Model contributors
+ * 
+ * This file is part of the Simple Device Model (SDM) framework SDK.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ * This header file defines conversion of samples to the formats
+ * supported by sdmReadStreamTyped(). It is used by both the plugin
+ * provider library and the client when the other side can't convert
+ * samples itself. C++ only.
+ */
+
+#ifndef SDMCONVERT_H_INCLUDED
+#define SDMCONVERT_H_INCLUDED
+
+#include "sdmtypes.h"
+
+#include <cstdint>
+
+/*
+ * Samples outside the range of the target type are saturated, NaN
+ * is converted to the lower bound.
+ */
+
+template <typename T> inline void sdmConvertSamples(const sdm_sample_t *src,void *dest,std::size_t n,double lo,double hi) {
+	T *out=static_cast<T*>(dest);
+	for(std::size_t i=0;i<n;i++) {
+		double v=src[i];
+		if(!(v>=lo)) v=lo; // also catches NaN
+		else if(v>hi) v=hi;
+		out[i]=static_cast<T>(v);
+	}
+}
+
+/*
+ * Converts n samples to one of SDM_SAMPLE_* formats. Returns false
+ * if the format is not supported (SDM_SAMPLE_DOUBLE is not converted).
+ */
+
+inline bool sdmConvertSamples(const sdm_sample_t *src,void *dest,std::size_t n,int format) {
+	switch(format) {
+	case SDM_SAMPLE_FLOAT:
+		sdmConvertSamples<float>(src,dest,n,-3.402823466e38,3.402823466e38);
+		return true;
+	case SDM_SAMPLE_INT8:
+		sdmConvertSamples<std::int8_t>(src,dest,n,-128,127);
+		return true;
+	case SDM_SAMPLE_UINT8:
+		sdmConvertSamples<std::uint8_t>(src,dest,n,0,255);
+		return true;
+	case SDM_SAMPLE_INT16:
+		sdmConvertSamples<std::int16_t>(src,dest,n,-32768,32767);
+		return true;
+	case SDM_SAMPLE_UINT16:
+		sdmConvertSamples<std::uint16_t>(src,dest,n,0,65535);
+		return true;
+	case SDM_SAMPLE_INT32:
+		sdmConvertSamples<std::int32_t>(src,dest,n,-2147483648.0,2147483647.0);
+		return true;
+	default:
+		return false;
+	}
+}
+
+#endif
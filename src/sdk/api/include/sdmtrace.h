@@ -0,0 +1,141 @@
+/*
+ * Copyright (c) 2015-2022 Simple Device Model contributors
+ * 
+ * This file is part of the Simple Device Model (SDM) framework SDK.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ * This header file defines the format of SDM trace files. A trace
+ * is a recording of plugin calls made by a client, including their
+ * results and stream data. It can be served back by the "replayplugin"
+ * SDK example to run clients without hardware.
+ */
+
+#ifndef SDMTRACE_H_INCLUDED
+#define SDMTRACE_H_INCLUDED
+
+#include "sdmtypes.h"
+
+/*
+ * A trace file starts with sdm_trace_header_t followed by records.
+ * Each record consists of sdm_trace_record_t followed by "size" bytes
+ * of payload. All values use the byte order of the recording machine,
+ * readers can detect it with the "byteOrder" field.
+ *
+ * Objects are identified by numbers assigned by the recorder, unique
+ * within the trace. Plugin, device, channel and source objects are
+ * introduced by the corresponding SDM_TRACE_OPEN* record before use.
+ */
+
+#define SDM_TRACE_MAGIC "SDMTRACE"
+#define SDM_TRACE_VERSION 1
+#define SDM_TRACE_BYTEORDER 0x01020304
+
+typedef struct {
+	char magic[8];                   /* SDM_TRACE_MAGIC without the terminating null */
+	sdm_uint32_t version;            /* SDM_TRACE_VERSION */
+	sdm_uint32_t byteOrder;          /* SDM_TRACE_BYTEORDER */
+} sdm_trace_header_t;
+
+typedef struct {
+	sdm_uint32_t type;               /* one of SDM_TRACE_* record types */
+	sdm_uint32_t object;             /* object number, 0 if not applicable */
+	sdm_uint64_t time;               /* nanoseconds since the start of the trace */
+	sdm_uint64_t arg;                /* record specific argument */
+	sdm_uint32_t status;             /* result code (as a two's complement int) */
+	sdm_uint32_t size;               /* payload size in bytes */
+} sdm_trace_record_t;
+
+/*
+ * Record types. Unless stated otherwise, "status" holds the value
+ * returned by the plugin function.
+ */
+
+/* Objects. Payload of OPENDEVICE, OPENCHANNEL and OPENSOURCE records
+ * is the parent object number (sdm_uint32_t), "arg" is the index
+ * passed to the plugin. Payload of OPENPLUGIN is the plugin file name. */
+#define SDM_TRACE_OPENPLUGIN 1
+#define SDM_TRACE_OPENDEVICE 2
+#define SDM_TRACE_OPENCHANNEL 3
+#define SDM_TRACE_OPENSOURCE 4
+#define SDM_TRACE_CLOSE 5
+
+/* Properties. Payload is a null-terminated name followed by
+ * a null-terminated value. GETPROPERTIES payload is the result of
+ * a batch query: name/value pairs terminated by an empty string. */
+#define SDM_TRACE_GETPROPERTY 16
+#define SDM_TRACE_SETPROPERTY 17
+#define SDM_TRACE_GETPROPERTIES 18
+
+/* Devices */
+#define SDM_TRACE_CONNECT 32
+#define SDM_TRACE_DISCONNECT 33
+
+/* Channels. "arg" is the address, payload is an array of sdm_reg_t.
+ * For WRITEREGS and READREGS, payload contains n addresses followed
+ * by n values. */
+#define SDM_TRACE_WRITEREG 48
+#define SDM_TRACE_READREG 49
+#define SDM_TRACE_WRITEFIFO 50
+#define SDM_TRACE_READFIFO 51
+#define SDM_TRACE_WRITEMEM 52
+#define SDM_TRACE_READMEM 53
+#define SDM_TRACE_WRITEREGS 54
+#define SDM_TRACE_READREGS 55
+
+/* Asynchronous transactions and read-modify-write operations. For
+ * SUBMITWRITEREG and SUBMITREADREG, "arg" is the address, "status" is
+ * the token (or an error code), SUBMITWRITEREG payload is the value.
+ * For COMPLETETRANSACTION, "arg" is the token, payload is the value
+ * returned (only if "status" is 0). MODIFYREG payload is the mask
+ * followed by the data. For MODIFYREGS, "arg" is the number of
+ * registers n, payload contains n addresses, n masks and n values. */
+#define SDM_TRACE_SUBMITWRITEREG 56
+#define SDM_TRACE_SUBMITREADREG 57
+#define SDM_TRACE_COMPLETETRANSACTION 58
+#define SDM_TRACE_MODIFYREG 59
+#define SDM_TRACE_MODIFYREGS 60
+
+/* Sources. For SELECTSTREAMS, "arg" is the number of packets,
+ * payload is the decimation factor followed by stream numbers
+ * (all as sdm_uint32_t). For READSTREAM, the low 32 bits of "arg"
+ * hold the stream number, the next 8 bits hold the SDM_SAMPLE_*
+ * format of the payload samples, "status" is the number of samples
+ * (0 at the end of the packet). */
+#define SDM_TRACE_SELECTSTREAMS 64
+#define SDM_TRACE_READSTREAM 65
+#define SDM_TRACE_READNEXTPACKET 66
+#define SDM_TRACE_DISCARDPACKETS 67
+
+/* Source state. PACKETINFO payload is sdm_packet_info_t (only if
+ * "status" is 0). For READSTREAMERRORS, "status" is the returned
+ * error count. */
+#define SDM_TRACE_PACKETINFO 68
+#define SDM_TRACE_READSTREAMERRORS 69
+
+/* 64-bit channel access, same as the 32-bit records above, but "arg"
+ * is a 64-bit address and payload is an array of sdm_reg64_t */
+#define SDM_TRACE_WRITEREG64 80
+#define SDM_TRACE_READREG64 81
+#define SDM_TRACE_WRITEFIFO64 82
+#define SDM_TRACE_READFIFO64 83
+#define SDM_TRACE_WRITEMEM64 84
+#define SDM_TRACE_READMEM64 85
+
+#endif
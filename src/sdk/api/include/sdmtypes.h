@@ -80,25 +80,111 @@
 #if (__cplusplus>=201103L) || (defined(__cplusplus) && (_MSC_VER>=1600))
 	#include <cstdint>
 	typedef std::uint32_t sdm_uint32_t;
+	typedef std::uint64_t sdm_uint64_t;
 #elif (__STDC_VERSION__>=199901L) || (_MSC_VER>=1600)
 	#include <stdint.h>
 	typedef uint32_t sdm_uint32_t;
-#elif defined(__UINT32_TYPE__) /* usually predefined by GCC */
+	typedef uint64_t sdm_uint64_t;
+#elif defined(__UINT32_TYPE__) && defined(__UINT64_TYPE__) /* usually predefined by GCC */
 	typedef __UINT32_TYPE__ sdm_uint32_t;
+	typedef __UINT64_TYPE__ sdm_uint64_t;
 #elif defined(_WIN32) && (defined(_MSC_VER) || defined(__BORLANDC__))
 	typedef unsigned __int32 sdm_uint32_t;
+	typedef unsigned __int64 sdm_uint64_t;
 #elif defined(_WIN32)
 	#include <windef.h>
 	typedef DWORD sdm_uint32_t;
+	typedef DWORD64 sdm_uint64_t;
 #else
 	#include <stdint.h>
 	typedef uint32_t sdm_uint32_t;
+	typedef uint64_t sdm_uint64_t;
 #endif
 
 typedef sdm_uint32_t sdm_addr_t;
 typedef sdm_uint32_t sdm_reg_t;
+typedef sdm_uint64_t sdm_addr64_t;
+typedef sdm_uint64_t sdm_reg64_t;
 typedef double sdm_sample_t;
 
+/* Readiness notification callback, see sdmSetReadyCallback() */
+typedef void (SDMCALL *sdm_ready_callback_t)(void *);
+
+/* Packet metadata, see sdmGetPacketInfo() */
+
+#define SDM_PACKETINFO_SEQUENCE 0x0001   /* "sequence" field is valid */
+#define SDM_PACKETINFO_TIMESTAMP 0x0002  /* "timestamp" field is valid */
+#define SDM_PACKETINFO_ARRIVAL 0x0004    /* "arrival" field is valid */
+
+/*
+ * All fields are 64-bit so that the layout doesn't depend on the
+ * alignment rules of the compiler (e.g. 32-bit GCC and MSVC align
+ * 64-bit integers differently)
+ */
+
+typedef struct {
+	sdm_uint64_t flags;              /* SDM_PACKETINFO_* flags */
+	sdm_uint64_t sequence;           /* packet sequence number, increments by 1 for every packet */
+	sdm_uint64_t timestamp;          /* device timestamp, units are defined by the plugin */
+	sdm_uint64_t arrival;            /* host arrival time, microseconds of the monotonic clock */
+} sdm_packet_info_t;
+
+/* Compile-time layout check (the array size is negative on mismatch) */
+typedef char sdm_packet_info_size_check[sizeof(sdm_packet_info_t)==32?1:-1];
+
+/********************************************************************
+ * Sample formats
+ *******************************************************************/
+
+/*
+ * Sample formats for sdmReadStreamTyped(). SDM_SAMPLE_DOUBLE
+ * corresponds to sdm_sample_t and is supported by every plugin.
+ */
+
+#define SDM_SAMPLE_DOUBLE 0
+#define SDM_SAMPLE_FLOAT 1
+#define SDM_SAMPLE_INT8 2
+#define SDM_SAMPLE_UINT8 3
+#define SDM_SAMPLE_INT16 4
+#define SDM_SAMPLE_UINT16 5
+#define SDM_SAMPLE_INT32 6
+
+/********************************************************************
+ * Plugin capabilities
+ *******************************************************************/
+
+/* Groups of optional functions, see sdmGetCapabilities() */
+
+#define SDM_FEATURE_REGBATCH 0x0001      /* sdmWriteRegs(), sdmReadRegs() */
+#define SDM_FEATURE_ASYNCREGS 0x0002     /* sdmSubmitWriteReg(), sdmSubmitReadReg(), sdmCompleteTransaction() */
+#define SDM_FEATURE_TYPEDREAD 0x0004     /* sdmGetStreamFormat(), sdmReadStreamTyped() */
+#define SDM_FEATURE_ACQUIRE 0x0008       /* sdmAcquirePacket(), sdmReleasePacket() */
+#define SDM_FEATURE_READYCALLBACK 0x0010 /* sdmSetReadyCallback() */
+#define SDM_FEATURE_MULTISTREAM 0x0020   /* sdmReadStreams() */
+#define SDM_FEATURE_PACKETINFO 0x0040    /* sdmGetPacketInfo() */
+#define SDM_FEATURE_BATCHPROPS 0x0080    /* sdmGetPluginProperties(), sdmGetDeviceProperties() etc. */
+#define SDM_FEATURE_REG64 0x0100         /* sdmWriteReg64(), sdmReadReg64(), sdmWriteMem64() etc. */
+#define SDM_FEATURE_DECIMATION 0x0200    /* sdmSelectReadStreams() honors the decimation factor */
+#define SDM_FEATURE_MODIFYREG 0x0400     /* sdmModifyReg(), sdmModifyRegs() */
+#define SDM_FEATURE_LASTERROR 0x0800     /* sdmGetLastError() */
+
+/* Thread safety levels */
+
+#define SDM_THREADSAFE_NONE 0            /* all calls must be serialized */
+#define SDM_THREADSAFE_DEVICE 1          /* calls for different devices can be concurrent */
+#define SDM_THREADSAFE_OBJECT 2          /* calls for different channels and sources can be concurrent */
+#define SDM_THREADSAFE_FULL 3            /* any calls can be concurrent */
+
+typedef struct {
+	size_t size;                     /* structure size in bytes, set by the caller */
+	sdm_uint32_t features;           /* SDM_FEATURE_* flags */
+	sdm_uint32_t formats;            /* native sample formats: bit N is set for format N */
+	int threadSafety;                /* one of SDM_THREADSAFE_* */
+	size_t maxRegBatch;              /* sdmWriteRegs()/sdmReadRegs() batch limit, 0 if unlimited */
+	size_t maxStreamBatch;           /* sdmReadStreams() batch limit, 0 if unlimited */
+	size_t preferredPacketSize;      /* in samples, 0 if unknown */
+} sdm_capabilities_t;
+
 /********************************************************************
  * Error codes
  *******************************************************************/
@@ -112,6 +198,7 @@ typedef double sdm_sample_t;
 
 #define SDM_ERROR -1                /* Unspecified error */
 #define SDM_WOULDBLOCK -2           /* Non-blocking operation request would block */
+#define SDM_NOTSUPPORTED -3         /* Operation is not supported by the object */
 
 #define SDM_USERERROR -1000         /* User defined error */
 
@@ -140,6 +227,11 @@ typedef int (SDMCALL *PtrSdmWriteFIFO)(void *,sdm_addr_t,const sdm_reg_t *,size_
 typedef int (SDMCALL *PtrSdmReadFIFO)(void *,sdm_addr_t,sdm_reg_t *,size_t,int);
 typedef int (SDMCALL *PtrSdmWriteMem)(void *,sdm_addr_t,const sdm_reg_t *,size_t);
 typedef int (SDMCALL *PtrSdmReadMem)(void *,sdm_addr_t,sdm_reg_t *,size_t);
+typedef int (SDMCALL *PtrSdmWriteRegs)(void *,const sdm_addr_t *,const sdm_reg_t *,size_t);
+typedef int (SDMCALL *PtrSdmReadRegs)(void *,const sdm_addr_t *,sdm_reg_t *,size_t);
+typedef int (SDMCALL *PtrSdmSubmitWriteReg)(void *,sdm_addr_t,sdm_reg_t);
+typedef int (SDMCALL *PtrSdmSubmitReadReg)(void *,sdm_addr_t);
+typedef int (SDMCALL *PtrSdmCompleteTransaction)(void *,int,sdm_reg_t *,int);
 
 typedef void * (SDMCALL *PtrSdmOpenSource)(void *,int);
 typedef int (SDMCALL *PtrSdmCloseSource)(void *);
@@ -150,5 +242,26 @@ typedef int (SDMCALL *PtrSdmReadStream)(void *,int,sdm_sample_t *,size_t,int);
 typedef int (SDMCALL *PtrSdmReadNextPacket)(void *);
 typedef void (SDMCALL *PtrSdmDiscardPackets)(void *);
 typedef int (SDMCALL *PtrSdmReadStreamErrors)(void *);
+typedef int (SDMCALL *PtrSdmGetStreamFormat)(void *,int);
+typedef int (SDMCALL *PtrSdmReadStreamTyped)(void *,int,void *,size_t,int,int);
+typedef int (SDMCALL *PtrSdmAcquirePacket)(void *,int,const sdm_sample_t **,size_t *,int);
+typedef int (SDMCALL *PtrSdmReleasePacket)(void *,int);
+typedef int (SDMCALL *PtrSdmSetReadyCallback)(void *,sdm_ready_callback_t,void *);
+typedef int (SDMCALL *PtrSdmGetCapabilities)(sdm_capabilities_t *);
+typedef int (SDMCALL *PtrSdmGetPluginProperties)(const char *,char *,size_t);
+typedef int (SDMCALL *PtrSdmGetDeviceProperties)(void *,const char *,char *,size_t);
+typedef int (SDMCALL *PtrSdmGetChannelProperties)(void *,const char *,char *,size_t);
+typedef int (SDMCALL *PtrSdmGetSourceProperties)(void *,const char *,char *,size_t);
+typedef int (SDMCALL *PtrSdmReadStreams)(void *,const int *,sdm_sample_t * const *,const size_t *,int *,size_t,int);
+typedef int (SDMCALL *PtrSdmGetPacketInfo)(void *,sdm_packet_info_t *);
+typedef int (SDMCALL *PtrSdmWriteReg64)(void *,sdm_addr64_t,sdm_reg64_t);
+typedef sdm_reg64_t (SDMCALL *PtrSdmReadReg64)(void *,sdm_addr64_t,int *);
+typedef int (SDMCALL *PtrSdmWriteFIFO64)(void *,sdm_addr64_t,const sdm_reg64_t *,size_t,int);
+typedef int (SDMCALL *PtrSdmReadFIFO64)(void *,sdm_addr64_t,sdm_reg64_t *,size_t,int);
+typedef int (SDMCALL *PtrSdmWriteMem64)(void *,sdm_addr64_t,const sdm_reg64_t *,size_t);
+typedef int (SDMCALL *PtrSdmReadMem64)(void *,sdm_addr64_t,sdm_reg64_t *,size_t);
+typedef int (SDMCALL *PtrSdmModifyReg)(void *,sdm_addr_t,sdm_reg_t,sdm_reg_t);
+typedef int (SDMCALL *PtrSdmModifyRegs)(void *,const sdm_addr_t *,const sdm_reg_t *,const sdm_reg_t *,size_t);
+typedef int (SDMCALL *PtrSdmGetLastError)(char *,size_t);
 
 #endif
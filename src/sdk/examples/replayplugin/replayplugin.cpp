@@ -0,0 +1,556 @@
+/*
+ * Copyright (c) 2015-2022 Simple Device Model contributors
+ * 
+ * This file is part of the Simple Device Model (SDM) framework SDK.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ * This module implements an SDM plugin which serves a trace recorded
+ * by SDMPlug (see sdmtrace.h) back to the client. It allows to run
+ * clients and benchmarks without hardware.
+ *
+ * Plugin properties:
+ *   "TraceFile": trace file name (the SDM_REPLAY_TRACE environment
+ *     variable by default)
+ *   "Timing": "Fast" to serve data as fast as possible, "Original"
+ *     to reproduce the timing of the recording
+ */
+
+#include "replayplugin.h"
+#include "sdmtrace.h"
+
+#include <fstream>
+#include <thread>
+#include <cstring>
+#include <climits>
+#include <cstdlib>
+#include <stdexcept>
+#include <algorithm>
+
+namespace {
+	template <typename T> void appendSamples(const std::vector<char> &payload,std::size_t n,std::vector<sdm_sample_t> &out) {
+		if(payload.size()<n*sizeof(T)) n=payload.size()/sizeof(T);
+		for(std::size_t i=0;i<n;i++) {
+			T sample;
+			std::memcpy(&sample,payload.data()+i*sizeof(T),sizeof(T));
+			out.push_back(static_cast<sdm_sample_t>(sample));
+		}
+	}
+	
+	std::size_t stringLength(const std::vector<char> &payload,std::size_t pos) {
+		auto end=static_cast<const char*>(std::memchr(payload.data()+pos,0,payload.size()-pos));
+		if(!end) return payload.size()-pos;
+		return static_cast<std::size_t>(end-(payload.data()+pos));
+	}
+	
+	sdm_reg_t regAt(const std::vector<char> &payload,std::size_t i) {
+		sdm_reg_t value;
+		std::memcpy(&value,payload.data()+i*sizeof(sdm_reg_t),sizeof(sdm_reg_t));
+		return value;
+	}
+	
+	sdm_reg64_t reg64At(const std::vector<char> &payload,std::size_t i) {
+		sdm_reg64_t value;
+		std::memcpy(&value,payload.data()+i*sizeof(sdm_reg64_t),sizeof(sdm_reg64_t));
+		return value;
+	}
+	
+	bool originalTiming() {
+		return SDMAbstractPlugin::instance()->getProperty("Timing")=="Original";
+	}
+}
+
+/*
+ * ReplayPlugin instance
+ */
+
+SDMAbstractPlugin *SDMAbstractPlugin::instance() {
+	static ReplayPlugin plugin;
+	return &plugin;
+}
+
+/*
+ * ReplayTrace members
+ */
+
+void ReplayTrace::load(const std::string &path) {
+	std::ifstream in(path,std::ios::in|std::ios::binary);
+	if(!in) throw std::runtime_error("Cannot open trace file \""+path+"\"");
+	
+	sdm_trace_header_t header;
+	if(!in.read(reinterpret_cast<char*>(&header),sizeof(header))||
+		std::memcmp(header.magic,SDM_TRACE_MAGIC,sizeof(header.magic))!=0)
+			throw std::runtime_error("Not an SDM trace file");
+	if(header.byteOrder!=SDM_TRACE_BYTEORDER) throw std::runtime_error("Trace byte order is not supported");
+	if(header.version!=SDM_TRACE_VERSION) throw std::runtime_error("Trace version is not supported");
+	
+	plugin.clear();
+	objects.clear();
+	
+	std::map<sdm_uint32_t,std::string> paths; // currently opened objects
+	std::map<sdm_uint32_t,bool> nextPacket;
+	std::map<sdm_uint32_t,std::map<int,sdm_addr_t> > pendingReads; // token => address
+	sdm_trace_record_t rec;
+	std::vector<char> payload;
+	
+// A trace can be cut short if the recording program was terminated,
+// an incomplete record at the end is ignored
+	while(in.read(reinterpret_cast<char*>(&rec),sizeof(rec))) {
+		payload.resize(rec.size);
+		if(rec.size>0&&!in.read(payload.data(),rec.size)) break;
+		const int status=static_cast<int>(rec.status);
+		
+		if(rec.type==SDM_TRACE_OPENPLUGIN) {
+			const std::string name(payload.begin(),payload.end());
+			if(plugin.empty()) plugin=name;
+			if(name==plugin) paths[rec.object]="";
+			continue;
+		}
+		if(rec.type==SDM_TRACE_OPENDEVICE||rec.type==SDM_TRACE_OPENCHANNEL||rec.type==SDM_TRACE_OPENSOURCE) {
+			if(payload.size()<sizeof(sdm_uint32_t)) continue;
+			sdm_uint32_t parent;
+			std::memcpy(&parent,payload.data(),sizeof(parent));
+			auto it=paths.find(parent);
+			if(it==paths.end()) continue; // object of another plugin
+			std::string path;
+			if(rec.type==SDM_TRACE_OPENDEVICE) path="device"+std::to_string(rec.arg);
+			else if(rec.type==SDM_TRACE_OPENCHANNEL) path=it->second+"/channel"+std::to_string(rec.arg);
+			else path=it->second+"/source"+std::to_string(rec.arg);
+			paths[rec.object]=path;
+			if(objects.find(path)==objects.end()) objects[path].openTime=rec.time;
+			nextPacket[rec.object]=true;
+			continue;
+		}
+		if(rec.type==SDM_TRACE_CLOSE) {
+			paths.erase(rec.object);
+			continue;
+		}
+		
+		auto it=paths.find(rec.object);
+		if(it==paths.end()) continue;
+		Object &obj=objects[it->second];
+		
+		auto currentPacket=[&]()->Packet& {
+			if(obj.packets.empty()||nextPacket[rec.object]) {
+				const int errors=obj.packets.empty()?0:obj.packets.back().errors;
+				obj.packets.push_back(Packet());
+				obj.packets.back().time=rec.time;
+				obj.packets.back().errors=errors;
+				nextPacket[rec.object]=false;
+			}
+			return obj.packets.back();
+		};
+		
+		switch(rec.type) {
+		case SDM_TRACE_GETPROPERTY:
+		case SDM_TRACE_SETPROPERTY:
+		case SDM_TRACE_GETPROPERTIES:
+// Payload is a sequence of null-terminated name/value pairs. The first
+// recorded value is used, pseudo-properties are not replayed.
+			if(status!=0) break;
+			for(std::size_t pos=0;pos<payload.size();) {
+				const char *name=payload.data()+pos;
+				const std::size_t nameLen=stringLength(payload,pos);
+				if(nameLen==0||pos+nameLen+1>=payload.size()) break;
+				pos+=nameLen+1;
+				const char *value=payload.data()+pos;
+				const std::size_t valueLen=stringLength(payload,pos);
+				pos+=valueLen+1;
+				if(name[0]!='*') obj.properties.emplace(std::string(name,nameLen),std::string(value,valueLen));
+			}
+			break;
+		case SDM_TRACE_READREG:
+			if(status==0&&payload.size()>=sizeof(sdm_reg_t)) obj.reads[static_cast<sdm_addr_t>(rec.arg)].push_back({rec.time,regAt(payload,0)});
+			break;
+		case SDM_TRACE_READFIFO:
+			for(std::size_t i=0;i<payload.size()/sizeof(sdm_reg_t);i++)
+				obj.reads[static_cast<sdm_addr_t>(rec.arg)].push_back({rec.time,regAt(payload,i)});
+			break;
+		case SDM_TRACE_READMEM:
+			for(std::size_t i=0;i<payload.size()/sizeof(sdm_reg_t);i++)
+				obj.reads[static_cast<sdm_addr_t>(rec.arg+i)].push_back({rec.time,regAt(payload,i)});
+			break;
+		case SDM_TRACE_READREGS:
+			if(status!=0||payload.size()<2*rec.arg*sizeof(sdm_reg_t)) break;
+			for(std::size_t i=0;i<rec.arg;i++)
+				obj.reads[regAt(payload,i)].push_back({rec.time,regAt(payload,rec.arg+i)});
+			break;
+		case SDM_TRACE_SUBMITREADREG:
+			if(status>=0) pendingReads[rec.object][status]=static_cast<sdm_addr_t>(rec.arg);
+			break;
+		case SDM_TRACE_COMPLETETRANSACTION:
+			{
+				auto &pending=pendingReads[rec.object];
+				auto read=pending.find(static_cast<int>(rec.arg));
+				if(read==pending.end()) break; // write transaction
+				if(status==0&&payload.size()>=sizeof(sdm_reg_t)) obj.reads[read->second].push_back({rec.time,regAt(payload,0)});
+				pending.erase(read);
+			}
+			break;
+		case SDM_TRACE_MODIFYREG:
+		case SDM_TRACE_MODIFYREGS:
+// No value is returned, ReplayChannel applies the operation itself
+			break;
+		case SDM_TRACE_READREG64:
+			if(status==0&&payload.size()>=sizeof(sdm_reg64_t)) obj.reads64[rec.arg].push_back({rec.time,reg64At(payload,0)});
+			break;
+		case SDM_TRACE_READFIFO64:
+			for(std::size_t i=0;i<payload.size()/sizeof(sdm_reg64_t);i++)
+				obj.reads64[rec.arg].push_back({rec.time,reg64At(payload,i)});
+			break;
+		case SDM_TRACE_READMEM64:
+			for(std::size_t i=0;i<payload.size()/sizeof(sdm_reg64_t);i++)
+				obj.reads64[rec.arg+i].push_back({rec.time,reg64At(payload,i)});
+			break;
+		case SDM_TRACE_READSTREAM:
+			{
+				if(status<=0) break;
+				const int stream=static_cast<int>(rec.arg&0xFFFFFFFF);
+				auto &samples=currentPacket().streams[stream];
+				const std::size_t n=static_cast<std::size_t>(status);
+				switch(static_cast<int>((rec.arg>>32)&0xFF)) {
+				case SDM_SAMPLE_DOUBLE:
+					appendSamples<double>(payload,n,samples);
+					break;
+				case SDM_SAMPLE_FLOAT:
+					appendSamples<float>(payload,n,samples);
+					break;
+				case SDM_SAMPLE_INT8:
+					appendSamples<std::int8_t>(payload,n,samples);
+					break;
+				case SDM_SAMPLE_UINT8:
+					appendSamples<std::uint8_t>(payload,n,samples);
+					break;
+				case SDM_SAMPLE_INT16:
+					appendSamples<std::int16_t>(payload,n,samples);
+					break;
+				case SDM_SAMPLE_UINT16:
+					appendSamples<std::uint16_t>(payload,n,samples);
+					break;
+				case SDM_SAMPLE_INT32:
+					appendSamples<std::int32_t>(payload,n,samples);
+					break;
+				}
+			}
+			break;
+		case SDM_TRACE_PACKETINFO:
+			if(status==0&&payload.size()>=sizeof(sdm_packet_info_t)) {
+				Packet &packet=currentPacket();
+				std::memcpy(&packet.info,payload.data(),sizeof(sdm_packet_info_t));
+				packet.hasInfo=true;
+			}
+			break;
+		case SDM_TRACE_READSTREAMERRORS:
+			if(!obj.packets.empty()) obj.packets.back().errors=status;
+			break;
+		case SDM_TRACE_SELECTSTREAMS:
+		case SDM_TRACE_READNEXTPACKET:
+		case SDM_TRACE_DISCARDPACKETS:
+			nextPacket[rec.object]=true;
+			break;
+		}
+	}
+	
+	if(plugin.empty()) throw std::runtime_error("The trace doesn't contain plugin calls");
+}
+
+const ReplayTrace::Object *ReplayTrace::find(const std::string &path) const {
+	auto it=objects.find(path);
+	if(it==objects.end()) return nullptr;
+	return &it->second;
+}
+
+/*
+ * ReplayPlugin members
+ */
+
+ReplayPlugin::ReplayPlugin() {
+	setFeatures(SDM_FEATURE_PACKETINFO|SDM_FEATURE_REG64|SDM_FEATURE_MODIFYREG);
+	enableRevision();
+	addConstProperty("Name","Trace replay");
+	addConstProperty("Vendor","Simple Device Model");
+	
+	const char *env=std::getenv("SDM_REPLAY_TRACE");
+	addProperty("TraceFile",env?env:"");
+	addProperty("Timing","Fast");
+	
+	try {
+		if(env&&*env) loadTrace(env);
+	}
+	catch(std::exception &) {} // will be reported by sdmOpenDevice()
+}
+
+SDMAbstractDevice *ReplayPlugin::openDevice(int id) {
+	try {
+		if(!_trace) loadTrace(getProperty("TraceFile"));
+		return new ReplayDevice(_trace,id);
+	}
+	catch(std::exception &) {
+		return nullptr;
+	}
+}
+
+// Channels and sources only read the shared trace, so calls for
+// different objects can be concurrent
+
+int ReplayPlugin::getCapabilities(sdm_capabilities_t *caps) {
+	SDMAbstractPlugin::getCapabilities(caps);
+	caps->threadSafety=SDM_THREADSAFE_OBJECT;
+	return 0;
+}
+
+void ReplayPlugin::setProperty(const std::string &name,const std::string &value) {
+	if(name=="Timing"&&value!="Fast"&&value!="Original")
+		throw std::runtime_error("Unsupported timing mode: \""+value+"\"");
+	if(name=="TraceFile") loadTrace(value);
+	SDMAbstractPlugin::setProperty(name,value);
+}
+
+// Plugin properties from the trace (e.g. the list of devices) are
+// reported along with the replay plugin's own properties
+
+void ReplayPlugin::loadTrace(const std::string &path) {
+	auto trace=std::make_shared<ReplayTrace>();
+	trace->load(path);
+	
+	const std::string timing=getProperty("Timing","Fast");
+	clear();
+	enableRevision();
+	addConstProperty("Name","Trace replay");
+	addConstProperty("Vendor","Simple Device Model");
+	addProperty("TraceFile",path);
+	addProperty("Timing",timing);
+	
+	if(auto obj=trace->find("")) {
+		for(auto const &prop: obj->properties) {
+			if(getProperty(prop.first,"").empty()&&prop.first!="TraceFile")
+				addConstProperty(prop.first,prop.second);
+		}
+	}
+	_trace=trace;
+}
+
+/*
+ * ReplayDevice members
+ */
+
+ReplayDevice::ReplayDevice(const std::shared_ptr<const ReplayTrace> &trace,int id):
+	_trace(trace),
+	_path("device"+std::to_string(id))
+{
+	auto obj=_trace->find(_path);
+	if(!obj) throw std::runtime_error("Device is not in the trace");
+	
+	enableRevision();
+	for(auto const &prop: obj->properties) addProperty(prop.first,prop.second);
+}
+
+int ReplayDevice::close() {
+	delete this;
+	return 0;
+}
+
+SDMAbstractChannel *ReplayDevice::openChannel(int id) {
+	auto obj=_trace->find(_path+"/channel"+std::to_string(id));
+	if(!obj) return nullptr;
+	return new ReplayChannel(_trace,*obj);
+}
+
+SDMAbstractSource *ReplayDevice::openSource(int id) {
+	auto obj=_trace->find(_path+"/source"+std::to_string(id));
+	if(!obj) return nullptr;
+	return new ReplaySource(_trace,*obj);
+}
+
+int ReplayDevice::connect() {
+	_connected=true;
+	return 0;
+}
+
+int ReplayDevice::disconnect() {
+	_connected=false;
+	return 0;
+}
+
+int ReplayDevice::getConnectionStatus() {
+	if(_connected) return 1;
+	return 0;
+}
+
+/*
+ * ReplayChannel members
+ */
+
+ReplayChannel::ReplayChannel(const std::shared_ptr<const ReplayTrace> &trace,const ReplayTrace::Object &obj):
+	_trace(trace),
+	_obj(obj),
+	_originalTiming(originalTiming()),
+	_start(std::chrono::steady_clock::now())
+{
+	enableRevision();
+	for(auto const &prop: _obj.properties) addProperty(prop.first,prop.second);
+}
+
+int ReplayChannel::close() {
+	delete this;
+	return 0;
+}
+
+int ReplayChannel::writeReg(sdm_addr_t addr,sdm_reg_t data) {
+	_regs[addr]=data;
+	_regs64.erase(addr);
+	return 0;
+}
+
+sdm_reg_t ReplayChannel::readReg(sdm_addr_t addr,int *status) {
+	if(status) *status=0;
+	auto it=_obj.reads.find(addr);
+	if(it!=_obj.reads.end()) {
+		std::size_t &next=_next[addr];
+		if(next<it->second.size()) {
+			auto const &v=it->second[next++];
+			if(_originalTiming) std::this_thread::sleep_until(_start+std::chrono::nanoseconds(v.time-_obj.openTime));
+			_regs[addr]=v.value;
+		}
+	}
+	return _regs[addr];
+}
+
+int ReplayChannel::writeReg64(sdm_addr64_t addr,sdm_reg64_t data) {
+	_regs64[addr]=data;
+	if(addr<=0xFFFFFFFF&&data<=0xFFFFFFFF) _regs[static_cast<sdm_addr_t>(addr)]=static_cast<sdm_reg_t>(data);
+	return 0;
+}
+
+sdm_reg64_t ReplayChannel::readReg64(sdm_addr64_t addr,int *status) {
+	auto it=_obj.reads64.find(addr);
+	if(it==_obj.reads64.end()&&_regs64.find(addr)==_regs64.end()&&addr<=0xFFFFFFFF)
+		return readReg(static_cast<sdm_addr_t>(addr),status);
+	
+	if(status) *status=0;
+	if(it!=_obj.reads64.end()) {
+		std::size_t &next=_next64[addr];
+		if(next<it->second.size()) {
+			auto const &v=it->second[next++];
+			if(_originalTiming) std::this_thread::sleep_until(_start+std::chrono::nanoseconds(v.time-_obj.openTime));
+			_regs64[addr]=v.value;
+		}
+	}
+	return _regs64[addr];
+}
+
+int ReplayChannel::modifyReg(sdm_addr_t addr,sdm_reg_t mask,sdm_reg_t data) {
+	_regs[addr]=(_regs[addr]&~mask)|(data&mask);
+	_regs64.erase(addr);
+	return 0;
+}
+
+int ReplayChannel::modifyRegs(const sdm_addr_t *addr,const sdm_reg_t *mask,const sdm_reg_t *data,std::size_t n) {
+	for(std::size_t i=0;i<n;i++) modifyReg(addr[i],mask[i],data[i]);
+	return 0;
+}
+
+/*
+ * ReplaySource members
+ */
+
+ReplaySource::ReplaySource(const std::shared_ptr<const ReplayTrace> &trace,const ReplayTrace::Object &obj):
+	_trace(trace),
+	_obj(obj),
+	_originalTiming(originalTiming())
+{
+	enableRevision();
+	for(auto const &prop: _obj.properties) addProperty(prop.first,prop.second);
+	
+// When starting over, keep the average packet interval
+	if(_obj.packets.size()>1) {
+		const std::uint64_t duration=_obj.packets.back().time-_obj.packets.front().time;
+		_period=duration+duration/(_obj.packets.size()-1);
+	}
+}
+
+int ReplaySource::close() {
+	delete this;
+	return 0;
+}
+
+// Streams are replayed as recorded, so the decimation factor is
+// ignored. Since the plugin doesn't report SDM_FEATURE_DECIMATION,
+// SDMPlug clients decimate samples themselves.
+
+int ReplaySource::selectReadStreams(const int *,std::size_t,std::size_t,int) {
+	_pos.clear();
+	return 0;
+}
+
+int ReplaySource::readStream(int stream,sdm_sample_t *data,std::size_t n,int nb) {
+	if(_obj.packets.empty()) return 0;
+	auto const &packet=_obj.packets[_packet];
+	
+	if(_originalTiming) {
+		if(!_started) {
+			_start=std::chrono::steady_clock::now();
+			_started=true;
+		}
+		auto const due=_start+std::chrono::nanoseconds(packet.time-_obj.packets.front().time+_loopOffset);
+		if(std::chrono::steady_clock::now()<due) {
+			if(nb) return SDM_WOULDBLOCK;
+			std::this_thread::sleep_until(due);
+		}
+	}
+	
+	auto it=packet.streams.find(stream);
+	if(it==packet.streams.end()) return 0;
+	std::size_t &pos=_pos[stream];
+	std::size_t count=std::min(n,it->second.size()-pos);
+	if(count>INT_MAX) count=INT_MAX;
+	std::copy(it->second.begin()+pos,it->second.begin()+pos+count,data);
+	pos+=count;
+	return static_cast<int>(count);
+}
+
+int ReplaySource::readNextPacket() {
+	_pos.clear();
+	if(_obj.packets.empty()) return 0;
+	if(++_packet>=_obj.packets.size()) {
+		auto const &first=_obj.packets.front();
+		auto const &last=_obj.packets.back();
+		_packet=0;
+		_loopOffset+=_period;
+		if(first.hasInfo&&last.hasInfo) _sequenceOffset+=last.info.sequence-first.info.sequence+1;
+		_errorOffset+=last.errors;
+	}
+	return 0;
+}
+
+void ReplaySource::discardPackets() {
+	readNextPacket();
+}
+
+int ReplaySource::readStreamErrors() {
+	if(_obj.packets.empty()) return 0;
+	return _errorOffset+_obj.packets[_packet].errors;
+}
+
+int ReplaySource::packetInfo(sdm_packet_info_t *info) {
+	if(_obj.packets.empty()||!_obj.packets[_packet].hasInfo) return SDM_NOTSUPPORTED;
+	*info=_obj.packets[_packet].info;
+	info->sequence+=_sequenceOffset;
+	return 0;
+}
@@ -0,0 +1,162 @@
+/*
+ * Copyright (c) 2015-2022 Simple Device Model contributors
+ * 
+ * This file is part of the Simple Device Model (SDM) framework SDK.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ * This header file defines classes for the trace replay SDM plugin.
+ */
+
+#ifndef REPLAYPLUGIN_H_INCLUDED
+#define REPLAYPLUGIN_H_INCLUDED
+
+#include "sdmprovider.h"
+
+#include <map>
+#include <vector>
+#include <string>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+
+// Trace contents, grouped by object path ("device0", "device0/channel1"
+// etc.). Objects opened several times during the recording are merged.
+
+struct ReplayTrace {
+	struct Value {
+		std::uint64_t time;
+		sdm_reg_t value;
+	};
+	
+	struct Value64 {
+		std::uint64_t time;
+		sdm_reg64_t value;
+	};
+	
+	struct Packet {
+		std::uint64_t time;
+		std::map<int,std::vector<sdm_sample_t> > streams;
+		bool hasInfo=false;
+		sdm_packet_info_t info;
+		int errors=0; // stream error counter
+	};
+	
+	struct Object {
+		std::uint64_t openTime=0;
+		std::map<std::string,std::string> properties;
+		std::map<sdm_addr_t,std::vector<Value> > reads;
+		std::map<sdm_addr64_t,std::vector<Value64> > reads64;
+		std::vector<Packet> packets;
+	};
+	
+	std::string plugin;
+	std::map<std::string,Object> objects;
+	
+	void load(const std::string &path);
+	const Object *find(const std::string &path) const;
+};
+
+class ReplayPlugin : public SDMAbstractPlugin {
+	std::shared_ptr<const ReplayTrace> _trace;
+public:
+	ReplayPlugin();
+	virtual SDMAbstractDevice *openDevice(int id) override;
+	virtual int getCapabilities(sdm_capabilities_t *caps) override;
+	
+	virtual void setProperty(const std::string &name,const std::string &value) override;
+private:
+	void loadTrace(const std::string &path);
+};
+
+class ReplayDevice : public SDMAbstractDevice {
+	std::shared_ptr<const ReplayTrace> _trace;
+	std::string _path;
+	bool _connected=false;
+public:
+	ReplayDevice(const std::shared_ptr<const ReplayTrace> &trace,int id);
+	
+	virtual int close() override;
+	
+	virtual SDMAbstractChannel *openChannel(int id) override;
+	virtual SDMAbstractSource *openSource(int id) override;
+	
+	virtual int connect() override;
+	virtual int disconnect() override;
+	virtual int getConnectionStatus() override;
+};
+
+// Register reads return recorded values in order, one queue per
+// address. When the queue is exhausted, the last value read or
+// written is returned. 64-bit reads of addresses without recorded
+// 64-bit values fall back to 32-bit ones. Read-modify-write operations
+// are applied to the last value without consuming recorded reads.
+
+class ReplayChannel : public SDMAbstractChannel {
+	std::shared_ptr<const ReplayTrace> _trace;
+	const ReplayTrace::Object &_obj;
+	bool _originalTiming;
+	std::chrono::steady_clock::time_point _start;
+	std::map<sdm_addr_t,std::size_t> _next;
+	std::map<sdm_addr_t,sdm_reg_t> _regs;
+	std::map<sdm_addr64_t,std::size_t> _next64;
+	std::map<sdm_addr64_t,sdm_reg64_t> _regs64;
+public:
+	ReplayChannel(const std::shared_ptr<const ReplayTrace> &trace,const ReplayTrace::Object &obj);
+	
+	virtual int close() override;
+	
+	virtual int writeReg(sdm_addr_t addr,sdm_reg_t data) override;
+	virtual sdm_reg_t readReg(sdm_addr_t addr,int *status) override;
+	virtual int writeReg64(sdm_addr64_t addr,sdm_reg64_t data) override;
+	virtual sdm_reg64_t readReg64(sdm_addr64_t addr,int *status) override;
+	virtual int modifyReg(sdm_addr_t addr,sdm_reg_t mask,sdm_reg_t data) override;
+	virtual int modifyRegs(const sdm_addr_t *addr,const sdm_reg_t *mask,const sdm_reg_t *data,std::size_t n) override;
+};
+
+// Recorded packets are served in order. After the last packet the
+// replay starts over, sequence numbers and the stream error counter
+// keep growing.
+
+class ReplaySource : public SDMAbstractSource {
+	std::shared_ptr<const ReplayTrace> _trace;
+	const ReplayTrace::Object &_obj;
+	bool _originalTiming;
+	std::chrono::steady_clock::time_point _start;
+	bool _started=false;
+	std::uint64_t _loopOffset=0;
+	std::uint64_t _period=0;
+	std::uint64_t _sequenceOffset=0;
+	int _errorOffset=0;
+	std::size_t _packet=0;
+	std::map<int,std::size_t> _pos;
+public:
+	ReplaySource(const std::shared_ptr<const ReplayTrace> &trace,const ReplayTrace::Object &obj);
+	
+	virtual int close() override;
+	
+	virtual int selectReadStreams(const int *streams,std::size_t n,std::size_t packets,int df) override;
+	virtual int readStream(int stream,sdm_sample_t *data,std::size_t n,int nb) override;
+	virtual int readNextPacket() override;
+	virtual void discardPackets() override;
+	virtual int readStreamErrors() override;
+	virtual int packetInfo(sdm_packet_info_t *info) override;
+};
+
+#endif
@@ -0,0 +1,112 @@
+-- Measures register access patterns against a simulated slow link.
+--
+-- Usage: sdmhost benchmark.lua [path to testplugin]
+--
+-- The test plugin channels delay every transaction by the "Latency"
+-- property and the transfer time of its data words at "Bandwidth"
+-- words per second. This script compares how different access
+-- patterns cope with typical USB and Ethernet link parameters.
+
+local profiles={
+	{name="Local",latency=0,bandwidth=0,outstanding=1},
+	{name="USB",latency=125,bandwidth=4e6,outstanding=8},
+	{name="Ethernet",latency=250,bandwidth=25e6,outstanding=32}
+}
+
+local sparse=0x10000000 -- start of the sparse address space
+local count=200 -- registers per workload
+
+local plugin=sdm.openplugin(arg[1] or "testplugin")
+plugin.Verbosity="Quiet"
+local dev=plugin.opendevice(0)
+dev.connect()
+local ch=dev.openchannel(0)
+
+local addrs={}
+local values={}
+for i=1,count do
+	addrs[i]=sparse+(i-1)*0x1000 -- scattered register map
+	values[i]=i
+end
+
+-- Register map workloads
+
+local function onebyone()
+	for i=1,count do ch.readreg(addrs[i]) end
+end
+
+local function batch()
+	ch.readregs(addrs)
+end
+
+local function async()
+	local tokens={}
+	for i=1,count do tokens[i]=ch.readregasync(addrs[i]) end
+	for i=1,count do ch.waittransaction(tokens[i]) end
+end
+
+local function cached()
+	ch.cachemode("writethrough")
+	for pass=1,2 do -- the second pass is served from the cache
+		for i=1,count do ch.readreg(addrs[i]) end
+	end
+	ch.cachemode("off")
+end
+
+-- Script workloads
+
+local function configure()
+	for i=1,count do ch.writereg(addrs[i],values[i]) end
+end
+
+local function postedconfigure()
+	ch.postedwrites(true)
+	for i=1,count do ch.writereg(addrs[i],values[i]) end
+	ch.flush()
+	ch.postedwrites(false)
+end
+
+local function memblock()
+	ch.readmem(sparse,count)
+end
+
+local workloads={
+	{name="readreg one by one",func=onebyone},
+	{name="readregs batch",func=batch},
+	{name="readregasync",func=async},
+	{name="readreg cached (2 passes)",func=cached},
+	{name="writereg configuration",func=configure},
+	{name="posted writereg configuration",func=postedconfigure},
+	{name="readmem block",func=memblock}
+}
+
+local function pad(str,width)
+	return str..string.rep(" ",width-#str)
+end
+
+local header=pad("Workload ("..count.." registers), ms",36)
+for _,p in ipairs(profiles) do header=header..pad(p.name,10) end
+print(header)
+
+local results={}
+for _,p in ipairs(profiles) do
+	ch.Latency=p.latency
+	ch.Bandwidth=p.bandwidth
+	ch.MaxOutstanding=p.outstanding
+	for _,w in ipairs(workloads) do
+		local start=sdm.time()
+		w.func()
+		results[w.name..p.name]=sdm.time()-start
+	end
+end
+
+for _,w in ipairs(workloads) do
+	local line=pad(w.name,36)
+	for _,p in ipairs(profiles) do line=line..pad(tostring(results[w.name..p.name]),10) end
+	print(line)
+end
+
+ch.Latency=0
+ch.close()
+dev.disconnect()
+plugin.close()
@@ -31,6 +31,7 @@
 #include <cstring>
 #include <climits>
 #include <cstdlib>
+#include <cmath>
 #include <exception>
 #include <algorithm>
 
@@ -48,6 +49,7 @@ SDMAbstractPlugin *SDMAbstractPlugin::instance() {
  */
 
 TestPlugin::TestPlugin() {
+	enableRevision();
 	addConstProperty("Name","Software simulated test");
 	addConstProperty("Vendor","Simple Device Model");
 	
@@ -57,6 +59,23 @@ TestPlugin::TestPlugin() {
 	addProperty("Verbosity","Default");
 	addProperty("AutoOpenMode","open");
 	addProperty("DisableChildProperties","false");
+	
+// Optional function groups implemented by the channel and sources below
+	setFeatures(SDM_FEATURE_REGBATCH|SDM_FEATURE_ASYNCREGS|SDM_FEATURE_TYPEDREAD|
+		SDM_FEATURE_ACQUIRE|SDM_FEATURE_READYCALLBACK|SDM_FEATURE_PACKETINFO|
+		SDM_FEATURE_REG64|SDM_FEATURE_MODIFYREG);
+}
+
+int TestPlugin::getCapabilities(sdm_capabilities_t *caps) {
+	SDMAbstractPlugin::getCapabilities(caps);
+	caps->features|=SDM_FEATURE_DECIMATION; // all sources honor "df"
+	caps->formats|=1<<SDM_SAMPLE_INT16;
+	caps->maxRegBatch=TestChannel::MaxRegBatch;
+	caps->preferredPacketSize=6400;
+// Devices don't share state. Plugin properties are only read by
+// devices and are expected to be set before devices are used.
+	caps->threadSafety=SDM_THREADSAFE_DEVICE;
+	return 0;
 }
 
 SDMAbstractDevice *TestPlugin::openDevice(int id) {
@@ -77,6 +96,7 @@ SDMAbstractDevice *TestPlugin::openDevice(int id) {
  */
 
 TestDevice::TestDevice(int id) {
+	enableRevision();
 	if(SDMAbstractPlugin::instance()->getProperty("DisableChildProperties")=="true") return;
 	addConstProperty("Name","Test device "+std::to_string(id+1));
 	
@@ -94,6 +114,8 @@ TestDevice::TestDevice(int id) {
 	addListItem("Sources","Source 1");
 	addListItem("Sources","Source 2");
 	addListItem("Sources","Video source");
+	addListItem("Sources","Ring buffer source");
+	addListItem("Sources","Serial source");
 }
 
 int TestDevice::close() {
@@ -127,6 +149,12 @@ SDMAbstractSource *TestDevice::openSource(int id) {
 		else if(id==2) {
 			return new VideoSource(_connected);
 		}
+		else if(id==3) {
+			return new RingSource(_connected);
+		}
+		else if(id==4) {
+			return new SerialSource(_connected);
+		}
 		else return nullptr;
 	}
 	catch(std::exception &) {
@@ -172,6 +200,7 @@ TestChannel::TestChannel(int id,const bool &connected):
 	_id(id),
 	_connected(connected)
 {
+	enableRevision();
 	if(SDMAbstractPlugin::instance()->getProperty("DisableChildProperties")=="true") return;
 	if(_id==0) {
 		addConstProperty("Name","Measurement equipment");
@@ -181,6 +210,27 @@ TestChannel::TestChannel(int id,const bool &connected):
 		addConstProperty("Name","Unit under test");
 		addConstProperty("RegisterMapFile","testplugin/map.srm");
 	}
+	onPropertyChanged(addIntProperty("Latency",0),[this](PropertyId id) {
+		_latency=std::chrono::microseconds(std::max(intProperty(id),0));
+	});
+	onPropertyChanged(addDoubleProperty("Bandwidth",_bandwidth),[this](PropertyId id) {
+		_bandwidth=std::max(doubleProperty(id),0.0);
+	});
+	onPropertyChanged(addIntProperty("MaxOutstanding",static_cast<int>(_maxOutstanding)),[this](PropertyId id) {
+		_maxOutstanding=static_cast<std::size_t>(std::max(intProperty(id),1));
+	});
+	
+// Native burst primitive, 0 disables bursts. "BurstCount" counts
+// bursts issued, "PeakBursts" is the largest number of bursts in flight
+// at the same time. Both can be reset by the client.
+	onPropertyChanged(addIntProperty("MaxBurst",_maxBurst),[this](PropertyId id) {
+		_maxBurst=std::max(intProperty(id),0);
+		updateBursts();
+	});
+	onPropertyChanged(addIntProperty("BurstBoundary",0),[this](PropertyId) {updateBursts();});
+	onPropertyChanged(addBoolProperty("BurstPipelining",false),[this](PropertyId) {updateBursts();});
+	_burstCount=addIntProperty("BurstCount",0);
+	_peakBursts=addIntProperty("PeakBursts",0);
 }
 
 int TestChannel::close() {
@@ -198,6 +248,12 @@ int TestChannel::writeReg(sdm_addr_t addr,sdm_reg_t data) {
 	}
 	
 	if(!_connected) return SDM_ERROR;
+	
+	transaction(1);
+	if(isSparse(addr)) {
+		_sparse[addr]=data;
+		return 0;
+	}
 
 	if(addr>=256) return SDM_ERROR;
 	
@@ -217,12 +273,18 @@ sdm_reg_t TestChannel::readReg(sdm_addr_t addr,int *status) {
 		std::cout<<"testplugin: requested read from address "<<addr<<std::endl;
 	}
 
-	if(!_connected||addr>=256) {
+	if(!_connected||(addr>=256&&!isSparse(addr))) {
 		if(status) *status=-1;
 		return 0;
 	}
 	if(status) *status=0;
 	
+	transaction(1);
+	if(isSparse(addr)) {
+		auto it=_sparse.find(addr);
+		return (it!=_sparse.end())?it->second:0;
+	}
+	
 	sdm_reg_t data;
 	
 	if(addr!=0) { // plain register
@@ -257,16 +319,10 @@ int TestChannel::writeFIFO(sdm_addr_t addr,const sdm_reg_t *data,std::size_t n,i
 	
 	if(!_connected) return SDM_ERROR;
 	if(n>INT_MAX) n=INT_MAX;
+	if(_maxBurst>0) return SDMAbstractChannel::writeFIFO(addr,data,n,flags);
 	
-	if(addr!=0) { // plain register, no need to write all values
-		if(addr>=256) return SDM_ERROR;
-		_regs[addr]=data[n-1];
-	}
-	else { // dedicated FIFO at address 0
-		for(std::size_t i=0;i<n;i++) _fifo0.push_back(data[i]);
-	}
-	
-	return 0;
+	transaction(n);
+	return writeWords(addr,data,n,false);
 }
 
 int TestChannel::readFIFO(sdm_addr_t addr,sdm_reg_t *data,std::size_t n,int flags) {
@@ -277,25 +333,10 @@ int TestChannel::readFIFO(sdm_addr_t addr,sdm_reg_t *data,std::size_t n,int flag
 	
 	if(!_connected) return SDM_ERROR;
 	if(n>INT_MAX) n=INT_MAX;
+	if(_maxBurst>0) return SDMAbstractChannel::readFIFO(addr,data,n,flags);
 	
-	std::size_t i;
-	if(addr!=0) { // plain register
-		if(addr>=256) return SDM_ERROR;
-		for(i=0;i<n;i++) {
-			data[i]=_regs[addr];
-		}
-	}
-	else { // dedicated FIFO at address 0
-		for(i=0;i<n;i++) {
-			if(_fifo0.empty()) data[i]=0;
-			else {
-				data[i]=_fifo0.front();
-				_fifo0.pop_front();
-			}
-		}
-	}
-	
-	return 0;
+	transaction(n);
+	return readWords(addr,data,n,false);
 }
 
 int TestChannel::writeMem(sdm_addr_t addr,const sdm_reg_t *data,std::size_t n) {
@@ -313,10 +354,10 @@ int TestChannel::writeMem(sdm_addr_t addr,const sdm_reg_t *data,std::size_t n) {
 	if(!_connected) return SDM_ERROR;
 	
 	if(n==0) return 0;
-
-	if(addr+n>256) return SDM_ERROR;
-	std::memcpy(&_regs[addr],data,n*sizeof(sdm_reg_t));
-	return 0;
+	if(_maxBurst>0) return SDMAbstractChannel::writeMem(addr,data,n);
+	
+	transaction(n);
+	return writeWords(addr,data,n,true);
 }
 
 int TestChannel::readMem(sdm_addr_t addr,sdm_reg_t *data,std::size_t n) {
@@ -326,12 +367,325 @@ int TestChannel::readMem(sdm_addr_t addr,sdm_reg_t *data,std::size_t n) {
 	}
 	
 	if(!_connected) return SDM_ERROR;
+	if(_maxBurst>0) return SDMAbstractChannel::readMem(addr,data,n);
+	
+	transaction(n);
+	return readWords(addr,data,n,true);
+}
+
+int TestChannel::writeReg64(sdm_addr64_t addr,sdm_reg64_t data) {
+	if(addr<0x100000000ULL) return SDMAbstractChannel::writeReg64(addr,data);
+	if(!_connected) return SDM_ERROR;
+	if(addr-0x100000000ULL>=256) return SDM_ERROR;
+	_wideRegs[addr-0x100000000ULL]=data;
+	return 0;
+}
+
+sdm_reg64_t TestChannel::readReg64(sdm_addr64_t addr,int *status) {
+	if(addr<0x100000000ULL) return SDMAbstractChannel::readReg64(addr,status);
+	if(!_connected||addr-0x100000000ULL>=256) {
+		if(status) *status=-1;
+		return 0;
+	}
+	if(status) *status=0;
+	return _wideRegs[addr-0x100000000ULL];
+}
+
+// Plain registers are modified in place, like a device-side
+// read-modify-write operation would do
+
+int TestChannel::modifyReg(sdm_addr_t addr,sdm_reg_t mask,sdm_reg_t data) {
+	if(SDMAbstractPlugin::instance()->getProperty("Verbosity")=="Verbose")
+		std::cout<<"testplugin: entered sdmModifyReg()"<<std::endl;
+	if(!_connected) return SDM_ERROR;
+	transaction(1);
+	if(addr==0) { // FIFO
+		const bool batch=_batch;
+		_batch=true;
+		int r=SDMAbstractChannel::modifyReg(addr,mask,data);
+		_batch=batch;
+		return r;
+	}
+	if(isSparse(addr)) {
+		_sparse[addr]=(_sparse[addr]&~mask)|(data&mask);
+		return 0;
+	}
+	if(addr>=256) return SDM_ERROR;
+	_regs[addr]=(_regs[addr]&~mask)|(data&mask);
+	return 0;
+}
+
+int TestChannel::modifyRegs(const sdm_addr_t *addr,const sdm_reg_t *mask,const sdm_reg_t *data,std::size_t n) {
+	if(!_connected) return SDM_ERROR;
+	transaction(n);
+	_batch=true;
+	int r=0;
+	for(std::size_t i=0;i<n&&r==0;i++) r=modifyReg(addr[i],mask[i],data[i]);
+	_batch=false;
+	return r;
+}
+
+// Batches are transferred as single transactions
+
+int TestChannel::writeRegs(const sdm_addr_t *addr,const sdm_reg_t *data,std::size_t n) {
+	if(!_connected) return SDM_ERROR;
+	if(n>MaxRegBatch) return SDM_ERROR;
+	transaction(n);
+	_batch=true;
+	int r=SDMAbstractChannel::writeRegs(addr,data,n);
+	_batch=false;
+	return r;
+}
+
+int TestChannel::readRegs(const sdm_addr_t *addr,sdm_reg_t *data,std::size_t n) {
+	if(!_connected) return SDM_ERROR;
+	if(n>MaxRegBatch) return SDM_ERROR;
+	transaction(n);
+	_batch=true;
+	int r=SDMAbstractChannel::readRegs(addr,data,n);
+	_batch=false;
+	return r;
+}
+
+// With a simulated link, transactions are executed at submission,
+// but their results are released only when the simulated transfer
+// completes. Without it, default implementations are used.
+
+int TestChannel::submitWriteReg(sdm_addr_t addr,sdm_reg_t data) {
+	if(!linkSimulated()) return SDMAbstractChannel::submitWriteReg(addr,data);
+	if(!_connected) return SDM_ERROR;
+	waitOutstanding();
+	Pending p;
+	p.token=allocateToken();
+	p.done=schedule(1);
+	_batch=true;
+	p.status=writeReg(addr,data);
+	_batch=false;
+	p.data=0;
+	_pending.push_back(p);
+	return p.token;
+}
+
+int TestChannel::submitReadReg(sdm_addr_t addr) {
+	if(!linkSimulated()) return SDMAbstractChannel::submitReadReg(addr);
+	if(!_connected) return SDM_ERROR;
+	waitOutstanding();
+	Pending p;
+	p.token=allocateToken();
+	p.done=schedule(1);
+	_batch=true;
+	p.data=readReg(addr,&p.status);
+	_batch=false;
+	_pending.push_back(p);
+	return p.token;
+}
+
+// Bursts are transactions of "n" words, pipelined bursts overlap
+// like asynchronous register transactions
+
+int TestChannel::writeBurst(sdm_addr_t addr,const sdm_reg_t *data,std::size_t n,bool increment) {
+	countBurst(1);
+	transaction(n);
+	return writeWords(addr,data,n,increment);
+}
 
+int TestChannel::readBurst(sdm_addr_t addr,sdm_reg_t *data,std::size_t n,bool increment) {
+	countBurst(1);
+	transaction(n);
+	return readWords(addr,data,n,increment);
+}
+
+int TestChannel::submitWriteBurst(sdm_addr_t addr,const sdm_reg_t *data,std::size_t n,bool increment) {
+	if(!linkSimulated()) return SDMAbstractChannel::submitWriteBurst(addr,data,n,increment);
+	waitOutstanding();
+	countBurst(_pending.size()+1);
+	Pending p;
+	p.token=allocateToken();
+	p.done=schedule(n);
+	p.status=writeWords(addr,data,n,increment);
+	p.data=0;
+	_pending.push_back(p);
+	return p.token;
+}
+
+int TestChannel::submitReadBurst(sdm_addr_t addr,sdm_reg_t *data,std::size_t n,bool increment) {
+	if(!linkSimulated()) return SDMAbstractChannel::submitReadBurst(addr,data,n,increment);
+	waitOutstanding();
+	countBurst(_pending.size()+1);
+	Pending p;
+	p.token=allocateToken();
+	p.done=schedule(n);
+	p.status=readWords(addr,data,n,increment);
+	p.data=0;
+	_pending.push_back(p);
+	return p.token;
+}
+
+int TestChannel::completeBurst(int token) {
+	return completeTransaction(token,nullptr,0);
+}
+
+int TestChannel::completeTransaction(int token,sdm_reg_t *data,int nb) {
+	auto it=std::find_if(_pending.begin(),_pending.end(),[token](const Pending &p){return p.token==token;});
+	if(it==_pending.end()) return SDMAbstractChannel::completeTransaction(token,data,nb);
+	if(std::chrono::steady_clock::now()<it->done) {
+		if(nb) return SDM_WOULDBLOCK;
+		std::this_thread::sleep_until(it->done);
+	}
+	if(data) *data=it->data;
+	const int status=it->status;
+	_pending.erase(it);
+	return status;
+}
+
+bool TestChannel::isSparse(sdm_addr_t addr,std::size_t n) {
+	return addr>=SparseBase&&addr-SparseBase<SparseSize&&n<=SparseSize-(addr-SparseBase);
+}
+
+// Storage access shared by FIFO, memory and burst functions. Without
+// "increment", address 0 is a FIFO and other addresses are plain
+// registers.
+
+int TestChannel::writeWords(sdm_addr_t addr,const sdm_reg_t *data,std::size_t n,bool increment) {
+	if(n==0) return 0;
+	if(!increment) {
+		if(addr!=0) { // plain register, no need to write all values
+			if(isSparse(addr)) _sparse[addr]=data[n-1];
+			else if(addr>=256) return SDM_ERROR;
+			else _regs[addr]=data[n-1];
+		}
+		else { // dedicated FIFO at address 0
+			for(std::size_t i=0;i<n;i++) _fifo0.push_back(data[i]);
+		}
+		return 0;
+	}
+	
+	if(isSparse(addr,n)) {
+		for(std::size_t i=0;i<n;i++) _sparse[static_cast<sdm_addr_t>(addr+i)]=data[i];
+		return 0;
+	}
+	if(addr+n>256) return SDM_ERROR;
+	std::memcpy(&_regs[addr],data,n*sizeof(sdm_reg_t));
+	return 0;
+}
+
+int TestChannel::readWords(sdm_addr_t addr,sdm_reg_t *data,std::size_t n,bool increment) {
+	if(!increment) {
+		if(addr!=0) { // plain register
+			if(isSparse(addr)) {
+				auto it=_sparse.find(addr);
+				std::fill(data,data+n,(it!=_sparse.end())?it->second:0);
+				return 0;
+			}
+			if(addr>=256) return SDM_ERROR;
+			std::fill(data,data+n,_regs[addr]);
+		}
+		else { // dedicated FIFO at address 0
+			for(std::size_t i=0;i<n;i++) {
+				if(_fifo0.empty()) data[i]=0;
+				else {
+					data[i]=_fifo0.front();
+					_fifo0.pop_front();
+				}
+			}
+		}
+		return 0;
+	}
+	
+	if(isSparse(addr,n)) {
+		for(std::size_t i=0;i<n;i++) {
+			auto it=_sparse.find(static_cast<sdm_addr_t>(addr+i));
+			data[i]=(it!=_sparse.end())?it->second:0;
+		}
+		return 0;
+	}
 	if(addr+n>256) return SDM_ERROR;
 	std::memcpy(data,&_regs[addr],n*sizeof(sdm_reg_t));
 	return 0;
 }
 
+void TestChannel::countBurst(std::size_t inFlight) {
+	setIntProperty(_burstCount,intProperty(_burstCount)+1);
+	if(static_cast<int>(inFlight)>intProperty(_peakBursts)) setIntProperty(_peakBursts,static_cast<int>(inFlight));
+}
+
+void TestChannel::updateBursts() {
+	int flags=BurstMemory|BurstFIFO;
+	if(boolProperty(propertyId("BurstPipelining"))) flags|=BurstPipelined;
+	setBurstCapabilities(static_cast<std::size_t>(_maxBurst),
+		static_cast<std::size_t>(std::max(intProperty(propertyId("BurstBoundary")),0)),flags);
+}
+
+// The link transfers words one transaction at a time, latencies
+// of subsequent transactions overlap
+
+std::chrono::steady_clock::time_point TestChannel::schedule(std::size_t words) {
+	auto start=std::max(std::chrono::steady_clock::now(),_linkFree);
+	if(_bandwidth>0) {
+		start+=std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+			std::chrono::duration<double>(static_cast<double>(words)/_bandwidth));
+	}
+	_linkFree=start;
+	return start+_latency;
+}
+
+void TestChannel::transaction(std::size_t words) {
+	if(_batch||!linkSimulated()) return;
+	std::this_thread::sleep_until(schedule(words));
+}
+
+void TestChannel::waitOutstanding() {
+	for(;;) {
+		auto const now=std::chrono::steady_clock::now();
+		std::size_t inFlight=0;
+		auto earliest=std::chrono::steady_clock::time_point::max();
+		for(auto const &p: _pending) {
+			if(p.done<=now) continue;
+			inFlight++;
+			earliest=std::min(earliest,p.done);
+		}
+		if(inFlight<_maxOutstanding) return;
+		std::this_thread::sleep_until(earliest);
+	}
+}
+
+/*
+ * TestSource::Throughput members
+ */
+
+// The counter pattern is the sample number modulo 16384, continued
+// across packets, so that consumers can detect lost or duplicated
+// samples. All packets are slices of one buffer. The noise pattern
+// is generated once per stream and repeated in every packet.
+
+void TestSource::Throughput::setup() {
+	pattern.clear();
+	if(counter) {
+		pattern.emplace_back(packetSize+16384);
+		for(std::size_t i=0;i<pattern[0].size();i++) pattern[0][i]=static_cast<sdm_sample_t>(i%16384);
+	}
+	else for(int s=0;s<streams;s++) {
+		pattern.emplace_back(packetSize);
+		for(auto &sample: pattern.back()) sample=std::rand()%16384;
+	}
+	npacket.assign(streams,0);
+	pos.assign(streams,0);
+	selected.assign(streams,false);
+	begin=std::chrono::steady_clock::now();
+}
+
+const sdm_sample_t *TestSource::Throughput::packetData(int stream) const {
+	if(counter) return pattern[0].data()+(npacket[stream]*packetSize)%16384;
+	return pattern[stream].data();
+}
+
+// The packet is available when all of its samples have been "acquired"
+
+std::chrono::steady_clock::time_point TestSource::Throughput::due(int stream) const {
+	const double seconds=static_cast<double>(npacket[stream]+1)*static_cast<double>(packetSize)/rate;
+	return begin+std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(seconds));
+}
+
 /*
  * TestSource members
  */
@@ -349,16 +703,42 @@ TestSource::TestSource(int id,const bool &connected):
 	_id(id),
 	_connected(connected)
 {
+	enableRevision();
 	if(SDMAbstractPlugin::instance()->getProperty("DisableChildProperties")=="true") return;
 	if(_id==0) addConstProperty("Name","Source 1");
 	else if(_id==1) addConstProperty("Name","Source 2");
 	if(_id==0) addConstProperty("ShowStreams","0,1");
 	else if(_id==1) addConstProperty("ShowStreams","0,1");
-	addProperty("MsPerPacket",std::to_string(_msPerPacket));
+	onPropertyChanged(addIntProperty("MsPerPacket",_msPerPacket.load()),[this](PropertyId id) {
+		_msPerPacket=std::max(intProperty(id),1);
+	});
+	
+// Throughput mode settings take effect on the next sdmSelectReadStreams()
+	onPropertyChanged(addEnumProperty("Mode",{"Normal","Throughput"},"Normal"),[this](PropertyId id) {
+		_t.enabled=(enumProperty(id)==1);
+	});
+	onPropertyChanged(addIntProperty("PacketSize",static_cast<int>(_t.packetSize)),[this](PropertyId id) {
+		_t.packetSize=static_cast<std::size_t>(std::max(intProperty(id),1));
+	});
+	onPropertyChanged(addIntProperty("StreamCount",_t.streams),[this](PropertyId id) {
+		_t.streams=std::min(std::max(intProperty(id),1),16);
+	});
+	onPropertyChanged(addDoubleProperty("SampleRate",_t.rate),[this](PropertyId id) {
+		_t.rate=std::max(doubleProperty(id),0.0);
+	});
+	onPropertyChanged(addEnumProperty("Pattern",{"Counter","Noise"},"Counter"),[this](PropertyId id) {
+		_t.counter=(enumProperty(id)==0);
+	});
 	addListItem("Streams","Stream 1");
 	addListItem("Streams","Stream 2");
 	addListItem("UserScripts","Signal Analyzer");
 	addListItem("UserScripts","signal_analyzer.lua");
+	
+	enableReadyNotification();
+}
+
+TestSource::~TestSource() {
+	stopNotifier();
 }
 
 int TestSource::close() {
@@ -369,6 +749,29 @@ int TestSource::close() {
 	return 0;
 }
 
+void TestSource::startNotifier() {
+	if(_notifier.joinable()) return;
+	_stopNotifier=false;
+	_notifier=std::thread([this]{
+		std::unique_lock<std::mutex> lock(_notifierMutex);
+		for(;;) {
+			_notifierCv.wait_for(lock,std::chrono::milliseconds(_msPerPacket.load()));
+			if(_stopNotifier) return;
+			notifyReady();
+		}
+	});
+}
+
+void TestSource::stopNotifier() {
+	if(!_notifier.joinable()) return;
+	{
+		std::lock_guard<std::mutex> lock(_notifierMutex);
+		_stopNotifier=true;
+	}
+	_notifierCv.notify_all();
+	_notifier.join();
+}
+
 int TestSource::selectReadStreams(const int *streams,std::size_t n,std::size_t packets,int df) {
 	if(SDMAbstractPlugin::instance()->getProperty("Verbosity")!="Quiet") {
 		std::cout<<"testplugin: entered sdmSelectReadStreams()"<<std::endl;
@@ -379,6 +782,18 @@ int TestSource::selectReadStreams(const int *streams,std::size_t n,std::size_t p
 	
 	if(!_connected) return SDM_ERROR;
 	
+	if(_t.enabled) {
+		for(std::size_t i=0;i<n;i++) if(streams[i]<0||streams[i]>=_t.streams) return SDM_ERROR;
+		if(df<1) return SDM_ERROR;
+		_t.setup();
+		for(std::size_t i=0;i<n;i++) _t.selected[streams[i]]=true;
+		_t.df=df;
+		_t.active=(n>0);
+		if(_t.active) startNotifier();
+		return 0;
+	}
+	_t.active=false;
+	
 	for(std::size_t i=0;i<n;i++) if(streams[i]!=0&&streams[i]!=1) return SDM_ERROR;
 	
 	for(std::size_t i=0;i<2;i++) _s.selectedStreams[i]=false;
@@ -394,10 +809,16 @@ int TestSource::selectReadStreams(const int *streams,std::size_t n,std::size_t p
 	
 	if(df<1) return SDM_ERROR;
 	_s.df=df;
+	startNotifier();
 	return 0;
 }
 
 int TestSource::readStream(int stream,sdm_sample_t *data,std::size_t n,int nb) {
+	return readSamples(stream,data,n,nb);
+}
+
+template <typename T> int TestSource::readSamples(int stream,T *data,std::size_t n,int nb) {
+	if(_t.active) return readThroughput(stream,data,n,nb);
 	if(n==0) return 0;
 	if(n>INT_MAX) n=INT_MAX;
 	
@@ -438,18 +859,93 @@ int TestSource::readStream(int stream,sdm_sample_t *data,std::size_t n,int nb) {
 		else toread=availableSamples-pos;
 		
 // Read data
-		for(int i=0;i<toread;i++) data[i]=_s.word(stream,i+pos);
+		for(int i=0;i<toread;i++) data[i]=static_cast<T>(_s.word(stream,i+pos));
 		pos+=toread;
 		return toread;
 	}
 }
 
+template <typename T> int TestSource::readThroughput(int stream,T *data,std::size_t n,int nb) {
+	if(n==0) return 0;
+	if(n>INT_MAX) n=INT_MAX;
+	
+	if(!_connected) return SDM_ERROR;
+	if(stream<0||stream>=static_cast<int>(_t.selected.size())||!_t.selected[stream]) return SDM_ERROR;
+	
+	std::size_t &pos=_t.pos[stream];
+	if(pos==_t.packetSize) return 0; // end of packet
+	if(!waitThroughput(stream,nb)) return SDM_WOULDBLOCK;
+	
+	const std::size_t toread=std::min(n,_t.packetSize-pos);
+	const sdm_sample_t *src=_t.packetData(stream)+pos;
+	std::copy(src,src+toread,data);
+	pos+=toread;
+	return static_cast<int>(toread);
+}
+
+bool TestSource::waitThroughput(int stream,int nb) {
+	if(_t.rate<=0) return true;
+	auto const due=_t.due(stream);
+	if(std::chrono::steady_clock::now()>=due) return true;
+	if(nb) return false;
+	std::this_thread::sleep_until(due);
+	return true;
+}
+
+// Device timestamps are microseconds since the start of acquisition
+int TestSource::packetInfo(sdm_packet_info_t *info) {
+	if(!_connected) return SDM_ERROR;
+	
+	if(_t.active) {
+		const int streams=static_cast<int>(_t.selected.size());
+		int stream=0;
+		while(stream<streams&&!_t.selected[stream]) stream++;
+		if(stream==streams) return SDM_ERROR;
+		info->flags=SDM_PACKETINFO_SEQUENCE;
+		info->sequence=_t.npacket[stream]/_t.df;
+		info->timestamp=0;
+		info->arrival=0;
+		if(_t.rate>0) {
+			info->flags|=SDM_PACKETINFO_TIMESTAMP;
+			info->timestamp=static_cast<sdm_uint64_t>(static_cast<double>(_t.npacket[stream]*_t.packetSize)/_t.rate*1e6);
+		}
+		return 0;
+	}
+	
+	int stream;
+	if(_s.selectedStreams[0]) stream=0;
+	else if(_s.selectedStreams[1]) stream=1;
+	else return SDM_ERROR;
+	
+	const int npacket=_s.npacket[stream];
+	auto arrival=_s.begin+std::chrono::milliseconds((npacket+1)*_msPerPacket);
+	
+	info->flags=SDM_PACKETINFO_SEQUENCE|SDM_PACKETINFO_TIMESTAMP;
+	info->sequence=static_cast<sdm_uint64_t>(npacket/_s.df);
+	info->timestamp=static_cast<sdm_uint64_t>(npacket)*_msPerPacket*1000;
+	info->arrival=0;
+	if(arrival<=std::chrono::steady_clock::now()) {
+		info->flags|=SDM_PACKETINFO_ARRIVAL;
+		info->arrival=static_cast<sdm_uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>
+			(arrival.time_since_epoch()).count());
+	}
+	return 0;
+}
+
 int TestSource::readNextPacket() {
 	if(SDMAbstractPlugin::instance()->getProperty("Verbosity")=="Verbose")
 		std::cout<<"testplugin: entered sdmReadNextPacket()"<<std::endl;
 	
 	if(!_connected) return SDM_ERROR;
 	
+	if(_t.active) {
+		for(std::size_t i=0;i<_t.npacket.size();i++) {
+			_t.npacket[i]+=_t.df;
+			_t.pos[i]=0;
+		}
+		return 0;
+	}
+	
 	for(int i=0;i<2;i++) {
 		_s.npacket[i]+=_s.df;
 		_s.pos[i]=0;
@@ -466,6 +962,10 @@ void TestSource::discardPackets() {
 		_s.npacket[i]=0;
 		_s.pos[i]=0;
 	}
+	
+	_t.begin=_s.begin;
+	std::fill(_t.npacket.begin(),_t.npacket.end(),0);
+	std::fill(_t.pos.begin(),_t.pos.end(),0);
 }
 
 int TestSource::readStreamErrors() {
@@ -475,15 +975,69 @@ int TestSource::readStreamErrors() {
 	return 0;
 }
 
-void TestSource::setProperty(const std::string &name,const std::string &value) {
-	SDMAbstractSource::setProperty(name,value);
+int TestSource::streamFormat(int) {
+	return SDM_SAMPLE_INT16; // all samples fit into 14 bits
+}
+
+int TestSource::readStreamTyped(int stream,void *data,std::size_t n,int format,int nb) {
+	switch(format) {
+	case SDM_SAMPLE_DOUBLE:
+		return readSamples(stream,static_cast<sdm_sample_t*>(data),n,nb);
+	case SDM_SAMPLE_FLOAT:
+		return readSamples(stream,static_cast<float*>(data),n,nb);
+	case SDM_SAMPLE_INT16:
+		return readSamples(stream,static_cast<std::int16_t*>(data),n,nb);
+	case SDM_SAMPLE_UINT16:
+		return readSamples(stream,static_cast<std::uint16_t*>(data),n,nb);
+	case SDM_SAMPLE_INT32:
+		return readSamples(stream,static_cast<std::int32_t*>(data),n,nb);
+	default: // 8-bit formats need saturation
+		return SDMAbstractSource::readStreamTyped(stream,data,n,format,nb);
+	}
+}
+
+// Emulates a source that keeps the whole packet in its own buffer
+int TestSource::acquirePacket(int stream,const sdm_sample_t **data,std::size_t *n,int nb) {
+	if(!_connected) return SDM_ERROR;
 	
-	try {
-		_msPerPacket=std::max(std::stoi(getProperty("MsPerPacket")),1);
+// In throughput mode, the packet is lent directly from the pattern buffer
+	if(_t.active) {
+		if(stream<0||stream>=static_cast<int>(_t.selected.size())||!_t.selected[stream]) return SDM_ERROR;
+		if(!waitThroughput(stream,nb)) return SDM_WOULDBLOCK;
+		*data=_t.packetData(stream);
+		*n=_t.packetSize;
+		_t.pos[stream]=_t.packetSize; // packet is consumed
+		return 0;
 	}
-	catch(std::exception &) {
-		std::cout<<"Warning: bad property value \""<<value<<"\""<<std::endl;
+	
+	if(stream<0||stream>1) return SDM_ERROR;
+	if(!_s.selectedStreams[stream]) return SDM_ERROR;
+	
+	const int expectedPacket=_s.npacket[stream];
+	
+	for(;;) {
+		const int timeElapsed=static_cast<int>(std::chrono::duration_cast<std::chrono::milliseconds>
+			(std::chrono::steady_clock::now()-_s.begin).count());
+		const int currentPacketTime=timeElapsed-expectedPacket*_msPerPacket;
+		if(currentPacketTime>=_msPerPacket) break; // full packet is available
+		if(nb) return SDM_WOULDBLOCK;
+		std::this_thread::sleep_for(std::chrono::milliseconds(_msPerPacket-currentPacketTime));
 	}
+	
+	auto &buf=_lent[stream];
+	buf.resize(6400);
+	for(int i=0;i<6400;i++) buf[i]=_s.word(stream,i);
+	_s.pos[stream]=6400; // packet is consumed
+	
+	*data=buf.data();
+	*n=buf.size();
+	return 0;
+}
+
+int TestSource::releasePacket(int stream) {
+	if(_t.active) return (stream<0||stream>=static_cast<int>(_t.selected.size()))?SDM_ERROR:0;
+	if(stream<0||stream>1) return SDM_ERROR;
+	return 0;
 }
 
 
@@ -638,7 +1192,8 @@ int VideoSource::readNextPacket() {
 	_npacket+=_df;
 	_pos=0;
 	
-	if(!_simpleMode) _frame.next();
+// Skip frames to honor the decimation factor
+	if(!_simpleMode) for(int i=0;i<_df;i++) _frame.next();
 	
 	return 0;
 }
@@ -682,3 +1237,192 @@ void VideoSource::setProperty(const std::string &name,const std::string &value)
 		std::cout<<"Warning: bad property value \""<<value<<"\""<<std::endl;
 	}
 }
+
+/*
+ * RingSource members
+ */
+
+RingSource::RingSource(const bool &connected):
+	SDMRingBufferSource(16,1000),
+	_connected(connected)
+{
+	addConstProperty("Name","Ring buffer source");
+	onPropertyChanged(addIntProperty("MsPerPacket",_msPerPacket.load()),[this](PropertyId id) {
+		_msPerPacket=std::max(intProperty(id),1);
+	});
+	onPropertyChanged(addIntProperty("PacketSize",_packetSize.load()),[this](PropertyId id) {
+		_packetSize=std::max(intProperty(id),1);
+	});
+	addListItem("Streams","Stream 1");
+	addListItem("Streams","Stream 2");
+	addListItem("Streams","Stream 3");
+	addListItem("Streams","Stream 4");
+}
+
+int RingSource::close() {
+	if(SDMAbstractPlugin::instance()->getProperty("Verbosity")!="Quiet")
+		std::cout<<"testplugin: entered sdmCloseSource()"<<std::endl;
+	
+	return SDMRingBufferSource::close();
+}
+
+int RingSource::selectReadStreams(const int *streams,std::size_t n,std::size_t packets,int df) {
+	if(SDMAbstractPlugin::instance()->getProperty("Verbosity")=="Verbose")
+		std::cout<<"testplugin: entered sdmSelectReadStreams()"<<std::endl;
+	
+	if(!_connected) return SDM_ERROR;
+	for(std::size_t i=0;i<n;i++) if(streams[i]<0||streams[i]>3) return SDM_ERROR;
+	
+// The acquisition thread isn't running here, so its state can be reset
+	stopAcquisition();
+	_npacket=0;
+	_due=std::chrono::steady_clock::now()+std::chrono::milliseconds(_msPerPacket);
+	return SDMRingBufferSource::selectReadStreams(streams,n,packets,df);
+}
+
+// Called from the acquisition thread
+
+bool RingSource::produce(Packet &packet) {
+	auto const now=std::chrono::steady_clock::now();
+	if(now<_due) {
+		std::this_thread::sleep_for(std::min<std::chrono::steady_clock::duration>(_due-now,std::chrono::milliseconds(100)));
+		if(std::chrono::steady_clock::now()<_due) return false;
+	}
+	_due+=std::chrono::milliseconds(_msPerPacket);
+	
+	const std::size_t size=static_cast<std::size_t>(_packetSize);
+	const std::uint64_t df=static_cast<std::uint64_t>(std::max(decimationFactor(),1));
+	for(std::size_t i=0;i<packet.streams();i++) {
+		auto &v=packet.data(i);
+		v.resize(size);
+		for(std::size_t j=0;j<size;j++)
+			v[j]=static_cast<sdm_sample_t>(((_npacket*size+j)*df)%16384);
+	}
+	packet.setTimestamp(_npacket);
+	_npacket++;
+	return true;
+}
+
+/*
+ * SerialSource members
+ */
+
+SerialSource::SerialSource(const bool &connected): _connected(connected) {
+	addConstProperty("Name","Serial source");
+	_frameSize=addIntProperty("FrameSize",100); // samples per stream
+	_noiseBytes=addIntProperty("NoiseBytes",0); // garbage bytes between frames
+	_dropFrames=addIntProperty("DropFrames",0); // lose every Nth frame, 0 to disable
+	addConstProperty("SkippedBytes","0"); // listed here, reported by getProperty()
+	addListItem("Streams","Stream 1");
+	addListItem("Streams","Stream 2");
+	
+	_framer.setEncoding(SDMFramer::Int16BE,2);
+	_framer.setSyncPattern("\xA5\x5A",2*frameSize());
+	onPropertyChanged(_frameSize,[this](PropertyId) {
+		_framer.setSyncPattern("\xA5\x5A",2*frameSize());
+	});
+}
+
+int SerialSource::close() {
+	if(SDMAbstractPlugin::instance()->getProperty("Verbosity")!="Quiet")
+		std::cout<<"testplugin: entered sdmCloseSource()"<<std::endl;
+	
+	delete this;
+	return 0;
+}
+
+int SerialSource::selectReadStreams(const int *streams,std::size_t n,std::size_t packets,int df) {
+	if(SDMAbstractPlugin::instance()->getProperty("Verbosity")=="Verbose")
+		std::cout<<"testplugin: entered sdmSelectReadStreams()"<<std::endl;
+	
+	if(!_connected) return SDM_ERROR;
+	for(std::size_t i=0;i<n;i++) if(streams[i]!=0&&streams[i]!=1) return SDM_ERROR;
+	if(df<1) return SDM_ERROR;
+	_df=df;
+	_counter=0;
+	return SDMAbstractQueuedSource::selectReadStreams(streams,n,packets,df);
+}
+
+// The counter changes on every read, so it isn't stored as a property value
+
+std::string SerialSource::getProperty(const std::string &name) const {
+	if(name=="SkippedBytes") return std::to_string(_framer.skippedBytes());
+	return SDMAbstractQueuedSource::getProperty(name);
+}
+
+// Emulates reading whatever the serial port has received so far
+
+void SerialSource::addDataToQueue(std::size_t,bool) {
+	if(!_connected) throw std::runtime_error("Device is not connected");
+	while(_wire.size()<1000) sendFrame();
+	
+	std::size_t space;
+	char *buf=_framer.reserve(space);
+	const std::size_t r=std::min<std::size_t>(space,1000);
+	std::copy(_wire.begin(),_wire.begin()+r,buf);
+	_framer.commit(r);
+	_wire.erase(0,r);
+	
+	_framer.process();
+}
+
+std::size_t SerialSource::getSamplesFromQueue(int stream,std::size_t pos,sdm_sample_t *data,std::size_t n,bool &eop) {
+	if(_framer.frames()==0) return 0;
+	auto const &p=_framer.frame(static_cast<std::size_t>(stream));
+	_error=false;
+	if(pos==0&&!p.empty()) {
+// Stream 2 is negated, so compare magnitudes
+		const sdm_sample_t first=std::abs(p[0]);
+		_error=(_synced&&first!=_expected);
+		_expected=first;
+		_synced=true;
+	}
+	if(pos>=p.size()) pos=p.size();
+	auto toread=std::min<std::size_t>(n,p.size()-pos);
+	if(toread>0) std::copy(p.begin()+pos,p.begin()+pos+toread,data);
+	else eop=true;
+	return toread;
+}
+
+void SerialSource::next() {
+	_framer.popFrame();
+	_expected=static_cast<sdm_sample_t>((static_cast<std::uint64_t>(_expected)+frameSize()*_df)%32768);
+}
+
+void SerialSource::clear() {
+	_framer.clear();
+	_wire.clear();
+	_synced=false;
+}
+
+bool SerialSource::isError() const {
+	return _error;
+}
+
+std::size_t SerialSource::frameSize() const {
+	return static_cast<std::size_t>(std::max(intProperty(_frameSize),1));
+}
+
+// Stream 1 is a counter, stream 2 is its negation
+
+void SerialSource::sendFrame() {
+	const std::size_t size=frameSize();
+	const int drop=intProperty(_dropFrames);
+	if(drop>0&&(_counter/size)%drop==static_cast<std::size_t>(drop-1)) {
+		_counter+=size; // the frame is lost on the link
+		return;
+	}
+	
+	const int noise=intProperty(_noiseBytes);
+	for(int i=0;i<noise;i++) _wire.push_back("\xA5\x00\x5A"[i%3]); // never forms a sync pattern
+	
+	_wire.append("\xA5\x5A");
+	for(std::size_t i=0;i<size;i++) {
+		const std::int16_t value=static_cast<std::int16_t>((_counter*_df)%32768);
+		for(std::int16_t v: {value,static_cast<std::int16_t>(-value)}) {
+			_wire.push_back(static_cast<char>((v>>8)&0xFF));
+			_wire.push_back(static_cast<char>(v&0xFF));
+		}
+		_counter++;
+	}
+}
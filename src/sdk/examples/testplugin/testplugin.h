@@ -28,11 +28,19 @@
 #define TESTPLUGIN_H_INCLUDED
 
 #include "sdmprovider.h"
+#include "sdmringbuffer.h"
+#include "sdmframer.h"
 #include "videoframe.h"
 
 #include <deque>
+#include <unordered_map>
+#include <vector>
 #include <chrono>
 #include <cstdint>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
 
 #ifdef _MSC_VER
 // Disable useless warning about array initialization
@@ -43,6 +51,7 @@ class TestPlugin : public SDMAbstractPlugin {
 public:
 	TestPlugin();
 	virtual SDMAbstractDevice *openDevice(int id) override;
+	virtual int getCapabilities(sdm_capabilities_t *caps) override;
 };
 
 class TestDevice : public SDMAbstractDevice {
@@ -60,12 +69,45 @@ public:
 	virtual int getConnectionStatus() override;
 };
 
+// TestChannel can simulate a device behind a slow link: every
+// transaction takes "Latency" microseconds plus the transfer time of
+// its data words at "Bandwidth" words per second. Batch, memory and
+// FIFO calls are single transactions. Up to "MaxOutstanding"
+// asynchronous transactions can be in flight at the same time.
+// Setting "MaxBurst" makes memory and FIFO calls use the default
+// burst splitting of SDMAbstractChannel, one transaction per burst.
+
 class TestChannel : public SDMAbstractChannel {
+	struct Pending {
+		int token;
+		std::chrono::steady_clock::time_point done;
+		int status;
+		sdm_reg_t data;
+	};
+	
+	static const sdm_addr_t SparseBase=0x10000000;
+	static const sdm_addr_t SparseSize=0x10000000;
+	
 	int _id;
 	sdm_reg_t _regs[256] {};
 	std::deque<sdm_reg_t> _fifo0;
+	sdm_reg64_t _wideRegs[256] {}; // 64-bit registers at 0x100000000
+	std::unordered_map<sdm_addr_t,sdm_reg_t> _sparse; // sparse memory at SparseBase
 	const bool &_connected;
+	
+	std::chrono::microseconds _latency {0};
+	double _bandwidth=0; // words per second, 0 if unlimited
+	std::size_t _maxOutstanding=1;
+	std::chrono::steady_clock::time_point _linkFree;
+	std::deque<Pending> _pending;
+	bool _batch=false;
+	
+	int _maxBurst=0;
+	PropertyId _burstCount=0;
+	PropertyId _peakBursts=0;
 public:
+	static const std::size_t MaxRegBatch=256; // per writeRegs()/readRegs() call
+	
 	TestChannel(int id,const bool &connected);
 	
 	virtual int close() override;
@@ -76,6 +118,32 @@ public:
 	virtual int readFIFO(sdm_addr_t addr,sdm_reg_t *data,std::size_t n,int flags) override;
 	virtual int writeMem(sdm_addr_t addr,const sdm_reg_t *data,std::size_t n) override;
 	virtual int readMem(sdm_addr_t addr,sdm_reg_t *data,std::size_t n) override;
+	virtual int writeReg64(sdm_addr64_t addr,sdm_reg64_t data) override;
+	virtual sdm_reg64_t readReg64(sdm_addr64_t addr,int *status) override;
+	virtual int modifyReg(sdm_addr_t addr,sdm_reg_t mask,sdm_reg_t data) override;
+	virtual int modifyRegs(const sdm_addr_t *addr,const sdm_reg_t *mask,const sdm_reg_t *data,std::size_t n) override;
+	virtual int writeRegs(const sdm_addr_t *addr,const sdm_reg_t *data,std::size_t n) override;
+	virtual int readRegs(const sdm_addr_t *addr,sdm_reg_t *data,std::size_t n) override;
+	
+	virtual int submitWriteReg(sdm_addr_t addr,sdm_reg_t data) override;
+	virtual int submitReadReg(sdm_addr_t addr) override;
+	virtual int completeTransaction(int token,sdm_reg_t *data,int nb) override;
+protected:
+	virtual int writeBurst(sdm_addr_t addr,const sdm_reg_t *data,std::size_t n,bool increment) override;
+	virtual int readBurst(sdm_addr_t addr,sdm_reg_t *data,std::size_t n,bool increment) override;
+	virtual int submitWriteBurst(sdm_addr_t addr,const sdm_reg_t *data,std::size_t n,bool increment) override;
+	virtual int submitReadBurst(sdm_addr_t addr,sdm_reg_t *data,std::size_t n,bool increment) override;
+	virtual int completeBurst(int token) override;
+private:
+	static bool isSparse(sdm_addr_t addr,std::size_t n=1);
+	int writeWords(sdm_addr_t addr,const sdm_reg_t *data,std::size_t n,bool increment);
+	int readWords(sdm_addr_t addr,sdm_reg_t *data,std::size_t n,bool increment);
+	void updateBursts();
+	void countBurst(std::size_t inFlight);
+	bool linkSimulated() const {return _latency.count()>0||_bandwidth>0;}
+	std::chrono::steady_clock::time_point schedule(std::size_t words);
+	void transaction(std::size_t words);
+	void waitOutstanding();
 };
 
 class TestSource : public SDMAbstractSource {
@@ -89,12 +157,42 @@ class TestSource : public SDMAbstractSource {
 		sdm_sample_t word(int stream,int i);
 	};
 	
+// Throughput mode: packets of configurable size are copied in bulk
+// from pregenerated pattern buffers, optionally without rate limiting
+	struct Throughput {
+		bool enabled=false;
+		bool active=false;
+		std::size_t packetSize=6400;
+		int streams=2;
+		double rate=0; // samples per second per stream, 0 if unthrottled
+		bool counter=true;
+		int df=1;
+		std::vector<std::vector<sdm_sample_t> > pattern;
+		std::vector<std::uint64_t> npacket;
+		std::vector<std::size_t> pos;
+		std::vector<bool> selected;
+		std::chrono::steady_clock::time_point begin;
+		
+		void setup();
+		const sdm_sample_t *packetData(int stream) const;
+		std::chrono::steady_clock::time_point due(int stream) const;
+	};
+	
 	int _id;
 	Streams _s;
+	Throughput _t;
 	const bool &_connected;
-	int _msPerPacket=10;
+	std::atomic<int> _msPerPacket {10};
+	std::vector<sdm_sample_t> _lent[2];
+	
+// Emulates a device interrupt signaling that a packet is ready
+	std::thread _notifier;
+	std::mutex _notifierMutex;
+	std::condition_variable _notifierCv;
+	bool _stopNotifier=false;
 public:
 	TestSource(int id,const bool &connected);
+	virtual ~TestSource();
 	
 	virtual int close() override;
 	
@@ -104,7 +202,17 @@ public:
 	virtual void discardPackets() override;
 	virtual int readStreamErrors() override;
 	
-	virtual void setProperty(const std::string &name,const std::string &value) override;
+	virtual int streamFormat(int stream) override;
+	virtual int readStreamTyped(int stream,void *data,std::size_t n,int format,int nb) override;
+	virtual int acquirePacket(int stream,const sdm_sample_t **data,std::size_t *n,int nb) override;
+	virtual int releasePacket(int stream) override;
+	virtual int packetInfo(sdm_packet_info_t *info) override;
+private:
+	template <typename T> int readSamples(int stream,T *data,std::size_t n,int nb);
+	template <typename T> int readThroughput(int stream,T *data,std::size_t n,int nb);
+	bool waitThroughput(int stream,int nb);
+	void startNotifier();
+	void stopNotifier();
 };
 
 class VideoSource : public SDMAbstractSource {
@@ -134,4 +242,61 @@ public:
 	virtual void setProperty(const std::string &name,const std::string &value) override;
 };
 
+// RingSource produces packets of counter samples in the acquisition
+// thread of SDMRingBufferSource, one packet every "MsPerPacket"
+// milliseconds
+
+class RingSource : public SDMRingBufferSource {
+	const bool &_connected;
+	std::atomic<int> _msPerPacket {10};
+	std::atomic<int> _packetSize {1000};
+	std::uint64_t _npacket=0;
+	std::chrono::steady_clock::time_point _due;
+public:
+	RingSource(const bool &connected);
+	
+	virtual int close() override;
+	
+	virtual int selectReadStreams(const int *streams,std::size_t n,std::size_t packets,int df) override;
+protected:
+	virtual bool produce(Packet &packet) override;
+};
+
+// Emulates a device which sends frames over a serial link: a sync
+// pattern followed by interleaved 16-bit big-endian samples for two
+// streams, with optional noise bytes between frames. Frames can be
+// lost on the link; the loss is detected from the sample counter.
+
+class SerialSource : public SDMAbstractQueuedSource {
+	const bool &_connected;
+	SDMFramer _framer;
+	std::string _wire; // bytes sent by the emulated device, not read yet
+	std::uint64_t _counter=0;
+	int _df=1;
+	sdm_sample_t _expected=0; // first sample of the next frame
+	bool _synced=false;
+	bool _error=false;
+	PropertyId _frameSize;
+	PropertyId _noiseBytes;
+	PropertyId _dropFrames;
+public:
+	SerialSource(const bool &connected);
+	
+	virtual int close() override;
+	
+	virtual int selectReadStreams(const int *streams,std::size_t n,std::size_t packets,int df) override;
+	
+	using SDMAbstractQueuedSource::getProperty;
+	virtual std::string getProperty(const std::string &name) const override;
+protected:
+	virtual void addDataToQueue(std::size_t samples,bool nonBlocking) override;
+	virtual std::size_t getSamplesFromQueue(int stream,std::size_t pos,sdm_sample_t *data,std::size_t n,bool &eop) override;
+	virtual void next() override;
+	virtual void clear() override;
+	virtual bool isError() const override;
+private:
+	std::size_t frameSize() const;
+	void sendFrame();
+};
+
 #endif
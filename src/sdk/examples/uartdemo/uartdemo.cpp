@@ -32,8 +32,6 @@
 #include <stdexcept>
 #include <algorithm>
 
-#define MAXBUFSIZE 65536
-
 /*
  * UartPlugin instance
  * 
@@ -56,6 +54,8 @@ UartPlugin::UartPlugin() {
 	addConstProperty("Name","UART demo");
 	addConstProperty("Vendor","Simple Device Model");
 	addListItem("Devices","Arduino Uno");
+// SDMAbstractQueuedSource keeps packet sequence numbers
+	setFeatures(SDM_FEATURE_PACKETINFO);
 }
 
 SDMAbstractDevice *UartPlugin::openDevice(int id) {
@@ -88,6 +88,17 @@ UartDevice::UartDevice() {
 	if(!portlist.empty()) defaultPort=portlist[0];
 	
 	addProperty("SerialPort",defaultPort);
+	
+// Stream data words are 2 bytes long: 11 SOP DATA[9:5] 000 DATA[4:0].
+// Words with the SOP flag set start a new packet.
+	SDMFramer::ByteClass classes[256];
+	for(int i=0;i<256;i++) {
+		if((i&0xE0)==0xE0) classes[i]=SDMFramer::FrameStart;
+		else if((i&0xC0)==0xC0) classes[i]=SDMFramer::WordStart;
+		else classes[i]=SDMFramer::Skip;
+	}
+	_framer.setMarkerClasses(classes);
+	_framer.setBitFields({{0,0x1F,5},{1,0x1F,0}},2);
 }
 
 int UartDevice::close() {
@@ -97,12 +108,12 @@ int UartDevice::close() {
 
 SDMAbstractChannel *UartDevice::openChannel(int id) {
 	if(id!=0) throw std::runtime_error("No channel with such ID");
-	return new UartChannel(_port,_q);
+	return new UartChannel(_port,_framer);
 }
 
 SDMAbstractSource *UartDevice::openSource(int id) {
 	if(id!=0) throw std::runtime_error("No source with such ID");
-	return new UartSource(_port,_q);
+	return new UartSource(_port,_framer);
 }
 
 int UartDevice::connect() {
@@ -129,7 +140,7 @@ int UartDevice::getConnectionStatus() {
  * UartChannel members
  */
 
-UartChannel::UartChannel(Uart &port,std::deque<char> &q): _port(port),_q(q) {
+UartChannel::UartChannel(Uart &port,SDMFramer &framer): _port(port),_framer(framer) {
 	addConstProperty("Name","Settings");
 	addConstProperty("RegisterMapFile","uartdemo/uartdemo.srm");
 }
@@ -161,7 +172,7 @@ sdm_reg_t UartChannel::readReg(sdm_addr_t addr,int *status) {
 		auto r=_port.read(&ch,1);
 		if(r==0) throw std::runtime_error("Can't read data from the serial port");
 		if((ch&0xC0)!=0x80) { // not a register data packet, add to queue
-			if(_q.size()<MAXBUFSIZE) _q.push_back(ch);
+			_framer.write(&ch,1);
 		}
 		else break;
 		if(i==10000) throw std::runtime_error("Device is not responding");
@@ -186,7 +197,7 @@ void UartChannel::sendBytes(const std::string &s) {
  * UartSource members
  */
 
-UartSource::UartSource(Uart &port,std::deque<char> &q): _port(port),_q(q) {
+UartSource::UartSource(Uart &port,SDMFramer &framer): _port(port),_framer(framer) {
 	addConstProperty("Name","Virtual oscilloscope");
 	addConstProperty("ViewMode","plot"); // default view mode for sdmconsole
 	addListItem("Streams","ADC");
@@ -200,50 +211,33 @@ int UartSource::close() {
 }
 
 void UartSource::addDataToQueue(std::size_t samples,bool nonBlocking) {
-// Add data to the raw queue
-	if(_q.size()<MAXBUFSIZE) {
-		std::size_t toread=MAXBUFSIZE-_q.size();
-		std::vector<char> buf(toread);
-		auto r=_port.read(buf.data(),toread,nonBlocking?0:-1);
-		_q.insert(_q.end(),buf.begin(),buf.begin()+r);
-	}
+// Read data directly into the framer buffer
+	std::size_t space;
+	char *buf=_framer.reserve(space);
+	if(space>0) _framer.commit(_port.read(buf,space,nonBlocking?0:-1));
 	
 // Update processed packets queue
-	while(!_q.empty()) {
-		if((_q.front()&0xC0)!=0xC0) { // Not a stream data packet, skip
-			_q.pop_front();
-			continue;
-		}
-		if(_q.size()<2) break; // packet size is 2 bytes
-		int sample=((_q[0]&0x1F)<<5)|(_q[1]&0x1F);
-		if((_q.front()&0xE0)==0xE0) { // new packet
-			_packets.push_back(std::vector<sdm_sample_t>());
-			_packets.back().push_back(sample);
-		}
-		else if(!_packets.empty()) {
-			_packets.back().push_back(sample);
-		}
-		_q.erase(_q.begin(),_q.begin()+2);
-	}
+	_framer.process();
 }
 
+// The last packet is still being received, so it can grow between calls
+
 std::size_t UartSource::getSamplesFromQueue(int stream,std::size_t pos,sdm_sample_t *data,std::size_t n,bool &eop) {
-	if(_packets.empty()) return 0;
-	auto const &p=_packets.front();
+	if(_framer.frames()==0) return 0;
+	auto const &p=_framer.frame(0);
 	if(pos>=p.size()) pos=p.size();
 	auto toread=std::min<std::size_t>(n,p.size()-pos);
 	if(toread>0) std::copy(p.begin()+pos,p.begin()+pos+toread,data);
-	else if(_packets.size()>1) eop=true;
+	else if(_framer.frameComplete()) eop=true;
 	return toread;
 }
 
 void UartSource::next() {
-	if(!_packets.empty()) _packets.pop_front();
+	_framer.popFrame();
 }
 
 void UartSource::clear() {
-	_packets.clear();
-	_q.clear();
+	_framer.clear();
 // Note: after the first readAll() there may still be some out-of-sequence
 // data in the serial port buffer. Wait a bit and repeat.
 	_port.readAll();
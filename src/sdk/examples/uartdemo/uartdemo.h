@@ -29,10 +29,9 @@
 #define UARTDEMO_H_INCLUDED
 
 #include "sdmprovider.h"
+#include "sdmframer.h"
 #include "uart.h"
 
-#include <deque>
-
 // Plugin class
 
 class UartPlugin : public SDMAbstractPlugin {
@@ -45,7 +44,7 @@ public:
 
 class UartDevice : public SDMAbstractDevice {
 	Uart _port; // serial port used to communicate
-	std::deque<char> _q; // stream data buffer
+	SDMFramer _framer; // stream data buffer
 public:
 	UartDevice();
 	
@@ -63,9 +62,9 @@ public:
 
 class UartChannel : public SDMAbstractChannel {
 	Uart &_port;
-	std::deque<char> &_q;
+	SDMFramer &_framer;
 public:
-	UartChannel(Uart &port,std::deque<char> &q);
+	UartChannel(Uart &port,SDMFramer &framer);
 	
 	virtual int close() override;
 	
@@ -86,11 +85,10 @@ private:
 
 class UartSource : public SDMAbstractQueuedSource {
 	Uart &_port;
-	std::deque<char> &_q;
-	std::deque<std::vector<sdm_sample_t> > _packets;
+	SDMFramer &_framer;
 
 public:
-	UartSource(Uart &port,std::deque<char> &q);
+	UartSource(Uart &port,SDMFramer &framer);
 	virtual int close() override;
 
 protected:
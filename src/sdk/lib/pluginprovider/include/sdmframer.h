@@ -0,0 +1,149 @@
+/*
+ * Copyright (c) 2015-2022 Simple Device Model contributors
+ * 
+ * This file is part of the Simple Device Model (SDM) framework SDK.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ * This header file defines the SDMFramer class, a helper which splits
+ * a byte stream into frames and unpacks samples from them.
+ */
+
+#ifndef SDMFRAMER_H_INCLUDED
+#define SDMFRAMER_H_INCLUDED
+
+#include "sdmtypes.h"
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <cstddef>
+
+/*
+ * SDMFramer is intended for sources that receive data as a byte stream,
+ * e.g. from a serial port or a network socket. Received bytes are
+ * appended to a contiguous buffer: either copied with write(), or read
+ * directly into it using reserve() and commit(). process() then splits
+ * buffered bytes into frames and unpacks frame words into samples.
+ * Incomplete frames are kept in the buffer until more data arrive.
+ *
+ * Two framing methods are supported:
+ *
+ * 1. Sync pattern (setSyncPattern()): each frame consists of a fixed
+ * byte sequence followed by a fixed number of words. Bytes that don't
+ * belong to a frame are skipped; the pattern is located with memchr(),
+ * which is vectorized by common C runtime libraries.
+ *
+ * 2. Marker bits (setMarkerClasses()): a 256-entry table classifies the
+ * first byte of each word as a word start, a frame start or a byte to
+ * be skipped. This suits protocols that reserve the most significant
+ * bits of each byte for synchronization. A frame lasts until the next
+ * frame start, so the last frame remains open and can be read while
+ * it is being filled (see frameComplete()).
+ *
+ * Words are unpacked according to the selected encoding, either one of
+ * the common integer and floating point formats (see setEncoding()),
+ * or an arbitrary combination of bit fields (see setBitFields()). With
+ * several streams, consecutive words of a frame are distributed among
+ * them in turn.
+ *
+ * Memory used by consumed frames is reused, so no memory is allocated
+ * in the steady state. The framer is not thread-safe.
+ */
+
+class SDMFramer {
+public:
+	enum Encoding {
+		UInt8,Int8,
+		UInt16LE,Int16LE,UInt16BE,Int16BE,
+		UInt32LE,Int32LE,UInt32BE,Int32BE,
+		Float32LE,Float32BE,
+		BitFields
+	};
+	
+	enum ByteClass {Skip,WordStart,FrameStart};
+	
+// The sample is a sum of masked bytes shifted to the left
+	struct BitField {
+		std::size_t offset; // byte offset within the word
+		unsigned char mask;
+		int shift;
+	};
+	
+	typedef sdm_sample_t (*Unpacker)(const unsigned char *word);
+private:
+	typedef std::vector<std::vector<sdm_sample_t> > Frame;
+	
+	std::vector<char> _buf;
+	std::size_t _begin;
+	std::size_t _end;
+	
+	std::string _sync;
+	std::size_t _frameWords;
+	bool _markers;
+	unsigned char _classes[256];
+	
+	Encoding _encoding;
+	Unpacker _unpacker;
+	std::vector<BitField> _fields;
+	std::size_t _wordSize;
+	std::size_t _streams;
+	
+	std::deque<Frame> _frames;
+	std::vector<Frame> _free; // consumed frames, reused to avoid allocations
+	bool _open; // the last frame can receive more words
+	std::size_t _next; // index of the stream to receive the next word
+	
+	std::size_t _skipped;
+	std::size_t _dropped;
+public:
+	explicit SDMFramer(std::size_t bufferSize=65536);
+	
+	void setSyncPattern(const std::string &pattern,std::size_t frameWords);
+	void setMarkerClasses(const ByteClass *classes);
+	void setEncoding(Encoding encoding,std::size_t streams=1);
+	void setBitFields(const std::vector<BitField> &fields,std::size_t wordSize,std::size_t streams=1);
+	
+	static std::size_t encodingSize(Encoding encoding);
+	static Unpacker unpacker(Encoding encoding);
+	
+	char *reserve(std::size_t &n);
+	void commit(std::size_t n);
+	std::size_t write(const char *data,std::size_t n);
+	std::size_t buffered() const {return _end-_begin;}
+	std::size_t space() const {return _buf.size()-buffered();}
+	
+	std::size_t process();
+	
+	std::size_t frames() const {return _frames.size();}
+	bool frameComplete() const;
+	const std::vector<sdm_sample_t> &frame(std::size_t stream) const;
+	void popFrame();
+	
+	void clear();
+	
+	std::size_t skippedBytes() const {return _skipped;}
+	std::size_t droppedBytes() const {return _dropped;}
+private:
+	std::size_t findSync(std::size_t pos) const;
+	void startFrame();
+	void addWord(const unsigned char *word);
+};
+
+#endif
@@ -26,26 +26,64 @@
  * 
  * Note: All the exceptions thrown by SDMPropertyManager members
  * are derived from std::exception.
+ * 
+ * Objects can opt in to report a "*revision" pseudo-property which
+ * changes every time a property is defined, modified or removed.
+ * Clients use it to validate cached property values. Derived classes
+ * that override getProperty() to report values that can change by
+ * themselves must call touch() when that happens.
+ * 
+ * Properties can be typed (integer, floating point, boolean or
+ * enumeration). Clients still see them as strings; setProperty()
+ * rejects values that can't be converted and the parsed value is
+ * stored along with the string. Plugin code reads it with
+ * intProperty() etc. using the id returned when the property was
+ * defined (or obtained from propertyId()), which avoids both the name
+ * lookup and string parsing. Ids stay valid until clear() is called.
+ * 
+ * onPropertyChanged() registers a callback which is invoked after the
+ * property value has been changed by setProperty() or a typed setter.
  */
 
 #ifndef SDMPROPERTY_H_INCLUDED
 #define SDMPROPERTY_H_INCLUDED
 
-#include <map>
 #include <string>
 #include <vector>
-#include <utility>
+#include <unordered_map>
+#include <functional>
 
 class SDMPropertyManager {
+public:
+	typedef std::size_t PropertyId;
+	typedef std::function<void(PropertyId)> ChangeCallback;
+private:
 	enum Type {Normal,ReadOnly,List};
+	enum ValueType {StringValue,IntValue,DoubleValue,BoolValue,EnumValue};
+	
+	struct Property {
+		std::string name;
+		std::string value;
+		Type type;
+		ValueType valueType;
+		int intValue; // also used for booleans and enumeration indexes
+		double doubleValue;
+		std::vector<std::string> items; // enumeration items
+		std::vector<ChangeCallback> callbacks;
+	};
 	
-	std::map<std::string,std::pair<std::string,Type> > _props;
-	std::vector<std::string> _listall;
+// Properties are stored in the order of definition, names are
+// interned as indexes into this vector
+	std::vector<Property> _props;
+	std::unordered_map<std::string,PropertyId> _ids;
 	
 	mutable std::string _cacheAll;
 	mutable std::string _cacheReadOnly;
 	mutable std::string _cacheWritable;
 	mutable bool _dirty;
+	
+	unsigned long _revision;
+	bool _revisionEnabled;
 
 public:
 	SDMPropertyManager();
@@ -65,10 +103,44 @@ public:
 	virtual std::string getProperty(const std::string &name) const;
 // Get the value of the existing property. Return the default value if the property doesn't exist.
 	virtual std::string getProperty(const std::string &name,const std::string &defaultValue) const;
-// Set the value of the existing property. Throw an exception if the property doesn't exist or is not writable.
+// Set the value of the existing property. Throw an exception if the property doesn't exist, is not writable
+// or the value doesn't match the property type.
 	virtual void setProperty(const std::string &name,const std::string &value);
 	
+// Define a new editable typed property or redefine the existing one. Return the property id.
+	PropertyId addIntProperty(const std::string &name,int value);
+	PropertyId addDoubleProperty(const std::string &name,double value);
+	PropertyId addBoolProperty(const std::string &name,bool value);
+	PropertyId addEnumProperty(const std::string &name,const std::vector<std::string> &items,const std::string &value);
+// Get the id of the existing property. Throw an exception if the property doesn't exist.
+	PropertyId propertyId(const std::string &name) const;
+	
+// Get the native value of the typed property. Throw an exception if the property type doesn't match.
+// The enumeration value is the index of the item.
+	int intProperty(PropertyId id) const;
+	double doubleProperty(PropertyId id) const;
+	bool boolProperty(PropertyId id) const;
+	int enumProperty(PropertyId id) const;
+// Set the native value of the typed property.
+	void setIntProperty(PropertyId id,int value);
+	void setDoubleProperty(PropertyId id,double value);
+	void setBoolProperty(PropertyId id,bool value);
+	void setEnumProperty(PropertyId id,int value);
+	
+// Register a callback to be invoked after the property value changes.
+	void onPropertyChanged(PropertyId id,const ChangeCallback &callback);
+	
+// Enable the "*revision" pseudo-property.
+	void enableRevision();
+// Mark property values as changed.
+	void touch();
+	
 private:
+	Property &define(const std::string &name,const std::string &value,Type type,ValueType valueType);
+	Property &typed(PropertyId id,ValueType valueType);
+	const Property &typed(PropertyId id,ValueType valueType) const;
+	void parseValue(Property &prop,const std::string &value);
+	void changed(PropertyId id);
 	void rebuildCache() const;
 	static std::string formatListItem(const std::string &str);
 };
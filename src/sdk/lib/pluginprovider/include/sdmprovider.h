@@ -32,19 +32,39 @@
 #include "sdmtypes.h"
 
 #include <map>
+#include <vector>
 
 class SDMAbstractDevice;
 class SDMAbstractChannel;
 class SDMAbstractSource;
 
+/*
+ * getCapabilities() fills the capability descriptor returned by
+ * sdmGetCapabilities(). The structure is zero-initialized before the
+ * call. All optional functions are always exported by this library,
+ * but the generic defaults are usually slower than what the client
+ * can do by itself, so the default implementation only reports the
+ * function groups declared by the plugin with setFeatures() (plus
+ * batch property access and error reporting, which the library
+ * implements natively), SDM_SAMPLE_DOUBLE as the only native format
+ * and no thread safety. Plugins should override it to report their
+ * other properties.
+ */
+
 class SDMAbstractPlugin : public SDMPropertyManager {
+	sdm_uint32_t _features;
 public:
+	SDMAbstractPlugin(): _features(0) {}
 	virtual ~SDMAbstractPlugin() {}
 	
 	virtual SDMAbstractDevice *openDevice(int id)=0;
 	
+	virtual int getCapabilities(sdm_capabilities_t *caps);
+	
 // Note: instance() function must be defined by the user
 	static SDMAbstractPlugin *instance();
+protected:
+	void setFeatures(sdm_uint32_t features) {_features=features;}
 };
 
 class SDMAbstractDevice : public SDMPropertyManager {
@@ -72,15 +92,73 @@ public:
  * 2) FIFO doesn't support the notion of packets.
  * 
  * If at least one of these assumptions is not true, these functions
- * must be overriden.
+ * must be overriden. When FIFO bursts are enabled (see Note 7), they
+ * call writeBurst() and readBurst() instead.
  *
  * Note 2: default implementations for writeMem() and readMem() work
  * by repeatedly calling writeReg() and readReg() respectively,
- * incrementing address each time.
+ * incrementing address each time. When memory bursts are enabled
+ * (see Note 7), they call writeBurst() and readBurst() instead.
+ *
+ * Note 3: writeRegs() and readRegs() access a batch of arbitrary
+ * registers in one call. Default implementations call writeReg() and
+ * readReg() for each address in order. Plugins that talk to the device
+ * over a high-latency link should override them to pack the whole batch
+ * into a single transaction.
+ *
+ * Note 4: submitWriteReg() and submitReadReg() start an asynchronous
+ * register transaction and return a non-negative token identifying it.
+ * completeTransaction() waits for (or, if "nb" is non-zero, polls)
+ * the transaction completion and releases the token. Default
+ * implementations execute transactions synchronously at submission and
+ * store the results until they are collected. Plugins using pipelined
+ * transports should override all three functions to keep several
+ * transactions in flight.
+ *
+ * Note 5: the "64" functions access registers and memory with 64-bit
+ * addresses and data. Default writeReg64() and readReg64() forward
+ * to writeReg() and readReg() when the address and data fit in
+ * 32 bits and fail with SDM_NOTSUPPORTED otherwise. Default FIFO
+ * and memory functions repeatedly call writeReg64() and readReg64()
+ * like their 32-bit counterparts. Plugins for devices with a wide
+ * address space or wide registers should override at least
+ * writeReg64() and readReg64().
+ *
+ * Note 6: modifyReg() replaces the bits selected by "mask" with the
+ * corresponding bits of "data", leaving other bits intact. The
+ * default implementation reads the register and writes it back.
+ * Default modifyRegs() reads all registers with one readRegs() call,
+ * applies the modifications in order and writes the results with one
+ * writeRegs() call. Plugins for devices capable of atomic
+ * read-modify-write operations should override both functions.
+ *
+ * Note 7: plugins for devices with a native burst primitive can
+ * implement writeBurst() and readBurst() and declare it with
+ * setBurstCapabilities() instead of overriding the FIFO and memory
+ * functions. A burst transfers up to "maxLength" words, either at
+ * a fixed address ("increment" is false, enabled by BurstFIFO) or at
+ * consecutive addresses ("increment" is true, enabled by BurstMemory).
+ * Incrementing bursts never cross an address that is a multiple of
+ * "boundary" (if non-zero). Default FIFO and memory functions split
+ * transfers accordingly. With BurstPipelined, the next burst is
+ * submitted with submitWriteBurst() or submitReadBurst() before the
+ * previous one is completed with completeBurst(), keeping up to two
+ * bursts in flight. Default implementations of these three functions
+ * execute bursts synchronously at submission.
  */
 
 class SDMAbstractChannel : public SDMPropertyManager {
+	struct TransactionResult {
+		int status;
+		sdm_reg_t data;
+	};
+	std::map<int,TransactionResult> _transactions;
+	int _nextToken;
+	std::size_t _burstLength;
+	std::size_t _burstBoundary;
+	int _burstFlags;
 public:
+	SDMAbstractChannel();
 	virtual ~SDMAbstractChannel() {}
 	
 	virtual int close()=0;
@@ -91,10 +169,88 @@ public:
 	virtual int readFIFO(sdm_addr_t addr,sdm_reg_t *data,std::size_t n,int flags);
 	virtual int writeMem(sdm_addr_t addr,const sdm_reg_t *data,std::size_t n);
 	virtual int readMem(sdm_addr_t addr,sdm_reg_t *data,std::size_t n);
+	virtual int writeRegs(const sdm_addr_t *addr,const sdm_reg_t *data,std::size_t n);
+	virtual int readRegs(const sdm_addr_t *addr,sdm_reg_t *data,std::size_t n);
+	
+	virtual int submitWriteReg(sdm_addr_t addr,sdm_reg_t data);
+	virtual int submitReadReg(sdm_addr_t addr);
+	virtual int completeTransaction(int token,sdm_reg_t *data,int nb);
+	
+	virtual int writeReg64(sdm_addr64_t addr,sdm_reg64_t data);
+	virtual sdm_reg64_t readReg64(sdm_addr64_t addr,int *status);
+	virtual int writeFIFO64(sdm_addr64_t addr,const sdm_reg64_t *data,std::size_t n,int flags);
+	virtual int readFIFO64(sdm_addr64_t addr,sdm_reg64_t *data,std::size_t n,int flags);
+	virtual int writeMem64(sdm_addr64_t addr,const sdm_reg64_t *data,std::size_t n);
+	virtual int readMem64(sdm_addr64_t addr,sdm_reg64_t *data,std::size_t n);
+	
+	virtual int modifyReg(sdm_addr_t addr,sdm_reg_t mask,sdm_reg_t data);
+	virtual int modifyRegs(const sdm_addr_t *addr,const sdm_reg_t *mask,const sdm_reg_t *data,std::size_t n);
+protected:
+	enum BurstFlags {BurstMemory=1,BurstFIFO=2,BurstPipelined=4};
+	
+	int allocateToken();
+	
+	void setBurstCapabilities(std::size_t maxLength,std::size_t boundary,int flags);
+	virtual int writeBurst(sdm_addr_t addr,const sdm_reg_t *data,std::size_t n,bool increment) {return SDM_NOTSUPPORTED;}
+	virtual int readBurst(sdm_addr_t addr,sdm_reg_t *data,std::size_t n,bool increment) {return SDM_NOTSUPPORTED;}
+	virtual int submitWriteBurst(sdm_addr_t addr,const sdm_reg_t *data,std::size_t n,bool increment);
+	virtual int submitReadBurst(sdm_addr_t addr,sdm_reg_t *data,std::size_t n,bool increment);
+	virtual int completeBurst(int token);
+private:
+	bool burstsEnabled(bool increment) const;
+	int transferBursts(sdm_addr_t addr,const sdm_reg_t *wdata,sdm_reg_t *rdata,std::size_t n,bool increment);
 };
 
+/*
+ * streamFormat() returns the native sample format for the stream
+ * (one of the SDM_SAMPLE_* constants). readStreamTyped() has the same
+ * semantics as readStream() but stores samples in the requested format.
+ * The default implementation calls readStream() and converts samples,
+ * saturating them to the range of the target type. Sources that can
+ * produce data in a narrower format directly should override both
+ * functions.
+ *
+ * acquirePacket() lends the caller a pointer to the whole current packet
+ * of the stream, allowing to avoid copying when the source keeps packets
+ * in its own memory (e.g. a DMA or ring buffer). The pointer must stay
+ * valid until releasePacket() is called for the stream. The default
+ * implementation reads the rest of the packet with readStream() into
+ * an internal buffer, so that plugins declaring SDM_FEATURE_ACQUIRE
+ * only need to override it for sources that can actually lend their
+ * memory. If no more data are available in non-blocking mode, the
+ * samples read so far are kept until the next call.
+ *
+ * Sources that know when new data arrive can let the client block
+ * instead of polling. Such a source calls enableReadyNotification()
+ * (typically in its constructor) and then notifyReady() every time
+ * new data become available for reading. notifyReady() can be called
+ * from any thread; spurious notifications are allowed. The source must
+ * stop calling it before close() returns.
+ *
+ * readStreams() reads from several streams of the current packet with
+ * a single call. res[i] receives the value readStream() would have
+ * returned for streams[i]. The default implementation just calls
+ * readStream() for each stream.
+ *
+ * packetInfo() fills metadata for the current packet: sequence number,
+ * device timestamp and host arrival time. Only fields marked in
+ * info->flags are considered valid. The default implementation returns
+ * SDM_NOTSUPPORTED.
+ */
+
 class SDMAbstractSource : public SDMPropertyManager {
+	struct AcquireBuffer {
+		std::vector<sdm_sample_t> data;
+		std::size_t size=0;
+	};
+	
+	std::vector<sdm_sample_t> _typedBuf;
+	std::map<int,AcquireBuffer> _acquireBufs;
+	bool _readyEnabled;
+	sdm_ready_callback_t _readyCallback;
+	void *_readyContext;
 public:
+	SDMAbstractSource();
 	virtual ~SDMAbstractSource() {}
 	
 	virtual int close()=0;
@@ -104,6 +260,22 @@ public:
 	virtual int readNextPacket()=0;
 	virtual void discardPackets()=0;
 	virtual int readStreamErrors() {return 0;}
+	
+	virtual int streamFormat(int stream) {return SDM_SAMPLE_DOUBLE;}
+	virtual int readStreamTyped(int stream,void *data,std::size_t n,int format,int nb);
+	virtual int readStreams(const int *streams,sdm_sample_t * const *data,const std::size_t *n,int *res,std::size_t count,int nb);
+	virtual int packetInfo(sdm_packet_info_t *info) {return SDM_NOTSUPPORTED;}
+	
+	virtual int acquirePacket(int stream,const sdm_sample_t **data,std::size_t *n,int nb);
+	virtual int releasePacket(int stream);
+	
+	virtual int setReadyCallback(sdm_ready_callback_t callback,void *context);
+	
+// Note: called by the library when the current packet changes
+	void dropAcquiredData() {_acquireBufs.clear();}
+protected:
+	void enableReadyNotification() {_readyEnabled=true;}
+	void notifyReady();
 };
 
 /*
@@ -139,11 +311,30 @@ public:
  * isError() returns true when the last call to getSamplesFromQueue() resulted
  * in broken stream continuity.
  * 
+ * Readiness notifications are only useful if the source learns about new
+ * data by itself, so they are disabled by default. Derived classes that
+ * get data from the device asynchronously (e.g. in a background thread)
+ * can enable them by calling enableReadyNotification() in the constructor
+ * and notifyReady() every time data are added to the queue. The client is
+ * then also notified when a read leaves more data in the queue than it
+ * has consumed and after switching to the next packet.
+ * 
+ * Queued sources also report packet metadata. The sequence number counts
+ * packets since the last discardPackets() call and additionally advances
+ * by one for every packet in which isError() reported a discontinuity,
+ * so that the client sees the loss as a gap; the arrival time is the
+ * moment the first samples of the packet were obtained from the queue.
+ * Derived classes that know more (e.g. hardware sequence numbers or
+ * timestamps) should override packetInfo().
+ * 
  */
 
 class SDMAbstractQueuedSource : public SDMAbstractSource {
 	std::map<int,std::size_t> _pos;
 	int _errors;
+	sdm_uint64_t _sequence;
+	sdm_uint64_t _arrival;
+	bool _gap;
 public:
 	SDMAbstractQueuedSource();
 	virtual int selectReadStreams(const int *streams,std::size_t n,std::size_t packets,int df);
@@ -151,12 +342,15 @@ public:
 	virtual int readNextPacket();
 	virtual void discardPackets();
 	virtual int readStreamErrors();
+	virtual int packetInfo(sdm_packet_info_t *info);
 protected:
 	virtual void addDataToQueue(std::size_t samples,bool nonBlocking)=0;
 	virtual std::size_t getSamplesFromQueue(int stream,std::size_t pos,sdm_sample_t *data,std::size_t n,bool &eop)=0;
 	virtual void next()=0;
 	virtual void clear()=0;
 	virtual bool isError() const {return false;}
+private:
+	void checkContinuity();
 };
 
 /*
@@ -0,0 +1,142 @@
+/*
+ * Copyright (c) 2015-2022 Simple Device Model contributors
+ * 
+ * This file is part of the Simple Device Model (SDM) framework SDK.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ * This header file defines the SDMRingBufferSource class, a source
+ * base class which acquires packets in a background thread.
+ */
+
+#ifndef SDMRINGBUFFER_H_INCLUDED
+#define SDMRINGBUFFER_H_INCLUDED
+
+#include "sdmprovider.h"
+
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+/*
+ * SDMRingBufferSource is a ready-made alternative to
+ * SDMAbstractQueuedSource for sources that stream data at high rates.
+ * Packets are acquired from the device by a background thread and
+ * stored in a preallocated ring of "ringPackets" slots. The ring has a
+ * single producer (the acquisition thread) and a single consumer (the
+ * client thread); slot ownership is passed through atomic counters, so
+ * neither side takes a lock to access packet data.
+ *
+ * Derived classes only implement produce(), which is called repeatedly
+ * from the acquisition thread. It should fill the provided packet with
+ * samples for each selected stream and return true, or return false if
+ * no data arrived (e.g. on timeout). produce() should not block for
+ * more than about 100 ms so that the thread can be stopped in time.
+ * Packet buffers keep their capacity between uses ("packetSize" is the
+ * initial capacity), so no memory is allocated in the steady state.
+ * An exception thrown by produce() stops the acquisition; reads return
+ * SDM_ERROR once the packets acquired before it have been consumed.
+ *
+ * The acquisition thread is started by selectReadStreams() and stopped
+ * by stopAcquisition(). The default close() stops it and deletes the
+ * object; derived classes that override close() or have a destructor
+ * that releases resources used by produce() must call stopAcquisition()
+ * first.
+ *
+ * When the ring is full, the newly acquired packet is dropped and
+ * counted as a stream error (see readStreamErrors()). Every acquired
+ * packet, including dropped ones, gets the next sequence number, so
+ * drops show up as gaps in packetInfo() sequence numbers. readStream(),
+ * acquirePacket() and readNextPacket() take O(1) time regardless of
+ * the number of selected streams. Packets are lent to the client by
+ * acquirePacket() directly from the ring.
+ */
+
+class SDMRingBufferSource : public SDMAbstractSource {
+public:
+	class Packet {
+		friend class SDMRingBufferSource;
+		const std::vector<int> *_streams;
+		std::vector<std::vector<sdm_sample_t> > _data;
+		sdm_uint64_t _sequence;
+		sdm_uint64_t _timestamp;
+		bool _hasTimestamp;
+		
+		void reset();
+	public:
+		Packet();
+		
+		std::size_t streams() const {return _data.size();}
+		int streamId(std::size_t i) const {return (*_streams)[i];}
+		std::vector<sdm_sample_t> &data(std::size_t i) {return _data[i];}
+		const std::vector<sdm_sample_t> &data(std::size_t i) const {return _data[i];}
+		void setTimestamp(sdm_uint64_t timestamp);
+	};
+private:
+	std::vector<Packet> _slots;
+	Packet _scratch; // receives packets dropped due to the ring being full
+	std::size_t _packetSize;
+	std::vector<int> _streams;
+	std::vector<int> _index; // stream id => index in _streams, -1 if not selected
+	std::vector<std::size_t> _pos; // per-stream cursors in the current packet
+	int _df;
+	
+	sdm_uint64_t _produced; // packets acquired (including dropped ones), used by the producer
+	std::atomic<std::size_t> _head; // packets written, modified by the producer
+	std::atomic<std::size_t> _tail; // packets read, modified by the consumer
+	std::atomic<int> _overflows;
+	std::atomic<bool> _stop;
+	std::atomic<bool> _failed;
+	std::thread _thread;
+	std::mutex _waitMutex;
+	std::condition_variable _waitCv;
+	
+	sdm_uint64_t _arrival;
+public:
+	explicit SDMRingBufferSource(std::size_t ringPackets=16,std::size_t packetSize=0);
+	virtual ~SDMRingBufferSource();
+	
+	virtual int close();
+	
+	virtual int selectReadStreams(const int *streams,std::size_t n,std::size_t packets,int df);
+	virtual int readStream(int stream,sdm_sample_t *data,std::size_t n,int nb);
+	virtual int readNextPacket();
+	virtual void discardPackets();
+	virtual int readStreamErrors();
+	virtual int packetInfo(sdm_packet_info_t *info);
+	
+	virtual int acquirePacket(int stream,const sdm_sample_t **data,std::size_t *n,int nb);
+	virtual int releasePacket(int stream);
+	
+	std::size_t available() const;
+protected:
+	virtual bool produce(Packet &packet)=0;
+	
+	void stopAcquisition();
+	bool stopRequested() const {return _stop.load(std::memory_order_relaxed);}
+	const std::vector<int> &selectedStreams() const {return _streams;}
+	int decimationFactor() const {return _df;}
+private:
+	void run();
+	void notifyConsumer();
+	const Packet *currentPacket(int nb,int &status);
+};
+
+#endif
@@ -35,10 +35,53 @@
 #include <stdexcept>
 #include <cstring>
 #include <climits>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 
 namespace {
+	const int maxMessagesPerSecond=10;
+	
+	std::atomic<long long> logWindow(LLONG_MIN/2); // start of the current logging interval, ms
+	std::atomic<int> logCount(0);
+	std::atomic<int> logSuppressed(0);
+	
+	std::string &lastError() {
+		static thread_local std::string str;
+		return str;
+	}
+
+// Called on entry to every exported function that can fail, so that
+// a message left by an earlier call isn't attached to a later error
+	void clearLastError() {
+		lastError().clear();
+	}
+
+// Stores the message to be retrieved by sdmGetLastError()
+	void setLastError(const char *what) {
+		try {
+			lastError()=what;
+		}
+		catch(std::exception &) {}
+	}
+
+// Console output is rate-limited so that error storms (e.g. a failed
+// device polled at a high rate) don't cost more than the errors themselves.
+// Suppressed messages are counted and reported with the next printed one.
 	void displayErrorMessage(const char *what) {
-		std::cout<<"SDM plugin exception: "<<what<<std::endl;
+		setLastError(what);
+		
+		const long long now=std::chrono::duration_cast<std::chrono::milliseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+		long long start=logWindow.load(std::memory_order_relaxed);
+		if(now-start>=1000&&logWindow.compare_exchange_strong(start,now)) {
+			logCount.store(0);
+			int suppressed=logSuppressed.exchange(0);
+			if(suppressed>0) std::cout<<"SDM plugin: "<<suppressed<<" more exception(s) not displayed"<<std::endl;
+		}
+		if(logCount.fetch_add(1)<maxMessagesPerSecond)
+			std::cout<<"SDM plugin exception: "<<what<<std::endl;
+		else logSuppressed.fetch_add(1);
 	}
 
 	int getProperty(const SDMPropertyManager *obj,const char *name,char *buf,std::size_t n) {
@@ -50,7 +93,39 @@ namespace {
 			std::memcpy(buf,value.c_str(),size);
 			return 0;
 		}
-		catch(std::exception &) {
+		catch(std::exception &ex) {
+			setLastError(ex.what());
+			return SDM_ERROR;
+		}
+	}
+
+// Names and values are packed as null-terminated strings, the list is
+// terminated by an empty string. Non-existent properties are skipped.
+	int getProperties(const SDMPropertyManager *obj,const char *names,char *buf,std::size_t n) {
+		try {
+			std::string res;
+			for(const char *name=names;*name;name+=std::strlen(name)+1) {
+				std::string value;
+				try {
+					value=obj->getProperty(name);
+				}
+				catch(std::exception &) {
+					continue;
+				}
+				res.append(name);
+				res.push_back('\0');
+				res.append(value);
+				res.push_back('\0');
+			}
+			res.push_back('\0');
+			std::size_t size=res.size();
+			if(size>INT_MAX) return SDM_ERROR;
+			if(n<size) return static_cast<int>(size);
+			std::memcpy(buf,res.data(),size);
+			return 0;
+		}
+		catch(std::exception &ex) {
+			setLastError(ex.what());
 			return SDM_ERROR;
 		}
 	}
@@ -60,10 +135,10 @@ namespace {
 			obj->setProperty(name,value);
 			return 0;
 		}
-		catch(std::exception &) {
+		catch(std::exception &ex) {
+			setLastError(ex.what());
 			return SDM_ERROR;
 		}
-
 	}
 }
 
@@ -72,6 +147,7 @@ namespace {
  *******************************************************************/
 
 SDMAPI int SDMCALL sdmGetPluginProperty(const char *name,char *buf,std::size_t n) {
+	clearLastError();
 	try {
 		return getProperty(SDMAbstractPlugin::instance(),name,buf,n);
 	}
@@ -82,6 +158,7 @@ SDMAPI int SDMCALL sdmGetPluginProperty(const char *name,char *buf,std::size_t n
 }
 
 SDMAPI int SDMCALL sdmSetPluginProperty(const char *name,const char *value) {
+	clearLastError();
 	try {
 		return setProperty(SDMAbstractPlugin::instance(),name,value);
 	}
@@ -91,11 +168,87 @@ SDMAPI int SDMCALL sdmSetPluginProperty(const char *name,const char *value) {
 	}
 }
 
+SDMAPI int SDMCALL sdmGetCapabilities(sdm_capabilities_t *caps) {
+	clearLastError();
+	try {
+		if(!caps||caps->size<sizeof(std::size_t)) return SDM_ERROR;
+// Fill only as many fields as the caller knows about
+		sdm_capabilities_t full;
+		std::memset(&full,0,sizeof(full));
+		int r=SDMAbstractPlugin::instance()->getCapabilities(&full);
+		if(r) return r;
+		full.size=std::min(caps->size,sizeof(full));
+		std::memcpy(caps,&full,full.size);
+		return 0;
+	}
+	catch(std::exception &ex) {
+		displayErrorMessage(ex.what());
+		return SDM_ERROR;
+	}
+}
+
+// The message is cleared once retrieved, so that it isn't attributed
+// to an unrelated error later
+SDMAPI int SDMCALL sdmGetLastError(char *buf,std::size_t n) {
+	std::string &str=lastError();
+	std::size_t size=str.size()+1; // plus terminating null character
+	if(size>INT_MAX) return SDM_ERROR;
+	if(n<size) return static_cast<int>(size);
+	std::memcpy(buf,str.c_str(),size);
+	str.clear();
+	return 0;
+}
+
+SDMAPI int SDMCALL sdmGetPluginProperties(const char *names,char *buf,std::size_t n) {
+	clearLastError();
+	try {
+		return getProperties(SDMAbstractPlugin::instance(),names,buf,n);
+	}
+	catch(std::exception &ex) {
+		displayErrorMessage(ex.what());
+		return SDM_ERROR;
+	}
+}
+
+SDMAPI int SDMCALL sdmGetDeviceProperties(void *h,const char *names,char *buf,std::size_t n) {
+	clearLastError();
+	try {
+		return getProperties(static_cast<SDMAbstractDevice*>(h),names,buf,n);
+	}
+	catch(std::exception &ex) {
+		displayErrorMessage(ex.what());
+		return SDM_ERROR;
+	}
+}
+
+SDMAPI int SDMCALL sdmGetChannelProperties(void *h,const char *names,char *buf,std::size_t n) {
+	clearLastError();
+	try {
+		return getProperties(static_cast<SDMAbstractChannel*>(h),names,buf,n);
+	}
+	catch(std::exception &ex) {
+		displayErrorMessage(ex.what());
+		return SDM_ERROR;
+	}
+}
+
+SDMAPI int SDMCALL sdmGetSourceProperties(void *h,const char *names,char *buf,std::size_t n) {
+	clearLastError();
+	try {
+		return getProperties(static_cast<SDMAbstractSource*>(h),names,buf,n);
+	}
+	catch(std::exception &ex) {
+		displayErrorMessage(ex.what());
+		return SDM_ERROR;
+	}
+}
+
 /********************************************************************
  * Device functions
  *******************************************************************/
 
 SDMAPI void * SDMCALL sdmOpenDevice(int id) {
+	clearLastError();
 	try {
 		return SDMAbstractPlugin::instance()->openDevice(id);
 	}
@@ -106,6 +259,7 @@ SDMAPI void * SDMCALL sdmOpenDevice(int id) {
 }
 
 SDMAPI int SDMCALL sdmCloseDevice(void *h) {
+	clearLastError();
 	try {
 		return static_cast<SDMAbstractDevice*>(h)->close();
 	}
@@ -116,6 +270,7 @@ SDMAPI int SDMCALL sdmCloseDevice(void *h) {
 }
 
 SDMAPI int SDMCALL sdmGetDeviceProperty(void *h,const char *name,char *buf,std::size_t n) {
+	clearLastError();
 	try {
 		return getProperty(static_cast<SDMAbstractDevice*>(h),name,buf,n);
 	}
@@ -126,6 +281,7 @@ SDMAPI int SDMCALL sdmGetDeviceProperty(void *h,const char *name,char *buf,std::
 }
 
 SDMAPI int SDMCALL sdmSetDeviceProperty(void *h,const char *name,const char *value) {
+	clearLastError();
 	try {
 		return setProperty(static_cast<SDMAbstractDevice*>(h),name,value);
 	}
@@ -136,6 +292,7 @@ SDMAPI int SDMCALL sdmSetDeviceProperty(void *h,const char *name,const char *val
 }
 
 SDMAPI int SDMCALL sdmConnect(void *h) {
+	clearLastError();
 	try {
 		return static_cast<SDMAbstractDevice*>(h)->connect();
 	}
@@ -146,6 +303,7 @@ SDMAPI int SDMCALL sdmConnect(void *h) {
 }
 
 SDMAPI int SDMCALL sdmDisconnect(void *h) {
+	clearLastError();
 	try {
 		return static_cast<SDMAbstractDevice*>(h)->disconnect();
 	}
@@ -156,6 +314,7 @@ SDMAPI int SDMCALL sdmDisconnect(void *h) {
 }
 
 SDMAPI int SDMCALL sdmGetConnectionStatus(void *h) {
+	clearLastError();
 	try {
 		return static_cast<SDMAbstractDevice*>(h)->getConnectionStatus();
 	}
@@ -170,6 +329,7 @@ SDMAPI int SDMCALL sdmGetConnectionStatus(void *h) {
  *******************************************************************/
 
 SDMAPI void * SDMCALL sdmOpenChannel(void *hdev,int id) {
+	clearLastError();
 	try {
 		return static_cast<SDMAbstractDevice*>(hdev)->openChannel(id);
 	}
@@ -180,6 +340,7 @@ SDMAPI void * SDMCALL sdmOpenChannel(void *hdev,int id) {
 }
 
 SDMAPI int SDMCALL sdmCloseChannel(void *h) {
+	clearLastError();
 	try {
 		return static_cast<SDMAbstractChannel*>(h)->close();
 	}
@@ -190,6 +351,7 @@ SDMAPI int SDMCALL sdmCloseChannel(void *h) {
 }
 
 SDMAPI int SDMCALL sdmGetChannelProperty(void *h,const char *name,char *buf,std::size_t n) {
+	clearLastError();
 	try {
 		return getProperty(static_cast<SDMAbstractChannel*>(h),name,buf,n);
 	}
@@ -200,6 +362,7 @@ SDMAPI int SDMCALL sdmGetChannelProperty(void *h,const char *name,char *buf,std:
 }
 
 SDMAPI int SDMCALL sdmSetChannelProperty(void *h,const char *name,const char *value) {
+	clearLastError();
 	try {
 		return setProperty(static_cast<SDMAbstractChannel*>(h),name,value);
 	}
@@ -210,6 +373,7 @@ SDMAPI int SDMCALL sdmSetChannelProperty(void *h,const char *name,const char *va
 }
 
 SDMAPI int SDMCALL sdmWriteReg(void *h,sdm_addr_t addr,sdm_reg_t data) {
+	clearLastError();
 	try {
 		return static_cast<SDMAbstractChannel*>(h)->writeReg(addr,data);
 	}
@@ -220,6 +384,7 @@ SDMAPI int SDMCALL sdmWriteReg(void *h,sdm_addr_t addr,sdm_reg_t data) {
 }
 
 SDMAPI sdm_reg_t SDMCALL sdmReadReg(void *h,sdm_addr_t addr,int *status) {
+	clearLastError();
 	try {
 		if(status) *status=0;
 		return static_cast<SDMAbstractChannel*>(h)->readReg(addr,status);
@@ -232,6 +397,7 @@ SDMAPI sdm_reg_t SDMCALL sdmReadReg(void *h,sdm_addr_t addr,int *status) {
 }
 
 SDMAPI int SDMCALL sdmWriteFIFO(void *h,sdm_addr_t addr,const sdm_reg_t *data,std::size_t n,int flags) {
+	clearLastError();
 	try {
 		return static_cast<SDMAbstractChannel*>(h)->writeFIFO(addr,data,n,flags);
 	}
@@ -242,6 +408,7 @@ SDMAPI int SDMCALL sdmWriteFIFO(void *h,sdm_addr_t addr,const sdm_reg_t *data,st
 }
 
 SDMAPI int SDMCALL sdmReadFIFO(void *h,sdm_addr_t addr,sdm_reg_t *data,std::size_t n,int flags) {
+	clearLastError();
 	try {
 		return static_cast<SDMAbstractChannel*>(h)->readFIFO(addr,data,n,flags);
 	}
@@ -252,6 +419,7 @@ SDMAPI int SDMCALL sdmReadFIFO(void *h,sdm_addr_t addr,sdm_reg_t *data,std::size
 }
 
 SDMAPI int SDMCALL sdmWriteMem(void *h,sdm_addr_t addr,const sdm_reg_t *data,std::size_t n) {
+	clearLastError();
 	try {
 		return static_cast<SDMAbstractChannel*>(h)->writeMem(addr,data,n);
 	}
@@ -262,6 +430,7 @@ SDMAPI int SDMCALL sdmWriteMem(void *h,sdm_addr_t addr,const sdm_reg_t *data,std
 }
 
 SDMAPI int SDMCALL sdmReadMem(void *h,sdm_addr_t addr,sdm_reg_t *data,std::size_t n) {
+	clearLastError();
 	try {
 		return static_cast<SDMAbstractChannel*>(h)->readMem(addr,data,n);
 	}
@@ -271,11 +440,157 @@ SDMAPI int SDMCALL sdmReadMem(void *h,sdm_addr_t addr,sdm_reg_t *data,std::size_
 	}
 }
 
+SDMAPI int SDMCALL sdmWriteRegs(void *h,const sdm_addr_t *addr,const sdm_reg_t *data,std::size_t n) {
+	clearLastError();
+	try {
+		return static_cast<SDMAbstractChannel*>(h)->writeRegs(addr,data,n);
+	}
+	catch(std::exception &ex) {
+		displayErrorMessage(ex.what());
+		return SDM_ERROR;
+	}
+}
+
+SDMAPI int SDMCALL sdmReadRegs(void *h,const sdm_addr_t *addr,sdm_reg_t *data,std::size_t n) {
+	clearLastError();
+	try {
+		return static_cast<SDMAbstractChannel*>(h)->readRegs(addr,data,n);
+	}
+	catch(std::exception &ex) {
+		displayErrorMessage(ex.what());
+		return SDM_ERROR;
+	}
+}
+
+SDMAPI int SDMCALL sdmSubmitWriteReg(void *h,sdm_addr_t addr,sdm_reg_t data) {
+	clearLastError();
+	try {
+		return static_cast<SDMAbstractChannel*>(h)->submitWriteReg(addr,data);
+	}
+	catch(std::exception &ex) {
+		displayErrorMessage(ex.what());
+		return SDM_ERROR;
+	}
+}
+
+SDMAPI int SDMCALL sdmSubmitReadReg(void *h,sdm_addr_t addr) {
+	clearLastError();
+	try {
+		return static_cast<SDMAbstractChannel*>(h)->submitReadReg(addr);
+	}
+	catch(std::exception &ex) {
+		displayErrorMessage(ex.what());
+		return SDM_ERROR;
+	}
+}
+
+SDMAPI int SDMCALL sdmCompleteTransaction(void *h,int token,sdm_reg_t *data,int nb) {
+	clearLastError();
+	try {
+		return static_cast<SDMAbstractChannel*>(h)->completeTransaction(token,data,nb);
+	}
+	catch(std::exception &ex) {
+		displayErrorMessage(ex.what());
+		return SDM_ERROR;
+	}
+}
+
+SDMAPI int SDMCALL sdmWriteReg64(void *h,sdm_addr64_t addr,sdm_reg64_t data) {
+	clearLastError();
+	try {
+		return static_cast<SDMAbstractChannel*>(h)->writeReg64(addr,data);
+	}
+	catch(std::exception &ex) {
+		displayErrorMessage(ex.what());
+		return SDM_ERROR;
+	}
+}
+
+SDMAPI sdm_reg64_t SDMCALL sdmReadReg64(void *h,sdm_addr64_t addr,int *status) {
+	clearLastError();
+	try {
+		if(status) *status=0;
+		return static_cast<SDMAbstractChannel*>(h)->readReg64(addr,status);
+	}
+	catch(std::exception &ex) {
+		displayErrorMessage(ex.what());
+		if(status&&*status==0) *status=-1;
+		return 0;
+	}
+}
+
+SDMAPI int SDMCALL sdmWriteFIFO64(void *h,sdm_addr64_t addr,const sdm_reg64_t *data,std::size_t n,int flags) {
+	clearLastError();
+	try {
+		return static_cast<SDMAbstractChannel*>(h)->writeFIFO64(addr,data,n,flags);
+	}
+	catch(std::exception &ex) {
+		displayErrorMessage(ex.what());
+		return SDM_ERROR;
+	}
+}
+
+SDMAPI int SDMCALL sdmReadFIFO64(void *h,sdm_addr64_t addr,sdm_reg64_t *data,std::size_t n,int flags) {
+	clearLastError();
+	try {
+		return static_cast<SDMAbstractChannel*>(h)->readFIFO64(addr,data,n,flags);
+	}
+	catch(std::exception &ex) {
+		displayErrorMessage(ex.what());
+		return SDM_ERROR;
+	}
+}
+
+SDMAPI int SDMCALL sdmWriteMem64(void *h,sdm_addr64_t addr,const sdm_reg64_t *data,std::size_t n) {
+	clearLastError();
+	try {
+		return static_cast<SDMAbstractChannel*>(h)->writeMem64(addr,data,n);
+	}
+	catch(std::exception &ex) {
+		displayErrorMessage(ex.what());
+		return SDM_ERROR;
+	}
+}
+
+SDMAPI int SDMCALL sdmReadMem64(void *h,sdm_addr64_t addr,sdm_reg64_t *data,std::size_t n) {
+	clearLastError();
+	try {
+		return static_cast<SDMAbstractChannel*>(h)->readMem64(addr,data,n);
+	}
+	catch(std::exception &ex) {
+		displayErrorMessage(ex.what());
+		return SDM_ERROR;
+	}
+}
+
+SDMAPI int SDMCALL sdmModifyReg(void *h,sdm_addr_t addr,sdm_reg_t mask,sdm_reg_t data) {
+	clearLastError();
+	try {
+		return static_cast<SDMAbstractChannel*>(h)->modifyReg(addr,mask,data);
+	}
+	catch(std::exception &ex) {
+		displayErrorMessage(ex.what());
+		return SDM_ERROR;
+	}
+}
+
+SDMAPI int SDMCALL sdmModifyRegs(void *h,const sdm_addr_t *addr,const sdm_reg_t *mask,const sdm_reg_t *data,std::size_t n) {
+	clearLastError();
+	try {
+		return static_cast<SDMAbstractChannel*>(h)->modifyRegs(addr,mask,data,n);
+	}
+	catch(std::exception &ex) {
+		displayErrorMessage(ex.what());
+		return SDM_ERROR;
+	}
+}
+
 /********************************************************************
  * Data source functions
  *******************************************************************/
 
 SDMAPI void * SDMCALL sdmOpenSource(void *hdev,int id) {
+	clearLastError();
 	try {
 		return static_cast<SDMAbstractDevice*>(hdev)->openSource(id);
 	}
@@ -286,6 +601,7 @@ SDMAPI void * SDMCALL sdmOpenSource(void *hdev,int id) {
 }
 
 SDMAPI int SDMCALL sdmCloseSource(void *h) {
+	clearLastError();
 	try {
 		return static_cast<SDMAbstractSource*>(h)->close();
 	}
@@ -296,6 +612,7 @@ SDMAPI int SDMCALL sdmCloseSource(void *h) {
 }
 
 SDMAPI int SDMCALL sdmGetSourceProperty(void *h,const char *name,char *buf,std::size_t n) {
+	clearLastError();
 	try {
 		return getProperty(static_cast<SDMAbstractSource*>(h),name,buf,n);
 	}
@@ -306,6 +623,7 @@ SDMAPI int SDMCALL sdmGetSourceProperty(void *h,const char *name,char *buf,std::
 }
 
 SDMAPI int SDMCALL sdmSetSourceProperty(void *h,const char *name,const char *value) {
+	clearLastError();
 	try {
 		return setProperty(static_cast<SDMAbstractSource*>(h),name,value);
 	}
@@ -316,7 +634,9 @@ SDMAPI int SDMCALL sdmSetSourceProperty(void *h,const char *name,const char *val
 }
 
 SDMAPI int SDMCALL sdmSelectReadStreams(void *h,const int *streams,std::size_t n,std::size_t packets,int df) {
+	clearLastError();
 	try {
+		static_cast<SDMAbstractSource*>(h)->dropAcquiredData();
 		return static_cast<SDMAbstractSource*>(h)->selectReadStreams(streams,n,packets,df);
 	}
 	catch(std::exception &ex) {
@@ -326,6 +646,7 @@ SDMAPI int SDMCALL sdmSelectReadStreams(void *h,const int *streams,std::size_t n
 }
 
 SDMAPI int SDMCALL sdmReadStream(void *h,int stream,sdm_sample_t *data,std::size_t n,int nb) {
+	clearLastError();
 	try {
 		return static_cast<SDMAbstractSource*>(h)->readStream(stream,data,n,nb);
 	}
@@ -336,7 +657,9 @@ SDMAPI int SDMCALL sdmReadStream(void *h,int stream,sdm_sample_t *data,std::size
 }
 
 SDMAPI int SDMCALL sdmReadNextPacket(void *h) {
+	clearLastError();
 	try {
+		static_cast<SDMAbstractSource*>(h)->dropAcquiredData();
 		return static_cast<SDMAbstractSource*>(h)->readNextPacket();
 	}
 	catch(std::exception &ex) {
@@ -346,7 +669,9 @@ SDMAPI int SDMCALL sdmReadNextPacket(void *h) {
 }
 
 SDMAPI void SDMCALL sdmDiscardPackets(void *h) {
+	clearLastError();
 	try {
+		static_cast<SDMAbstractSource*>(h)->dropAcquiredData();
 		static_cast<SDMAbstractSource*>(h)->discardPackets();
 	}
 	catch(std::exception &ex) {
@@ -355,6 +680,7 @@ SDMAPI void SDMCALL sdmDiscardPackets(void *h) {
 }
 
 SDMAPI int SDMCALL sdmReadStreamErrors(void *h) {
+	clearLastError();
 	try {
 		return static_cast<SDMAbstractSource*>(h)->readStreamErrors();
 	}
@@ -363,3 +689,80 @@ SDMAPI int SDMCALL sdmReadStreamErrors(void *h) {
 		return SDM_ERROR;
 	}
 }
+
+SDMAPI int SDMCALL sdmGetStreamFormat(void *h,int stream) {
+	clearLastError();
+	try {
+		return static_cast<SDMAbstractSource*>(h)->streamFormat(stream);
+	}
+	catch(std::exception &ex) {
+		displayErrorMessage(ex.what());
+		return SDM_ERROR;
+	}
+}
+
+SDMAPI int SDMCALL sdmReadStreamTyped(void *h,int stream,void *data,std::size_t n,int format,int nb) {
+	clearLastError();
+	try {
+		return static_cast<SDMAbstractSource*>(h)->readStreamTyped(stream,data,n,format,nb);
+	}
+	catch(std::exception &ex) {
+		displayErrorMessage(ex.what());
+		return SDM_ERROR;
+	}
+}
+
+SDMAPI int SDMCALL sdmAcquirePacket(void *h,int stream,const sdm_sample_t **data,std::size_t *n,int nb) {
+	clearLastError();
+	try {
+		return static_cast<SDMAbstractSource*>(h)->acquirePacket(stream,data,n,nb);
+	}
+	catch(std::exception &ex) {
+		displayErrorMessage(ex.what());
+		return SDM_ERROR;
+	}
+}
+
+SDMAPI int SDMCALL sdmReleasePacket(void *h,int stream) {
+	clearLastError();
+	try {
+		return static_cast<SDMAbstractSource*>(h)->releasePacket(stream);
+	}
+	catch(std::exception &ex) {
+		displayErrorMessage(ex.what());
+		return SDM_ERROR;
+	}
+}
+
+SDMAPI int SDMCALL sdmSetReadyCallback(void *h,sdm_ready_callback_t callback,void *context) {
+	clearLastError();
+	try {
+		return static_cast<SDMAbstractSource*>(h)->setReadyCallback(callback,context);
+	}
+	catch(std::exception &ex) {
+		displayErrorMessage(ex.what());
+		return SDM_ERROR;
+	}
+}
+
+SDMAPI int SDMCALL sdmReadStreams(void *h,const int *streams,sdm_sample_t * const *data,const std::size_t *n,int *res,std::size_t count,int nb) {
+	clearLastError();
+	try {
+		return static_cast<SDMAbstractSource*>(h)->readStreams(streams,data,n,res,count,nb);
+	}
+	catch(std::exception &ex) {
+		displayErrorMessage(ex.what());
+		return SDM_ERROR;
+	}
+}
+
+SDMAPI int SDMCALL sdmGetPacketInfo(void *h,sdm_packet_info_t *info) {
+	clearLastError();
+	try {
+		return static_cast<SDMAbstractSource*>(h)->packetInfo(info);
+	}
+	catch(std::exception &ex) {
+		displayErrorMessage(ex.what());
+		return SDM_ERROR;
+	}
+}
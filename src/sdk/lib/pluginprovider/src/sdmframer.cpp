@@ -0,0 +1,298 @@
+/*
+ * Copyright (c) 2015-2022 Simple Device Model contributors
+ * 
+ * This file is part of the Simple Device Model (SDM) framework SDK.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ * This module provides an implementation of the SDMFramer class.
+ */
+
+#include "sdmframer.h"
+
+#include <cstring>
+#include <cstdint>
+#include <stdexcept>
+#include <algorithm>
+#include <type_traits>
+
+namespace {
+	template <typename T,bool bigEndian> T loadWord(const unsigned char *word) {
+		typedef typename std::make_unsigned<T>::type U;
+		U u=0;
+		for(std::size_t i=0;i<sizeof(T);i++) {
+			const std::size_t byte=bigEndian?i:sizeof(T)-1-i;
+			u=static_cast<U>((u<<8)|word[byte]);
+		}
+		return static_cast<T>(u);
+	}
+	
+	template <typename T,bool bigEndian> sdm_sample_t unpackInt(const unsigned char *word) {
+		return static_cast<sdm_sample_t>(loadWord<T,bigEndian>(word));
+	}
+	
+	template <bool bigEndian> sdm_sample_t unpackFloat(const unsigned char *word) {
+		const std::uint32_t u=loadWord<std::uint32_t,bigEndian>(word);
+		float f;
+		std::memcpy(&f,&u,sizeof(f));
+		return static_cast<sdm_sample_t>(f);
+	}
+
+// Indexed by SDMFramer::Encoding
+	const struct {std::size_t size; SDMFramer::Unpacker unpacker;} encodings[]={
+		{1,unpackInt<std::uint8_t,false>},
+		{1,unpackInt<std::int8_t,false>},
+		{2,unpackInt<std::uint16_t,false>},
+		{2,unpackInt<std::int16_t,false>},
+		{2,unpackInt<std::uint16_t,true>},
+		{2,unpackInt<std::int16_t,true>},
+		{4,unpackInt<std::uint32_t,false>},
+		{4,unpackInt<std::int32_t,false>},
+		{4,unpackInt<std::uint32_t,true>},
+		{4,unpackInt<std::int32_t,true>},
+		{4,unpackFloat<false>},
+		{4,unpackFloat<true>},
+		{0,nullptr} // BitFields
+	};
+}
+
+/*
+ * SDMFramer members
+ */
+
+SDMFramer::SDMFramer(std::size_t bufferSize):
+	_buf(std::max<std::size_t>(bufferSize,1)),
+	_begin(0),
+	_end(0),
+	_frameWords(1),
+	_markers(false),
+	_encoding(UInt8),
+	_unpacker(encodings[UInt8].unpacker),
+	_wordSize(1),
+	_streams(1),
+	_open(false),
+	_next(0),
+	_skipped(0),
+	_dropped(0)
+{
+	std::fill(_classes,_classes+256,static_cast<unsigned char>(WordStart));
+}
+
+// An empty pattern means that frames follow each other without gaps
+
+void SDMFramer::setSyncPattern(const std::string &pattern,std::size_t frameWords) {
+	if(frameWords==0) throw std::runtime_error("Frame must contain at least one word");
+	_sync=pattern;
+	_frameWords=frameWords;
+	_markers=false;
+	_buf.resize(std::max(_buf.size(),_sync.size()+_frameWords*_wordSize));
+}
+
+void SDMFramer::setMarkerClasses(const ByteClass *classes) {
+	for(int i=0;i<256;i++) _classes[i]=static_cast<unsigned char>(classes[i]);
+	_markers=true;
+}
+
+void SDMFramer::setEncoding(Encoding encoding,std::size_t streams) {
+	if(encoding<UInt8||encoding>=BitFields) throw std::runtime_error("Use setBitFields() to define a custom encoding");
+	if(streams==0) throw std::runtime_error("Number of streams must be positive");
+	_encoding=encoding;
+	_unpacker=encodings[encoding].unpacker;
+	_fields.clear();
+	_wordSize=encodings[encoding].size;
+	_streams=streams;
+	_buf.resize(std::max(_buf.size(),_sync.size()+_frameWords*_wordSize));
+}
+
+void SDMFramer::setBitFields(const std::vector<BitField> &fields,std::size_t wordSize,std::size_t streams) {
+	if(streams==0) throw std::runtime_error("Number of streams must be positive");
+	for(auto const &field: fields) {
+		if(field.offset>=wordSize) throw std::runtime_error("Bit field is outside the word");
+		if(field.shift<0||field.shift>24) throw std::runtime_error("Bad bit field shift");
+	}
+	_encoding=BitFields;
+	_unpacker=nullptr;
+	_fields=fields;
+	_wordSize=std::max<std::size_t>(wordSize,1);
+	_streams=streams;
+	_buf.resize(std::max(_buf.size(),_sync.size()+_frameWords*_wordSize));
+}
+
+std::size_t SDMFramer::encodingSize(Encoding encoding) {
+	if(encoding<UInt8||encoding>BitFields) return 0;
+	return encodings[encoding].size;
+}
+
+SDMFramer::Unpacker SDMFramer::unpacker(Encoding encoding) {
+	if(encoding<UInt8||encoding>BitFields) return nullptr;
+	return encodings[encoding].unpacker;
+}
+
+// Returns a pointer to the free space at the end of the buffer, which
+// can be passed directly to a read function. Buffered data are moved
+// to the beginning of the buffer first.
+
+char *SDMFramer::reserve(std::size_t &n) {
+	if(_begin>0) {
+		if(_end>_begin) std::memmove(_buf.data(),_buf.data()+_begin,_end-_begin);
+		_end-=_begin;
+		_begin=0;
+	}
+	n=_buf.size()-_end;
+	return _buf.data()+_end;
+}
+
+void SDMFramer::commit(std::size_t n) {
+	_end+=std::min(n,_buf.size()-_end);
+}
+
+// Bytes that don't fit into the buffer are dropped
+
+std::size_t SDMFramer::write(const char *data,std::size_t n) {
+	std::size_t size;
+	char *p=reserve(size);
+	const std::size_t towrite=std::min(n,size);
+	if(towrite>0) std::memcpy(p,data,towrite);
+	_end+=towrite;
+	_dropped+=n-towrite;
+	return towrite;
+}
+
+// Returns the number of frames completed
+
+std::size_t SDMFramer::process() {
+	const unsigned char *p=reinterpret_cast<const unsigned char*>(_buf.data());
+	std::size_t pos=_begin;
+	std::size_t completed=0;
+	
+	if(_markers) {
+		while(_end-pos>=_wordSize) {
+			const unsigned char cls=_classes[p[pos]];
+			if(cls==Skip) {
+				std::size_t next=pos+1;
+				while(next<_end&&_classes[p[next]]==Skip) next++;
+				_skipped+=next-pos;
+				pos=next;
+				continue;
+			}
+			if(cls==FrameStart) {
+				if(_open) completed++;
+				startFrame();
+			}
+			if(_open) addWord(p+pos);
+			else _skipped+=_wordSize; // no frame to add the word to
+			pos+=_wordSize;
+		}
+	}
+	else {
+		const std::size_t frameSize=_sync.size()+_frameWords*_wordSize;
+		while(_end-pos>=frameSize) {
+			if(!_sync.empty()&&std::memcmp(p+pos,_sync.data(),_sync.size())!=0) {
+				const std::size_t next=findSync(pos+1);
+				_skipped+=next-pos;
+				pos=next;
+				continue;
+			}
+			startFrame();
+			const unsigned char *word=p+pos+_sync.size();
+			for(std::size_t i=0;i<_frameWords;i++,word+=_wordSize) addWord(word);
+			_open=false;
+			completed++;
+			pos+=frameSize;
+		}
+	}
+	
+	_begin=pos;
+	if(_begin==_end) _begin=_end=0;
+	return completed;
+}
+
+// The first frame is complete if no more words can be added to it
+
+bool SDMFramer::frameComplete() const {
+	return !_frames.empty()&&(_frames.size()>1||!_open);
+}
+
+const std::vector<sdm_sample_t> &SDMFramer::frame(std::size_t stream) const {
+	if(_frames.empty()) throw std::runtime_error("No frames available");
+	if(stream>=_frames.front().size()) throw std::runtime_error("Stream index out of range");
+	return _frames.front()[stream];
+}
+
+// If the last open frame is removed, words are skipped until the next
+// frame start
+
+void SDMFramer::popFrame() {
+	if(_frames.empty()) return;
+	_free.push_back(std::move(_frames.front()));
+	_frames.pop_front();
+	if(_frames.empty()) _open=false;
+}
+
+// Discards buffered bytes and frames. Byte counters are not reset.
+
+void SDMFramer::clear() {
+	while(!_frames.empty()) popFrame();
+	_begin=_end=0;
+}
+
+/*
+ * SDMFramer private members
+ */
+
+// Returns the position of the next (possibly incomplete) sync pattern
+// occurrence, or the end of the buffered data if there is none
+
+std::size_t SDMFramer::findSync(std::size_t pos) const {
+	const char *p=_buf.data();
+	while(pos<_end) {
+		const char *found=static_cast<const char*>(std::memchr(p+pos,_sync[0],_end-pos));
+		if(!found) return _end;
+		pos=found-p;
+		const std::size_t n=std::min(_sync.size(),_end-pos);
+		if(std::memcmp(p+pos,_sync.data(),n)==0) return pos;
+		pos++;
+	}
+	return _end;
+}
+
+void SDMFramer::startFrame() {
+	if(!_free.empty()) {
+		_frames.push_back(std::move(_free.back()));
+		_free.pop_back();
+	}
+	else _frames.push_back(Frame());
+	auto &frame=_frames.back();
+	frame.resize(_streams);
+	for(auto &v: frame) v.clear();
+	_open=true;
+	_next=0;
+}
+
+void SDMFramer::addWord(const unsigned char *word) {
+	sdm_sample_t sample;
+	if(_unpacker) sample=_unpacker(word);
+	else {
+		std::uint32_t u=0;
+		for(auto const &field: _fields) u|=static_cast<std::uint32_t>(word[field.offset]&field.mask)<<field.shift;
+		sample=static_cast<sdm_sample_t>(u);
+	}
+	_frames.back()[_next].push_back(sample);
+	if(++_next==_streams) _next=0;
+}
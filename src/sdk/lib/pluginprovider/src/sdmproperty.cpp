@@ -28,50 +28,53 @@
 #include "sdmproperty.h"
 
 #include <stdexcept>
+#include <sstream>
+#include <cstdlib>
+#include <cerrno>
+#include <climits>
+
+namespace {
+	std::string formatDouble(double value) {
+		std::ostringstream oss;
+		oss.precision(15);
+		oss<<value;
+		return oss.str();
+	}
+}
 
 /*
  * Public members
  */
 
-SDMPropertyManager::SDMPropertyManager(): _dirty(false) {}
+SDMPropertyManager::SDMPropertyManager():
+	_dirty(false),
+	_revision(0),
+	_revisionEnabled(false) {}
 
 SDMPropertyManager::~SDMPropertyManager() {}
 
 void SDMPropertyManager::clear() {
 	_props.clear();
-	_listall.clear();
+	_ids.clear();
 	_dirty=true;
+	_revision++;
 }
 
 void SDMPropertyManager::addProperty(const std::string &name,const std::string &value) {
-	std::map<std::string,std::pair<std::string,Type> >::iterator it=_props.find(name);
-	if(it==_props.end()) {
-		_props[name]=std::make_pair(value,Normal);
-		_listall.push_back(name);
-	}
-	else it->second=std::make_pair(value,Normal);
-	_dirty=true;
+	define(name,value,Normal,StringValue);
 }
 
 void SDMPropertyManager::addConstProperty(const std::string &name,const std::string &value) {
-	std::map<std::string,std::pair<std::string,Type> >::iterator it=_props.find(name);
-	if(it==_props.end()) {
-		_props[name]=std::make_pair(value,ReadOnly);
-		_listall.push_back(name);
-	}
-	else it->second=std::make_pair(value,ReadOnly);
-	_dirty=true;
+	define(name,value,ReadOnly,StringValue);
 }
 
 void SDMPropertyManager::addListItem(const std::string &list,const std::string &item) {
-	std::map<std::string,std::pair<std::string,Type> >::iterator it=_props.find(list);
-	if(it==_props.end()) {
-		_props[list]=std::make_pair(formatListItem(item),List);
-		_listall.push_back(list);
+	std::unordered_map<std::string,PropertyId>::const_iterator it=_ids.find(list);
+	if(it==_ids.end()||_props[it->second].type!=List) define(list,formatListItem(item),List,StringValue);
+	else {
+		_props[it->second].value+=(","+formatListItem(item));
+		_revision++;
 	}
-	else if(it->second.second!=List) it->second=std::make_pair(formatListItem(item),List);
-	else it->second.first+=(","+formatListItem(item));
-	_dirty=true;
 }
 
 std::string SDMPropertyManager::getProperty(const std::string &name) const {
@@ -88,10 +91,15 @@ std::string SDMPropertyManager::getProperty(const std::string &name) const {
 		if(_dirty) rebuildCache();
 		return _cacheWritable;
 	}
+	if(name=="*revision"&&_revisionEnabled) {
+		std::ostringstream oss;
+		oss<<_revision;
+		return oss.str();
+	}
 	
 // Handle normal properties
-	std::map<std::string,std::pair<std::string,Type> >::const_iterator it=_props.find(name);
-	if(it!=_props.end()) return it->second.first;
+	std::unordered_map<std::string,PropertyId>::const_iterator it=_ids.find(name);
+	if(it!=_ids.end()) return _props[it->second].value;
 	throw std::runtime_error("Property \""+name+"\" not found");
 }
 
@@ -105,32 +113,216 @@ std::string SDMPropertyManager::getProperty(const std::string &name,const std::s
 }
 
 void SDMPropertyManager::setProperty(const std::string &name,const std::string &value) {
-	std::map<std::string,std::pair<std::string,Type> >::iterator it=_props.find(name);
-	if(it==_props.end()) throw std::runtime_error("Property \""+name+"\" is not defined");
-	if(it->second.second!=Normal) throw std::runtime_error("Property \""+name+"\" is not writable");
-	it->second.first=value;
+	std::unordered_map<std::string,PropertyId>::const_iterator it=_ids.find(name);
+	if(it==_ids.end()) throw std::runtime_error("Property \""+name+"\" is not defined");
+	Property &prop=_props[it->second];
+	if(prop.type!=Normal) throw std::runtime_error("Property \""+name+"\" is not writable");
+	parseValue(prop,value);
+	_revision++;
+	changed(it->second);
+}
+
+SDMPropertyManager::PropertyId SDMPropertyManager::addIntProperty(const std::string &name,int value) {
+	std::ostringstream oss;
+	oss<<value;
+	Property &prop=define(name,oss.str(),Normal,IntValue);
+	prop.intValue=value;
+	return _ids[name];
+}
+
+SDMPropertyManager::PropertyId SDMPropertyManager::addDoubleProperty(const std::string &name,double value) {
+	Property &prop=define(name,formatDouble(value),Normal,DoubleValue);
+	prop.doubleValue=value;
+	return _ids[name];
+}
+
+SDMPropertyManager::PropertyId SDMPropertyManager::addBoolProperty(const std::string &name,bool value) {
+	Property &prop=define(name,value?"true":"false",Normal,BoolValue);
+	prop.intValue=value?1:0;
+	return _ids[name];
+}
+
+SDMPropertyManager::PropertyId SDMPropertyManager::addEnumProperty(const std::string &name,const std::vector<std::string> &items,const std::string &value) {
+	std::size_t i=0;
+	while(i<items.size()&&items[i]!=value) i++;
+	if(i==items.size()) throw std::runtime_error("Bad value for property \""+name+"\": \""+value+"\"");
+	Property &prop=define(name,value,Normal,EnumValue);
+	prop.items=items;
+	prop.intValue=static_cast<int>(i);
+	return _ids[name];
+}
+
+SDMPropertyManager::PropertyId SDMPropertyManager::propertyId(const std::string &name) const {
+	std::unordered_map<std::string,PropertyId>::const_iterator it=_ids.find(name);
+	if(it==_ids.end()) throw std::runtime_error("Property \""+name+"\" not found");
+	return it->second;
+}
+
+int SDMPropertyManager::intProperty(PropertyId id) const {
+	return typed(id,IntValue).intValue;
+}
+
+double SDMPropertyManager::doubleProperty(PropertyId id) const {
+	return typed(id,DoubleValue).doubleValue;
+}
+
+bool SDMPropertyManager::boolProperty(PropertyId id) const {
+	return typed(id,BoolValue).intValue!=0;
+}
+
+int SDMPropertyManager::enumProperty(PropertyId id) const {
+	return typed(id,EnumValue).intValue;
+}
+
+void SDMPropertyManager::setIntProperty(PropertyId id,int value) {
+	Property &prop=typed(id,IntValue);
+	std::ostringstream oss;
+	oss<<value;
+	prop.value=oss.str();
+	prop.intValue=value;
+	_revision++;
+	changed(id);
+}
+
+void SDMPropertyManager::setDoubleProperty(PropertyId id,double value) {
+	Property &prop=typed(id,DoubleValue);
+	prop.value=formatDouble(value);
+	prop.doubleValue=value;
+	_revision++;
+	changed(id);
+}
+
+void SDMPropertyManager::setBoolProperty(PropertyId id,bool value) {
+	Property &prop=typed(id,BoolValue);
+	prop.value=value?"true":"false";
+	prop.intValue=value?1:0;
+	_revision++;
+	changed(id);
+}
+
+void SDMPropertyManager::setEnumProperty(PropertyId id,int value) {
+	Property &prop=typed(id,EnumValue);
+	if(value<0||value>=static_cast<int>(prop.items.size()))
+		throw std::runtime_error("Bad value for property \""+prop.name+"\"");
+	prop.value=prop.items[value];
+	prop.intValue=value;
+	_revision++;
+	changed(id);
+}
+
+void SDMPropertyManager::onPropertyChanged(PropertyId id,const ChangeCallback &callback) {
+	if(id>=_props.size()) throw std::runtime_error("Bad property id");
+	_props[id].callbacks.push_back(callback);
+}
+
+void SDMPropertyManager::enableRevision() {
+	_revisionEnabled=true;
+}
+
+void SDMPropertyManager::touch() {
+	_revision++;
 }
 
 /*
  * Private members
  */
 
-void SDMPropertyManager::rebuildCache() const {
-	std::map<std::string,std::pair<std::string,Type> >::const_iterator it;
+// Redefining a property keeps its position, id and callbacks
+
+SDMPropertyManager::Property &SDMPropertyManager::define(const std::string &name,const std::string &value,Type type,ValueType valueType) {
+	std::unordered_map<std::string,PropertyId>::const_iterator it=_ids.find(name);
+	PropertyId id;
+	if(it==_ids.end()) {
+		id=_props.size();
+		_props.push_back(Property());
+		_props[id].name=name;
+		_ids[name]=id;
+	}
+	else id=it->second;
 	
+	Property &prop=_props[id];
+	prop.value=value;
+	prop.type=type;
+	prop.valueType=valueType;
+	prop.intValue=0;
+	prop.doubleValue=0;
+	prop.items.clear();
+	_dirty=true;
+	_revision++;
+	return prop;
+}
+
+SDMPropertyManager::Property &SDMPropertyManager::typed(PropertyId id,ValueType valueType) {
+	return const_cast<Property&>(static_cast<const SDMPropertyManager*>(this)->typed(id,valueType));
+}
+
+const SDMPropertyManager::Property &SDMPropertyManager::typed(PropertyId id,ValueType valueType) const {
+	if(id>=_props.size()) throw std::runtime_error("Bad property id");
+	const Property &prop=_props[id];
+	if(prop.valueType!=valueType) throw std::runtime_error("Property \""+prop.name+"\" type mismatch");
+	return prop;
+}
+
+// Converts the string to the native value. The property is not
+// modified if the value is invalid.
+
+void SDMPropertyManager::parseValue(Property &prop,const std::string &value) {
+	const std::string error="Bad value for property \""+prop.name+"\": \""+value+"\"";
+	switch(prop.valueType) {
+	case IntValue:
+		{
+			char *end;
+			errno=0;
+			long l=std::strtol(value.c_str(),&end,10);
+			if(value.empty()||*end!='\0'||errno==ERANGE||l<INT_MIN||l>INT_MAX) throw std::runtime_error(error);
+			prop.intValue=static_cast<int>(l);
+		}
+		break;
+	case DoubleValue:
+		{
+			char *end;
+			double d=std::strtod(value.c_str(),&end);
+			if(value.empty()||*end!='\0') throw std::runtime_error(error);
+			prop.doubleValue=d;
+		}
+		break;
+	case BoolValue:
+		if(value=="true"||value=="1") prop.intValue=1;
+		else if(value=="false"||value=="0") prop.intValue=0;
+		else throw std::runtime_error(error);
+		prop.value=prop.intValue?"true":"false";
+		return;
+	case EnumValue:
+		{
+			std::size_t i=0;
+			while(i<prop.items.size()&&prop.items[i]!=value) i++;
+			if(i==prop.items.size()) throw std::runtime_error(error);
+			prop.intValue=static_cast<int>(i);
+		}
+		break;
+	default:
+		break;
+	}
+	prop.value=value;
+}
+
+// Callbacks can modify other properties, but not define new ones
+
+void SDMPropertyManager::changed(PropertyId id) {
+	for(std::size_t i=0;i<_props[id].callbacks.size();i++) _props[id].callbacks[i](id);
+}
+
+void SDMPropertyManager::rebuildCache() const {
 	_cacheAll.clear();
 	_cacheReadOnly.clear();
 	_cacheWritable.clear();
-	for(std::size_t i=0;i<_listall.size();i++) {
-		it=_props.find(_listall[i]);
-		if(it==_props.end()) continue;
-		
-		const std::string &listItem=formatListItem(_listall[i]);
+	for(std::size_t i=0;i<_props.size();i++) {
+		const std::string &listItem=formatListItem(_props[i].name);
 		
 		if(!_cacheAll.empty()) _cacheAll.push_back(',');
 		_cacheAll+=listItem;
 		
-		if(it->second.second!=Normal) {
+		if(_props[i].type!=Normal) {
 			if(!_cacheReadOnly.empty()) _cacheReadOnly.push_back(',');
 			_cacheReadOnly+=listItem;
 		}
@@ -26,15 +26,44 @@
  */
 
 #include "sdmprovider.h"
+#include "sdmconvert.h"
 
 #include <climits>
+#include <algorithm>
+#include <chrono>
+
+namespace {
+	sdm_uint64_t monotonicTime() {
+		return static_cast<sdm_uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>
+			(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+}
+
+/*
+ * SDMAbstractPlugin members
+ */
+
+int SDMAbstractPlugin::getCapabilities(sdm_capabilities_t *caps) {
+// Don't advertise generic defaults: the client has faster fallbacks
+	caps->features=_features|SDM_FEATURE_BATCHPROPS|SDM_FEATURE_LASTERROR;
+	caps->formats=1<<SDM_SAMPLE_DOUBLE;
+	caps->threadSafety=SDM_THREADSAFE_NONE;
+	return 0;
+}
 
 /*
  * SDMAbstractChannel members
  */
 
+SDMAbstractChannel::SDMAbstractChannel():
+	_nextToken(0),
+	_burstLength(0),
+	_burstBoundary(0),
+	_burstFlags(0) {}
+
 int SDMAbstractChannel::writeFIFO(sdm_addr_t addr,const sdm_reg_t *data,std::size_t n,int) {
 	if(n>INT_MAX) n=INT_MAX;
+	if(burstsEnabled(false)) return transferBursts(addr,data,NULL,n,false)?SDM_ERROR:static_cast<int>(n);
 	for(std::size_t i=0;i<n;i++) {
 		int r=writeReg(addr,data[i]);
 		if(r) return SDM_ERROR;
@@ -46,6 +75,7 @@ int SDMAbstractChannel::writeFIFO(sdm_addr_t addr,const sdm_reg_t *data,std::siz
 
 int SDMAbstractChannel::readFIFO(sdm_addr_t addr,sdm_reg_t *data,std::size_t n,int) {
 	if(n>INT_MAX) n=INT_MAX;
+	if(burstsEnabled(false)) return transferBursts(addr,NULL,data,n,false)?SDM_ERROR:static_cast<int>(n);
 	for(std::size_t i=0;i<n;i++) {
 		int status;
 		data[i]=readReg(addr,&status);
@@ -57,6 +87,7 @@ int SDMAbstractChannel::readFIFO(sdm_addr_t addr,sdm_reg_t *data,std::size_t n,i
 }
 
 int SDMAbstractChannel::writeMem(sdm_addr_t addr,const sdm_reg_t *data,std::size_t n) {
+	if(burstsEnabled(true)) return transferBursts(addr,data,NULL,n,true);
 	for(std::size_t i=0;i<n;i++) {
 		int r=writeReg(addr++,data[i]);
 		if(r) return SDM_ERROR;
@@ -65,6 +96,7 @@ int SDMAbstractChannel::writeMem(sdm_addr_t addr,const sdm_reg_t *data,std::size
 }
 
 int SDMAbstractChannel::readMem(sdm_addr_t addr,sdm_reg_t *data,std::size_t n) {
+	if(burstsEnabled(true)) return transferBursts(addr,NULL,data,n,true);
 	int status;
 	for(std::size_t i=0;i<n;i++) {
 		data[i]=readReg(addr++,&status);
@@ -73,12 +105,286 @@ int SDMAbstractChannel::readMem(sdm_addr_t addr,sdm_reg_t *data,std::size_t n) {
 	return 0;
 }
 
+int SDMAbstractChannel::writeRegs(const sdm_addr_t *addr,const sdm_reg_t *data,std::size_t n) {
+	for(std::size_t i=0;i<n;i++) {
+		int r=writeReg(addr[i],data[i]);
+		if(r) return SDM_ERROR;
+	}
+	return 0;
+}
+
+int SDMAbstractChannel::readRegs(const sdm_addr_t *addr,sdm_reg_t *data,std::size_t n) {
+	int status;
+	for(std::size_t i=0;i<n;i++) {
+		data[i]=readReg(addr[i],&status);
+		if(status) return SDM_ERROR;
+	}
+	return 0;
+}
+
+int SDMAbstractChannel::submitWriteReg(sdm_addr_t addr,sdm_reg_t data) {
+	TransactionResult res;
+	res.status=writeReg(addr,data)?SDM_ERROR:0;
+	res.data=0;
+	int token=allocateToken();
+	_transactions[token]=res;
+	return token;
+}
+
+int SDMAbstractChannel::submitReadReg(sdm_addr_t addr) {
+	TransactionResult res;
+	int status;
+	res.data=readReg(addr,&status);
+	res.status=status?SDM_ERROR:0;
+	int token=allocateToken();
+	_transactions[token]=res;
+	return token;
+}
+
+int SDMAbstractChannel::completeTransaction(int token,sdm_reg_t *data,int) {
+	std::map<int,TransactionResult>::iterator it=_transactions.find(token);
+	if(it==_transactions.end()) return SDM_ERROR;
+	int status=it->second.status;
+	if(data) *data=it->second.data;
+	_transactions.erase(it);
+	return status;
+}
+
+int SDMAbstractChannel::writeReg64(sdm_addr64_t addr,sdm_reg64_t data) {
+	if(addr>0xFFFFFFFF||data>0xFFFFFFFF) return SDM_NOTSUPPORTED;
+	return writeReg(static_cast<sdm_addr_t>(addr),static_cast<sdm_reg_t>(data));
+}
+
+sdm_reg64_t SDMAbstractChannel::readReg64(sdm_addr64_t addr,int *status) {
+	if(addr>0xFFFFFFFF) {
+		if(status) *status=SDM_NOTSUPPORTED;
+		return 0;
+	}
+	return readReg(static_cast<sdm_addr_t>(addr),status);
+}
+
+int SDMAbstractChannel::writeFIFO64(sdm_addr64_t addr,const sdm_reg64_t *data,std::size_t n,int) {
+	if(n>INT_MAX) n=INT_MAX;
+	for(std::size_t i=0;i<n;i++) {
+		int r=writeReg64(addr,data[i]);
+		if(r) return (r==SDM_NOTSUPPORTED)?r:SDM_ERROR;
+	}
+	return static_cast<int>(n);
+}
+
+int SDMAbstractChannel::readFIFO64(sdm_addr64_t addr,sdm_reg64_t *data,std::size_t n,int) {
+	if(n>INT_MAX) n=INT_MAX;
+	for(std::size_t i=0;i<n;i++) {
+		int status=0;
+		data[i]=readReg64(addr,&status);
+		if(status) return (status==SDM_NOTSUPPORTED)?status:SDM_ERROR;
+	}
+	return static_cast<int>(n);
+}
+
+int SDMAbstractChannel::writeMem64(sdm_addr64_t addr,const sdm_reg64_t *data,std::size_t n) {
+	for(std::size_t i=0;i<n;i++) {
+		int r=writeReg64(addr++,data[i]);
+		if(r) return (r==SDM_NOTSUPPORTED)?r:SDM_ERROR;
+	}
+	return 0;
+}
+
+int SDMAbstractChannel::readMem64(sdm_addr64_t addr,sdm_reg64_t *data,std::size_t n) {
+	for(std::size_t i=0;i<n;i++) {
+		int status=0;
+		data[i]=readReg64(addr++,&status);
+		if(status) return (status==SDM_NOTSUPPORTED)?status:SDM_ERROR;
+	}
+	return 0;
+}
+
+int SDMAbstractChannel::modifyReg(sdm_addr_t addr,sdm_reg_t mask,sdm_reg_t data) {
+	int status;
+	sdm_reg_t value=readReg(addr,&status);
+	if(status) return SDM_ERROR;
+	value=(value&~mask)|(data&mask);
+	return writeReg(addr,value)?SDM_ERROR:0;
+}
+
+int SDMAbstractChannel::modifyRegs(const sdm_addr_t *addr,const sdm_reg_t *mask,const sdm_reg_t *data,std::size_t n) {
+	if(n==0) return 0;
+	
+	std::vector<sdm_reg_t> values(n);
+	int r=readRegs(addr,values.data(),n);
+	if(r) return SDM_ERROR;
+	
+// Modifications to the same address are applied in order, each
+// address is written once
+	std::map<sdm_addr_t,std::size_t> first;
+	std::vector<sdm_addr_t> outAddr;
+	std::vector<sdm_reg_t> outData;
+	for(std::size_t i=0;i<n;i++) {
+		auto it=first.find(addr[i]);
+		if(it==first.end()) {
+			first.emplace(addr[i],outAddr.size());
+			outAddr.push_back(addr[i]);
+			outData.push_back((values[i]&~mask[i])|(data[i]&mask[i]));
+		}
+		else {
+			auto &value=outData[it->second];
+			value=(value&~mask[i])|(data[i]&mask[i]);
+		}
+	}
+	return writeRegs(outAddr.data(),outData.data(),outAddr.size())?SDM_ERROR:0;
+}
+
+// Tokens are non-negative and wrap around after INT_MAX
+int SDMAbstractChannel::allocateToken() {
+	int token=_nextToken;
+	if(_nextToken==INT_MAX) _nextToken=0;
+	else _nextToken++;
+	return token;
+}
+
+void SDMAbstractChannel::setBurstCapabilities(std::size_t maxLength,std::size_t boundary,int flags) {
+	_burstLength=maxLength;
+	_burstBoundary=boundary;
+	_burstFlags=flags;
+}
+
+// Bursts share the token space with register transactions
+
+int SDMAbstractChannel::submitWriteBurst(sdm_addr_t addr,const sdm_reg_t *data,std::size_t n,bool increment) {
+	TransactionResult res;
+	res.status=writeBurst(addr,data,n,increment)?SDM_ERROR:0;
+	res.data=0;
+	int token=allocateToken();
+	_transactions[token]=res;
+	return token;
+}
+
+int SDMAbstractChannel::submitReadBurst(sdm_addr_t addr,sdm_reg_t *data,std::size_t n,bool increment) {
+	TransactionResult res;
+	res.status=readBurst(addr,data,n,increment)?SDM_ERROR:0;
+	res.data=0;
+	int token=allocateToken();
+	_transactions[token]=res;
+	return token;
+}
+
+int SDMAbstractChannel::completeBurst(int token) {
+	std::map<int,TransactionResult>::iterator it=_transactions.find(token);
+	if(it==_transactions.end()) return SDM_ERROR;
+	int status=it->second.status;
+	_transactions.erase(it);
+	return status;
+}
+
+bool SDMAbstractChannel::burstsEnabled(bool increment) const {
+	if(_burstLength==0) return false;
+	return (_burstFlags&(increment?BurstMemory:BurstFIFO))!=0;
+}
+
+// Splits the transfer into bursts. "wdata" is set for writes, "rdata"
+// for reads. Pipelined bursts are double-buffered: the next burst is
+// submitted before waiting for the previous one.
+
+int SDMAbstractChannel::transferBursts(sdm_addr_t addr,const sdm_reg_t *wdata,sdm_reg_t *rdata,std::size_t n,bool increment) {
+	const bool pipelined=(_burstFlags&BurstPipelined)!=0;
+	int pending=-1;
+	int status=0;
+	
+	while(n>0) {
+		std::size_t len=std::min(n,_burstLength);
+		if(increment&&_burstBoundary>0) len=std::min<std::size_t>(len,_burstBoundary-addr%_burstBoundary);
+		
+		if(!pipelined) {
+			int r=wdata?writeBurst(addr,wdata,len,increment):readBurst(addr,rdata,len,increment);
+			if(r) return SDM_ERROR;
+		}
+		else {
+			int token=wdata?submitWriteBurst(addr,wdata,len,increment):submitReadBurst(addr,rdata,len,increment);
+			if(token<0) status=SDM_ERROR;
+			if(pending>=0&&completeBurst(pending)) status=SDM_ERROR;
+			pending=token;
+			if(status) break;
+		}
+		
+		if(increment) addr+=static_cast<sdm_addr_t>(len);
+		if(wdata) wdata+=len;
+		else rdata+=len;
+		n-=len;
+	}
+	
+	if(pending>=0&&completeBurst(pending)) status=SDM_ERROR;
+	return status;
+}
+
+/*
+ * SDMAbstractSource members
+ */
+
+SDMAbstractSource::SDMAbstractSource():
+	_readyEnabled(false),
+	_readyCallback(NULL),
+	_readyContext(NULL) {}
+
+int SDMAbstractSource::setReadyCallback(sdm_ready_callback_t callback,void *context) {
+	if(!_readyEnabled) return SDM_NOTSUPPORTED;
+	_readyCallback=callback;
+	_readyContext=context;
+	return 0;
+}
+
+void SDMAbstractSource::notifyReady() {
+	if(_readyCallback) _readyCallback(_readyContext);
+}
+
+int SDMAbstractSource::readStreamTyped(int stream,void *data,std::size_t n,int format,int nb) {
+	if(format==SDM_SAMPLE_DOUBLE) return readStream(stream,static_cast<sdm_sample_t*>(data),n,nb);
+	if(format<SDM_SAMPLE_FLOAT||format>SDM_SAMPLE_INT32) return SDM_ERROR;
+	
+	if(_typedBuf.size()<n) _typedBuf.resize(n);
+	int r=readStream(stream,n?&_typedBuf[0]:NULL,n,nb);
+	if(r<=0) return r;
+	
+	std::size_t samples=static_cast<std::size_t>(r);
+	sdmConvertSamples(&_typedBuf[0],data,samples,format);
+	return r;
+}
+
+int SDMAbstractSource::readStreams(const int *streams,sdm_sample_t * const *data,const std::size_t *n,int *res,std::size_t count,int nb) {
+	for(std::size_t i=0;i<count;i++) res[i]=readStream(streams[i],data[i],n[i],nb);
+	return 0;
+}
+
+int SDMAbstractSource::acquirePacket(int stream,const sdm_sample_t **data,std::size_t *n,int nb) {
+	static const std::size_t Chunk=16384;
+	AcquireBuffer &buf=_acquireBufs[stream];
+// Read until the end of packet, keeping partial data on WOULDBLOCK
+	for(;;) {
+		if(buf.data.size()<buf.size+Chunk) buf.data.resize(buf.size+Chunk);
+		int r=readStream(stream,buf.data.data()+buf.size,Chunk,nb);
+		if(r<0) return r;
+		if(r==0) break;
+		buf.size+=r;
+	}
+	*data=buf.data.data();
+	*n=buf.size;
+	return 0;
+}
+
+int SDMAbstractSource::releasePacket(int stream) {
+	std::map<int,AcquireBuffer>::iterator it=_acquireBufs.find(stream);
+	if(it!=_acquireBufs.end()) it->second.size=0;
+	return 0;
+}
+
 /*
  * SDMAbstractQueuedSource members
  */
 
 SDMAbstractQueuedSource::SDMAbstractQueuedSource():
-	_errors(0) {}
+	_errors(0),
+	_sequence(0),
+	_arrival(0),
+	_gap(false) {}
 
 int SDMAbstractQueuedSource::selectReadStreams(const int *streams,std::size_t n,std::size_t packets,int df) {
 	_pos.clear();
@@ -99,7 +405,7 @@ int SDMAbstractQueuedSource::readStream(int stream,sdm_sample_t *data,std::size_
 // Process data from the queue
 	bool eop=false;
 	std::size_t loaded=getSamplesFromQueue(stream,currentPos,data,n,eop);
-	if(isError()) _errors++;
+	checkContinuity();
 	currentPos+=loaded;
 	
 	for(;;) {
@@ -113,7 +419,7 @@ int SDMAbstractQueuedSource::readStream(int stream,sdm_sample_t *data,std::size_
 // Put new samples to the buffer
 		if(loaded<n&&!eop) {
 			std::size_t r=getSamplesFromQueue(stream,currentPos,data+loaded,n-loaded,eop);
-			if(isError()) _errors++;
+			checkContinuity();
 			currentPos+=r;
 			loaded+=r;
 		}
@@ -124,12 +430,19 @@ int SDMAbstractQueuedSource::readStream(int stream,sdm_sample_t *data,std::size_
 	}
 	
 	if(nb!=0&&loaded==0&&!eop) return SDM_WOULDBLOCK;
+	if(loaded>0&&_arrival==0) _arrival=monotonicTime();
+// The buffer was filled up, so there can be more data in the queue
+	if(loaded==n) notifyReady();
 	return static_cast<int>(loaded);
 }
 
 int SDMAbstractQueuedSource::readNextPacket() {
 	next();
 	for(std::map<int,std::size_t>::iterator it=_pos.begin();it!=_pos.end();++it) it->second=0;
+	_sequence++;
+	_arrival=0;
+	_gap=false;
+	notifyReady(); // the next packet may be already in the queue
 	return 0;
 }
 
@@ -137,8 +450,30 @@ void SDMAbstractQueuedSource::discardPackets() {
 	clear();
 	for(std::map<int,std::size_t>::iterator it=_pos.begin();it!=_pos.end();++it) it->second=0;
 	_errors=0;
+	_sequence=0;
+	_arrival=0;
+	_gap=false;
+}
+
+// Lost data are accounted for once per packet, even if
+// the discontinuity is reported for several streams
+
+void SDMAbstractQueuedSource::checkContinuity() {
+	if(!isError()) return;
+	_errors++;
+	if(!_gap) _sequence++;
+	_gap=true;
 }
 
 int SDMAbstractQueuedSource::readStreamErrors() {
 	return _errors;
 }
+
+int SDMAbstractQueuedSource::packetInfo(sdm_packet_info_t *info) {
+	info->flags=SDM_PACKETINFO_SEQUENCE;
+	info->sequence=_sequence;
+	info->timestamp=0;
+	info->arrival=_arrival;
+	if(_arrival!=0) info->flags|=SDM_PACKETINFO_ARRIVAL;
+	return 0;
+}
@@ -0,0 +1,280 @@
+/*
+ * Copyright (c) 2015-2022 Simple Device Model contributors
+ * 
+ * This file is part of the Simple Device Model (SDM) framework SDK.
+ * 
+ * Permission is hereby granted, free of charge, to any person obtaining
+ * a copy of this software and associated documentation files (the "Software"),
+ * to deal in the Software without restriction, including without limitation
+ * the rights to use, copy, modify, merge, publish, distribute, sublicense,
+ * and/or sell copies of the Software, and to permit persons to whom
+ * the Software is furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included
+ * in all copies or substantial portions of the Software.
+ * 
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+ * OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+ * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS
+ * IN THE SOFTWARE.
+ *
+ * This module provides an implementation of the SDMRingBufferSource
+ * class.
+ */
+
+#include "sdmringbuffer.h"
+
+#include <algorithm>
+#include <chrono>
+
+namespace {
+	sdm_uint64_t monotonicTime() {
+		return static_cast<sdm_uint64_t>(std::chrono::duration_cast<std::chrono::microseconds>
+			(std::chrono::steady_clock::now().time_since_epoch()).count());
+	}
+}
+
+/*
+ * SDMRingBufferSource::Packet members
+ */
+
+SDMRingBufferSource::Packet::Packet():
+	_streams(NULL),
+	_sequence(0),
+	_timestamp(0),
+	_hasTimestamp(false) {}
+
+void SDMRingBufferSource::Packet::setTimestamp(sdm_uint64_t timestamp) {
+	_timestamp=timestamp;
+	_hasTimestamp=true;
+}
+
+// Buffers are cleared without releasing memory
+
+void SDMRingBufferSource::Packet::reset() {
+	for(std::size_t i=0;i<_data.size();i++) _data[i].clear();
+	_timestamp=0;
+	_hasTimestamp=false;
+}
+
+/*
+ * SDMRingBufferSource members
+ */
+
+SDMRingBufferSource::SDMRingBufferSource(std::size_t ringPackets,std::size_t packetSize):
+	_slots(std::max<std::size_t>(ringPackets,1)),
+	_packetSize(packetSize),
+	_df(1),
+	_produced(0),
+	_head(0),
+	_tail(0),
+	_overflows(0),
+	_stop(false),
+	_failed(false),
+	_arrival(0)
+{
+	enableReadyNotification();
+}
+
+SDMRingBufferSource::~SDMRingBufferSource() {
+	stopAcquisition();
+}
+
+int SDMRingBufferSource::close() {
+	stopAcquisition();
+	delete this;
+	return 0;
+}
+
+int SDMRingBufferSource::selectReadStreams(const int *streams,std::size_t n,std::size_t packets,int df) {
+	stopAcquisition();
+	
+	int maxStream=-1;
+	for(std::size_t i=0;i<n;i++) {
+		if(streams[i]<0) return SDM_ERROR;
+		maxStream=std::max(maxStream,streams[i]);
+	}
+	
+	_streams.assign(streams,streams+n);
+	_index.assign(static_cast<std::size_t>(maxStream+1),-1);
+	for(std::size_t i=0;i<n;i++) _index[streams[i]]=static_cast<int>(i);
+	_pos.assign(n,0);
+	_df=df;
+	
+// Preallocate packet buffers
+	for(std::size_t i=0;i<=_slots.size();i++) {
+		Packet &packet=(i<_slots.size())?_slots[i]:_scratch;
+		packet._streams=&_streams;
+		packet._data.resize(n);
+		for(std::size_t j=0;j<n;j++) packet._data[j].reserve(_packetSize);
+		packet.reset();
+	}
+	
+	_head.store(0);
+	_tail.store(0);
+	_overflows.store(0);
+	_failed.store(false);
+	_produced=0;
+	_arrival=0;
+	
+	if(n==0) return 0;
+	_stop.store(false);
+	_thread=std::thread(&SDMRingBufferSource::run,this);
+	return 0;
+}
+
+int SDMRingBufferSource::readStream(int stream,sdm_sample_t *data,std::size_t n,int nb) {
+	if(n==0) return 0;
+	if(stream<0||stream>=static_cast<int>(_index.size())||_index[stream]<0) return SDM_ERROR;
+	
+	int status;
+	const Packet *packet=currentPacket(nb,status);
+	if(!packet) return status;
+	
+	const std::size_t i=static_cast<std::size_t>(_index[stream]);
+	const std::vector<sdm_sample_t> &v=packet->_data[i];
+	std::size_t &pos=_pos[i];
+	if(pos>=v.size()) return 0; // end of packet
+	
+	const std::size_t toread=std::min(n,v.size()-pos);
+	std::copy(v.begin()+pos,v.begin()+pos+toread,data);
+	pos+=toread;
+	if(_arrival==0) _arrival=monotonicTime();
+// There are more data in the current packet
+	if(toread==n) notifyReady();
+	return static_cast<int>(toread);
+}
+
+int SDMRingBufferSource::readNextPacket() {
+	const std::size_t tail=_tail.load(std::memory_order_relaxed);
+	if(_head.load(std::memory_order_acquire)!=tail) _tail.store(tail+1,std::memory_order_release);
+	std::fill(_pos.begin(),_pos.end(),0);
+	_arrival=0;
+	if(available()>0) notifyReady();
+	return 0;
+}
+
+// The consumer owns the tail, so the ring can be emptied without
+// stopping the acquisition thread
+
+void SDMRingBufferSource::discardPackets() {
+	_tail.store(_head.load(std::memory_order_acquire),std::memory_order_release);
+	std::fill(_pos.begin(),_pos.end(),0);
+	_overflows.store(0);
+	_arrival=0;
+}
+
+int SDMRingBufferSource::readStreamErrors() {
+	return _overflows.load();
+}
+
+// The sequence number is only known when the current packet is in the ring
+
+int SDMRingBufferSource::packetInfo(sdm_packet_info_t *info) {
+	info->flags=0;
+	info->sequence=0;
+	info->timestamp=0;
+	info->arrival=_arrival;
+	if(_arrival!=0) info->flags|=SDM_PACKETINFO_ARRIVAL;
+	if(available()>0) {
+		const Packet &packet=_slots[_tail.load(std::memory_order_relaxed)%_slots.size()];
+		info->sequence=packet._sequence;
+		info->flags|=SDM_PACKETINFO_SEQUENCE;
+		if(packet._hasTimestamp) {
+			info->timestamp=packet._timestamp;
+			info->flags|=SDM_PACKETINFO_TIMESTAMP;
+		}
+	}
+	return 0;
+}
+
+// The packet stays in the ring until readNextPacket() is called, so
+// it can be lent to the client without copying
+
+int SDMRingBufferSource::acquirePacket(int stream,const sdm_sample_t **data,std::size_t *n,int nb) {
+	if(stream<0||stream>=static_cast<int>(_index.size())||_index[stream]<0) return SDM_ERROR;
+	
+	int status;
+	const Packet *packet=currentPacket(nb,status);
+	if(!packet) return status;
+	
+	const std::size_t i=static_cast<std::size_t>(_index[stream]);
+	const std::vector<sdm_sample_t> &v=packet->_data[i];
+	*data=v.empty()?NULL:&v[0];
+	*n=v.size();
+	_pos[i]=v.size(); // packet is consumed
+	if(_arrival==0) _arrival=monotonicTime();
+	return 0;
+}
+
+int SDMRingBufferSource::releasePacket(int stream) {
+	if(stream<0||stream>=static_cast<int>(_index.size())||_index[stream]<0) return SDM_ERROR;
+	return 0;
+}
+
+std::size_t SDMRingBufferSource::available() const {
+	return _head.load(std::memory_order_acquire)-_tail.load(std::memory_order_acquire);
+}
+
+void SDMRingBufferSource::stopAcquisition() {
+	if(!_thread.joinable()) return;
+	_stop.store(true);
+	_thread.join();
+}
+
+void SDMRingBufferSource::run() {
+	try {
+		while(!_stop.load()) {
+			const std::size_t head=_head.load(std::memory_order_relaxed);
+			const bool full=(head-_tail.load(std::memory_order_acquire)==_slots.size());
+			Packet &packet=full?_scratch:_slots[head%_slots.size()];
+			packet.reset();
+			if(!produce(packet)) continue;
+			packet._sequence=_produced++;
+			if(full) _overflows++;
+			else {
+				_head.store(head+1,std::memory_order_release);
+				notifyConsumer();
+				notifyReady();
+			}
+		}
+	}
+	catch(...) {
+		_failed.store(true);
+		notifyConsumer();
+		notifyReady();
+	}
+}
+
+void SDMRingBufferSource::notifyConsumer() {
+// Locking the mutex prevents a lost wakeup between the consumer's
+// check and wait
+	std::lock_guard<std::mutex> lock(_waitMutex);
+	_waitCv.notify_all();
+}
+
+// Returns the packet at the ring tail, waiting for it unless "nb" is
+// set. Packets acquired before a failure are still returned.
+
+const SDMRingBufferSource::Packet *SDMRingBufferSource::currentPacket(int nb,int &status) {
+	const std::size_t tail=_tail.load(std::memory_order_relaxed);
+	while(_head.load(std::memory_order_acquire)==tail) {
+		if(_failed.load()||!_thread.joinable()) {
+			status=SDM_ERROR;
+			return NULL;
+		}
+		if(nb) {
+			status=SDM_WOULDBLOCK;
+			return NULL;
+		}
+		std::unique_lock<std::mutex> lock(_waitMutex);
+		_waitCv.wait_for(lock,std::chrono::milliseconds(100),[&]{
+			return _head.load(std::memory_order_acquire)!=tail||_failed.load();
+		});
+	}
+	status=0;
+	return &_slots[tail%_slots.size()];
+}
@@ -30,11 +30,20 @@
 #define SDMPLUG_H_INCLUDED
 
 #include "sdmtypes.h"
+#include "sdmtrace.h"
 #include "safeflags.h"
 
 #include <string>
 #include <vector>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <atomic>
+#include <thread>
+#include <condition_variable>
+#include <exception>
+#include <cstdint>
+#include <chrono>
 
 class SDMPluginImpl;
 class SDMDeviceImpl;
@@ -76,32 +85,192 @@ struct SDMImport {
 	PtrSdmDiscardPackets ptrDiscardPackets;
 	PtrSdmReadStreamErrors ptrReadStreamErrors;
 	
+// Optional functions (null if not exported by the plugin)
+	PtrSdmWriteRegs ptrWriteRegs;
+	PtrSdmReadRegs ptrReadRegs;
+	PtrSdmSubmitWriteReg ptrSubmitWriteReg;
+	PtrSdmSubmitReadReg ptrSubmitReadReg;
+	PtrSdmCompleteTransaction ptrCompleteTransaction;
+	PtrSdmGetStreamFormat ptrGetStreamFormat;
+	PtrSdmReadStreamTyped ptrReadStreamTyped;
+	PtrSdmAcquirePacket ptrAcquirePacket;
+	PtrSdmReleasePacket ptrReleasePacket;
+	PtrSdmSetReadyCallback ptrSetReadyCallback;
+	PtrSdmReadStreams ptrReadStreams;
+	PtrSdmGetPacketInfo ptrGetPacketInfo;
+	PtrSdmGetPluginProperties ptrGetPluginProperties;
+	PtrSdmGetDeviceProperties ptrGetDeviceProperties;
+	PtrSdmGetChannelProperties ptrGetChannelProperties;
+	PtrSdmGetSourceProperties ptrGetSourceProperties;
+	PtrSdmWriteReg64 ptrWriteReg64;
+	PtrSdmReadReg64 ptrReadReg64;
+	PtrSdmWriteFIFO64 ptrWriteFIFO64;
+	PtrSdmReadFIFO64 ptrReadFIFO64;
+	PtrSdmWriteMem64 ptrWriteMem64;
+	PtrSdmReadMem64 ptrReadMem64;
+	PtrSdmModifyReg ptrModifyReg;
+	PtrSdmModifyRegs ptrModifyRegs;
+	PtrSdmGetLastError ptrGetLastError;
+	
 	bool supportChannels;
 	bool supportSources;
+	
+// Capabilities reported by the plugin (or detected if it doesn't export sdmGetCapabilities)
+	sdm_capabilities_t caps;
+	
+// Retrieves (and clears) the plugin error message for the calling thread
+	std::string lastError() const;
 };
 
+// If the plugin import table is passed, the plugin error message
+// (see sdmGetLastError()) is appended to the exception text
+
 class sdmplugin_error : public std::exception {
 	std::string message;
+	std::string detail;
 	int code=0;
 public:
 	explicit sdmplugin_error(): message("SDM plugin returned an error") {}
 	explicit sdmplugin_error(const std::string &strFuncName);
 	explicit sdmplugin_error(const std::string &strFuncName, int iErrorCode);
+	sdmplugin_error(const std::string &strFuncName, const SDMImport &pf);
+	sdmplugin_error(const std::string &strFuncName, int iErrorCode, const SDMImport &pf);
 	virtual ~sdmplugin_error() throw() {}
 	
 	virtual const char *what() const throw() {return message.c_str();}
 	int errorCode() const {return code;}
+	const std::string &details() const {return detail;}
+};
+
+// Optional per-call statistics for plugin functions. When enabled
+// (with setEnabled() or by setting the SDM_STATS environment variable
+// to a non-zero value), SDMPlug records the number of calls, bytes
+// transferred and call latencies for each object and plugin function.
+// Latency histogram buckets cover powers of two in nanoseconds, each
+// split into 4 linear sub-buckets (HDR-style, the relative error is
+// below 25%). When disabled, the overhead is one atomic load per call.
+
+class SDMStats {
+public:
+	static const int Buckets=256;
+	
+	struct Record {
+		std::string object;
+		std::string function;
+		std::uint64_t calls=0;
+		std::uint64_t bytes=0;
+		std::uint64_t totalNs=0;
+		std::uint64_t minNs=0;
+		std::uint64_t maxNs=0;
+		std::vector<std::uint64_t> histogram;
+		
+		std::uint64_t percentile(double p) const;
+	};
+	
+// Measures one plugin call, the result is recorded by finish() or
+// by the destructor, whichever comes first
+	class Call {
+		const void *_object;
+		const char *_function;
+		std::chrono::steady_clock::time_point _start;
+		bool _active;
+	public:
+		Call(const void *object,const char *function);
+		Call(const Call &)=delete;
+		~Call() {finish();}
+		
+		Call &operator=(const Call &)=delete;
+		
+		void finish(std::uint64_t bytes=0) {
+			if(_active) record(bytes);
+		}
+	private:
+		void record(std::uint64_t bytes);
+	};
+	
+	static void setEnabled(bool enable);
+	static bool enabled();
+	static void reset();
+	
+	static void setObjectName(const void *object,const std::string &name);
+	static std::string objectName(const void *object);
+	
+	static std::vector<Record> records();
+	static std::string toJSON();
+	static std::string toCSV();
+	
+	static int bucket(std::uint64_t ns);
+	static std::uint64_t bucketLowerBound(int i);
 };
 
+// Optional recording of plugin calls to a trace file (the format is
+// defined in sdmtrace.h). Recording is started with start() or by
+// setting the SDM_TRACE environment variable to the file name. Objects
+// are tracked even when not recording, so that a trace started in the
+// middle of a session begins with records for objects already opened.
+
+class SDMTrace {
+public:
+	static void start(const std::string &path);
+	static void stop();
+	static bool active();
+	
+	static void openObject(const void *object,const void *parent,std::uint32_t type,int index,const std::string &name=std::string());
+	static void closeObject(const void *object);
+	
+	static void record(const void *object,std::uint32_t type,std::uint64_t arg,int status,const void *payload=nullptr,std::size_t size=0);
+	static void recordProperty(const void *object,std::uint32_t type,const char *name,const char *value,int status);
+	static void recordProperties(const void *object,const char *buf,int status);
+	static void recordRegs(const void *object,std::uint32_t type,const sdm_addr_t *addr,const sdm_reg_t *data,std::size_t n,int status);
+	static void recordSamples(const void *object,int stream,const void *data,int format,int status);
+};
+
+// Property values can be cached on the host side if the object reports
+// a "*revision" pseudo-property. The cache is validated against it
+// at most once per validation interval (100 ms by default, zero means
+// on every access); setProperty() invalidates it immediately. The cache
+// is disabled by default.
+
+// SDMPlug doesn't serialize plugin calls by itself (except for channel
+// methods, see below). Multithreaded clients should hold the mutex
+// returned by mutex() while calling object methods. Objects share mutexes according to the thread safety
+// level declared by the plugin: with SDM_THREADSAFE_NONE all objects
+// of the plugin share one mutex, with SDM_THREADSAFE_DEVICE channels
+// and sources use the mutex of their device, otherwise each object has
+// its own mutex.
+
 class SDMBase {
+public:
+	typedef std::recursive_timed_mutex mutex_t;
+private:
+	bool _cacheEnabled=false;
+	std::string _cacheRevision;
+	std::chrono::steady_clock::time_point _cacheValidated;
+	std::chrono::steady_clock::duration _cacheInterval=std::chrono::milliseconds(100);
+	std::map<std::string,std::string> _cacheValues;
+	std::map<std::string,std::vector<std::string> > _cacheLists;
 protected:
 	virtual int getPropertyAPI(const char *name,char *buf,std::size_t n)=0;
 	virtual int setPropertyAPI(const char *name,const char *value)=0;
+	virtual int getPropertiesAPI(const char *names,char *buf,std::size_t n) {return SDM_NOTSUPPORTED;}
+	virtual std::string lastErrorAPI() {return std::string();}
 public:
 	std::string getProperty(const std::string &name);
 	std::string getProperty(const std::string &name,const std::string &defaultValue);
+	std::map<std::string,std::string> getProperties(const std::vector<std::string> &names);
 	std::vector<std::string> listProperties(const std::string &name);
 	void setProperty(const std::string &name,const std::string &value);
+	
+	bool enablePropertyCache(bool enable=true);
+	bool propertyCacheEnabled() const {return _cacheEnabled;}
+	void setPropertyCacheInterval(std::chrono::steady_clock::duration interval) {_cacheInterval=interval;}
+	
+	virtual std::shared_ptr<mutex_t> mutex() const=0;
+private:
+	std::string fetchProperty(const std::string &name);
+	void fetchProperties(const std::vector<std::string> &names,std::map<std::string,std::string> &values);
+	bool validateCache();
+	void clearCache();
 };
 
 // Main class to work with an SDM plugin
@@ -115,6 +284,8 @@ class SDMPlugin : virtual public SDMBase {
 
 	virtual int getPropertyAPI(const char *name,char *buf,std::size_t n) override;
 	virtual int setPropertyAPI(const char *name,const char *value) override;
+	virtual int getPropertiesAPI(const char *names,char *buf,std::size_t n) override;
+	virtual std::string lastErrorAPI() override;
 	
 public:
 	SDMPlugin() {}
@@ -127,6 +298,8 @@ public:
 	virtual void close();
 	
 	const SDMImport &functions() const;
+	const sdm_capabilities_t &capabilities() const;
+	virtual std::shared_ptr<mutex_t> mutex() const override;
 	
 	operator bool() const;
 	std::string path() const;
@@ -142,6 +315,8 @@ class SDMDevice : virtual public SDMBase {
 	
 	virtual int getPropertyAPI(const char *name,char *buf,std::size_t n) override;
 	virtual int setPropertyAPI(const char *name,const char *value) override;
+	virtual int getPropertiesAPI(const char *names,char *buf,std::size_t n) override;
+	virtual std::string lastErrorAPI() override;
 public:
 	SDMDevice() {}
 	SDMDevice(const SDMPlugin &pl,int iDev);
@@ -158,13 +333,46 @@ public:
 	virtual void disconnect();
 	virtual bool isConnected();
 	
+	virtual std::shared_ptr<mutex_t> mutex() const override;
+	
 	operator bool() const;
 	int id() const;
 };
 
 // Control channel class
 
+// The channel can keep shadow copies of register values to avoid
+// hardware round trips. The cache is off by default. When enabled,
+// each address has a policy: Cacheable registers are read from the
+// device once, Volatile registers always bypass the cache, WriteOnly
+// registers return the last written value. In the WriteBack mode
+// register writes are deferred until flush() which writes dirty
+// registers in address order. FIFO, memory and asynchronous operations
+// bypass the cache, but flush and invalidate the affected addresses.
+// The cache is shared by all copies of the channel object.
+
+// In the posted write mode register writes that reach the device are
+// queued instead. Repeated writes to the same address are collapsed,
+// runs of consecutive addresses are written with one writeMem() call.
+// The queue is flushed before any read, FIFO, memory or asynchronous
+// operation and by flush(), which therefore acts as a write barrier.
+// Queued writes are issued in address order, not in program order,
+// and errors are reported by the operation that flushes the queue.
+
+// Channel methods hold mutex() while they run, since the cache, the
+// posted write queue and emulated transaction results are shared by
+// all copies of the channel object. Clients still need to hold the
+// mutex to make a sequence of calls atomic.
+
+// Call close() (or flush()) before the channel is destroyed: close()
+// writes pending registers and throws on failure, while the destructor
+// can only report the failure to the standard error stream.
+
 class SDMChannel : virtual public SDMBase {
+public:
+	enum CacheMode {CacheOff,WriteThrough,WriteBack};
+	enum CachePolicy {Cacheable,Volatile,WriteOnly};
+private:
 	std::shared_ptr<SDMChannelImpl> _impl;
 	
 	SDMChannelImpl &impl();
@@ -172,6 +380,8 @@ class SDMChannel : virtual public SDMBase {
 	
 	virtual int getPropertyAPI(const char *name,char *buf,std::size_t n) override;
 	virtual int setPropertyAPI(const char *name,const char *value) override;
+	virtual int getPropertiesAPI(const char *names,char *buf,std::size_t n) override;
+	virtual std::string lastErrorAPI() override;
 public:
 	SDMChannel() {}
 	SDMChannel(const SDMDevice &d,int ch);
@@ -192,13 +402,92 @@ public:
 	virtual void readFIFO(sdm_addr_t addr,sdm_reg_t *data,std::size_t n);
 	virtual void writeMem(sdm_addr_t addr,const sdm_reg_t *data,std::size_t n);
 	virtual void readMem(sdm_addr_t addr,sdm_reg_t *data,std::size_t n);
+	virtual void writeRegs(const sdm_addr_t *addr,const sdm_reg_t *data,std::size_t n);
+	virtual void readRegs(const sdm_addr_t *addr,sdm_reg_t *data,std::size_t n);
+	
+	virtual int submitWriteReg(sdm_addr_t addr,sdm_reg_t data);
+	virtual int submitReadReg(sdm_addr_t addr);
+	virtual sdm_reg_t waitTransaction(int token);
+	virtual bool pollTransaction(int token,sdm_reg_t *data=nullptr);
+	
+// 64-bit variants fall back to 32-bit functions when the plugin
+// doesn't export them and the addresses and data fit in 32 bits
+	virtual void writeReg64(sdm_addr64_t addr,sdm_reg64_t data);
+	virtual sdm_reg64_t readReg64(sdm_addr64_t addr);
+	virtual void writeFIFO64(sdm_addr64_t addr,const sdm_reg64_t *data,std::size_t n);
+	virtual void readFIFO64(sdm_addr64_t addr,sdm_reg64_t *data,std::size_t n);
+	virtual void writeMem64(sdm_addr64_t addr,const sdm_reg64_t *data,std::size_t n);
+	virtual void readMem64(sdm_addr64_t addr,sdm_reg64_t *data,std::size_t n);
+	
+// Replace bits selected by the mask, atomically if the plugin
+// supports read-modify-write operations
+	virtual void modifyReg(sdm_addr_t addr,sdm_reg_t mask,sdm_reg_t data);
+	virtual void modifyRegs(const sdm_addr_t *addr,const sdm_reg_t *mask,const sdm_reg_t *data,std::size_t n);
+	
+	void setCacheMode(CacheMode mode);
+	CacheMode cacheMode() const;
+	void setCachePolicy(sdm_addr_t addr,CachePolicy policy);
+	void setCachePolicy(sdm_addr_t first,sdm_addr_t last,CachePolicy policy);
+	void setDefaultCachePolicy(CachePolicy policy);
+	CachePolicy cachePolicy(sdm_addr_t addr) const;
+	virtual sdm_reg_t refreshReg(sdm_addr_t addr); // reads from the device, updates the cache
+	virtual void flush();
+	void invalidateCache();
+	
+	void setPostedWrites(bool enable);
+	bool postedWrites() const;
+	std::size_t pendingWrites() const; // dirty cached registers plus posted writes
+	
+	virtual std::shared_ptr<mutex_t> mutex() const override;
 	
 	operator bool() const;
 	int id() const;
 };
 
+// Host-side decimator, used by SDMSource when the plugin doesn't
+// handle the decimation factor itself (SDM_FEATURE_DECIMATION is not
+// reported). Plain mode keeps one of each df samples, other modes
+// apply a low-pass filter first: a boxcar (Average), a 3-stage CIC
+// response or a windowed-sinc FIR. The filter state is kept between
+// process() calls, so a stream can be fed in arbitrary chunks.
+
+class SDMDecimator {
+public:
+	enum Mode {Plain,Average,CIC,FIR};
+private:
+	Mode _mode=Plain;
+	int _df=1;
+	std::size_t _phase=0; // input samples since the last output
+	std::vector<sdm_sample_t> _coefs;
+	std::vector<sdm_sample_t> _work; // history followed by new input
+public:
+	SDMDecimator() {}
+	SDMDecimator(Mode mode,int df) {setup(mode,df);}
+	
+	void setup(Mode mode,int df);
+	void reset();
+	
+	Mode mode() const {return _mode;}
+	int factor() const {return _df;}
+	
+// Returns the number of samples written to "out" which must have room for n/df+1 samples
+	std::size_t process(const sdm_sample_t *in,std::size_t n,sdm_sample_t *out);
+// Maximum number of input samples that produce no more than "outputs" samples
+	std::size_t maxInput(std::size_t outputs) const;
+	
+	static const char *modeName(Mode mode);
+	static Mode modeFromName(const std::string &name);
+private:
+	static sdm_sample_t dot(const sdm_sample_t *x,const sdm_sample_t *c,std::size_t n);
+};
+
 // Data source class
 
+// Unlike channel methods, source methods don't lock mutex(): stream
+// reads can block for a long time and would stall other objects sharing
+// the mutex (e.g. channels of the same device). Clients calling a source
+// from several threads must hold mutex() themselves.
+
 class SDMSource : virtual public SDMBase {
 public:
 	typedef SafeFlags<SDMSource> Flags;
@@ -208,6 +497,7 @@ public:
 	static const Flags AllowPartial;
 	
 	static const int WouldBlock;
+	static const int NotSupported;
 private:
 	std::shared_ptr<SDMSourceImpl> _impl;
 	
@@ -216,6 +506,8 @@ private:
 	
 	virtual int getPropertyAPI(const char *name,char *buf,std::size_t n) override;
 	virtual int setPropertyAPI(const char *name,const char *value) override;
+	virtual int getPropertiesAPI(const char *names,char *buf,std::size_t n) override;
+	virtual std::string lastErrorAPI() override;
 public:
 	SDMSource() {}
 	SDMSource(const SDMDevice &d,int src);
@@ -231,13 +523,91 @@ public:
 	virtual void close();
 	
 	virtual void selectReadStreams(const std::vector<int> &streams,std::size_t packets,int df);
+	void setDecimationMode(SDMDecimator::Mode mode);
+	SDMDecimator::Mode decimationMode() const;
+	bool hostDecimation() const;
 	virtual int readStream(int stream,sdm_sample_t *data,std::size_t n,Flags flags=Normal);
+	virtual int readStreamTyped(int stream,void *data,std::size_t n,int format,Flags flags=Normal);
+	virtual void readStreams(const int *streams,sdm_sample_t * const *data,const std::size_t *n,int *res,std::size_t count,Flags flags=Normal);
+	virtual int acquirePacket(int stream,const sdm_sample_t *&data,std::size_t &n,Flags flags=Normal);
+	virtual void releasePacket(int stream);
 	virtual void readNextPacket();
 	virtual void discardPackets();
 	virtual int readStreamErrors();
 	
+	int streamFormat(int stream);
+	static std::size_t sampleSize(int format);
+	
+	bool packetInfo(sdm_packet_info_t &info);
+	
+	bool readyNotification() const;
+	bool waitReady(int msec);
+	
+	virtual std::shared_ptr<mutex_t> mutex() const override;
+	
 	operator bool() const;
 	int id() const;
 };
 
+// SDMPrefetchSource reads packets from a source in a dedicated thread
+// and stores them in a ring buffer, so that a slow consumer doesn't
+// stall the device. The ring has a single producer (the acquisition
+// thread) and a single consumer, slot ownership is passed through
+// atomic counters. When the ring is full, the acquisition thread keeps
+// reading packets from the plugin and drops them (see dropped()).
+// The source mutex is held only while calling the plugin.
+
+class SDMPrefetchSource {
+public:
+	struct Packet {
+		std::vector<std::vector<sdm_sample_t>> data; // one vector per selected stream
+		sdm_packet_info_t info {};
+		bool hasInfo=false;
+	};
+private:
+	SDMSource _src;
+	std::shared_ptr<SDMBase::mutex_t> _mutex;
+	std::vector<int> _streams;
+	std::vector<Packet> _slots;
+	Packet _scratch; // receives packets dropped due to the ring being full
+	std::vector<char> _done;
+	std::vector<std::size_t> _lengths; // samples read per stream
+	std::size_t _chunk=0;
+	std::atomic<std::size_t> _reserve {0}; // slot buffer capacity, grows with packet size
+	
+	std::atomic<std::size_t> _head {0}; // packets written, modified by the producer
+	std::atomic<std::size_t> _tail {0}; // packets read, modified by the consumer
+	std::atomic<std::uint64_t> _dropped {0};
+	std::atomic<bool> _stop {false};
+	std::atomic<bool> _failed {false};
+	std::exception_ptr _error;
+	
+	std::thread _thread;
+	std::mutex _waitMutex;
+	std::condition_variable _waitCv;
+public:
+	explicit SDMPrefetchSource(const SDMSource &src,std::size_t ringPackets=16);
+	SDMPrefetchSource(const SDMPrefetchSource &)=delete;
+	~SDMPrefetchSource();
+	
+	SDMPrefetchSource &operator=(const SDMPrefetchSource &)=delete;
+	
+	SDMSource &source() {return _src;}
+	
+	void start(const std::vector<int> &streams,std::size_t packets=0,int df=1);
+	void stop();
+	bool running() const {return _thread.joinable();}
+	
+// Consumer side. The buffers of "packet" are exchanged with the ring
+// slot, so reusing the same Packet object avoids memory allocations.
+	bool readPacket(Packet &packet,int msec);
+	std::size_t available() const;
+	std::uint64_t dropped() const {return _dropped.load();}
+private:
+	void reserveBuffers(Packet &packet);
+	void run();
+	bool fetchPacket(Packet &packet);
+	void notifyConsumer();
+};
+
 #endif
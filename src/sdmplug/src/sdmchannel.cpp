@@ -23,7 +23,12 @@
 
 #include "sdmplug.h"
 
+#include <iostream>
 #include <stdexcept>
+#include <map>
+#include <vector>
+#include <algorithm>
+#include <climits>
 
 /*
  * SDMChannelImpl definition
@@ -34,6 +39,28 @@ class SDMChannelImpl {
 	void *_hChannel;
 	int _id;
 	const SDMImport &_pf;
+	std::shared_ptr<SDMBase::mutex_t> _mutex;
+	
+// Results of transactions executed synchronously when the plugin
+// doesn't support asynchronous ones
+	std::map<int,sdm_reg_t> _syncResults;
+	int _nextToken=0;
+	
+// Shadow register cache. _policies maps the first address of a range
+// to the policy in effect up to the next key (-1 means default).
+	struct CacheEntry {
+		sdm_reg_t value;
+		bool dirty;
+	};
+	SDMChannel::CacheMode _cacheMode=SDMChannel::CacheOff;
+	SDMChannel::CachePolicy _defaultPolicy=SDMChannel::Cacheable;
+	std::map<sdm_addr_t,int> _policies;
+	std::map<sdm_addr_t,CacheEntry> _cache;
+	std::size_t _dirty=0;
+	
+// Posted write queue: maps addresses to the last value written
+	bool _posted=false;
+	std::map<sdm_addr_t,sdm_reg_t> _postedQueue;
 	
 public:
 	SDMChannelImpl(const SDMDevice &d,int ch);
@@ -43,6 +70,8 @@ public:
 	SDMChannelImpl &operator=(const SDMChannelImpl &right)=delete;
 	
 	void *handle() const {return _hChannel;}
+	const std::shared_ptr<SDMBase::mutex_t> &mutex() const {return _mutex;}
+	std::unique_lock<SDMBase::mutex_t> lock() const {return std::unique_lock<SDMBase::mutex_t>(*_mutex);}
 	SDMPlugin &plugin() {return _device.plugin();}
 	const SDMPlugin &plugin() const {return _device.plugin();}
 	SDMDevice &device() {return _device;}
@@ -50,6 +79,8 @@ public:
 	
 	int getPropertyAPI(const char *name,char *buf,std::size_t n);
 	int setPropertyAPI(const char *name,const char *value);
+	int getPropertiesAPI(const char *names,char *buf,std::size_t n);
+	std::string lastErrorAPI() const {return _pf.lastError();}
 	
 	void writeReg(sdm_addr_t addr,sdm_reg_t data);
 	sdm_reg_t readReg(sdm_addr_t addr);
@@ -57,8 +88,54 @@ public:
 	void readFIFO(sdm_addr_t addr,sdm_reg_t *data,std::size_t n);
 	void writeMem(sdm_addr_t addr,const sdm_reg_t *data,std::size_t n);
 	void readMem(sdm_addr_t addr,sdm_reg_t *data,std::size_t n);
+	void writeRegs(const sdm_addr_t *addr,const sdm_reg_t *data,std::size_t n);
+	void readRegs(const sdm_addr_t *addr,sdm_reg_t *data,std::size_t n);
+	
+	int submitWriteReg(sdm_addr_t addr,sdm_reg_t data);
+	int submitReadReg(sdm_addr_t addr);
+	bool completeTransaction(int token,sdm_reg_t *data,bool wait);
+	
+	void writeReg64(sdm_addr64_t addr,sdm_reg64_t data);
+	sdm_reg64_t readReg64(sdm_addr64_t addr);
+	void writeFIFO64(sdm_addr64_t addr,const sdm_reg64_t *data,std::size_t n);
+	void readFIFO64(sdm_addr64_t addr,sdm_reg64_t *data,std::size_t n);
+	void writeMem64(sdm_addr64_t addr,const sdm_reg64_t *data,std::size_t n);
+	void readMem64(sdm_addr64_t addr,sdm_reg64_t *data,std::size_t n);
+	
+	void modifyReg(sdm_addr_t addr,sdm_reg_t mask,sdm_reg_t data);
+	void modifyRegs(const sdm_addr_t *addr,const sdm_reg_t *mask,const sdm_reg_t *data,std::size_t n);
+	
+	void setCacheMode(SDMChannel::CacheMode mode);
+	SDMChannel::CacheMode cacheMode() const {return _cacheMode;}
+	void setCachePolicy(sdm_addr_t first,sdm_addr_t last,SDMChannel::CachePolicy policy);
+	void setDefaultCachePolicy(SDMChannel::CachePolicy policy);
+	SDMChannel::CachePolicy cachePolicy(sdm_addr_t addr) const;
+	sdm_reg_t refreshReg(sdm_addr_t addr);
+	void flush();
+	void invalidateCache();
+	
+	void setPostedWrites(bool enable);
+	bool postedWrites() const {return _posted;}
+	std::size_t pendingWrites() const {return _dirty+_postedQueue.size();}
 	
 	int id() const {return _id;}
+private:
+	void rawWriteReg(sdm_addr_t addr,sdm_reg_t data);
+	sdm_reg_t rawReadReg(sdm_addr_t addr);
+	void rawWriteRegs(const sdm_addr_t *addr,const sdm_reg_t *data,std::size_t n);
+	void rawReadRegs(const sdm_addr_t *addr,sdm_reg_t *data,std::size_t n);
+	void sendWriteRegs(const sdm_addr_t *addr,const sdm_reg_t *data,std::size_t n);
+	std::size_t regBatch(std::size_t n) const;
+	void rawWriteMem(sdm_addr_t addr,const sdm_reg_t *data,std::size_t n);
+	void postWrite(sdm_addr_t addr,sdm_reg_t data);
+	void flushPosted();
+	void storeCached(sdm_addr_t addr,sdm_reg_t data,bool dirty);
+	void flushRange(sdm_addr_t first,sdm_addr_t last);
+	void bypassRange(sdm_addr64_t addr,std::size_t n,bool write);
+	
+	int storeResult(sdm_reg_t data);
+	static bool fits32(sdm_addr64_t addr,std::size_t n);
+	static bool fits32(const sdm_reg64_t *data,std::size_t n);
 };
 
 /*
@@ -68,55 +145,647 @@ public:
 SDMChannelImpl::SDMChannelImpl(const SDMDevice &d,int ch): _device(d),_pf(d.plugin().functions()) {
 	if(!_device) throw std::runtime_error("Device is not opened");
 	if(!_pf.supportChannels) throw std::runtime_error("This plugin doesn't support control channels");
+	SDMStats::Call call(_device.handle(),"sdmOpenChannel");
 	_hChannel=_pf.ptrOpenChannel(_device.handle(),ch);
-	if(!_hChannel) throw sdmplugin_error("sdmOpenChannel");
+	if(!_hChannel) throw sdmplugin_error("sdmOpenChannel",_pf);
 	_id=ch;
+	SDMStats::setObjectName(_hChannel,SDMStats::objectName(_device.handle())+"/channel"+std::to_string(ch));
+	SDMTrace::openObject(_hChannel,_device.handle(),SDM_TRACE_OPENCHANNEL,ch);
+	switch(_pf.caps.threadSafety) {
+	case SDM_THREADSAFE_NONE:
+	case SDM_THREADSAFE_DEVICE:
+		_mutex=_device.mutex();
+		break;
+	default:
+		_mutex=std::make_shared<SDMBase::mutex_t>();
+	}
 }
 
+// Pending writes should be flushed by close(). A failure here can't be
+// propagated, so it is only reported to the standard error stream.
+
 SDMChannelImpl::~SDMChannelImpl() {
+	try {
+		flush();
+	}
+	catch(std::exception &ex) {
+		std::cerr<<"SDM channel closed with pending writes lost: "<<ex.what()<<std::endl;
+	}
+	SDMStats::Call call(_hChannel,"sdmCloseChannel");
+	SDMTrace::closeObject(_hChannel);
 	_pf.ptrCloseChannel(_hChannel);
 }
 
 int SDMChannelImpl::getPropertyAPI(const char *name,char *buf,std::size_t n) {
-	return _pf.ptrGetChannelProperty(_hChannel,name,buf,n);
+	SDMStats::Call call(_hChannel,"sdmGetChannelProperty");
+	int r=_pf.ptrGetChannelProperty(_hChannel,name,buf,n);
+	if(r==0) SDMTrace::recordProperty(_hChannel,SDM_TRACE_GETPROPERTY,name,buf,r);
+	return r;
 }
 
 int SDMChannelImpl::setPropertyAPI(const char *name,const char *value) {
-	return _pf.ptrSetChannelProperty(_hChannel,name,value);
+	SDMStats::Call call(_hChannel,"sdmSetChannelProperty");
+	int r=_pf.ptrSetChannelProperty(_hChannel,name,value);
+	SDMTrace::recordProperty(_hChannel,SDM_TRACE_SETPROPERTY,name,value,r);
+	return r;
+}
+
+int SDMChannelImpl::getPropertiesAPI(const char *names,char *buf,std::size_t n) {
+	if(!_pf.ptrGetChannelProperties) return SDM_NOTSUPPORTED;
+	SDMStats::Call call(_hChannel,"sdmGetChannelProperties");
+	int r=_pf.ptrGetChannelProperties(_hChannel,names,buf,n);
+	if(r==0) SDMTrace::recordProperties(_hChannel,buf,r);
+	return r;
 }
 
 void SDMChannelImpl::writeReg(sdm_addr_t addr,sdm_reg_t data) {
-	int r=_pf.ptrWriteReg(_hChannel,addr,data);
-	if(r) throw sdmplugin_error("sdmWriteReg",r);
+	if(_cacheMode==SDMChannel::CacheOff) return rawWriteReg(addr,data);
+	
+	if(cachePolicy(addr)==SDMChannel::Volatile) return rawWriteReg(addr,data);
+	if(_cacheMode==SDMChannel::WriteThrough) rawWriteReg(addr,data);
+	storeCached(addr,data,_cacheMode==SDMChannel::WriteBack);
 }
 
 sdm_reg_t SDMChannelImpl::readReg(sdm_addr_t addr) {
+	if(_cacheMode==SDMChannel::CacheOff) return rawReadReg(addr);
+	
+	auto it=_cache.find(addr);
+	if(it!=_cache.end()) return it->second.value;
+	
+	sdm_reg_t val=rawReadReg(addr);
+	if(cachePolicy(addr)==SDMChannel::Cacheable) storeCached(addr,val,false);
+	return val;
+}
+
+sdm_reg_t SDMChannelImpl::refreshReg(sdm_addr_t addr) {
+	if(_cacheMode==SDMChannel::CacheOff) return rawReadReg(addr);
+	
+	flushRange(addr,addr);
+	sdm_reg_t val=rawReadReg(addr);
+	if(cachePolicy(addr)==SDMChannel::Cacheable) storeCached(addr,val,false);
+	return val;
+}
+
+void SDMChannelImpl::rawWriteReg(sdm_addr_t addr,sdm_reg_t data) {
+	if(_posted) return postWrite(addr,data);
+	SDMStats::Call call(_hChannel,"sdmWriteReg");
+	int r=_pf.ptrWriteReg(_hChannel,addr,data);
+	call.finish(r?0:sizeof(sdm_reg_t));
+	SDMTrace::record(_hChannel,SDM_TRACE_WRITEREG,addr,r,&data,sizeof(sdm_reg_t));
+	if(r) throw sdmplugin_error("sdmWriteReg",r,_pf);
+}
+
+sdm_reg_t SDMChannelImpl::rawReadReg(sdm_addr_t addr) {
 	sdm_reg_t val;
 	int err;
 	
+	flushPosted();
+	SDMStats::Call call(_hChannel,"sdmReadReg");
 	val=_pf.ptrReadReg(_hChannel,addr,&err);
-	if(err) throw sdmplugin_error("sdmReadReg",err);
+	call.finish(err?0:sizeof(sdm_reg_t));
+	SDMTrace::record(_hChannel,SDM_TRACE_READREG,addr,err,&val,err?0:sizeof(sdm_reg_t));
+	if(err) throw sdmplugin_error("sdmReadReg",err,_pf);
 	return val;
 }
 
 void SDMChannelImpl::writeFIFO(sdm_addr_t addr,const sdm_reg_t *data,std::size_t n) {
+	bypassRange(addr,1,true);
+	SDMStats::Call call(_hChannel,"sdmWriteFIFO");
 	int r=_pf.ptrWriteFIFO(_hChannel,addr,data,n,0);
-	if(r<0) throw sdmplugin_error("sdmWriteFIFO",r);
+	call.finish(r>0?r*sizeof(sdm_reg_t):0);
+	SDMTrace::record(_hChannel,SDM_TRACE_WRITEFIFO,addr,r,data,r>0?r*sizeof(sdm_reg_t):0);
+	if(r<0) throw sdmplugin_error("sdmWriteFIFO",r,_pf);
 }
 
 void SDMChannelImpl::readFIFO(sdm_addr_t addr,sdm_reg_t *data,std::size_t n) {
+	bypassRange(addr,1,false);
+	SDMStats::Call call(_hChannel,"sdmReadFIFO");
 	int r=_pf.ptrReadFIFO(_hChannel,addr,data,n,0);
-	if(r<0) throw sdmplugin_error("sdmReadFIFO",r);
+	call.finish(r>0?r*sizeof(sdm_reg_t):0);
+	SDMTrace::record(_hChannel,SDM_TRACE_READFIFO,addr,r,data,r>0?r*sizeof(sdm_reg_t):0);
+	if(r<0) throw sdmplugin_error("sdmReadFIFO",r,_pf);
 }
 
 void SDMChannelImpl::writeMem(sdm_addr_t addr,const sdm_reg_t *data,std::size_t n) {
+	bypassRange(addr,n,true);
+	SDMStats::Call call(_hChannel,"sdmWriteMem");
 	int r=_pf.ptrWriteMem(_hChannel,addr,data,n);
-	if(r) throw sdmplugin_error("sdmWriteMem",r);
+	call.finish(r?0:n*sizeof(sdm_reg_t));
+	SDMTrace::record(_hChannel,SDM_TRACE_WRITEMEM,addr,r,data,r?0:n*sizeof(sdm_reg_t));
+	if(r) throw sdmplugin_error("sdmWriteMem",r,_pf);
 }
 
 void SDMChannelImpl::readMem(sdm_addr_t addr,sdm_reg_t *data,std::size_t n) {
+	bypassRange(addr,n,false);
+	SDMStats::Call call(_hChannel,"sdmReadMem");
 	int r=_pf.ptrReadMem(_hChannel,addr,data,n);
-	if(r) throw sdmplugin_error("sdmReadMem",r);
+	call.finish(r?0:n*sizeof(sdm_reg_t));
+	SDMTrace::record(_hChannel,SDM_TRACE_READMEM,addr,r,data,r?0:n*sizeof(sdm_reg_t));
+	if(r) throw sdmplugin_error("sdmReadMem",r,_pf);
+}
+
+void SDMChannelImpl::writeRegs(const sdm_addr_t *addr,const sdm_reg_t *data,std::size_t n) {
+	if(_cacheMode==SDMChannel::CacheOff) return rawWriteRegs(addr,data,n);
+	
+// Registers that must reach the device now are written in one batch
+	std::vector<sdm_addr_t> hwAddr;
+	std::vector<sdm_reg_t> hwData;
+	for(std::size_t i=0;i<n;i++) {
+		if(_cacheMode==SDMChannel::WriteBack&&cachePolicy(addr[i])!=SDMChannel::Volatile) continue;
+		hwAddr.push_back(addr[i]);
+		hwData.push_back(data[i]);
+	}
+	if(!hwAddr.empty()) rawWriteRegs(hwAddr.data(),hwData.data(),hwAddr.size());
+	
+	for(std::size_t i=0;i<n;i++) {
+		if(cachePolicy(addr[i])==SDMChannel::Volatile) continue;
+		storeCached(addr[i],data[i],_cacheMode==SDMChannel::WriteBack);
+	}
+}
+
+void SDMChannelImpl::readRegs(const sdm_addr_t *addr,sdm_reg_t *data,std::size_t n) {
+	if(_cacheMode==SDMChannel::CacheOff) return rawReadRegs(addr,data,n);
+	
+// Serve what we can from the cache, read the rest in one batch
+	std::vector<std::size_t> misses;
+	for(std::size_t i=0;i<n;i++) {
+		auto it=_cache.find(addr[i]);
+		if(it!=_cache.end()) data[i]=it->second.value;
+		else misses.push_back(i);
+	}
+	if(misses.empty()) return;
+	
+	std::vector<sdm_addr_t> hwAddr(misses.size());
+	std::vector<sdm_reg_t> hwData(misses.size());
+	for(std::size_t i=0;i<misses.size();i++) hwAddr[i]=addr[misses[i]];
+	rawReadRegs(hwAddr.data(),hwData.data(),hwAddr.size());
+	for(std::size_t i=0;i<misses.size();i++) {
+		data[misses[i]]=hwData[i];
+		if(cachePolicy(hwAddr[i])==SDMChannel::Cacheable) storeCached(hwAddr[i],hwData[i],false);
+	}
+}
+
+void SDMChannelImpl::rawWriteRegs(const sdm_addr_t *addr,const sdm_reg_t *data,std::size_t n) {
+	if(_posted) {
+		for(std::size_t i=0;i<n;i++) postWrite(addr[i],data[i]);
+		return;
+	}
+	if(_pf.ptrWriteRegs) sendWriteRegs(addr,data,n);
+	else for(std::size_t i=0;i<n;i++) rawWriteReg(addr[i],data[i]);
+}
+
+void SDMChannelImpl::rawReadRegs(const sdm_addr_t *addr,sdm_reg_t *data,std::size_t n) {
+	flushPosted();
+	if(_pf.ptrReadRegs) {
+		const std::size_t batch=regBatch(n);
+		for(std::size_t i=0;i<n;i+=batch) {
+			const std::size_t k=std::min(batch,n-i);
+			SDMStats::Call call(_hChannel,"sdmReadRegs");
+			int r=_pf.ptrReadRegs(_hChannel,addr+i,data+i,k);
+			call.finish(r?0:k*sizeof(sdm_reg_t));
+			SDMTrace::recordRegs(_hChannel,SDM_TRACE_READREGS,addr+i,data+i,k,r);
+			if(r) throw sdmplugin_error("sdmReadRegs",r,_pf);
+		}
+	}
+	else for(std::size_t i=0;i<n;i++) data[i]=rawReadReg(addr[i]);
+}
+
+// Calls sdmWriteRegs() directly, bypassing the posted write queue
+
+void SDMChannelImpl::sendWriteRegs(const sdm_addr_t *addr,const sdm_reg_t *data,std::size_t n) {
+	const std::size_t batch=regBatch(n);
+	for(std::size_t i=0;i<n;i+=batch) {
+		const std::size_t k=std::min(batch,n-i);
+		SDMStats::Call call(_hChannel,"sdmWriteRegs");
+		int r=_pf.ptrWriteRegs(_hChannel,addr+i,data+i,k);
+		call.finish(r?0:k*sizeof(sdm_reg_t));
+		SDMTrace::recordRegs(_hChannel,SDM_TRACE_WRITEREGS,addr+i,data+i,k,r);
+		if(r) throw sdmplugin_error("sdmWriteRegs",r,_pf);
+	}
+}
+
+// Number of registers per sdmWriteRegs()/sdmReadRegs() call,
+// limited by the plugin-reported maxRegBatch
+
+std::size_t SDMChannelImpl::regBatch(std::size_t n) const {
+	if(_pf.caps.maxRegBatch>0&&_pf.caps.maxRegBatch<n) return _pf.caps.maxRegBatch;
+	return n;
+}
+
+void SDMChannelImpl::rawWriteMem(sdm_addr_t addr,const sdm_reg_t *data,std::size_t n) {
+	if(_posted) {
+		for(std::size_t i=0;i<n;i++) postWrite(static_cast<sdm_addr_t>(addr+i),data[i]);
+		return;
+	}
+	SDMStats::Call call(_hChannel,"sdmWriteMem");
+	int r=_pf.ptrWriteMem(_hChannel,addr,data,n);
+	call.finish(r?0:n*sizeof(sdm_reg_t));
+	SDMTrace::record(_hChannel,SDM_TRACE_WRITEMEM,addr,r,data,r?0:n*sizeof(sdm_reg_t));
+	if(r) throw sdmplugin_error("sdmWriteMem",r,_pf);
+}
+
+// Queues a posted write. A later write to the same address replaces
+// the queued value. The queue is bounded to keep memory usage sane.
+
+void SDMChannelImpl::postWrite(sdm_addr_t addr,sdm_reg_t data) {
+	_postedQueue[addr]=data;
+	if(_postedQueue.size()>=65536) flushPosted();
+}
+
+// Writes queued registers in address order: runs of consecutive
+// addresses are written with sdmWriteMem(), the remaining registers
+// with sdmWriteRegs() batches (or one by one if the plugin doesn't
+// support batch writes). The queue is detached first, so queued
+// writes are dropped rather than retried if the plugin reports an error.
+
+void SDMChannelImpl::flushPosted() {
+	if(_postedQueue.empty()) return;
+	
+	std::map<sdm_addr_t,sdm_reg_t> queue;
+	queue.swap(_postedQueue);
+	
+	std::vector<sdm_addr_t> singleAddr;
+	std::vector<sdm_reg_t> singleData;
+	std::vector<sdm_reg_t> burst;
+	
+	for(auto it=queue.begin();it!=queue.end();) {
+		const sdm_addr_t start=it->first;
+		burst.clear();
+		do {
+			burst.push_back(it->second);
+			++it;
+		} while(it!=queue.end()&&it->first==start+burst.size());
+		
+		if(burst.size()>1) {
+			SDMStats::Call call(_hChannel,"sdmWriteMem");
+			int r=_pf.ptrWriteMem(_hChannel,start,burst.data(),burst.size());
+			call.finish(r?0:burst.size()*sizeof(sdm_reg_t));
+			SDMTrace::record(_hChannel,SDM_TRACE_WRITEMEM,start,r,burst.data(),burst.size()*sizeof(sdm_reg_t));
+			if(r) throw sdmplugin_error("sdmWriteMem",r,_pf);
+		}
+		else {
+			singleAddr.push_back(start);
+			singleData.push_back(burst[0]);
+		}
+	}
+	
+	if(singleAddr.empty()) return;
+	
+	if(_pf.ptrWriteRegs) sendWriteRegs(singleAddr.data(),singleData.data(),singleAddr.size());
+	else for(std::size_t i=0;i<singleAddr.size();i++) {
+		SDMStats::Call call(_hChannel,"sdmWriteReg");
+		int r=_pf.ptrWriteReg(_hChannel,singleAddr[i],singleData[i]);
+		call.finish(r?0:sizeof(sdm_reg_t));
+		SDMTrace::record(_hChannel,SDM_TRACE_WRITEREG,singleAddr[i],r,&singleData[i],sizeof(sdm_reg_t));
+		if(r) throw sdmplugin_error("sdmWriteReg",r,_pf);
+	}
+}
+
+int SDMChannelImpl::submitWriteReg(sdm_addr_t addr,sdm_reg_t data) {
+	if(_pf.ptrSubmitWriteReg) {
+		bypassRange(addr,1,true);
+		SDMStats::Call call(_hChannel,"sdmSubmitWriteReg");
+		int r=_pf.ptrSubmitWriteReg(_hChannel,addr,data);
+		call.finish(r<0?0:sizeof(sdm_reg_t));
+		SDMTrace::record(_hChannel,SDM_TRACE_SUBMITWRITEREG,addr,r,&data,sizeof(sdm_reg_t));
+		if(r<0) throw sdmplugin_error("sdmSubmitWriteReg",r,_pf);
+		return r;
+	}
+	writeReg(addr,data);
+	return storeResult(0);
+}
+
+int SDMChannelImpl::submitReadReg(sdm_addr_t addr) {
+	if(_pf.ptrSubmitReadReg) {
+		bypassRange(addr,1,false);
+		SDMStats::Call call(_hChannel,"sdmSubmitReadReg");
+		int r=_pf.ptrSubmitReadReg(_hChannel,addr);
+		SDMTrace::record(_hChannel,SDM_TRACE_SUBMITREADREG,addr,r);
+		if(r<0) throw sdmplugin_error("sdmSubmitReadReg",r,_pf);
+		return r;
+	}
+	return storeResult(readReg(addr));
+}
+
+bool SDMChannelImpl::completeTransaction(int token,sdm_reg_t *data,bool wait) {
+	if(_pf.ptrCompleteTransaction) {
+		sdm_reg_t value=0;
+		SDMStats::Call call(_hChannel,"sdmCompleteTransaction");
+		int r=_pf.ptrCompleteTransaction(_hChannel,token,&value,wait?0:1);
+		if(r==SDM_WOULDBLOCK) return false;
+		SDMTrace::record(_hChannel,SDM_TRACE_COMPLETETRANSACTION,static_cast<sdm_uint64_t>(token),r,&value,r?0:sizeof(sdm_reg_t));
+		if(r) throw sdmplugin_error("sdmCompleteTransaction",r,_pf);
+		if(data) *data=value;
+		return true;
+	}
+	auto it=_syncResults.find(token);
+	if(it==_syncResults.end()) throw std::runtime_error("Unknown transaction token");
+	if(data) *data=it->second;
+	_syncResults.erase(it);
+	return true;
+}
+
+void SDMChannelImpl::setCacheMode(SDMChannel::CacheMode mode) {
+	if(mode!=SDMChannel::WriteBack) flush();
+	if(mode==SDMChannel::CacheOff) _cache.clear();
+	_cacheMode=mode;
+}
+
+void SDMChannelImpl::setCachePolicy(sdm_addr_t first,sdm_addr_t last,SDMChannel::CachePolicy policy) {
+	if(last<first) throw std::runtime_error("Invalid address range");
+	
+// Cached values may not be valid under the new policy
+	flushRange(first,last);
+	_cache.erase(_cache.lower_bound(first),_cache.upper_bound(last));
+	
+	int after=-1;
+	if(last<0xFFFFFFFF) {
+		auto it=_policies.upper_bound(last+1);
+		if(it!=_policies.begin()) after=(--it)->second;
+	}
+	_policies.erase(_policies.lower_bound(first),_policies.upper_bound(last));
+	_policies[first]=policy;
+	if(last<0xFFFFFFFF) _policies[last+1]=after;
+}
+
+void SDMChannelImpl::setDefaultCachePolicy(SDMChannel::CachePolicy policy) {
+	flush();
+	_cache.clear();
+	_defaultPolicy=policy;
+}
+
+SDMChannel::CachePolicy SDMChannelImpl::cachePolicy(sdm_addr_t addr) const {
+	auto it=_policies.upper_bound(addr);
+	if(it==_policies.begin()) return _defaultPolicy;
+	int policy=(--it)->second;
+	if(policy<0) return _defaultPolicy;
+	return static_cast<SDMChannel::CachePolicy>(policy);
+}
+
+void SDMChannelImpl::flush() {
+	flushRange(0,0xFFFFFFFF);
+	flushPosted();
+}
+
+void SDMChannelImpl::setPostedWrites(bool enable) {
+	if(!enable) flushPosted();
+	_posted=enable;
+}
+
+// Flushes dirty registers before invalidating the cache, so that no writes are lost
+
+void SDMChannelImpl::invalidateCache() {
+	flush();
+	_cache.clear();
+}
+
+void SDMChannelImpl::storeCached(sdm_addr_t addr,sdm_reg_t data,bool dirty) {
+	auto it=_cache.find(addr);
+	if(it==_cache.end()) {
+		_cache.emplace(addr,CacheEntry{data,dirty});
+		if(dirty) _dirty++;
+		return;
+	}
+	if(dirty&&!it->second.dirty) _dirty++;
+	else if(!dirty&&it->second.dirty) _dirty--;
+	it->second.value=data;
+	it->second.dirty=dirty;
+}
+
+// Writes dirty registers in address order. If the plugin supports
+// batch writes, all registers are written in one call, otherwise runs
+// of consecutive addresses are written with sdmWriteMem().
+
+void SDMChannelImpl::flushRange(sdm_addr_t first,sdm_addr_t last) {
+	if(_dirty==0) return;
+	
+	std::vector<sdm_addr_t> addrs;
+	std::vector<sdm_reg_t> values;
+	auto const begin=_cache.lower_bound(first);
+	auto const end=_cache.upper_bound(last);
+	for(auto it=begin;it!=end;++it) {
+		if(!it->second.dirty) continue;
+		addrs.push_back(it->first);
+		values.push_back(it->second.value);
+	}
+	if(addrs.empty()) return;
+	
+	auto markClean=[this](sdm_addr_t addr,std::size_t n) {
+		for(std::size_t i=0;i<n;i++) {
+			auto &entry=_cache[static_cast<sdm_addr_t>(addr+i)];
+			if(entry.dirty) _dirty--;
+			entry.dirty=false;
+		}
+	};
+	
+	if(_pf.ptrWriteRegs) {
+		rawWriteRegs(addrs.data(),values.data(),addrs.size());
+		for(auto addr: addrs) markClean(addr,1);
+		return;
+	}
+	
+	for(std::size_t i=0;i<addrs.size();) {
+		std::size_t n=1;
+		while(i+n<addrs.size()&&addrs[i+n]==addrs[i]+n) n++;
+		if(n==1) rawWriteReg(addrs[i],values[i]);
+		else rawWriteMem(addrs[i],&values[i],n);
+		markClean(addrs[i],n);
+		i+=n;
+	}
+}
+
+// Prepares for an operation that bypasses the cache and the posted
+// write queue: the queue is flushed, cached writes to the affected
+// addresses are flushed, written addresses are invalidated
+
+void SDMChannelImpl::bypassRange(sdm_addr64_t addr,std::size_t n,bool write) {
+	flushPosted();
+	if(_cacheMode==SDMChannel::CacheOff||n==0||addr>0xFFFFFFFF) return;
+	sdm_uint64_t last=addr+n-1;
+	if(last>0xFFFFFFFF) last=0xFFFFFFFF;
+	const sdm_addr_t first32=static_cast<sdm_addr_t>(addr);
+	const sdm_addr_t last32=static_cast<sdm_addr_t>(last);
+	flushRange(first32,last32);
+	if(write) _cache.erase(_cache.lower_bound(first32),_cache.upper_bound(last32));
+}
+
+int SDMChannelImpl::storeResult(sdm_reg_t data) {
+	int token=_nextToken;
+	_nextToken=(_nextToken==INT_MAX)?0:_nextToken+1;
+	_syncResults[token]=data;
+	return token;
+}
+
+// Checks that the address range [addr,addr+n) is within the 32-bit address space
+bool SDMChannelImpl::fits32(sdm_addr64_t addr,std::size_t n) {
+	const sdm_uint64_t limit=sdm_uint64_t(1)<<32;
+	if(addr>=limit) return false;
+	return static_cast<sdm_uint64_t>(n)<=limit-addr;
+}
+
+bool SDMChannelImpl::fits32(const sdm_reg64_t *data,std::size_t n) {
+	for(std::size_t i=0;i<n;i++) if(data[i]>0xFFFFFFFF) return false;
+	return true;
+}
+
+void SDMChannelImpl::writeReg64(sdm_addr64_t addr,sdm_reg64_t data) {
+	if(_pf.ptrWriteReg64) {
+		bypassRange(addr,1,true);
+		SDMStats::Call call(_hChannel,"sdmWriteReg64");
+		int r=_pf.ptrWriteReg64(_hChannel,addr,data);
+		call.finish(r?0:sizeof(sdm_reg64_t));
+		SDMTrace::record(_hChannel,SDM_TRACE_WRITEREG64,addr,r,&data,sizeof(sdm_reg64_t));
+		if(r) throw sdmplugin_error("sdmWriteReg64",r,_pf);
+	}
+	else {
+		if(!fits32(addr,1)||data>0xFFFFFFFF) throw sdmplugin_error("sdmWriteReg64",SDM_NOTSUPPORTED);
+		writeReg(static_cast<sdm_addr_t>(addr),static_cast<sdm_reg_t>(data));
+	}
+}
+
+sdm_reg64_t SDMChannelImpl::readReg64(sdm_addr64_t addr) {
+	if(_pf.ptrReadReg64) {
+		bypassRange(addr,1,false);
+		int err;
+		SDMStats::Call call(_hChannel,"sdmReadReg64");
+		sdm_reg64_t val=_pf.ptrReadReg64(_hChannel,addr,&err);
+		call.finish(err?0:sizeof(sdm_reg64_t));
+		SDMTrace::record(_hChannel,SDM_TRACE_READREG64,addr,err,&val,err?0:sizeof(sdm_reg64_t));
+		if(err) throw sdmplugin_error("sdmReadReg64",err,_pf);
+		return val;
+	}
+	if(!fits32(addr,1)) throw sdmplugin_error("sdmReadReg64",SDM_NOTSUPPORTED);
+	return readReg(static_cast<sdm_addr_t>(addr));
+}
+
+void SDMChannelImpl::writeFIFO64(sdm_addr64_t addr,const sdm_reg64_t *data,std::size_t n) {
+	if(_pf.ptrWriteFIFO64) {
+		bypassRange(addr,1,true);
+		SDMStats::Call call(_hChannel,"sdmWriteFIFO64");
+		int r=_pf.ptrWriteFIFO64(_hChannel,addr,data,n,0);
+		call.finish(r>0?r*sizeof(sdm_reg64_t):0);
+		SDMTrace::record(_hChannel,SDM_TRACE_WRITEFIFO64,addr,r,data,r>0?r*sizeof(sdm_reg64_t):0);
+		if(r<0) throw sdmplugin_error("sdmWriteFIFO64",r,_pf);
+	}
+	else {
+		if(!fits32(addr,1)||!fits32(data,n)) throw sdmplugin_error("sdmWriteFIFO64",SDM_NOTSUPPORTED);
+		std::vector<sdm_reg_t> tmp(data,data+n);
+		writeFIFO(static_cast<sdm_addr_t>(addr),tmp.data(),n);
+	}
+}
+
+void SDMChannelImpl::readFIFO64(sdm_addr64_t addr,sdm_reg64_t *data,std::size_t n) {
+	if(_pf.ptrReadFIFO64) {
+		bypassRange(addr,1,false);
+		SDMStats::Call call(_hChannel,"sdmReadFIFO64");
+		int r=_pf.ptrReadFIFO64(_hChannel,addr,data,n,0);
+		call.finish(r>0?r*sizeof(sdm_reg64_t):0);
+		SDMTrace::record(_hChannel,SDM_TRACE_READFIFO64,addr,r,data,r>0?r*sizeof(sdm_reg64_t):0);
+		if(r<0) throw sdmplugin_error("sdmReadFIFO64",r,_pf);
+	}
+	else {
+		if(!fits32(addr,1)) throw sdmplugin_error("sdmReadFIFO64",SDM_NOTSUPPORTED);
+		std::vector<sdm_reg_t> tmp(n);
+		readFIFO(static_cast<sdm_addr_t>(addr),tmp.data(),n);
+		std::copy(tmp.begin(),tmp.end(),data);
+	}
+}
+
+void SDMChannelImpl::writeMem64(sdm_addr64_t addr,const sdm_reg64_t *data,std::size_t n) {
+	if(_pf.ptrWriteMem64) {
+		bypassRange(addr,n,true);
+		SDMStats::Call call(_hChannel,"sdmWriteMem64");
+		int r=_pf.ptrWriteMem64(_hChannel,addr,data,n);
+		call.finish(r?0:n*sizeof(sdm_reg64_t));
+		SDMTrace::record(_hChannel,SDM_TRACE_WRITEMEM64,addr,r,data,r?0:n*sizeof(sdm_reg64_t));
+		if(r) throw sdmplugin_error("sdmWriteMem64",r,_pf);
+	}
+	else {
+		if(!fits32(addr,n)||!fits32(data,n)) throw sdmplugin_error("sdmWriteMem64",SDM_NOTSUPPORTED);
+		std::vector<sdm_reg_t> tmp(data,data+n);
+		writeMem(static_cast<sdm_addr_t>(addr),tmp.data(),n);
+	}
+}
+
+void SDMChannelImpl::readMem64(sdm_addr64_t addr,sdm_reg64_t *data,std::size_t n) {
+	if(_pf.ptrReadMem64) {
+		bypassRange(addr,n,false);
+		SDMStats::Call call(_hChannel,"sdmReadMem64");
+		int r=_pf.ptrReadMem64(_hChannel,addr,data,n);
+		call.finish(r?0:n*sizeof(sdm_reg64_t));
+		SDMTrace::record(_hChannel,SDM_TRACE_READMEM64,addr,r,data,r?0:n*sizeof(sdm_reg64_t));
+		if(r) throw sdmplugin_error("sdmReadMem64",r,_pf);
+	}
+	else {
+		if(!fits32(addr,n)) throw sdmplugin_error("sdmReadMem64",SDM_NOTSUPPORTED);
+		std::vector<sdm_reg_t> tmp(n);
+		readMem(static_cast<sdm_addr_t>(addr),tmp.data(),n);
+		std::copy(tmp.begin(),tmp.end(),data);
+	}
+}
+
+// Registers with a known shadow value are modified in the cache,
+// others with a plugin-side read-modify-write operation if available
+
+void SDMChannelImpl::modifyReg(sdm_addr_t addr,sdm_reg_t mask,sdm_reg_t data) {
+	if(_cacheMode!=SDMChannel::CacheOff) {
+		auto it=_cache.find(addr);
+		if(it!=_cache.end()) return writeReg(addr,(it->second.value&~mask)|(data&mask));
+	}
+	if(_pf.ptrModifyReg) {
+		bypassRange(addr,1,true);
+		SDMStats::Call call(_hChannel,"sdmModifyReg");
+		int r=_pf.ptrModifyReg(_hChannel,addr,mask,data);
+		call.finish(r?0:sizeof(sdm_reg_t));
+		const sdm_reg_t payload[2]={mask,data};
+		SDMTrace::record(_hChannel,SDM_TRACE_MODIFYREG,addr,r,payload,sizeof(payload));
+		if(r) throw sdmplugin_error("sdmModifyReg",r,_pf);
+		return;
+	}
+	writeReg(addr,(readReg(addr)&~mask)|(data&mask));
+}
+
+void SDMChannelImpl::modifyRegs(const sdm_addr_t *addr,const sdm_reg_t *mask,const sdm_reg_t *data,std::size_t n) {
+	if(n==0) return;
+	if(_cacheMode!=SDMChannel::CacheOff) {
+		for(std::size_t i=0;i<n;i++) modifyReg(addr[i],mask[i],data[i]);
+		return;
+	}
+	if(_pf.ptrModifyRegs) {
+		flushPosted();
+		SDMStats::Call call(_hChannel,"sdmModifyRegs");
+		int r=_pf.ptrModifyRegs(_hChannel,addr,mask,data,n);
+		call.finish(r?0:n*sizeof(sdm_reg_t));
+		if(SDMTrace::active()) {
+			std::vector<sdm_reg_t> payload(addr,addr+n);
+			payload.insert(payload.end(),mask,mask+n);
+			payload.insert(payload.end(),data,data+n);
+			SDMTrace::record(_hChannel,SDM_TRACE_MODIFYREGS,n,r,payload.data(),payload.size()*sizeof(sdm_reg_t));
+		}
+		if(r) throw sdmplugin_error("sdmModifyRegs",r,_pf);
+		return;
+	}
+	
+// One batch read, one batch write. Later modifications of the same
+// address apply to the result of earlier ones.
+	std::vector<sdm_reg_t> values(n);
+	readRegs(addr,values.data(),n);
+	std::map<sdm_addr_t,std::size_t> first;
+	std::vector<sdm_addr_t> outAddr;
+	std::vector<sdm_reg_t> outData;
+	for(std::size_t i=0;i<n;i++) {
+		auto it=first.find(addr[i]);
+		if(it==first.end()) {
+			first.emplace(addr[i],outAddr.size());
+			outAddr.push_back(addr[i]);
+			outData.push_back((values[i]&~mask[i])|(data[i]&mask[i]));
+		}
+		else {
+			auto &value=outData[it->second];
+			value=(value&~mask[i])|(data[i]&mask[i]);
+		}
+	}
+	writeRegs(outAddr.data(),outData.data(),outAddr.size());
 }
 
 /*
@@ -145,6 +814,14 @@ int SDMChannel::setPropertyAPI(const char *name,const char *value) {
 	return impl().setPropertyAPI(name,value);
 }
 
+int SDMChannel::getPropertiesAPI(const char *names,char *buf,std::size_t n) {
+	return impl().getPropertiesAPI(names,buf,n);
+}
+
+std::string SDMChannel::lastErrorAPI() {
+	return impl().lastErrorAPI();
+}
+
 void *SDMChannel::handle() const {
 	return impl().handle();
 }
@@ -169,34 +846,183 @@ void SDMChannel::open(const SDMDevice &d,int ch) {
 	_impl=std::make_shared<SDMChannelImpl>(d,ch);
 }
 
+// Writes pending registers before closing, errors are propagated to
+// the caller (the channel is closed anyway)
+
 void SDMChannel::close() {
-	_impl.reset();
+	std::shared_ptr<SDMChannelImpl> impl;
+	impl.swap(_impl);
+	if(!impl) return;
+	auto lock=impl->lock();
+	impl->flush();
 }
 
 void SDMChannel::writeReg(sdm_addr_t addr,sdm_reg_t data) {
+	auto lock=impl().lock();
 	impl().writeReg(addr,data);
 }
 
 sdm_reg_t SDMChannel::readReg(sdm_addr_t addr) {
+	auto lock=impl().lock();
 	return impl().readReg(addr);
 }
 
 void SDMChannel::writeFIFO(sdm_addr_t addr,const sdm_reg_t *data,std::size_t n) {
+	auto lock=impl().lock();
 	return impl().writeFIFO(addr,data,n);
 }
 
 void SDMChannel::readFIFO(sdm_addr_t addr,sdm_reg_t *data,std::size_t n) {
+	auto lock=impl().lock();
 	return impl().readFIFO(addr,data,n);
 }
 
 void SDMChannel::writeMem(sdm_addr_t addr,const sdm_reg_t *data,std::size_t n) {
+	auto lock=impl().lock();
 	impl().writeMem(addr,data,n);
 }
 
 void SDMChannel::readMem(sdm_addr_t addr,sdm_reg_t *data,std::size_t n) {
+	auto lock=impl().lock();
 	impl().readMem(addr,data,n);
 }
 
+void SDMChannel::writeRegs(const sdm_addr_t *addr,const sdm_reg_t *data,std::size_t n) {
+	auto lock=impl().lock();
+	impl().writeRegs(addr,data,n);
+}
+
+void SDMChannel::readRegs(const sdm_addr_t *addr,sdm_reg_t *data,std::size_t n) {
+	auto lock=impl().lock();
+	impl().readRegs(addr,data,n);
+}
+
+int SDMChannel::submitWriteReg(sdm_addr_t addr,sdm_reg_t data) {
+	auto lock=impl().lock();
+	return impl().submitWriteReg(addr,data);
+}
+
+int SDMChannel::submitReadReg(sdm_addr_t addr) {
+	auto lock=impl().lock();
+	return impl().submitReadReg(addr);
+}
+
+sdm_reg_t SDMChannel::waitTransaction(int token) {
+	auto lock=impl().lock();
+	sdm_reg_t data=0;
+	impl().completeTransaction(token,&data,true);
+	return data;
+}
+
+bool SDMChannel::pollTransaction(int token,sdm_reg_t *data) {
+	auto lock=impl().lock();
+	return impl().completeTransaction(token,data,false);
+}
+
+void SDMChannel::writeReg64(sdm_addr64_t addr,sdm_reg64_t data) {
+	auto lock=impl().lock();
+	impl().writeReg64(addr,data);
+}
+
+sdm_reg64_t SDMChannel::readReg64(sdm_addr64_t addr) {
+	auto lock=impl().lock();
+	return impl().readReg64(addr);
+}
+
+void SDMChannel::writeFIFO64(sdm_addr64_t addr,const sdm_reg64_t *data,std::size_t n) {
+	auto lock=impl().lock();
+	impl().writeFIFO64(addr,data,n);
+}
+
+void SDMChannel::readFIFO64(sdm_addr64_t addr,sdm_reg64_t *data,std::size_t n) {
+	auto lock=impl().lock();
+	impl().readFIFO64(addr,data,n);
+}
+
+void SDMChannel::writeMem64(sdm_addr64_t addr,const sdm_reg64_t *data,std::size_t n) {
+	auto lock=impl().lock();
+	impl().writeMem64(addr,data,n);
+}
+
+void SDMChannel::readMem64(sdm_addr64_t addr,sdm_reg64_t *data,std::size_t n) {
+	auto lock=impl().lock();
+	impl().readMem64(addr,data,n);
+}
+
+void SDMChannel::modifyReg(sdm_addr_t addr,sdm_reg_t mask,sdm_reg_t data) {
+	auto lock=impl().lock();
+	impl().modifyReg(addr,mask,data);
+}
+
+void SDMChannel::modifyRegs(const sdm_addr_t *addr,const sdm_reg_t *mask,const sdm_reg_t *data,std::size_t n) {
+	auto lock=impl().lock();
+	impl().modifyRegs(addr,mask,data,n);
+}
+
+void SDMChannel::setCacheMode(CacheMode mode) {
+	auto lock=impl().lock();
+	impl().setCacheMode(mode);
+}
+
+SDMChannel::CacheMode SDMChannel::cacheMode() const {
+	auto lock=impl().lock();
+	return impl().cacheMode();
+}
+
+void SDMChannel::setCachePolicy(sdm_addr_t addr,CachePolicy policy) {
+	auto lock=impl().lock();
+	impl().setCachePolicy(addr,addr,policy);
+}
+
+void SDMChannel::setCachePolicy(sdm_addr_t first,sdm_addr_t last,CachePolicy policy) {
+	auto lock=impl().lock();
+	impl().setCachePolicy(first,last,policy);
+}
+
+void SDMChannel::setDefaultCachePolicy(CachePolicy policy) {
+	auto lock=impl().lock();
+	impl().setDefaultCachePolicy(policy);
+}
+
+SDMChannel::CachePolicy SDMChannel::cachePolicy(sdm_addr_t addr) const {
+	auto lock=impl().lock();
+	return impl().cachePolicy(addr);
+}
+
+sdm_reg_t SDMChannel::refreshReg(sdm_addr_t addr) {
+	auto lock=impl().lock();
+	return impl().refreshReg(addr);
+}
+
+void SDMChannel::flush() {
+	auto lock=impl().lock();
+	impl().flush();
+}
+
+void SDMChannel::invalidateCache() {
+	auto lock=impl().lock();
+	impl().invalidateCache();
+}
+
+void SDMChannel::setPostedWrites(bool enable) {
+	auto lock=impl().lock();
+	impl().setPostedWrites(enable);
+}
+
+bool SDMChannel::postedWrites() const {
+	auto lock=impl().lock();
+	return impl().postedWrites();
+}
+
+std::size_t SDMChannel::pendingWrites() const {
+	auto lock=impl().lock();
+	return impl().pendingWrites();
+}
+
+std::shared_ptr<SDMBase::mutex_t> SDMChannel::mutex() const {
+	return impl().mutex();
+}
+
 SDMChannel::operator bool() const {
 	return _impl.operator bool();
 }
@@ -0,0 +1,180 @@
+/*
+ * Copyright (c) 2015-2022 Simple Device Model contributors
+ * 
+ * This file is part of the Simple Device Model (SDM) framework.
+ * 
+ * SDM framework is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SDM framework is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SDM framework.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * This module provides an implementation of the SDMDecimator class.
+ *
+ * All filtering modes are implemented as a single FIR kernel which
+ * differs only in coefficients: a boxcar for Average, the impulse
+ * response of a 3-stage CIC filter (boxcar convolved with itself
+ * three times) for CIC and a Blackman-windowed sinc for FIR. Only
+ * the output samples are computed (i.e. the filter is evaluated once
+ * per df input samples).
+ */
+
+#include "sdmplug.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cmath>
+
+#if defined(__SSE2__)||defined(_M_X64)||(defined(_M_IX86_FP)&&_M_IX86_FP>=2)
+	#define SDM_DECIMATOR_SSE2
+	#include <emmintrin.h>
+#endif
+
+void SDMDecimator::setup(Mode mode,int df) {
+	if(df<1) throw std::runtime_error("Decimation factor must be 1 or greater");
+	_mode=mode;
+	_df=df;
+	_coefs.clear();
+	
+	if(df>1) {
+		switch(mode) {
+		case Plain:
+			break;
+		case Average:
+			_coefs.assign(df,1.0/df);
+			break;
+		case CIC:
+			{
+				std::vector<sdm_sample_t> h(1,1.0);
+				for(int stage=0;stage<3;stage++) {
+					std::vector<sdm_sample_t> next(h.size()+df-1,0);
+					for(std::size_t i=0;i<h.size();i++) {
+						for(int j=0;j<df;j++) next[i+j]+=h[i];
+					}
+					h.swap(next);
+				}
+				const double gain=static_cast<double>(df)*df*df;
+				for(auto &x: h) x/=gain;
+				_coefs.swap(h);
+			}
+			break;
+		case FIR:
+			{
+				const double pi=3.14159265358979323846;
+				const int taps=8*df+1;
+				const double fc=0.4/df; // cutoff, leaves room for the transition band
+				const double center=(taps-1)/2.0;
+				_coefs.resize(taps);
+				double sum=0;
+				for(int i=0;i<taps;i++) {
+					double t=i-center;
+					double sinc=(t==0)?2*fc:std::sin(2*pi*fc*t)/(pi*t);
+					double w=0.42-0.5*std::cos(2*pi*i/(taps-1))+0.08*std::cos(4*pi*i/(taps-1));
+					_coefs[i]=sinc*w;
+					sum+=_coefs[i];
+				}
+				for(auto &x: _coefs) x/=sum; // unity DC gain
+			}
+			break;
+		default:
+			throw std::runtime_error("Unknown decimation mode");
+		}
+	}
+	
+	reset();
+}
+
+void SDMDecimator::reset() {
+	_phase=0;
+	_work.assign(_coefs.empty()?0:_coefs.size()-1,0);
+}
+
+std::size_t SDMDecimator::process(const sdm_sample_t *in,std::size_t n,sdm_sample_t *out) {
+	if(_df==1) {
+		std::copy(in,in+n,out);
+		return n;
+	}
+	
+	const std::size_t df=static_cast<std::size_t>(_df);
+	const std::size_t first=(df-_phase)%df; // first input sample to produce an output
+	_phase=(_phase+n)%df;
+	
+	std::size_t k=0;
+	if(_coefs.empty()) { // plain decimation
+		for(std::size_t i=first;i<n;i+=df) out[k++]=in[i];
+		return k;
+	}
+	
+// _work contains the last (taps-1) input samples followed by the new ones,
+// so the filter window for in[i] starts at _work[i]
+	const std::size_t taps=_coefs.size();
+	_work.insert(_work.end(),in,in+n);
+	for(std::size_t i=first;i<n;i+=df) out[k++]=dot(&_work[i],_coefs.data(),taps);
+	_work.erase(_work.begin(),_work.end()-(taps-1));
+	return k;
+}
+
+std::size_t SDMDecimator::maxInput(std::size_t outputs) const {
+	const std::size_t df=static_cast<std::size_t>(_df);
+	return (df-_phase)%df+outputs*df;
+}
+
+const char *SDMDecimator::modeName(Mode mode) {
+	switch(mode) {
+	case Plain:
+		return "plain";
+	case Average:
+		return "average";
+	case CIC:
+		return "cic";
+	case FIR:
+		return "fir";
+	default:
+		return "";
+	}
+}
+
+SDMDecimator::Mode SDMDecimator::modeFromName(const std::string &name) {
+	if(name=="plain") return Plain;
+	if(name=="average") return Average;
+	if(name=="cic") return CIC;
+	if(name=="fir") return FIR;
+	throw std::runtime_error("Unknown decimation mode: \""+name+"\"");
+}
+
+// Four independent accumulators. The SSE2 path keeps them in two
+// registers (s0,s1 and s2,s3), so both paths add in the same order
+// and give identical results. The scalar loop is the fallback for
+// other targets, where the compiler may still vectorize it.
+
+sdm_sample_t SDMDecimator::dot(const sdm_sample_t *x,const sdm_sample_t *c,std::size_t n) {
+	std::size_t i=0;
+#ifdef SDM_DECIMATOR_SSE2
+	__m128d a01=_mm_setzero_pd(),a23=_mm_setzero_pd();
+	for(;i+4<=n;i+=4) {
+		a01=_mm_add_pd(a01,_mm_mul_pd(_mm_loadu_pd(x+i),_mm_loadu_pd(c+i)));
+		a23=_mm_add_pd(a23,_mm_mul_pd(_mm_loadu_pd(x+i+2),_mm_loadu_pd(c+i+2)));
+	}
+	double acc[4];
+	_mm_storeu_pd(acc,a01);
+	_mm_storeu_pd(acc+2,a23);
+	sdm_sample_t s0=acc[0],s1=acc[1],s2=acc[2],s3=acc[3];
+#else
+	sdm_sample_t s0=0,s1=0,s2=0,s3=0;
+	for(;i+4<=n;i+=4) {
+		s0+=x[i]*c[i];
+		s1+=x[i+1]*c[i+1];
+		s2+=x[i+2]*c[i+2];
+		s3+=x[i+3]*c[i+3];
+	}
+#endif
+	for(;i<n;i++) s0+=x[i]*c[i];
+	return (s0+s1)+(s2+s3);
+}
@@ -34,6 +34,7 @@ class SDMDeviceImpl {
 	void *_hDevice;
 	int _id;
 	const SDMImport &_pf;
+	std::shared_ptr<SDMBase::mutex_t> _mutex;
 	
 public:
 	SDMDeviceImpl(const SDMPlugin &pl,int iDev);
@@ -46,9 +47,12 @@ public:
 	const SDMPlugin &plugin() const {return _plugin;}
 	
 	void *handle() const {return _hDevice;}
+	const std::shared_ptr<SDMBase::mutex_t> &mutex() const {return _mutex;}
 	
 	int getPropertyAPI(const char *name,char *buf,std::size_t n);
 	int setPropertyAPI(const char *name,const char *value);
+	int getPropertiesAPI(const char *names,char *buf,std::size_t n);
+	std::string lastErrorAPI() const {return _pf.lastError();}
 	
 	void connect();
 	void disconnect();
@@ -63,35 +67,61 @@ public:
 
 SDMDeviceImpl::SDMDeviceImpl(const SDMPlugin &pl,int iDev): _plugin(pl),_pf(pl.functions()) {
 	if(!_plugin) throw std::runtime_error("Plugin is not loaded");
+	SDMStats::Call call(&_pf,"sdmOpenDevice");
 	_hDevice=_pf.ptrOpenDevice(iDev);
-	if(!_hDevice) throw sdmplugin_error("sdmOpenDevice");
+	if(!_hDevice) throw sdmplugin_error("sdmOpenDevice",_pf);
 	_id=iDev;
+	SDMStats::setObjectName(_hDevice,SDMStats::objectName(&_pf)+"/device"+std::to_string(iDev));
+	SDMTrace::openObject(_hDevice,&_pf,SDM_TRACE_OPENDEVICE,iDev);
+	if(_pf.caps.threadSafety==SDM_THREADSAFE_NONE) _mutex=_plugin.mutex();
+	else _mutex=std::make_shared<SDMBase::mutex_t>();
 }
 
 SDMDeviceImpl::~SDMDeviceImpl() {
+	SDMStats::Call call(_hDevice,"sdmCloseDevice");
 	if(_pf.ptrGetConnectionStatus(_hDevice)!=0) _pf.ptrDisconnect(_hDevice);
+	SDMTrace::closeObject(_hDevice);
 	_pf.ptrCloseDevice(_hDevice);
 }
 
 int SDMDeviceImpl::getPropertyAPI(const char *name,char *buf,std::size_t n) {
-	return _pf.ptrGetDeviceProperty(_hDevice,name,buf,n);
+	SDMStats::Call call(_hDevice,"sdmGetDeviceProperty");
+	int r=_pf.ptrGetDeviceProperty(_hDevice,name,buf,n);
+	if(r==0) SDMTrace::recordProperty(_hDevice,SDM_TRACE_GETPROPERTY,name,buf,r);
+	return r;
 }
 
 int SDMDeviceImpl::setPropertyAPI(const char *name,const char *value) {
-	return _pf.ptrSetDeviceProperty(_hDevice,name,value);
+	SDMStats::Call call(_hDevice,"sdmSetDeviceProperty");
+	int r=_pf.ptrSetDeviceProperty(_hDevice,name,value);
+	SDMTrace::recordProperty(_hDevice,SDM_TRACE_SETPROPERTY,name,value,r);
+	return r;
+}
+
+int SDMDeviceImpl::getPropertiesAPI(const char *names,char *buf,std::size_t n) {
+	if(!_pf.ptrGetDeviceProperties) return SDM_NOTSUPPORTED;
+	SDMStats::Call call(_hDevice,"sdmGetDeviceProperties");
+	int r=_pf.ptrGetDeviceProperties(_hDevice,names,buf,n);
+	if(r==0) SDMTrace::recordProperties(_hDevice,buf,r);
+	return r;
 }
 
 void SDMDeviceImpl::connect() {
+	SDMStats::Call call(_hDevice,"sdmConnect");
 	int r=_pf.ptrConnect(_hDevice);
-	if(r) throw sdmplugin_error("sdmConnect",r);
+	SDMTrace::record(_hDevice,SDM_TRACE_CONNECT,0,r);
+	if(r) throw sdmplugin_error("sdmConnect",r,_pf);
 }
 
 void SDMDeviceImpl::disconnect() {
+	SDMStats::Call call(_hDevice,"sdmDisconnect");
 	int r=_pf.ptrDisconnect(_hDevice);
-	if(r) throw sdmplugin_error("sdmDisconnect",r);
+	SDMTrace::record(_hDevice,SDM_TRACE_DISCONNECT,0,r);
+	if(r) throw sdmplugin_error("sdmDisconnect",r,_pf);
 }
 
 bool SDMDeviceImpl::isConnected() {
+	SDMStats::Call call(_hDevice,"sdmGetConnectionStatus");
 	int r=_pf.ptrGetConnectionStatus(_hDevice);
 	return (r!=0);
 }
@@ -122,6 +152,14 @@ int SDMDevice::setPropertyAPI(const char *name,const char *value) {
 	return impl().setPropertyAPI(name,value);
 }
 
+int SDMDevice::getPropertiesAPI(const char *names,char *buf,std::size_t n) {
+	return impl().getPropertiesAPI(names,buf,n);
+}
+
+std::string SDMDevice::lastErrorAPI() {
+	return impl().lastErrorAPI();
+}
+
 void *SDMDevice::handle() const {
 	return impl().handle();
 }
@@ -154,6 +192,10 @@ bool SDMDevice::isConnected() {
 	return impl().isConnected();
 }
 
+std::shared_ptr<SDMBase::mutex_t> SDMDevice::mutex() const {
+	return impl().mutex();
+}
+
 SDMDevice::operator bool() const {
 	return _impl.operator bool();
 }
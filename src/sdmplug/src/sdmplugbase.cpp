@@ -25,6 +25,29 @@
 
 #include <stdexcept>
 #include <sstream>
+#include <algorithm>
+
+namespace {
+	std::string withDetails(const std::string &message,const std::string &details) {
+		if(details.empty()) return message;
+		return message+": "+details;
+	}
+}
+
+/*
+ * SDMImport members
+ */
+
+std::string SDMImport::lastError() const {
+	if(!ptrGetLastError) return std::string();
+	char smallbuf[256];
+	int size=ptrGetLastError(smallbuf,256);
+	if(size==0) return std::string(smallbuf);
+	if(size<0) return std::string();
+	std::vector<char> buf(size);
+	if(ptrGetLastError(buf.data(),size)!=0) return std::string();
+	return std::string(buf.data());
+}
 
 /*
  * sdmplugin_error members
@@ -43,41 +66,187 @@ sdmplugin_error::sdmplugin_error(const std::string &strFuncName, int iErrorCode)
 	code=iErrorCode;
 }
 
+sdmplugin_error::sdmplugin_error(const std::string &strFuncName, const SDMImport &pf):
+	sdmplugin_error(strFuncName)
+{
+	detail=pf.lastError();
+	message=withDetails(message,detail);
+}
+
+sdmplugin_error::sdmplugin_error(const std::string &strFuncName, int iErrorCode, const SDMImport &pf):
+	sdmplugin_error(strFuncName,iErrorCode)
+{
+	detail=pf.lastError();
+	message=withDetails(message,detail);
+}
+
 /*
  * SDMBase members
  */
 
 std::string SDMBase::getProperty(const std::string &name) {
+	if(!validateCache()) return fetchProperty(name);
+	
+	auto it=_cacheValues.find(name);
+	if(it!=_cacheValues.end()) return it->second;
+	auto const &value=fetchProperty(name);
+	_cacheValues[name]=value;
+	return value;
+}
+
+std::string SDMBase::getProperty(const std::string &name,const std::string &defaultValue) try {
+	return getProperty(name);
+}
+catch(std::exception &) {
+	return defaultValue;
+}
+
+// Non-existent properties are omitted from the result
+std::map<std::string,std::string> SDMBase::getProperties(const std::vector<std::string> &names) {
+	std::map<std::string,std::string> res;
+	
+	if(!validateCache()) {
+		fetchProperties(names,res);
+		return res;
+	}
+	
+	std::vector<std::string> missing;
+	for(auto const &name: names) {
+		auto it=_cacheValues.find(name);
+		if(it!=_cacheValues.end()) res.emplace(name,it->second);
+		else missing.push_back(name);
+	}
+	if(!missing.empty()) {
+		std::map<std::string,std::string> fetched;
+		fetchProperties(missing,fetched);
+		for(auto const &item: fetched) {
+			_cacheValues[item.first]=item.second;
+			res.insert(item);
+		}
+	}
+	return res;
+}
+
+std::vector<std::string> SDMBase::listProperties(const std::string &name) {
+	bool useCache=validateCache();
+	if(useCache) {
+		auto it=_cacheLists.find(name);
+		if(it!=_cacheLists.end()) return it->second;
+	}
+	
+	std::string val;
+	try {
+		val=fetchProperty(name);
+	}
+	catch(std::exception &) {}
+	std::istringstream iss(val);
+	auto const &list=CSVParser::getRecord(iss);
+	if(useCache) _cacheLists[name]=list;
+	return list;
+}
+
+void SDMBase::setProperty(const std::string &name,const std::string &value) {
+	clearCache();
+	int r=setPropertyAPI(name.c_str(),value.c_str());
+	if(r) throw std::runtime_error(withDetails("Can't set property \""+name+"\"",lastErrorAPI()));
+}
+
+// Returns false if the object doesn't support cache validation
+bool SDMBase::enablePropertyCache(bool enable) {
+	clearCache();
+	_cacheEnabled=false;
+	if(!enable) return true;
+	try {
+		_cacheRevision=fetchProperty("*revision");
+	}
+	catch(std::exception &) {
+		return false;
+	}
+	_cacheValidated=std::chrono::steady_clock::now();
+	_cacheEnabled=true;
+	return true;
+}
+
+/*
+ * SDMBase private members
+ */
+
+std::string SDMBase::fetchProperty(const std::string &name) {
 	char smallbuf[256];
 	
 // Try to use fixed-size buffer
 	int size=getPropertyAPI(name.c_str(),smallbuf,256);
 	if(size==0) return std::string(smallbuf);
-	if(size<0) throw std::runtime_error("Can't get property \""+name+"\"");
+	if(size<0) throw std::runtime_error(withDetails("Can't get property \""+name+"\"",lastErrorAPI()));
 
 // Otherwise, allocate buffer of required size
 	std::vector<char> buf(size);
 
 // Get property value
 	int r=getPropertyAPI(name.c_str(),buf.data(),size);
-	if(r!=0) throw std::runtime_error("Can't get property \""+name+"\"");
+	if(r!=0) throw std::runtime_error(withDetails("Can't get property \""+name+"\"",lastErrorAPI()));
 	return std::string(buf.data());
 }
 
-std::string SDMBase::getProperty(const std::string &name,const std::string &defaultValue) try {
-	return getProperty(name);
-}
-catch(std::exception &) {
-	return defaultValue;
+void SDMBase::fetchProperties(const std::vector<std::string> &names,std::map<std::string,std::string> &values) {
+// Pack names as a sequence of null-terminated strings followed by an empty string
+	std::string packed;
+	for(auto const &name: names) {
+		packed.append(name);
+		packed.push_back('\0');
+	}
+	packed.push_back('\0');
+	
+	std::vector<char> buf(4096);
+	int r=getPropertiesAPI(packed.data(),buf.data(),buf.size());
+	if(r==SDM_NOTSUPPORTED) { // fall back to getting properties one by one
+		for(auto const &name: names) {
+			try {
+				values[name]=fetchProperty(name);
+			}
+			catch(std::exception &) {}
+		}
+		return;
+	}
+	if(r>0) {
+		buf.resize(r);
+		r=getPropertiesAPI(packed.data(),buf.data(),buf.size());
+	}
+	if(r!=0) throw std::runtime_error("Can't get properties");
+	
+	auto p=buf.cbegin();
+	while(p!=buf.cend()&&*p) {
+		auto nameEnd=std::find(p,buf.cend(),'\0');
+		if(nameEnd==buf.cend()) break;
+		auto valueEnd=std::find(nameEnd+1,buf.cend(),'\0');
+		if(valueEnd==buf.cend()) break;
+		values[std::string(p,nameEnd)]=std::string(nameEnd+1,valueEnd);
+		p=valueEnd+1;
+	}
 }
 
-std::vector<std::string> SDMBase::listProperties(const std::string &name) {
-	std::string val(getProperty(name,""));
-	std::istringstream iss(val);
-	return CSVParser::getRecord(iss);
+bool SDMBase::validateCache() {
+	if(!_cacheEnabled) return false;
+	auto const now=std::chrono::steady_clock::now();
+	if(now-_cacheValidated<_cacheInterval) return true;
+	std::string revision;
+	try {
+		revision=fetchProperty("*revision");
+	}
+	catch(std::exception &) { // the object doesn't support revisions anymore
+		clearCache();
+		_cacheEnabled=false;
+		return false;
+	}
+	if(revision!=_cacheRevision) {
+		clearCache();
+		_cacheRevision=revision;
+	}
+	_cacheValidated=now;
+	return true;
 }
 
-void SDMBase::setProperty(const std::string &name,const std::string &value) {
-	int r=setPropertyAPI(name.c_str(),value.c_str());
-	if(r) throw std::runtime_error("Can't set property \""+name+"\"");
+void SDMBase::clearCache() {
+	_cacheValues.clear();
+	_cacheLists.clear();
 }
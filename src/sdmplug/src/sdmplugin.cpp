@@ -25,6 +25,7 @@
 
 #include <stdexcept>
 #include <sstream>
+#include <cstring>
 
 /*
  * SDMPluginImpl definition
@@ -33,26 +34,42 @@
 class SDMPluginImpl {
 	LoadableModule _lib;
 	SDMImport _pf;
+	std::shared_ptr<SDMBase::mutex_t> _mutex;
 	
 public:
 	explicit SDMPluginImpl(const std::string &strFileName);
+	~SDMPluginImpl();
 
 	int getPropertyAPI(const char *name,char *buf,std::size_t n);
 	int setPropertyAPI(const char *name,const char *value);
+	int getPropertiesAPI(const char *names,char *buf,std::size_t n);
+	std::string lastErrorAPI() const {return _pf.lastError();}
 	
 	const SDMImport &functions() const {return _pf;}
+	const std::shared_ptr<SDMBase::mutex_t> &mutex() const {return _mutex;}
 	std::string path() const {return _lib.path();}
 private:
 	template <typename T> T funcAddr(const std::string &name) {
 		return reinterpret_cast<T>(_lib.getAddr(name));
 	}
+	template <typename T> T optFuncAddr(const std::string &name) {
+		try {
+			return funcAddr<T>(name);
+		}
+		catch(std::exception &) {
+			return nullptr;
+		}
+	}
 };
 
 /*
  * SDMPluginImpl members
  */
 
-SDMPluginImpl::SDMPluginImpl(const std::string &strFileName): _lib(strFileName) {
+SDMPluginImpl::SDMPluginImpl(const std::string &strFileName):
+	_lib(strFileName),
+	_mutex(std::make_shared<SDMBase::mutex_t>())
+{
 // Mandatory functions
 	_pf.ptrGetPluginProperty=funcAddr<PtrSdmGetPluginProperty>("sdmGetPluginProperty");
 	_pf.ptrSetPluginProperty=funcAddr<PtrSdmSetPluginProperty>("sdmSetPluginProperty");
@@ -99,16 +116,182 @@ SDMPluginImpl::SDMPluginImpl(const std::string &strFileName): _lib(strFileName)
 	catch(std::exception &) {
 		_pf.supportSources=false;
 	}
+	
+// Plugin capabilities. If the plugin reports them, only advertised
+// optional functions are resolved
+	std::memset(&_pf.caps,0,sizeof(_pf.caps));
+	_pf.caps.size=sizeof(_pf.caps);
+	_pf.caps.formats=1<<SDM_SAMPLE_DOUBLE;
+	sdm_uint32_t wanted=~sdm_uint32_t(0);
+	auto ptrGetCapabilities=optFuncAddr<PtrSdmGetCapabilities>("sdmGetCapabilities");
+	if(ptrGetCapabilities) {
+		sdm_capabilities_t caps;
+		std::memset(&caps,0,sizeof(caps));
+		caps.size=sizeof(caps);
+		if(ptrGetCapabilities(&caps)==0) {
+			_pf.caps=caps;
+			_pf.caps.size=sizeof(_pf.caps);
+			_pf.caps.formats|=1<<SDM_SAMPLE_DOUBLE;
+			wanted=caps.features;
+		}
+	}
+// Treat unknown thread safety levels as the most restrictive one
+	if(_pf.caps.threadSafety>SDM_THREADSAFE_FULL) _pf.caps.threadSafety=SDM_THREADSAFE_NONE;
+	
+// Optional diagnostic functions
+	_pf.ptrGetLastError=nullptr;
+	if(wanted&SDM_FEATURE_LASTERROR)
+		_pf.ptrGetLastError=optFuncAddr<PtrSdmGetLastError>("sdmGetLastError");
+	
+// Optional property functions
+	_pf.ptrGetPluginProperties=nullptr;
+	_pf.ptrGetDeviceProperties=nullptr;
+	_pf.ptrGetChannelProperties=nullptr;
+	_pf.ptrGetSourceProperties=nullptr;
+	if(wanted&SDM_FEATURE_BATCHPROPS) {
+		_pf.ptrGetPluginProperties=optFuncAddr<PtrSdmGetPluginProperties>("sdmGetPluginProperties");
+		_pf.ptrGetDeviceProperties=optFuncAddr<PtrSdmGetDeviceProperties>("sdmGetDeviceProperties");
+		if(_pf.supportChannels)
+			_pf.ptrGetChannelProperties=optFuncAddr<PtrSdmGetChannelProperties>("sdmGetChannelProperties");
+		if(_pf.supportSources)
+			_pf.ptrGetSourceProperties=optFuncAddr<PtrSdmGetSourceProperties>("sdmGetSourceProperties");
+	}
+	
+// Optional control channel extensions
+	_pf.ptrWriteRegs=nullptr;
+	_pf.ptrReadRegs=nullptr;
+	_pf.ptrSubmitWriteReg=nullptr;
+	_pf.ptrSubmitReadReg=nullptr;
+	_pf.ptrCompleteTransaction=nullptr;
+	_pf.ptrWriteReg64=nullptr;
+	_pf.ptrReadReg64=nullptr;
+	_pf.ptrWriteFIFO64=nullptr;
+	_pf.ptrReadFIFO64=nullptr;
+	_pf.ptrWriteMem64=nullptr;
+	_pf.ptrReadMem64=nullptr;
+	_pf.ptrModifyReg=nullptr;
+	_pf.ptrModifyRegs=nullptr;
+	if(_pf.supportChannels) {
+		if(wanted&SDM_FEATURE_REGBATCH) {
+			_pf.ptrWriteRegs=optFuncAddr<PtrSdmWriteRegs>("sdmWriteRegs");
+			_pf.ptrReadRegs=optFuncAddr<PtrSdmReadRegs>("sdmReadRegs");
+		}
+		if(wanted&SDM_FEATURE_ASYNCREGS) {
+			_pf.ptrSubmitWriteReg=optFuncAddr<PtrSdmSubmitWriteReg>("sdmSubmitWriteReg");
+			_pf.ptrSubmitReadReg=optFuncAddr<PtrSdmSubmitReadReg>("sdmSubmitReadReg");
+			_pf.ptrCompleteTransaction=optFuncAddr<PtrSdmCompleteTransaction>("sdmCompleteTransaction");
+		}
+		if(!_pf.ptrSubmitWriteReg||!_pf.ptrSubmitReadReg||!_pf.ptrCompleteTransaction) { // all are needed
+			_pf.ptrSubmitWriteReg=nullptr;
+			_pf.ptrSubmitReadReg=nullptr;
+			_pf.ptrCompleteTransaction=nullptr;
+		}
+		if(wanted&SDM_FEATURE_REG64) {
+			_pf.ptrWriteReg64=optFuncAddr<PtrSdmWriteReg64>("sdmWriteReg64");
+			_pf.ptrReadReg64=optFuncAddr<PtrSdmReadReg64>("sdmReadReg64");
+			_pf.ptrWriteFIFO64=optFuncAddr<PtrSdmWriteFIFO64>("sdmWriteFIFO64");
+			_pf.ptrReadFIFO64=optFuncAddr<PtrSdmReadFIFO64>("sdmReadFIFO64");
+			_pf.ptrWriteMem64=optFuncAddr<PtrSdmWriteMem64>("sdmWriteMem64");
+			_pf.ptrReadMem64=optFuncAddr<PtrSdmReadMem64>("sdmReadMem64");
+		}
+		if(!_pf.ptrWriteReg64||!_pf.ptrReadReg64||!_pf.ptrWriteFIFO64||
+			!_pf.ptrReadFIFO64||!_pf.ptrWriteMem64||!_pf.ptrReadMem64) { // all are needed
+			_pf.ptrWriteReg64=nullptr;
+			_pf.ptrReadReg64=nullptr;
+			_pf.ptrWriteFIFO64=nullptr;
+			_pf.ptrReadFIFO64=nullptr;
+			_pf.ptrWriteMem64=nullptr;
+			_pf.ptrReadMem64=nullptr;
+		}
+		if(wanted&SDM_FEATURE_MODIFYREG) {
+			_pf.ptrModifyReg=optFuncAddr<PtrSdmModifyReg>("sdmModifyReg");
+			_pf.ptrModifyRegs=optFuncAddr<PtrSdmModifyRegs>("sdmModifyRegs");
+		}
+		if(!_pf.ptrModifyReg||!_pf.ptrModifyRegs) { // both are needed
+			_pf.ptrModifyReg=nullptr;
+			_pf.ptrModifyRegs=nullptr;
+		}
+	}
+	
+// Optional data source extensions
+	_pf.ptrGetStreamFormat=nullptr;
+	_pf.ptrReadStreamTyped=nullptr;
+	_pf.ptrAcquirePacket=nullptr;
+	_pf.ptrReleasePacket=nullptr;
+	_pf.ptrSetReadyCallback=nullptr;
+	_pf.ptrReadStreams=nullptr;
+	_pf.ptrGetPacketInfo=nullptr;
+	if(_pf.supportSources) {
+		if(wanted&SDM_FEATURE_TYPEDREAD) {
+			_pf.ptrGetStreamFormat=optFuncAddr<PtrSdmGetStreamFormat>("sdmGetStreamFormat");
+			_pf.ptrReadStreamTyped=optFuncAddr<PtrSdmReadStreamTyped>("sdmReadStreamTyped");
+		}
+		if(wanted&SDM_FEATURE_ACQUIRE) {
+			_pf.ptrAcquirePacket=optFuncAddr<PtrSdmAcquirePacket>("sdmAcquirePacket");
+			_pf.ptrReleasePacket=optFuncAddr<PtrSdmReleasePacket>("sdmReleasePacket");
+		}
+		if(!_pf.ptrAcquirePacket||!_pf.ptrReleasePacket) { // both are needed
+			_pf.ptrAcquirePacket=nullptr;
+			_pf.ptrReleasePacket=nullptr;
+		}
+		if(wanted&SDM_FEATURE_READYCALLBACK)
+			_pf.ptrSetReadyCallback=optFuncAddr<PtrSdmSetReadyCallback>("sdmSetReadyCallback");
+		if(wanted&SDM_FEATURE_MULTISTREAM)
+			_pf.ptrReadStreams=optFuncAddr<PtrSdmReadStreams>("sdmReadStreams");
+		if(wanted&SDM_FEATURE_PACKETINFO)
+			_pf.ptrGetPacketInfo=optFuncAddr<PtrSdmGetPacketInfo>("sdmGetPacketInfo");
+	}
+	
+// Report only features that are actually available
+	_pf.caps.features=0;
+	if(_pf.ptrWriteRegs&&_pf.ptrReadRegs) _pf.caps.features|=SDM_FEATURE_REGBATCH;
+	if(_pf.ptrSubmitWriteReg) _pf.caps.features|=SDM_FEATURE_ASYNCREGS;
+	if(_pf.ptrGetStreamFormat&&_pf.ptrReadStreamTyped) _pf.caps.features|=SDM_FEATURE_TYPEDREAD;
+	if(_pf.ptrAcquirePacket) _pf.caps.features|=SDM_FEATURE_ACQUIRE;
+	if(_pf.ptrSetReadyCallback) _pf.caps.features|=SDM_FEATURE_READYCALLBACK;
+	if(_pf.ptrReadStreams) _pf.caps.features|=SDM_FEATURE_MULTISTREAM;
+	if(_pf.ptrGetPacketInfo) _pf.caps.features|=SDM_FEATURE_PACKETINFO;
+	if(_pf.ptrGetPluginProperties) _pf.caps.features|=SDM_FEATURE_BATCHPROPS;
+	if(_pf.ptrWriteReg64) _pf.caps.features|=SDM_FEATURE_REG64;
+	if(_pf.ptrModifyReg) _pf.caps.features|=SDM_FEATURE_MODIFYREG;
+	if(_pf.ptrGetLastError) _pf.caps.features|=SDM_FEATURE_LASTERROR;
+// Not a function group: plugins that don't report capabilities are
+// assumed to handle the decimation factor, as before
+	if(_pf.supportSources&&(wanted&SDM_FEATURE_DECIMATION)) _pf.caps.features|=SDM_FEATURE_DECIMATION;
+	
+// Plugin-level calls are attributed to the import table
+	const std::string strPath=_lib.path();
+	SDMStats::setObjectName(&_pf,strPath.substr(strPath.find_last_of("/\\")+1));
+	SDMTrace::openObject(&_pf,nullptr,SDM_TRACE_OPENPLUGIN,0,strPath.substr(strPath.find_last_of("/\\")+1));
+}
+
+SDMPluginImpl::~SDMPluginImpl() {
+	SDMTrace::closeObject(&_pf);
 }
 
 int SDMPluginImpl::getPropertyAPI(const char *name,char *buf,std::size_t n) {
 	if(!_lib) throw std::runtime_error("Plugin not loaded");
-	return _pf.ptrGetPluginProperty(name,buf,n);
+	SDMStats::Call call(&_pf,"sdmGetPluginProperty");
+	int r=_pf.ptrGetPluginProperty(name,buf,n);
+	if(r==0) SDMTrace::recordProperty(&_pf,SDM_TRACE_GETPROPERTY,name,buf,r);
+	return r;
 }
 
 int SDMPluginImpl::setPropertyAPI(const char *name,const char *value) {
 	if(!_lib) throw std::runtime_error("Plugin not loaded");
-	return _pf.ptrSetPluginProperty(name,value);
+	SDMStats::Call call(&_pf,"sdmSetPluginProperty");
+	int r=_pf.ptrSetPluginProperty(name,value);
+	SDMTrace::recordProperty(&_pf,SDM_TRACE_SETPROPERTY,name,value,r);
+	return r;
+}
+
+int SDMPluginImpl::getPropertiesAPI(const char *names,char *buf,std::size_t n) {
+	if(!_lib) throw std::runtime_error("Plugin not loaded");
+	if(!_pf.ptrGetPluginProperties) return SDM_NOTSUPPORTED;
+	SDMStats::Call call(&_pf,"sdmGetPluginProperties");
+	int r=_pf.ptrGetPluginProperties(names,buf,n);
+	if(r==0) SDMTrace::recordProperties(&_pf,buf,r);
+	return r;
 }
 
 /*
@@ -132,6 +315,14 @@ int SDMPlugin::getPropertyAPI(const char *name,char *buf,std::size_t n) {
 int SDMPlugin::setPropertyAPI(const char *name,const char *value) {
 	return impl().setPropertyAPI(name,value);
 }
+
+int SDMPlugin::getPropertiesAPI(const char *names,char *buf,std::size_t n) {
+	return impl().getPropertiesAPI(names,buf,n);
+}
+
+std::string SDMPlugin::lastErrorAPI() {
+	return impl().lastErrorAPI();
+}
 	
 SDMPlugin::SDMPlugin(const std::string &strFileName) {
 	open(strFileName);
@@ -166,6 +357,14 @@ void SDMPlugin::close() {
 const SDMImport &SDMPlugin::functions() const {
 	return impl().functions();
 }
+
+const sdm_capabilities_t &SDMPlugin::capabilities() const {
+	return impl().functions().caps;
+}
+
+std::shared_ptr<SDMBase::mutex_t> SDMPlugin::mutex() const {
+	return impl().mutex();
+}
 	
 SDMPlugin::operator bool() const {
 	return _impl.operator bool();
@@ -0,0 +1,196 @@
+/*
+ * Copyright (c) 2015-2022 Simple Device Model contributors
+ * 
+ * This file is part of the Simple Device Model (SDM) framework.
+ * 
+ * SDM framework is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SDM framework is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SDM framework.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * This module provides an implementation of the SDMPrefetchSource
+ * class.
+ */
+
+#include "sdmplug.h"
+
+#include <stdexcept>
+#include <chrono>
+#include <algorithm>
+
+SDMPrefetchSource::SDMPrefetchSource(const SDMSource &src,std::size_t ringPackets):
+	_src(src),
+	_slots(ringPackets)
+{
+	if(!_src) throw std::runtime_error("Source is not opened");
+	if(ringPackets==0) throw std::runtime_error("Ring buffer must hold at least one packet");
+	_mutex=_src.mutex();
+	_chunk=_src.plugin().capabilities().preferredPacketSize;
+	if(_chunk==0) _chunk=4096;
+}
+
+SDMPrefetchSource::~SDMPrefetchSource() {
+	stop();
+}
+
+void SDMPrefetchSource::start(const std::vector<int> &streams,std::size_t packets,int df) {
+	stop();
+	
+	{
+		std::unique_lock<SDMBase::mutex_t> lock(*_mutex);
+		_src.selectReadStreams(streams,packets,df);
+	}
+	
+// Preallocate packet buffers: a packet of the preferred size plus room
+// for the read that detects the end of the packet
+	_streams=streams;
+	_reserve.store(2*_chunk);
+	for(auto &slot: _slots) reserveBuffers(slot);
+	reserveBuffers(_scratch);
+	_done.assign(_streams.size(),0);
+	_lengths.assign(_streams.size(),0);
+	
+	_head.store(0);
+	_tail.store(0);
+	_dropped.store(0);
+	_failed.store(false);
+	_error=nullptr;
+	_stop.store(false);
+	_thread=std::thread(&SDMPrefetchSource::run,this);
+}
+
+void SDMPrefetchSource::stop() {
+	if(!_thread.joinable()) return;
+	_stop.store(true);
+	_thread.join();
+}
+
+bool SDMPrefetchSource::readPacket(Packet &packet,int msec) {
+	const std::size_t tail=_tail.load(std::memory_order_relaxed);
+	if(_head.load(std::memory_order_acquire)==tail) {
+		std::unique_lock<std::mutex> lock(_waitMutex);
+		_waitCv.wait_for(lock,std::chrono::milliseconds(msec),[&]{
+			return _head.load(std::memory_order_acquire)!=tail||_failed.load();
+		});
+		if(_head.load(std::memory_order_acquire)==tail) {
+			if(_failed.load()) std::rethrow_exception(_error);
+			return false;
+		}
+	}
+	
+	auto &slot=_slots[tail%_slots.size()];
+	packet.data.swap(slot.data);
+	packet.info=slot.info;
+	packet.hasInfo=slot.hasInfo;
+// The buffers received from the caller are sized here, so that the
+// producer doesn't allocate memory
+	reserveBuffers(slot);
+	_tail.store(tail+1,std::memory_order_release);
+	return true;
+}
+
+std::size_t SDMPrefetchSource::available() const {
+	return _head.load(std::memory_order_acquire)-_tail.load(std::memory_order_acquire);
+}
+
+void SDMPrefetchSource::reserveBuffers(Packet &packet) {
+	const std::size_t reserve=_reserve.load();
+	if(packet.data.size()!=_streams.size()) packet.data.resize(_streams.size());
+	for(auto &v: packet.data) if(v.capacity()<reserve) v.reserve(reserve);
+}
+
+// When the ring is full, the packet is fetched into the scratch buffer.
+// The drop decision is made after the fetch: if the consumer has freed
+// a slot in the meantime, the buffers are exchanged and the packet is
+// published.
+
+void SDMPrefetchSource::run() {
+	try {
+		while(!_stop.load()) {
+			const std::size_t head=_head.load(std::memory_order_relaxed);
+			const bool full=(head-_tail.load(std::memory_order_acquire)==_slots.size());
+			Packet &slot=_slots[head%_slots.size()];
+			if(!fetchPacket(full?_scratch:slot)) break; // stop requested
+			if(full) {
+				if(head-_tail.load(std::memory_order_acquire)==_slots.size()) {
+					_dropped++;
+					continue;
+				}
+				slot.data.swap(_scratch.data);
+				slot.info=_scratch.info;
+				slot.hasInfo=_scratch.hasInfo;
+			}
+			_head.store(head+1,std::memory_order_release);
+			notifyConsumer();
+		}
+	}
+	catch(...) {
+		_error=std::current_exception();
+		_failed.store(true);
+		notifyConsumer();
+	}
+}
+
+// Reads one packet from all selected streams. Non-blocking reads are
+// used so that the source mutex isn't held while waiting for data.
+// Buffers are used up to their capacity and trimmed to the number of
+// samples read at the end, so memory is only allocated for a packet
+// larger than any seen before.
+
+bool SDMPrefetchSource::fetchPacket(Packet &packet) {
+	for(auto &v: packet.data) v.resize(v.capacity());
+	std::fill(_done.begin(),_done.end(),0);
+	std::fill(_lengths.begin(),_lengths.end(),0);
+	std::size_t remaining=_streams.size();
+	
+	while(remaining>0) {
+		if(_stop.load()) return false;
+		bool progress=false;
+		{
+			std::unique_lock<SDMBase::mutex_t> lock(*_mutex,std::defer_lock);
+			if(!lock.try_lock_for(std::chrono::milliseconds(100))) continue;
+			for(std::size_t i=0;i<_streams.size();i++) {
+				if(_done[i]) continue;
+				auto &v=packet.data[i];
+				std::size_t &len=_lengths[i];
+				for(;;) {
+					if(v.size()-len<_chunk) {
+						v.resize(len+_chunk);
+						if(v.capacity()>_reserve.load()) _reserve.store(v.capacity());
+					}
+					int r=_src.readStream(_streams[i],v.data()+len,_chunk,SDMSource::NonBlocking);
+					if(r==SDMSource::WouldBlock) break;
+					len+=static_cast<std::size_t>(r);
+					if(r==0) { // end of packet
+						_done[i]=1;
+						remaining--;
+						break;
+					}
+					progress=true;
+				}
+			}
+			if(remaining==0) {
+				for(std::size_t i=0;i<_streams.size();i++) packet.data[i].resize(_lengths[i]);
+				packet.hasInfo=_src.packetInfo(packet.info);
+				_src.readNextPacket();
+			}
+		}
+		if(remaining>0&&!progress) _src.waitReady(10);
+	}
+	return true;
+}
+
+void SDMPrefetchSource::notifyConsumer() {
+// Locking the mutex prevents a lost wakeup between the consumer's
+// check and wait
+	std::lock_guard<std::mutex> lock(_waitMutex);
+	_waitCv.notify_all();
+}
@@ -22,14 +22,24 @@
  */
 
 #include "sdmplug.h"
+#include "sdmconvert.h"
 
 #include <stdexcept>
+#include <cstdint>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <thread>
+#include <map>
+#include <string>
+#include <algorithm>
 
 const SDMSource::Flags SDMSource::Normal=0;
 const SDMSource::Flags SDMSource::NonBlocking=1;
 const SDMSource::Flags SDMSource::AllowPartial=2;
 
 const int SDMSource::WouldBlock=SDM_WOULDBLOCK;
+const int SDMSource::NotSupported=SDM_NOTSUPPORTED;
 
 /*
  * SDMSourceImpl definition
@@ -40,6 +50,19 @@ class SDMSourceImpl {
 	void *_hSource;
 	int _id;
 	const SDMImport &_pf;
+	std::shared_ptr<SDMBase::mutex_t> _mutex;
+	std::vector<sdm_sample_t> _convBuf;
+	
+// Host-side decimation, used when the plugin doesn't handle "df" itself
+	SDMDecimator::Mode _decMode=SDMDecimator::Plain;
+	int _hostDf=1;
+	std::map<int,SDMDecimator> _decimators;
+	std::vector<sdm_sample_t> _decBuf;
+	
+	bool _notifications=false;
+	std::mutex _readyMutex;
+	std::condition_variable _readyCv;
+	bool _ready=false;
 	
 public:
 	SDMSourceImpl(const SDMDevice &d,int ch);
@@ -49,6 +72,7 @@ public:
 	SDMSourceImpl &operator=(const SDMSourceImpl &right)=delete;
 	
 	void *handle() const {return _hSource;}
+	const std::shared_ptr<SDMBase::mutex_t> &mutex() const {return _mutex;}
 	SDMPlugin &plugin() {return _device.plugin();}
 	const SDMPlugin &plugin() const {return _device.plugin();}
 	SDMDevice &device() {return _device;}
@@ -56,14 +80,33 @@ public:
 	
 	int getPropertyAPI(const char *name,char *buf,std::size_t n);
 	int setPropertyAPI(const char *name,const char *value);
+	int getPropertiesAPI(const char *names,char *buf,std::size_t n);
+	std::string lastErrorAPI() const {return _pf.lastError();}
 	
 	void selectReadStreams(const std::vector<int> &streams,std::size_t packets,int df);
+	void setDecimationMode(SDMDecimator::Mode mode);
+	SDMDecimator::Mode decimationMode() const {return _decMode;}
+	bool hostDecimation() const {return _hostDf>1;}
 	int readStream(int stream,sdm_sample_t *data,std::size_t n,SDMSource::Flags flags);
+	int readStreamTyped(int stream,void *data,std::size_t n,int format,SDMSource::Flags flags);
+	void readStreams(const int *streams,sdm_sample_t * const *data,const std::size_t *n,int *res,std::size_t count,SDMSource::Flags flags);
+	int acquirePacket(int stream,const sdm_sample_t *&data,std::size_t &n,SDMSource::Flags flags);
+	void releasePacket(int stream);
 	void readNextPacket();
 	void discardPackets();
 	int readStreamErrors();
 	
+	int streamFormat(int stream);
+	bool packetInfo(sdm_packet_info_t &info);
+	
+	bool readyNotification() const {return _notifications;}
+	bool waitReady(int msec);
+	
 	int id() const {return _id;}
+private:
+	int readDecimated(int stream,sdm_sample_t *data,std::size_t n,SDMSource::Flags flags);
+	int readTypedAPI(int stream,void *data,std::size_t n,int format,int nb);
+	static void SDMCALL readyCallback(void *context);
 };
 
 /*
@@ -73,43 +116,184 @@ public:
 SDMSourceImpl::SDMSourceImpl(const SDMDevice &d,int ch): _device(d),_pf(d.plugin().functions()) {
 	if(!_device) throw std::runtime_error("Device is not opened");
 	if(!_pf.supportSources) throw std::runtime_error("This plugin doesn't support data sources");
+	SDMStats::Call call(_device.handle(),"sdmOpenSource");
 	_hSource=_pf.ptrOpenSource(_device.handle(),ch);
-	if(!_hSource) throw sdmplugin_error("sdmOpenChannel");
+	if(!_hSource) throw sdmplugin_error("sdmOpenSource",_pf);
 	_id=ch;
+	SDMStats::setObjectName(_hSource,SDMStats::objectName(_device.handle())+"/source"+std::to_string(ch));
+	SDMTrace::openObject(_hSource,_device.handle(),SDM_TRACE_OPENSOURCE,ch);
+	switch(_pf.caps.threadSafety) {
+	case SDM_THREADSAFE_NONE:
+	case SDM_THREADSAFE_DEVICE:
+		_mutex=_device.mutex();
+		break;
+	default:
+		_mutex=std::make_shared<SDMBase::mutex_t>();
+	}
+	
+// Note: the plugin stops calling the callback before sdmCloseSource()
+// returns, so there is no need to unregister it
+	if(_pf.ptrSetReadyCallback) {
+		SDMStats::Call call(_hSource,"sdmSetReadyCallback");
+		_notifications=(_pf.ptrSetReadyCallback(_hSource,&SDMSourceImpl::readyCallback,this)==0);
+	}
 }
 
 SDMSourceImpl::~SDMSourceImpl() {
+	SDMStats::Call call(_hSource,"sdmCloseSource");
+	SDMTrace::closeObject(_hSource);
 	_pf.ptrCloseSource(_hSource);
 }
 
 int SDMSourceImpl::getPropertyAPI(const char *name,char *buf,std::size_t n) {
-	return _pf.ptrGetSourceProperty(_hSource,name,buf,n);
+	SDMStats::Call call(_hSource,"sdmGetSourceProperty");
+	int r=_pf.ptrGetSourceProperty(_hSource,name,buf,n);
+	if(r==0) SDMTrace::recordProperty(_hSource,SDM_TRACE_GETPROPERTY,name,buf,r);
+	return r;
 }
 
 int SDMSourceImpl::setPropertyAPI(const char *name,const char *value) {
-	return _pf.ptrSetSourceProperty(_hSource,name,value);
+	SDMStats::Call call(_hSource,"sdmSetSourceProperty");
+	int r=_pf.ptrSetSourceProperty(_hSource,name,value);
+	SDMTrace::recordProperty(_hSource,SDM_TRACE_SETPROPERTY,name,value,r);
+	return r;
+}
+
+int SDMSourceImpl::getPropertiesAPI(const char *names,char *buf,std::size_t n) {
+	if(!_pf.ptrGetSourceProperties) return SDM_NOTSUPPORTED;
+	SDMStats::Call call(_hSource,"sdmGetSourceProperties");
+	int r=_pf.ptrGetSourceProperties(_hSource,names,buf,n);
+	if(r==0) SDMTrace::recordProperties(_hSource,buf,r);
+	return r;
 }
 
 void SDMSourceImpl::selectReadStreams(const std::vector<int> &streams,std::size_t packets,int df) {
-	int r=_pf.ptrSelectReadStreams(_hSource,streams.data(),static_cast<int>(streams.size()),packets,df);
-	if(r) throw sdmplugin_error("sdmSelectReadStreams",r);
+	const bool host=(df>1&&!(_pf.caps.features&SDM_FEATURE_DECIMATION));
+	SDMStats::Call call(_hSource,"sdmSelectReadStreams");
+	int r=_pf.ptrSelectReadStreams(_hSource,streams.data(),static_cast<int>(streams.size()),packets,host?1:df);
+	if(SDMTrace::active()) {
+		std::vector<sdm_uint32_t> payload {static_cast<sdm_uint32_t>(host?1:df)};
+		for(int s: streams) payload.push_back(static_cast<sdm_uint32_t>(s));
+		SDMTrace::record(_hSource,SDM_TRACE_SELECTSTREAMS,packets,r,payload.data(),payload.size()*sizeof(sdm_uint32_t));
+	}
+	if(r) throw sdmplugin_error("sdmSelectReadStreams",r,_pf);
+	_decimators.clear();
+	_hostDf=host?df:1;
+	if(host) for(int s: streams) _decimators[s].setup(_decMode,df);
+}
+
+void SDMSourceImpl::setDecimationMode(SDMDecimator::Mode mode) {
+	_decMode=mode;
+	for(auto &d: _decimators) d.second.setup(mode,_hostDf);
 }
 
 int SDMSourceImpl::readStream(int stream,sdm_sample_t *data,std::size_t n,SDMSource::Flags flags) {
+	if(_hostDf>1&&n>0) return readDecimated(stream,data,n,flags);
+	
 	int nb=0;
 	if(flags&SDMSource::NonBlocking) nb=1;
 	
 	if(flags&SDMSource::NonBlocking||flags&SDMSource::AllowPartial||n==0) {
+		SDMStats::Call call(_hSource,"sdmReadStream");
 		int r=_pf.ptrReadStream(_hSource,stream,data,n,nb);
+		call.finish(r>0?r*sizeof(sdm_sample_t):0);
+		SDMTrace::recordSamples(_hSource,stream,data,SDM_SAMPLE_DOUBLE,r);
 		if(r==SDM_WOULDBLOCK) return SDMSource::WouldBlock;
-		if(r<0) throw sdmplugin_error("sdmReadStream",r);
+		if(r<0) throw sdmplugin_error("sdmReadStream",r,_pf);
 		return r;
 	}
 	else { // read all in a blocking manner
 		std::size_t samplesRead=0;
 		while(samplesRead<n) {
+			SDMStats::Call call(_hSource,"sdmReadStream");
 			int r=_pf.ptrReadStream(_hSource,stream,data+samplesRead,n-samplesRead,nb);
-			if(r<0) throw sdmplugin_error("sdmReadStream",r);
+			call.finish(r>0?r*sizeof(sdm_sample_t):0);
+			SDMTrace::recordSamples(_hSource,stream,data+samplesRead,SDM_SAMPLE_DOUBLE,r);
+			if(r<0) throw sdmplugin_error("sdmReadStream",r,_pf);
+			if(r==0) break; // end of packet
+			samplesRead+=r;
+		}
+		return static_cast<int>(samplesRead);
+	}
+}
+
+// Reads from the plugin until n decimated samples are produced. With
+// NonBlocking or AllowPartial flags, returns as soon as there is at least
+// one sample to return. Input samples which don't produce output yet are
+// kept in the decimator state.
+
+int SDMSourceImpl::readDecimated(int stream,sdm_sample_t *data,std::size_t n,SDMSource::Flags flags) {
+	auto it=_decimators.find(stream);
+	if(it==_decimators.end()) throw std::runtime_error("Stream "+std::to_string(stream)+" is not selected");
+	auto &dec=it->second;
+	
+	const int nb=(flags&SDMSource::NonBlocking)?1:0;
+	const bool partial=(flags&SDMSource::NonBlocking||flags&SDMSource::AllowPartial);
+	const std::size_t maxChunk=std::max<std::size_t>(65536,dec.maxInput(1));
+	
+	std::size_t produced=0;
+	while(produced<n) {
+		const std::size_t want=std::min(dec.maxInput(n-produced),maxChunk);
+		if(_decBuf.size()<want) _decBuf.resize(want);
+		SDMStats::Call call(_hSource,"sdmReadStream");
+		int r=_pf.ptrReadStream(_hSource,stream,_decBuf.data(),want,nb);
+		call.finish(r>0?r*sizeof(sdm_sample_t):0);
+		SDMTrace::recordSamples(_hSource,stream,_decBuf.data(),SDM_SAMPLE_DOUBLE,r);
+		if(r==SDM_WOULDBLOCK) {
+			if(produced>0) break;
+			return SDMSource::WouldBlock;
+		}
+		if(r<0) throw sdmplugin_error("sdmReadStream",r,_pf);
+		if(r==0) break; // end of packet
+		produced+=dec.process(_decBuf.data(),static_cast<std::size_t>(r),data+produced);
+		if(partial&&produced>0) break;
+	}
+	return static_cast<int>(produced);
+}
+
+void SDMSourceImpl::readStreams(const int *streams,sdm_sample_t * const *data,const std::size_t *n,int *res,std::size_t count,SDMSource::Flags flags) {
+// Blocking reads of whole buffers are done stream by stream anyway
+	if(!_pf.ptrReadStreams||_hostDf>1||!(flags&SDMSource::NonBlocking||flags&SDMSource::AllowPartial)) {
+		for(std::size_t i=0;i<count;i++) res[i]=readStream(streams[i],data[i],n[i],flags);
+		return;
+	}
+	
+	int nb=0;
+	if(flags&SDMSource::NonBlocking) nb=1;
+	
+	SDMStats::Call call(_hSource,"sdmReadStreams");
+	int r=_pf.ptrReadStreams(_hSource,streams,data,n,res,count,nb);
+	std::uint64_t bytes=0;
+	if(!r) for(std::size_t i=0;i<count;i++) if(res[i]>0) bytes+=res[i]*sizeof(sdm_sample_t);
+	call.finish(bytes);
+	if(!r) for(std::size_t i=0;i<count;i++) SDMTrace::recordSamples(_hSource,streams[i],data[i],SDM_SAMPLE_DOUBLE,res[i]);
+	if(r) throw sdmplugin_error("sdmReadStreams",r,_pf);
+	for(std::size_t i=0;i<count;i++) {
+		if(res[i]<0&&res[i]!=SDM_WOULDBLOCK) throw sdmplugin_error("sdmReadStreams",res[i],_pf);
+	}
+}
+
+int SDMSourceImpl::readStreamTyped(int stream,void *data,std::size_t n,int format,SDMSource::Flags flags) {
+	if(format==SDM_SAMPLE_DOUBLE) return readStream(stream,static_cast<sdm_sample_t*>(data),n,flags);
+	
+	const std::size_t size=SDMSource::sampleSize(format);
+	if(size==0) throw std::runtime_error("Unsupported sample format");
+	
+	int nb=0;
+	if(flags&SDMSource::NonBlocking) nb=1;
+	
+	if(flags&SDMSource::NonBlocking||flags&SDMSource::AllowPartial||n==0) {
+		int r=readTypedAPI(stream,data,n,format,nb);
+		if(r==SDM_WOULDBLOCK) return SDMSource::WouldBlock;
+		if(r<0) throw sdmplugin_error("sdmReadStreamTyped",r,_pf);
+		return r;
+	}
+	else { // read all in a blocking manner
+		char *bytes=static_cast<char*>(data);
+		std::size_t samplesRead=0;
+		while(samplesRead<n) {
+			int r=readTypedAPI(stream,bytes+samplesRead*size,n-samplesRead,format,nb);
+			if(r<0) throw sdmplugin_error("sdmReadStreamTyped",r,_pf);
 			if(r==0) break; // end of packet
 			samplesRead+=r;
 		}
@@ -117,17 +301,120 @@ int SDMSourceImpl::readStream(int stream,sdm_sample_t *data,std::size_t n,SDMSou
 	}
 }
 
+int SDMSourceImpl::readTypedAPI(int stream,void *data,std::size_t n,int format,int nb) {
+	if(_pf.ptrReadStreamTyped&&_hostDf==1) {
+		SDMStats::Call call(_hSource,"sdmReadStreamTyped");
+		int r=_pf.ptrReadStreamTyped(_hSource,stream,data,n,format,nb);
+		call.finish(r>0?r*SDMSource::sampleSize(format):0);
+		SDMTrace::recordSamples(_hSource,stream,data,format,r);
+		return r;
+	}
+	
+// The plugin doesn't support typed reads (or samples are decimated here), convert samples here
+	if(_convBuf.size()<n) _convBuf.resize(n);
+	int r;
+	if(_hostDf>1) r=readDecimated(stream,_convBuf.data(),n,nb?SDMSource::NonBlocking:SDMSource::AllowPartial);
+	else {
+		SDMStats::Call call(_hSource,"sdmReadStream");
+		r=_pf.ptrReadStream(_hSource,stream,_convBuf.data(),n,nb);
+		call.finish(r>0?r*sizeof(sdm_sample_t):0);
+		SDMTrace::recordSamples(_hSource,stream,_convBuf.data(),SDM_SAMPLE_DOUBLE,r);
+	}
+	if(r<=0) return r;
+	
+	sdmConvertSamples(_convBuf.data(),data,r,format);
+	return r;
+}
+
+int SDMSourceImpl::acquirePacket(int stream,const sdm_sample_t *&data,std::size_t &n,SDMSource::Flags flags) {
+	if(!_pf.ptrAcquirePacket||_hostDf>1) return SDMSource::NotSupported;
+	
+	int nb=0;
+	if(flags&SDMSource::NonBlocking) nb=1;
+	
+	const sdm_sample_t *ptr=nullptr;
+	std::size_t size=0;
+	SDMStats::Call call(_hSource,"sdmAcquirePacket");
+	int r=_pf.ptrAcquirePacket(_hSource,stream,&ptr,&size,nb);
+	call.finish(r?0:size*sizeof(sdm_sample_t));
+	if(r==0) SDMTrace::recordSamples(_hSource,stream,ptr,SDM_SAMPLE_DOUBLE,static_cast<int>(size));
+	if(r==SDM_WOULDBLOCK) return SDMSource::WouldBlock;
+	if(r==SDM_NOTSUPPORTED) return SDMSource::NotSupported;
+	if(r<0) throw sdmplugin_error("sdmAcquirePacket",r,_pf);
+	data=ptr;
+	n=size;
+	return 0;
+}
+
+void SDMSourceImpl::releasePacket(int stream) {
+	if(!_pf.ptrReleasePacket) return;
+	SDMStats::Call call(_hSource,"sdmReleasePacket");
+	int r=_pf.ptrReleasePacket(_hSource,stream);
+	if(r) throw sdmplugin_error("sdmReleasePacket",r,_pf);
+}
+
+bool SDMSourceImpl::waitReady(int msec) {
+	if(!_notifications) { // the source can't notify us, just wait
+		std::this_thread::sleep_for(std::chrono::milliseconds(msec));
+		return false;
+	}
+	std::unique_lock<std::mutex> lock(_readyMutex);
+	_readyCv.wait_for(lock,std::chrono::milliseconds(msec),[this]{return _ready;});
+	bool r=_ready;
+	_ready=false;
+	return r;
+}
+
+void SDMCALL SDMSourceImpl::readyCallback(void *context) {
+	auto impl=static_cast<SDMSourceImpl*>(context);
+	{
+		std::lock_guard<std::mutex> lock(impl->_readyMutex);
+		impl->_ready=true;
+	}
+	impl->_readyCv.notify_all();
+}
+
+int SDMSourceImpl::streamFormat(int stream) {
+	if(!_pf.ptrGetStreamFormat) return SDM_SAMPLE_DOUBLE;
+	SDMStats::Call call(_hSource,"sdmGetStreamFormat");
+	int r=_pf.ptrGetStreamFormat(_hSource,stream);
+	if(r<0) throw sdmplugin_error("sdmGetStreamFormat",r,_pf);
+	return r;
+}
+
+bool SDMSourceImpl::packetInfo(sdm_packet_info_t &info) {
+	if(!_pf.ptrGetPacketInfo) return false;
+	sdm_packet_info_t tmp {};
+	SDMStats::Call call(_hSource,"sdmGetPacketInfo");
+	int r=_pf.ptrGetPacketInfo(_hSource,&tmp);
+	SDMTrace::record(_hSource,SDM_TRACE_PACKETINFO,0,r,&tmp,r?0:sizeof(tmp));
+	if(r==SDM_NOTSUPPORTED) return false;
+	if(r) throw sdmplugin_error("sdmGetPacketInfo",r,_pf);
+	info=tmp;
+	return true;
+}
+
 void SDMSourceImpl::readNextPacket() {
+	SDMStats::Call call(_hSource,"sdmReadNextPacket");
 	int r=_pf.ptrReadNextPacket(_hSource);
-	if(r) throw sdmplugin_error("sdmReadNextPacket",r);
+	SDMTrace::record(_hSource,SDM_TRACE_READNEXTPACKET,0,r);
+	if(r) throw sdmplugin_error("sdmReadNextPacket",r,_pf);
+// Packets are decimated independently, don't carry state over
+	for(auto &d: _decimators) d.second.reset();
 }
 
 void SDMSourceImpl::discardPackets() {
+	SDMStats::Call call(_hSource,"sdmDiscardPackets");
 	_pf.ptrDiscardPackets(_hSource);
+	SDMTrace::record(_hSource,SDM_TRACE_DISCARDPACKETS,0,0);
+	for(auto &d: _decimators) d.second.reset();
 }
 
 int SDMSourceImpl::readStreamErrors() {
-	return _pf.ptrReadStreamErrors(_hSource);
+	SDMStats::Call call(_hSource,"sdmReadStreamErrors");
+	int r=_pf.ptrReadStreamErrors(_hSource);
+	SDMTrace::record(_hSource,SDM_TRACE_READSTREAMERRORS,0,r);
+	return r;
 }
 
 /*
@@ -156,6 +443,14 @@ int SDMSource::setPropertyAPI(const char *name,const char *value) {
 	return impl().setPropertyAPI(name,value);
 }
 
+int SDMSource::getPropertiesAPI(const char *names,char *buf,std::size_t n) {
+	return impl().getPropertiesAPI(names,buf,n);
+}
+
+std::string SDMSource::lastErrorAPI() {
+	return impl().lastErrorAPI();
+}
+
 void *SDMSource::handle() const {
 	return impl().handle();
 }
@@ -188,10 +483,38 @@ void SDMSource::selectReadStreams(const std::vector<int> &streams,std::size_t pa
 	impl().selectReadStreams(streams,packets,df);
 }
 
+void SDMSource::setDecimationMode(SDMDecimator::Mode mode) {
+	impl().setDecimationMode(mode);
+}
+
+SDMDecimator::Mode SDMSource::decimationMode() const {
+	return impl().decimationMode();
+}
+
+bool SDMSource::hostDecimation() const {
+	return impl().hostDecimation();
+}
+
 int SDMSource::readStream(int stream,sdm_sample_t *data,std::size_t n,Flags flags) {
 	return impl().readStream(stream,data,n,flags);
 }
 
+int SDMSource::readStreamTyped(int stream,void *data,std::size_t n,int format,Flags flags) {
+	return impl().readStreamTyped(stream,data,n,format,flags);
+}
+
+void SDMSource::readStreams(const int *streams,sdm_sample_t * const *data,const std::size_t *n,int *res,std::size_t count,Flags flags) {
+	impl().readStreams(streams,data,n,res,count,flags);
+}
+
+int SDMSource::acquirePacket(int stream,const sdm_sample_t *&data,std::size_t &n,Flags flags) {
+	return impl().acquirePacket(stream,data,n,flags);
+}
+
+void SDMSource::releasePacket(int stream) {
+	impl().releasePacket(stream);
+}
+
 void SDMSource::readNextPacket() {
 	return impl().readNextPacket();
 }
@@ -204,6 +527,45 @@ int SDMSource::readStreamErrors() {
 	return impl().readStreamErrors();
 }
 
+int SDMSource::streamFormat(int stream) {
+	return impl().streamFormat(stream);
+}
+
+bool SDMSource::packetInfo(sdm_packet_info_t &info) {
+	return impl().packetInfo(info);
+}
+
+bool SDMSource::readyNotification() const {
+	return impl().readyNotification();
+}
+
+bool SDMSource::waitReady(int msec) {
+	return impl().waitReady(msec);
+}
+
+std::shared_ptr<SDMBase::mutex_t> SDMSource::mutex() const {
+	return impl().mutex();
+}
+
+std::size_t SDMSource::sampleSize(int format) {
+	switch(format) {
+	case SDM_SAMPLE_DOUBLE:
+		return sizeof(double);
+	case SDM_SAMPLE_FLOAT:
+		return sizeof(float);
+	case SDM_SAMPLE_INT8:
+	case SDM_SAMPLE_UINT8:
+		return 1;
+	case SDM_SAMPLE_INT16:
+	case SDM_SAMPLE_UINT16:
+		return 2;
+	case SDM_SAMPLE_INT32:
+		return 4;
+	default:
+		return 0;
+	}
+}
+
 SDMSource::operator bool() const {
 	return _impl.operator bool();
 }
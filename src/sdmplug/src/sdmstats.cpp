@@ -0,0 +1,250 @@
+/*
+ * Copyright (c) 2015-2022 Simple Device Model contributors
+ * 
+ * This file is part of the Simple Device Model (SDM) framework.
+ * 
+ * SDM framework is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SDM framework is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SDM framework.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * This module provides an implementation of the SDMStats class.
+ */
+
+#include "sdmplug.h"
+
+#include <cstdlib>
+#include <cmath>
+#include <sstream>
+#include <utility>
+
+namespace {
+	struct Registry {
+		std::mutex mutex;
+		std::map<const void*,std::string> names;
+		std::map<std::pair<std::string,std::string>,SDMStats::Record> records;
+	};
+	
+	Registry &registry() {
+		static Registry r;
+		return r;
+	}
+	
+	std::atomic<bool> &enabledFlag() {
+		static std::atomic<bool> flag([]{
+			const char *env=std::getenv("SDM_STATS");
+			return env&&*env&&std::string(env)!="0";
+		}());
+		return flag;
+	}
+	
+	std::string jsonString(const std::string &str) {
+		std::string res="\"";
+		for(char ch: str) {
+			if(ch=='\"'||ch=='\\') res.push_back('\\');
+			if(static_cast<unsigned char>(ch)<0x20) res.push_back(' ');
+			else res.push_back(ch);
+		}
+		res.push_back('\"');
+		return res;
+	}
+	
+	std::string csvString(const std::string &str) {
+		if(str.find_first_of(",\"\r\n")==std::string::npos) return str;
+		std::string res="\"";
+		for(char ch: str) {
+			if(ch=='\"') res.push_back('\"');
+			res.push_back(ch);
+		}
+		res.push_back('\"');
+		return res;
+	}
+}
+
+/*
+ * SDMStats::Record members
+ */
+
+// Returns the latency below which "p" percent of calls fall. The value
+// is the middle of the histogram bucket, clamped to the observed range.
+
+std::uint64_t SDMStats::Record::percentile(double p) const {
+	if(calls==0||histogram.empty()) return 0;
+	if(p<0) p=0;
+	if(p>100) p=100;
+	std::uint64_t target=static_cast<std::uint64_t>(std::ceil(p/100*static_cast<double>(calls)));
+	if(target==0) target=1;
+	
+	std::uint64_t cumulative=0;
+	for(int i=0;i<Buckets;i++) {
+		cumulative+=histogram[i];
+		if(cumulative<target) continue;
+		const std::uint64_t lower=bucketLowerBound(i);
+		const std::uint64_t upper=(i+1<Buckets)?bucketLowerBound(i+1):lower;
+		std::uint64_t value=lower+(upper-lower)/2;
+		if(value<minNs) value=minNs;
+		if(value>maxNs) value=maxNs;
+		return value;
+	}
+	return maxNs;
+}
+
+/*
+ * SDMStats::Call members
+ */
+
+SDMStats::Call::Call(const void *object,const char *function):
+	_object(object),
+	_function(function),
+	_active(SDMStats::enabled())
+{
+	if(_active) _start=std::chrono::steady_clock::now();
+}
+
+void SDMStats::Call::record(std::uint64_t bytes) {
+	_active=false;
+	auto const ns=static_cast<std::uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now()-_start).count());
+	
+	auto &reg=registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	
+	std::string object;
+	auto it=reg.names.find(_object);
+	if(it!=reg.names.end()) object=it->second;
+	else {
+		std::ostringstream ss;
+		ss<<"object@"<<_object;
+		object=ss.str();
+	}
+	
+	auto &rec=reg.records[std::make_pair(object,std::string(_function))];
+	if(rec.calls==0) {
+		rec.object=object;
+		rec.function=_function;
+		rec.histogram.assign(Buckets,0);
+		rec.minNs=ns;
+		rec.maxNs=ns;
+	}
+	rec.calls++;
+	rec.bytes+=bytes;
+	rec.totalNs+=ns;
+	if(ns<rec.minNs) rec.minNs=ns;
+	if(ns>rec.maxNs) rec.maxNs=ns;
+	rec.histogram[bucket(ns)]++;
+}
+
+/*
+ * SDMStats members
+ */
+
+void SDMStats::setEnabled(bool enable) {
+	enabledFlag().store(enable);
+}
+
+bool SDMStats::enabled() {
+	return enabledFlag().load(std::memory_order_relaxed);
+}
+
+void SDMStats::reset() {
+	auto &reg=registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	reg.records.clear();
+}
+
+// Statistics are accumulated by name, so that an object reopened
+// with the same name continues its records
+
+void SDMStats::setObjectName(const void *object,const std::string &name) {
+	auto &reg=registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	reg.names[object]=name;
+}
+
+std::string SDMStats::objectName(const void *object) {
+	auto &reg=registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	auto it=reg.names.find(object);
+	if(it==reg.names.end()) return std::string();
+	return it->second;
+}
+
+std::vector<SDMStats::Record> SDMStats::records() {
+	auto &reg=registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	std::vector<Record> res;
+	res.reserve(reg.records.size());
+	for(auto const &item: reg.records) res.push_back(item.second);
+	return res;
+}
+
+std::string SDMStats::toJSON() {
+	std::ostringstream ss;
+	ss<<"{\"enabled\":"<<(enabled()?"true":"false")<<",\"records\":[";
+	bool first=true;
+	for(auto const &rec: records()) {
+		if(!first) ss<<",";
+		first=false;
+		ss<<"{\"object\":"<<jsonString(rec.object)
+			<<",\"function\":"<<jsonString(rec.function)
+			<<",\"calls\":"<<rec.calls
+			<<",\"bytes\":"<<rec.bytes
+			<<",\"total_ns\":"<<rec.totalNs
+			<<",\"min_ns\":"<<rec.minNs
+			<<",\"mean_ns\":"<<rec.totalNs/rec.calls
+			<<",\"p50_ns\":"<<rec.percentile(50)
+			<<",\"p90_ns\":"<<rec.percentile(90)
+			<<",\"p99_ns\":"<<rec.percentile(99)
+			<<",\"max_ns\":"<<rec.maxNs
+			<<",\"histogram\":[";
+		bool firstBucket=true;
+		for(int i=0;i<Buckets;i++) {
+			if(rec.histogram[i]==0) continue;
+			if(!firstBucket) ss<<",";
+			firstBucket=false;
+			ss<<"["<<bucketLowerBound(i)<<","<<rec.histogram[i]<<"]";
+		}
+		ss<<"]}";
+	}
+	ss<<"]}";
+	return ss.str();
+}
+
+std::string SDMStats::toCSV() {
+	std::ostringstream ss;
+	ss<<"object,function,calls,bytes,total_ns,min_ns,mean_ns,p50_ns,p90_ns,p99_ns,max_ns\n";
+	for(auto const &rec: records()) {
+		ss<<csvString(rec.object)<<","<<csvString(rec.function)<<","
+			<<rec.calls<<","<<rec.bytes<<","<<rec.totalNs<<","
+			<<rec.minNs<<","<<rec.totalNs/rec.calls<<","
+			<<rec.percentile(50)<<","<<rec.percentile(90)<<","<<rec.percentile(99)<<","
+			<<rec.maxNs<<"\n";
+	}
+	return ss.str();
+}
+
+// Values below 8 ns have their own buckets. Above that, the bucket
+// is determined by the highest set bit and the two bits following it.
+
+int SDMStats::bucket(std::uint64_t ns) {
+	if(ns<4) return static_cast<int>(ns);
+	int e=0;
+	for(std::uint64_t v=ns;v>1;v>>=1) e++;
+	const int sub=static_cast<int>((ns>>(e-2))&3);
+	return 4*(e-1)+sub;
+}
+
+std::uint64_t SDMStats::bucketLowerBound(int i) {
+	if(i<4) return static_cast<std::uint64_t>(i);
+	const int e=i/4+1;
+	const std::uint64_t sub=static_cast<std::uint64_t>(i%4);
+	return (4+sub)<<(e-2);
+}
@@ -0,0 +1,270 @@
+/*
+ * Copyright (c) 2015-2022 Simple Device Model contributors
+ * 
+ * This file is part of the Simple Device Model (SDM) framework.
+ * 
+ * SDM framework is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Lesser General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * SDM framework is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public License
+ * along with SDM framework.  If not, see <https://www.gnu.org/licenses/>.
+ *
+ * This module provides an implementation of the SDMTrace class.
+ */
+
+#include "sdmplug.h"
+
+#include <fstream>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <cmath>
+#include <stdexcept>
+#include <algorithm>
+
+namespace {
+	struct Object {
+		std::uint32_t id;
+		std::uint32_t type;
+		const void *parent;
+		int index;
+		std::string name;
+	};
+	
+	struct Registry {
+		std::mutex mutex;
+		std::map<const void*,Object> objects;
+		std::uint32_t nextId=1;
+		std::ofstream out;
+		std::chrono::steady_clock::time_point start;
+		std::vector<char> buf;
+		
+		Registry();
+		void write(std::uint32_t type,std::uint32_t object,std::uint64_t arg,int status,const void *payload,std::size_t size);
+		void writeOpen(const Object &obj);
+		std::uint32_t id(const void *object) const;
+	};
+	
+	std::atomic<bool> &activeFlag() {
+		static std::atomic<bool> flag(false);
+		return flag;
+	}
+	
+	Registry &registry() {
+		static Registry r;
+		return r;
+	}
+	
+	void startLocked(Registry &reg,const std::string &path) {
+		if(reg.out.is_open()) reg.out.close();
+		reg.out.clear();
+		reg.out.open(path,std::ios::out|std::ios::binary|std::ios::trunc);
+		if(!reg.out) throw std::runtime_error("Cannot create trace file \""+path+"\"");
+		
+		sdm_trace_header_t header {};
+		std::memcpy(header.magic,SDM_TRACE_MAGIC,sizeof(header.magic));
+		header.version=SDM_TRACE_VERSION;
+		header.byteOrder=SDM_TRACE_BYTEORDER;
+		reg.out.write(reinterpret_cast<const char*>(&header),sizeof(header));
+		reg.start=std::chrono::steady_clock::now();
+		
+// Introduce objects opened before the trace has started, parents first
+		std::vector<const Object*> live;
+		for(auto const &item: reg.objects) live.push_back(&item.second);
+		std::sort(live.begin(),live.end(),[](const Object *a,const Object *b){return a->id<b->id;});
+		for(auto obj: live) reg.writeOpen(*obj);
+		
+		activeFlag().store(true);
+	}
+	
+	template <typename T> bool fitsFormat(const sdm_sample_t *data,std::size_t n) {
+		for(std::size_t i=0;i<n;i++) {
+			if(static_cast<sdm_sample_t>(static_cast<T>(data[i]))!=data[i]) return false;
+		}
+		return true;
+	}
+	
+	bool inRange(const sdm_sample_t *data,std::size_t n,double lo,double hi) {
+		for(std::size_t i=0;i<n;i++) {
+			if(!(data[i]>=lo&&data[i]<=hi)) return false;
+		}
+		return true;
+	}
+	
+	template <typename T> void narrow(const sdm_sample_t *data,std::size_t n,std::vector<char> &out) {
+		out.resize(n*sizeof(T));
+		T *dst=reinterpret_cast<T*>(out.data());
+		for(std::size_t i=0;i<n;i++) dst[i]=static_cast<T>(data[i]);
+	}
+}
+
+/*
+ * Registry members
+ */
+
+Registry::Registry() {
+	const char *env=std::getenv("SDM_TRACE");
+	if(!env||!*env) return;
+	try {
+		startLocked(*this,env);
+	}
+	catch(std::exception &) {}
+}
+
+void Registry::write(std::uint32_t type,std::uint32_t object,std::uint64_t arg,int status,const void *payload,std::size_t size) {
+	if(!out.is_open()) return;
+	sdm_trace_record_t rec {};
+	rec.type=type;
+	rec.object=object;
+	rec.time=static_cast<sdm_uint64_t>(std::chrono::duration_cast<std::chrono::nanoseconds>(
+		std::chrono::steady_clock::now()-start).count());
+	rec.arg=arg;
+	rec.status=static_cast<sdm_uint32_t>(status);
+	rec.size=static_cast<sdm_uint32_t>(size);
+	out.write(reinterpret_cast<const char*>(&rec),sizeof(rec));
+	if(size>0) out.write(static_cast<const char*>(payload),size);
+}
+
+void Registry::writeOpen(const Object &obj) {
+	if(obj.type==SDM_TRACE_OPENPLUGIN) {
+		write(obj.type,obj.id,0,0,obj.name.c_str(),obj.name.size());
+	}
+	else {
+		sdm_uint32_t parent=id(obj.parent);
+		write(obj.type,obj.id,static_cast<std::uint64_t>(obj.index),0,&parent,sizeof(parent));
+	}
+}
+
+std::uint32_t Registry::id(const void *object) const {
+	auto it=objects.find(object);
+	if(it==objects.end()) return 0;
+	return it->second.id;
+}
+
+/*
+ * SDMTrace members
+ */
+
+void SDMTrace::start(const std::string &path) {
+	auto &reg=registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	activeFlag().store(false);
+	startLocked(reg,path);
+}
+
+void SDMTrace::stop() {
+	auto &reg=registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	activeFlag().store(false);
+	if(reg.out.is_open()) reg.out.close();
+}
+
+bool SDMTrace::active() {
+	registry(); // make sure the SDM_TRACE variable has been checked
+	return activeFlag().load(std::memory_order_relaxed);
+}
+
+void SDMTrace::openObject(const void *object,const void *parent,std::uint32_t type,int index,const std::string &name) {
+	auto &reg=registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	auto &obj=reg.objects[object];
+	obj.id=reg.nextId++;
+	obj.type=type;
+	obj.parent=parent;
+	obj.index=index;
+	obj.name=name;
+	if(activeFlag().load()) reg.writeOpen(obj);
+}
+
+void SDMTrace::closeObject(const void *object) {
+	auto &reg=registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	auto it=reg.objects.find(object);
+	if(it==reg.objects.end()) return;
+	if(activeFlag().load()) reg.write(SDM_TRACE_CLOSE,it->second.id,0,0,nullptr,0);
+	reg.objects.erase(it);
+}
+
+void SDMTrace::record(const void *object,std::uint32_t type,std::uint64_t arg,int status,const void *payload,std::size_t size) {
+	if(!active()) return;
+	auto &reg=registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	reg.write(type,reg.id(object),arg,status,payload,size);
+}
+
+void SDMTrace::recordProperty(const void *object,std::uint32_t type,const char *name,const char *value,int status) {
+	if(!active()) return;
+	std::string payload(name);
+	payload.push_back('\0');
+	payload.append(value);
+	payload.push_back('\0');
+	record(object,type,0,status,payload.data(),payload.size());
+}
+
+// Batch query results consist of name/value pairs terminated
+// by an empty name
+
+void SDMTrace::recordProperties(const void *object,const char *buf,int status) {
+	if(!active()) return;
+	std::size_t size=0;
+	if(status==0) {
+		for(;;) {
+			const std::size_t nameLen=std::strlen(buf+size);
+			if(nameLen==0) break;
+			size+=nameLen+1;
+			size+=std::strlen(buf+size)+1;
+		}
+		size++;
+	}
+	record(object,SDM_TRACE_GETPROPERTIES,0,status,buf,size);
+}
+
+void SDMTrace::recordRegs(const void *object,std::uint32_t type,const sdm_addr_t *addr,const sdm_reg_t *data,std::size_t n,int status) {
+	if(!active()) return;
+	std::vector<sdm_reg_t> payload(addr,addr+n);
+	if(status==0) payload.insert(payload.end(),data,data+n);
+	record(object,type,n,status,payload.data(),payload.size()*sizeof(sdm_reg_t));
+}
+
+// Samples are stored in the narrowest format that represents them
+// exactly, which is typically an integer type for ADC data
+
+void SDMTrace::recordSamples(const void *object,int stream,const void *data,int format,int status) {
+	if(status==SDM_WOULDBLOCK||!active()) return;
+	const std::size_t n=(status>0)?static_cast<std::size_t>(status):0;
+	
+	auto &reg=registry();
+	std::lock_guard<std::mutex> lock(reg.mutex);
+	
+	const void *payload=data;
+	std::size_t size=n*SDMSource::sampleSize(format);
+	if(format==SDM_SAMPLE_DOUBLE&&n>0) {
+		auto samples=static_cast<const sdm_sample_t*>(data);
+		if(inRange(samples,n,-32768,32767)&&fitsFormat<std::int16_t>(samples,n)) {
+			narrow<std::int16_t>(samples,n,reg.buf);
+			format=SDM_SAMPLE_INT16;
+		}
+		else if(inRange(samples,n,-2147483648.0,2147483647.0)&&fitsFormat<std::int32_t>(samples,n)) {
+			narrow<std::int32_t>(samples,n,reg.buf);
+			format=SDM_SAMPLE_INT32;
+		}
+		else if(inRange(samples,n,-3.402823466e38,3.402823466e38)&&fitsFormat<float>(samples,n)) {
+			narrow<float>(samples,n,reg.buf);
+			format=SDM_SAMPLE_FLOAT;
+		}
+		if(format!=SDM_SAMPLE_DOUBLE) {
+			payload=reg.buf.data();
+			size=reg.buf.size();
+		}
+	}
+	
+	const std::uint64_t arg=static_cast<std::uint32_t>(stream)|(static_cast<std::uint64_t>(format)<<32);
+	reg.write(SDM_TRACE_READSTREAM,reg.id(object),arg,status,payload,size);
+}
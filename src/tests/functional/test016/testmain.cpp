@@ -0,0 +1,816 @@
+// Enable assertions even in Release builds
+#ifdef NDEBUG
+	#undef NDEBUG
+#endif
+
+#include "sdmplug.h"
+
+#include <iostream>
+#include <vector>
+#include <string>
+#include <chrono>
+#include <cstdint>
+#include <cassert>
+#include <cmath>
+#include <cstdio>
+#include <thread>
+#include <algorithm>
+#include <functional>
+
+// Number of plugin calls recorded by SDMStats for the function
+std::uint64_t statCalls(const std::string &function) {
+	std::uint64_t calls=0;
+	for(auto const &rec: SDMStats::records()) {
+		if(rec.function==function) calls+=rec.calls;
+	}
+	return calls;
+}
+
+void testCapabilities(SDMPlugin &plugin) {
+	std::cout<<"[0] Test plugin capabilities"<<std::endl;
+	
+	auto const &caps=plugin.capabilities();
+	assert(caps.size==sizeof(sdm_capabilities_t));
+	assert(caps.features&SDM_FEATURE_REGBATCH);
+	assert(caps.features&SDM_FEATURE_ACQUIRE);
+// Only natively implemented groups are reported
+	assert(!(caps.features&SDM_FEATURE_MULTISTREAM));
+	assert(caps.formats&(1<<SDM_SAMPLE_DOUBLE));
+	assert(caps.formats&(1<<SDM_SAMPLE_INT16));
+	assert(!(caps.formats&(1<<SDM_SAMPLE_INT8)));
+	assert(caps.threadSafety==SDM_THREADSAFE_DEVICE);
+	assert(caps.preferredPacketSize==6400);
+	assert(!plugin.functions().ptrReadStreams);
+	
+	std::cout<<"Seems to be OK"<<std::endl;
+}
+
+void testTypedReads(SDMDevice &dev) {
+	std::cout<<"[1] Test typed stream reads"<<std::endl;
+	
+	SDMSource src(dev,0);
+	src.setProperty("MsPerPacket","1");
+	assert(src.streamFormat(0)==SDM_SAMPLE_INT16);
+	assert(SDMSource::sampleSize(SDM_SAMPLE_INT16)==2);
+	
+	src.selectReadStreams({0,1},0,1);
+	
+	std::vector<std::int16_t> data0(6400);
+	std::vector<std::int8_t> data1(6400);
+	int r=src.readStreamTyped(0,data0.data(),data0.size(),SDM_SAMPLE_INT16);
+	assert(r==6400);
+	r=src.readStreamTyped(1,data1.data(),data1.size(),SDM_SAMPLE_INT8);
+	assert(r==6400);
+	
+	assert(data0[0]==0&&data1[0]==0);
+	assert(data0[1]==0&&data1[1]==1);
+	for(int i=400;i<1000;i++) {
+		assert(data0[i]==i);
+		assert(data1[i]==127); // saturated
+	}
+	src.readNextPacket();
+	
+	std::vector<float> fdata(6400);
+	r=src.readStreamTyped(0,fdata.data(),fdata.size(),SDM_SAMPLE_FLOAT);
+	assert(r==6400);
+	assert(fdata[0]==1.0f);
+	for(int i=400;i<1000;i++) assert(fdata[i]==static_cast<float>(i));
+	
+	std::cout<<"Seems to be OK"<<std::endl;
+}
+
+void testReadyNotification(SDMDevice &dev) {
+	std::cout<<"[2] Test readiness notification"<<std::endl;
+	
+	SDMSource src(dev,1);
+	src.setProperty("MsPerPacket","50");
+	assert(src.readyNotification());
+	
+	src.selectReadStreams({0},0,1);
+	src.waitReady(0); // reset pending notifications
+	
+	auto start=std::chrono::steady_clock::now();
+	bool notified=src.waitReady(5000);
+	auto elapsed=std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-start).count();
+	assert(notified);
+	assert(elapsed<2000);
+	
+	std::vector<sdm_sample_t> data(6400);
+	assert(src.readStream(0,data.data(),data.size(),SDMSource::NonBlocking)>0);
+	
+	std::cout<<"Seems to be OK"<<std::endl;
+}
+
+void testMultiStreamReads(SDMDevice &dev) {
+	std::cout<<"[3] Test multi-stream reads"<<std::endl;
+	
+	SDMSource src(dev,0);
+	src.setProperty("MsPerPacket","20");
+	src.selectReadStreams({0,1},0,1);
+	
+	const int streams[]={0,1};
+	std::vector<sdm_sample_t> data[2]={std::vector<sdm_sample_t>(6400),std::vector<sdm_sample_t>(6400)};
+	std::size_t total[2]={0,0};
+	bool finished[2]={false,false};
+	
+	while(!finished[0]||!finished[1]) {
+		sdm_sample_t *bufs[2];
+		std::size_t sizes[2];
+		int res[2];
+		for(int i=0;i<2;i++) {
+			sizes[i]=data[i].size()-total[i];
+			bufs[i]=data[i].data()+total[i];
+		}
+		src.readStreams(streams,bufs,sizes,res,2,SDMSource::AllowPartial);
+		for(int i=0;i<2;i++) {
+			assert(res[i]>=0);
+			if(res[i]==0) finished[i]=true;
+			total[i]+=res[i];
+		}
+	}
+	
+	assert(total[0]==6400&&total[1]==6400);
+	for(int i=400;i<1000;i++) assert(data[0][i]==i);
+	src.readNextPacket();
+	
+	std::cout<<"Seems to be OK"<<std::endl;
+}
+
+void testProperties(SDMDevice &dev) {
+	std::cout<<"[4] Test batch property access and property cache"<<std::endl;
+	
+	auto const &values=dev.getProperties({"Name","Setting1","NoSuchProperty"});
+	assert(values.size()==2);
+	assert(values.at("Name")=="Test device 1");
+	assert(values.at("Setting1")==dev.getProperty("Setting1"));
+	assert(dev.getProperties({}).empty());
+	
+	assert(dev.enablePropertyCache());
+	assert(dev.propertyCacheEnabled());
+	assert(dev.getProperty("Setting1")==values.at("Setting1"));
+	dev.setProperty("Setting1","cached");
+	assert(dev.getProperty("Setting1")=="cached");
+	assert(dev.getProperties({"Setting1"}).at("Setting1")=="cached");
+	
+// Changes made through another reference to the same device are seen
+// once the cache is revalidated
+	SDMDevice other(dev);
+	dev.setPropertyCacheInterval(std::chrono::hours(1));
+	other.setProperty("Setting1","changed");
+	assert(dev.getProperty("Setting1")=="cached");
+	dev.setPropertyCacheInterval(std::chrono::steady_clock::duration::zero());
+	assert(dev.getProperty("Setting1")=="changed");
+	assert(!dev.listProperties("*wr").empty());
+	
+	dev.enablePropertyCache(false);
+	assert(!dev.propertyCacheEnabled());
+	
+	std::cout<<"Seems to be OK"<<std::endl;
+}
+
+void testLockDomains(SDMPlugin &plugin,SDMDevice &dev) {
+	std::cout<<"[5] Test object mutexes"<<std::endl;
+	
+// testplugin is thread-safe at the device level: every device has its
+// own mutex, channels and sources use the mutex of their device
+	assert(plugin.capabilities().threadSafety==SDM_THREADSAFE_DEVICE);
+	
+	SDMChannel ch(dev,0);
+	SDMSource src(dev,0);
+	SDMDevice other(plugin,1);
+	SDMChannel otherCh(other,0);
+	
+	assert(dev.mutex()!=plugin.mutex());
+	assert(other.mutex()!=plugin.mutex());
+	assert(other.mutex()!=dev.mutex());
+	assert(ch.mutex()==dev.mutex());
+	assert(src.mutex()==dev.mutex());
+	assert(otherCh.mutex()==other.mutex());
+	
+// Channel methods lock the mutex themselves, so copies of a channel
+// sharing one write-back cache can be used from different threads
+	SDMChannel shared=ch;
+	shared.setCacheMode(SDMChannel::WriteBack);
+	std::vector<std::thread> threads;
+	for(sdm_addr_t t=0;t<4;t++) threads.emplace_back([shared,t]() mutable {
+		for(sdm_reg_t i=0;i<1000;i++) {
+			shared.writeReg(100+t,i);
+			assert(shared.readReg(100+t)==i);
+			if(i%100==0) shared.flush();
+		}
+	});
+	for(auto &thread: threads) thread.join();
+	shared.setCacheMode(SDMChannel::CacheOff);
+	for(sdm_addr_t t=0;t<4;t++) assert(ch.readReg(100+t)==999);
+	shared.close();
+	
+// The mutex must outlive the objects that use it
+	auto m=ch.mutex();
+	ch.close();
+	std::unique_lock<SDMBase::mutex_t> lock(*m);
+	
+	std::cout<<"Seems to be OK"<<std::endl;
+}
+
+void testDecimation(SDMDevice &dev) {
+	std::cout<<"[6] Test host-side decimation"<<std::endl;
+	
+// testplugin handles "df" by itself
+	SDMSource src(dev,0);
+	src.selectReadStreams({0},0,4);
+	assert(!src.hostDecimation());
+	src.close();
+	
+	std::vector<sdm_sample_t> in(100),out(1000);
+	for(std::size_t i=0;i<in.size();i++) in[i]=static_cast<sdm_sample_t>(i);
+	
+// Results must not depend on how the input is split
+	SDMDecimator plain(SDMDecimator::Plain,4);
+	std::size_t n=plain.process(in.data(),7,out.data());
+	n+=plain.process(in.data()+7,in.size()-7,out.data()+n);
+	assert(n==25);
+	for(std::size_t i=0;i<n;i++) assert(out[i]==in[i*4]);
+	
+	SDMDecimator avg(SDMDecimator::Average,4);
+	n=avg.process(in.data(),in.size(),out.data());
+	assert(n==25);
+	assert(out[1]==(1+2+3+4)/4.0); // output at sample 4 averages samples 1-4
+	
+// Filters must have unity DC gain
+	std::vector<sdm_sample_t> dc(1000,5.0);
+	for(auto mode: {SDMDecimator::Average,SDMDecimator::CIC,SDMDecimator::FIR}) {
+		SDMDecimator dec(mode,8);
+		n=dec.process(dc.data(),dc.size(),out.data());
+		assert(n==125);
+		assert(std::abs(out[n-1]-5.0)<1e-9);
+		assert(SDMDecimator::modeFromName(SDMDecimator::modeName(mode))==mode);
+	}
+	
+	std::cout<<"Seems to be OK"<<std::endl;
+}
+
+void testPrefetch(SDMDevice &dev) {
+	std::cout<<"[7] Test prefetching source"<<std::endl;
+	
+	SDMSource src(dev,0);
+	src.setProperty("MsPerPacket","1");
+	
+	SDMPrefetchSource prefetch(src,4);
+	prefetch.start({0,1});
+	assert(prefetch.running());
+	
+	SDMPrefetchSource::Packet packet;
+	sdm_uint64_t lastSeq=0;
+	for(int i=0;i<20;i++) {
+		bool r=prefetch.readPacket(packet,5000);
+		assert(r);
+		assert(packet.data.size()==2);
+		assert(packet.data[0].size()==6400);
+		assert(packet.data[1].size()==6400);
+		assert(packet.data[0][1]==0&&packet.data[1][1]==1); // stream ids
+		assert(packet.hasInfo);
+		if(i>0) assert(packet.info.sequence>lastSeq);
+		lastSeq=packet.info.sequence;
+	}
+	
+// Let the ring overflow, waiting no longer than 5 s. Packets may have
+// been dropped already while reading above, so wait for a new drop.
+// Packets are only dropped when the ring is full and nothing reads
+// from it now, so all slots stay occupied.
+	const std::uint64_t dropped=prefetch.dropped();
+	auto deadline=std::chrono::steady_clock::now()+std::chrono::seconds(5);
+	while(prefetch.dropped()==dropped&&std::chrono::steady_clock::now()<deadline)
+		std::this_thread::sleep_for(std::chrono::milliseconds(1));
+	assert(prefetch.dropped()>dropped);
+	assert(prefetch.available()==4);
+	
+	prefetch.stop();
+	assert(!prefetch.running());
+	
+	std::cout<<"Seems to be OK"<<std::endl;
+}
+
+void testTraceReplay(SDMDevice &dev,const std::string &replayPlugin) {
+	std::cout<<"[8] Test trace recording and replay"<<std::endl;
+	
+	const std::string traceFile="test016.trace";
+	
+// The device has been opened before the trace is started
+	SDMTrace::start(traceFile);
+	assert(SDMTrace::active());
+	
+	SDMChannel ch(dev,0);
+	ch.writeReg(5,0x1234);
+	const sdm_reg_t reg=ch.readReg(5);
+	std::vector<sdm_reg_t> mem(4);
+	ch.readMem(10,mem.data(),mem.size());
+	const sdm_reg_t async=ch.waitTransaction(ch.submitReadReg(6));
+	const sdm_addr64_t wide=0x100000010ULL;
+	ch.writeReg64(wide,0x123456789ABULL);
+	assert(ch.readReg64(wide)==0x123456789ABULL);
+	ch.modifyReg(5,0xFF,0x56);
+	
+	SDMSource src(dev,0);
+	src.setProperty("MsPerPacket","20");
+	src.selectReadStreams({0,1},0,1);
+	std::vector<std::vector<sdm_sample_t> > recorded;
+	std::vector<sdm_packet_info_t> infos;
+	for(int i=0;i<2;i++) {
+		for(int s=0;s<2;s++) {
+			std::vector<sdm_sample_t> data(6400);
+			int r=src.readStream(s,data.data(),data.size());
+			assert(r==6400);
+			recorded.push_back(data);
+		}
+		sdm_packet_info_t info;
+		assert(src.packetInfo(info));
+		infos.push_back(info);
+		assert(src.readStreamErrors()==0);
+		src.readNextPacket();
+	}
+	assert(infos[1].sequence==infos[0].sequence+1);
+	const std::string name=dev.getProperty("Name");
+	src.close();
+	ch.close();
+	
+	SDMTrace::stop();
+	assert(!SDMTrace::active());
+	
+	SDMPlugin replay(replayPlugin);
+	replay.setProperty("TraceFile",traceFile);
+	SDMDevice rdev(replay,0);
+	assert(rdev.getProperty("Name")==name);
+	rdev.connect();
+	
+	SDMChannel rch(rdev,0);
+	assert(rch.readReg(5)==reg);
+	
+// The replay plugin is thread-safe at the object level
+	assert(replay.capabilities().threadSafety==SDM_THREADSAFE_OBJECT);
+	assert(rdev.mutex()!=replay.mutex());
+	assert(rch.mutex()!=rdev.mutex());
+	std::vector<sdm_reg_t> rmem(4);
+	rch.readMem(10,rmem.data(),rmem.size());
+	assert(rmem==mem);
+	assert(rch.readReg(5)==reg); // the last value is repeated
+	
+// Asynchronous, 64-bit and read-modify-write calls are replayed too
+	assert(rch.waitTransaction(rch.submitReadReg(6))==async);
+	assert(rch.readReg64(wide)==0x123456789ABULL);
+	rch.modifyReg(5,0xFF,0x56);
+	assert(rch.readReg(5)==((reg&~0xFFu)|0x56));
+	
+// The replay starts over after the last packet, sequence numbers
+// keep growing
+	SDMSource rsrc(rdev,0);
+	assert(rsrc.mutex()!=rdev.mutex());
+	assert(rsrc.mutex()!=rch.mutex());
+	rsrc.selectReadStreams({0,1},0,1);
+	for(int i=0;i<4;i++) {
+		for(int s=0;s<2;s++) {
+			std::vector<sdm_sample_t> data(6400);
+			int r=rsrc.readStream(s,data.data(),data.size());
+			assert(r==6400);
+			assert(data==recorded[(i%2)*2+s]);
+		}
+		sdm_packet_info_t info;
+		assert(rsrc.packetInfo(info));
+		assert(info.sequence==infos[i%2].sequence+(i/2)*2);
+		assert(info.timestamp==infos[i%2].timestamp);
+		assert(rsrc.readStreamErrors()==0);
+		rsrc.readNextPacket();
+	}
+	
+// The replay plugin doesn't decimate, so "df" is handled by the host.
+// Packets are decimated independently (6400 is not a multiple of 3).
+	rsrc.selectReadStreams({0,1},0,3);
+	assert(rsrc.hostDecimation());
+	for(int i=0;i<2;i++) {
+		std::vector<sdm_sample_t> data(3000);
+		assert(rsrc.readStream(0,data.data(),data.size())==2134);
+		for(int j=0;j<2134;j++) assert(data[j]==recorded[i*2][j*3]);
+		std::vector<std::int16_t> data16(3000);
+		assert(rsrc.readStreamTyped(1,data16.data(),data16.size(),SDM_SAMPLE_INT16)==2134);
+		for(int j=0;j<2134;j++) assert(data16[j]==recorded[i*2+1][j*3]);
+		rsrc.readNextPacket();
+	}
+	rsrc.close();
+	
+// With the original timing, packets arrive at the recorded rate
+	replay.setProperty("Timing","Original");
+	SDMSource tsrc(rdev,0);
+	tsrc.selectReadStreams({0},0,1);
+	std::vector<sdm_sample_t> data(6400);
+	tsrc.readStream(0,data.data(),data.size());
+	tsrc.readNextPacket();
+	auto start=std::chrono::steady_clock::now();
+	tsrc.readStream(0,data.data(),data.size());
+	auto elapsed=std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-start).count();
+	assert(elapsed>=10);
+	tsrc.close();
+	
+	std::remove(traceFile.c_str());
+	
+	std::cout<<"Seems to be OK"<<std::endl;
+}
+
+void testThroughputMode(SDMDevice &dev) {
+	std::cout<<"[9] Test source throughput mode"<<std::endl;
+	
+	SDMSource src(dev,0);
+	src.setProperty("Mode","Throughput");
+	src.setProperty("PacketSize","1000");
+	src.setProperty("StreamCount","4");
+	src.setProperty("SampleRate","0");
+	src.selectReadStreams({0,3},0,1);
+	
+// Counter pattern continues across packets
+	std::vector<sdm_sample_t> data(1000);
+	std::vector<std::int16_t> data16(1000);
+	for(int p=0;p<20;p++) {
+		int r=src.readStream(3,data.data(),data.size());
+		assert(r==1000);
+		for(int i=0;i<r;i++) assert(data[i]==(p*1000+i)%16384);
+		r=src.readStreamTyped(0,data16.data(),data16.size(),SDM_SAMPLE_INT16);
+		assert(r==1000);
+		assert(data16[999]==(p*1000+999)%16384);
+		src.readNextPacket();
+	}
+	
+	const sdm_sample_t *ptr;
+	std::size_t n;
+	assert(src.acquirePacket(0,ptr,n)==0);
+	assert(n==1000&&ptr[0]==(20*1000)%16384);
+	src.releasePacket(0);
+	src.readNextPacket();
+	
+// 1000-sample packets at 100 kS/s take 10 ms each
+	src.setProperty("SampleRate","100000");
+	src.selectReadStreams({0},0,1);
+	auto start=std::chrono::steady_clock::now();
+	for(int p=0;p<3;p++) {
+		assert(src.readStream(0,data.data(),data.size())==1000);
+		src.readNextPacket();
+	}
+	auto elapsed=std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-start).count();
+	assert(elapsed>=25);
+	
+	std::cout<<"Seems to be OK"<<std::endl;
+}
+
+void testLinkSimulation(SDMDevice &dev) {
+	std::cout<<"[10] Test register link simulation"<<std::endl;
+	
+	SDMChannel ch(dev,1);
+	
+// Sparse address space
+	const sdm_addr_t sparse=0x10000000;
+	ch.writeReg(sparse+0x123456,42);
+	assert(ch.readReg(sparse+0x123456)==42);
+	assert(ch.readReg(sparse+0x123457)==0);
+	std::vector<sdm_reg_t> mem {1,2,3,4};
+	ch.writeMem(sparse+0xFFFF00,mem.data(),mem.size());
+	std::vector<sdm_reg_t> rmem(4);
+	ch.readMem(sparse+0xFFFF00,rmem.data(),rmem.size());
+	assert(rmem==mem);
+	
+// Link parameters are typed properties
+	bool rejected=false;
+	try {
+		ch.setProperty("Latency","fast");
+	}
+	catch(std::exception &) {
+		rejected=true;
+	}
+	assert(rejected);
+	ch.setProperty("Latency","2000");
+	ch.setProperty("MaxOutstanding","10");
+	
+	std::vector<sdm_addr_t> addrs;
+	for(sdm_addr_t i=0;i<10;i++) addrs.push_back(sparse+i);
+	std::vector<sdm_reg_t> values(addrs.size());
+	
+	auto start=std::chrono::steady_clock::now();
+	for(auto addr: addrs) ch.readReg(addr);
+	auto single=std::chrono::steady_clock::now()-start;
+	assert(single>=std::chrono::milliseconds(20));
+	
+// A batch is a single transaction, asynchronous transactions are
+// submitted without waiting for the previous ones
+	SDMStats::reset();
+	SDMStats::setEnabled(true);
+	ch.readRegs(addrs.data(),values.data(),addrs.size());
+	assert(statCalls("sdmReadRegs")==1);
+	assert(statCalls("sdmReadReg")==0);
+	
+	std::vector<int> tokens;
+	for(auto addr: addrs) tokens.push_back(ch.submitReadReg(addr));
+	assert(!ch.pollTransaction(tokens.back()));
+	for(int token: tokens) ch.waitTransaction(token);
+	SDMStats::setEnabled(false);
+	assert(statCalls("sdmSubmitReadReg")==addrs.size());
+	assert(statCalls("sdmReadReg")==0);
+	
+	ch.setProperty("Latency","0");
+	
+// Batches are split according to the plugin-reported limit
+	addrs.clear();
+	for(sdm_addr_t i=0;i<1000;i++) addrs.push_back(sparse+0x1000+2*i);
+	values.resize(addrs.size());
+	for(std::size_t i=0;i<values.size();i++) values[i]=static_cast<sdm_reg_t>(i*3);
+	SDMStats::reset();
+	SDMStats::setEnabled(true);
+	ch.writeRegs(addrs.data(),values.data(),addrs.size());
+	std::vector<sdm_reg_t> rvalues(addrs.size());
+	ch.readRegs(addrs.data(),rvalues.data(),addrs.size());
+	SDMStats::setEnabled(false);
+	assert(rvalues==values);
+	const std::size_t limit=ch.plugin().capabilities().maxRegBatch;
+	assert(limit>0&&limit<addrs.size());
+	const std::uint64_t batches=(addrs.size()+limit-1)/limit;
+	assert(statCalls("sdmWriteRegs")==batches);
+	assert(statCalls("sdmReadRegs")==batches);
+	
+	std::cout<<"Seems to be OK"<<std::endl;
+}
+
+void testRingBufferSource(SDMDevice &dev) {
+	std::cout<<"[11] Test ring buffer source"<<std::endl;
+	
+	SDMSource src(dev,3);
+	src.setProperty("MsPerPacket","1");
+	src.setProperty("PacketSize","500");
+	src.selectReadStreams({2,0},0,1);
+	
+// Counter continues across packets and partial reads
+	std::vector<sdm_sample_t> data(300);
+	for(int p=0;p<10;p++) {
+		assert(src.readStream(0,data.data(),data.size())==300);
+		for(int i=0;i<300;i++) assert(data[i]==(p*500+i)%16384);
+		assert(src.readStream(0,data.data(),data.size())==200);
+		assert(data[199]==(p*500+499)%16384);
+		assert(src.readStream(0,data.data(),data.size())==0); // end of packet
+		
+		sdm_packet_info_t info;
+		assert(src.packetInfo(info));
+		assert(info.sequence==static_cast<sdm_uint64_t>(p));
+		assert((info.flags&SDM_PACKETINFO_TIMESTAMP)&&info.timestamp==static_cast<sdm_uint64_t>(p));
+		src.readNextPacket();
+	}
+	
+	const sdm_sample_t *ptr;
+	std::size_t n;
+	assert(src.acquirePacket(2,ptr,n)==0);
+	assert(n==500&&ptr[0]==(10*500)%16384);
+	src.releasePacket(2);
+	src.readNextPacket();
+	
+// The ring holds 16 packets, the rest are dropped and counted as errors
+// and leave a gap in sequence numbers
+	std::this_thread::sleep_for(std::chrono::milliseconds(100));
+	assert(src.readStreamErrors()>0);
+	sdm_uint64_t last=0;
+	bool gap=false;
+	for(int p=0;p<20;p++) {
+		assert(src.readStream(0,data.data(),data.size())==300);
+		sdm_packet_info_t info;
+		assert(src.packetInfo(info)&&(info.flags&SDM_PACKETINFO_SEQUENCE));
+		assert(info.sequence==info.timestamp); // both count produced packets
+		if(p>0&&info.sequence>last+1) gap=true;
+		last=info.sequence;
+		src.readNextPacket();
+	}
+	assert(gap);
+	src.discardPackets();
+	assert(src.readStreamErrors()==0);
+	assert(src.readStream(0,data.data(),data.size())==300);
+	
+	std::cout<<"Seems to be OK"<<std::endl;
+}
+
+void testTypedProperties(SDMDevice &dev) {
+	std::cout<<"[12] Test typed properties"<<std::endl;
+	
+	SDMSource src(dev,0);
+	
+// Values that don't match the property type are rejected
+	const char *bad[][2]={{"Mode","Bogus"},{"PacketSize","12x"},{"StreamCount",""},{"SampleRate","fast"}};
+	for(auto const &item: bad) {
+		bool rejected=false;
+		try {
+			src.setProperty(item[0],item[1]);
+		}
+		catch(std::exception &) {
+			rejected=true;
+		}
+		assert(rejected);
+	}
+	assert(src.getProperty("Mode")=="Normal");
+	assert(src.getProperty("PacketSize")=="6400");
+	
+	src.setProperty("SampleRate","2.5e3");
+	assert(src.getProperty("SampleRate")=="2.5e3");
+	src.setProperty("SampleRate","0");
+	
+	std::cout<<"Seems to be OK"<<std::endl;
+}
+
+void testBursts(SDMDevice &dev) {
+	std::cout<<"[13] Test burst transfers"<<std::endl;
+	
+	SDMChannel ch(dev,1);
+	ch.setProperty("MaxBurst","4");
+	ch.setProperty("BurstBoundary","8");
+	ch.setProperty("BurstCount","0");
+	
+// Memory bursts don't cross the boundary: 2-6, 6-8, 8-12, 12-16, 16-18
+	const sdm_addr_t sparse=0x10000000;
+	std::vector<sdm_reg_t> mem(16),rmem(16);
+	for(std::size_t i=0;i<mem.size();i++) mem[i]=static_cast<sdm_reg_t>(i*3+1);
+	ch.writeMem(sparse+2,mem.data(),mem.size());
+	assert(ch.getProperty("BurstCount")=="5");
+	ch.readMem(sparse+2,rmem.data(),rmem.size());
+	assert(rmem==mem);
+	assert(ch.getProperty("BurstCount")=="10");
+	
+// FIFO bursts are limited by length only
+	std::vector<sdm_reg_t> fifo(10),rfifo(10),drain(100);
+	for(std::size_t i=0;i<fifo.size();i++) fifo[i]=static_cast<sdm_reg_t>(100+i);
+	ch.readFIFO(0,drain.data(),drain.size());
+	ch.setProperty("BurstCount","0");
+	ch.writeFIFO(0,fifo.data(),fifo.size());
+	ch.readFIFO(0,rfifo.data(),rfifo.size());
+	assert(rfifo==fifo);
+	assert(ch.getProperty("BurstCount")=="6");
+	
+// Without pipelining bursts are issued one at a time, pipelining keeps
+// two bursts in flight
+	ch.setProperty("BurstBoundary","0");
+	ch.setProperty("Latency","5000");
+	ch.setProperty("MaxOutstanding","2");
+	ch.setProperty("BurstCount","0");
+	ch.setProperty("PeakBursts","0");
+	ch.readMem(sparse+2,rmem.data(),rmem.size());
+	assert(rmem==mem);
+	assert(ch.getProperty("BurstCount")=="4");
+	assert(ch.getProperty("PeakBursts")=="1");
+	
+	ch.setProperty("BurstPipelining","true");
+	ch.setProperty("BurstCount","0");
+	ch.readMem(sparse+2,rmem.data(),rmem.size());
+	assert(rmem==mem);
+	assert(ch.getProperty("BurstCount")=="4");
+	assert(ch.getProperty("PeakBursts")=="2");
+	
+	ch.setProperty("BurstPipelining","false");
+	ch.setProperty("Latency","0");
+	ch.setProperty("MaxOutstanding","1");
+	ch.setProperty("MaxBurst","0");
+	
+	std::cout<<"Seems to be OK"<<std::endl;
+}
+
+void testErrorReporting(SDMPlugin &plugin,SDMDevice &dev) {
+	std::cout<<"[14] Test plugin error messages"<<std::endl;
+	
+	assert(plugin.capabilities().features&SDM_FEATURE_LASTERROR);
+	assert(plugin.functions().ptrGetLastError);
+	
+// Messages of exceptions caught by the plugin are passed to the client
+	SDMSource src(dev,0);
+	std::string what;
+	try {
+		src.setProperty("PacketSize","12x");
+	}
+	catch(std::exception &ex) {
+		what=ex.what();
+	}
+	assert(what.find("Bad value for property \"PacketSize\"")!=std::string::npos);
+	
+	what.clear();
+	try {
+		src.getProperty("NoSuchProperty");
+	}
+	catch(std::exception &ex) {
+		what=ex.what();
+	}
+	assert(what.find("not found")!=std::string::npos);
+	
+// The message is consumed once retrieved and not attributed to later errors
+	assert(src.getProperty("NoSuchProperty","default")=="default");
+	SDMChannel ch(dev,0);
+	bool failed=false;
+	try {
+		ch.writeReg(300,0);
+	}
+	catch(sdmplugin_error &ex) {
+		failed=true;
+		assert(ex.errorCode()==SDM_ERROR);
+		assert(ex.details().empty());
+	}
+	assert(failed);
+	assert(plugin.functions().lastError().empty());
+	
+	std::cout<<"Seems to be OK"<<std::endl;
+}
+
+void testFramer(SDMDevice &dev) {
+	std::cout<<"[15] Test byte stream framer"<<std::endl;
+	
+	SDMSource src(dev,4);
+	assert(!src.readyNotification()); // data are only read on demand
+	src.setProperty("FrameSize","50");
+	src.setProperty("NoiseBytes","5");
+	src.selectReadStreams({0,1},0,1);
+	
+// Frames are found between noise bytes, even if split between reads
+	std::vector<sdm_sample_t> s0(50),s1(50);
+	for(int p=0;p<100;p++) {
+		assert(src.readStream(0,s0.data(),s0.size())==50);
+		assert(src.readStream(1,s1.data(),s1.size())==50);
+		for(int i=0;i<50;i++) {
+			assert(s0[i]==p*50+i);
+			assert(s1[i]==-s0[i]);
+		}
+		assert(src.readStream(0,s0.data(),s0.size())==0); // end of packet
+		src.readNextPacket();
+	}
+	
+// Sources that can't lend their memory are served from a library-side copy
+	const sdm_sample_t *ptr;
+	std::size_t n;
+	assert(src.acquirePacket(0,ptr,n)==0);
+	assert(n==50&&ptr[0]==100*50);
+	src.releasePacket(0);
+	assert(src.acquirePacket(1,ptr,n)==0);
+	assert(n==50&&ptr[49]==-(100*50+49));
+	src.releasePacket(1);
+	src.readNextPacket();
+	assert(std::stoi(src.getProperty("SkippedBytes"))>=99*5);
+	
+// Lost frames show up as gaps in packet sequence numbers
+	src.setProperty("DropFrames","3");
+	src.selectReadStreams({0,1},0,1);
+	sdm_packet_info_t info;
+	sdm_uint64_t first=0,last=0;
+	for(int p=0;p<10;p++) {
+		assert(src.readStream(0,s0.data(),s0.size())==50);
+		assert(src.readStream(1,s1.data(),s1.size())==50);
+		assert(src.packetInfo(info)&&(info.flags&SDM_PACKETINFO_SEQUENCE));
+		if(p==0) first=info.sequence;
+		last=info.sequence;
+		src.readNextPacket();
+	}
+	assert(last-first-9==4); // frames 2, 5, 8 and 11 are lost
+	assert(src.readStreamErrors()>0);
+	src.setProperty("DropFrames","0");
+	
+	std::cout<<"Seems to be OK"<<std::endl;
+}
+
+// Usage: test016 testplugin replayplugin [section]
+// Each section is registered as a separate test, all sections are run
+// if none is specified
+
+int main(int argc,char *argv[]) {
+	assert(argc>2);
+	
+	SDMPlugin plugin(argv[1]);
+	plugin.setProperty("Verbosity","Quiet");
+	SDMDevice dev(plugin,0);
+	dev.connect();
+	
+	const std::vector<std::pair<std::string,std::function<void()> > > sections={
+		{"capabilities",[&]{testCapabilities(plugin);}},
+		{"typedreads",[&]{testTypedReads(dev);}},
+		{"ready",[&]{testReadyNotification(dev);}},
+		{"multistream",[&]{testMultiStreamReads(dev);}},
+		{"properties",[&]{testProperties(dev);}},
+		{"locks",[&]{testLockDomains(plugin,dev);}},
+		{"decimation",[&]{testDecimation(dev);}},
+		{"prefetch",[&]{testPrefetch(dev);}},
+		{"replay",[&]{testTraceReplay(dev,argv[2]);}},
+		{"throughput",[&]{testThroughputMode(dev);}},
+		{"link",[&]{testLinkSimulation(dev);}},
+		{"ringbuffer",[&]{testRingBufferSource(dev);}},
+		{"typedprops",[&]{testTypedProperties(dev);}},
+		{"bursts",[&]{testBursts(dev);}},
+		{"errors",[&]{testErrorReporting(plugin,dev);}},
+		{"framer",[&]{testFramer(dev);}}
+	};
+	
+	const std::string only=(argc>3)?argv[3]:"";
+	bool found=false;
+	for(auto const &section: sections) {
+		if(!only.empty()&&section.first!=only) continue;
+		section.second();
+		found=true;
+	}
+	if(!found) {
+		std::cout<<"Unknown test section: "<<only<<std::endl;
+		return 1;
+	}
+	
+	std::cout<<"Test finished successfully"<<std::endl;
+	return 0;
+}